@@ -17,6 +17,9 @@ uniform sampler2D texMaterial;
 uniform samplerCube texPrefilteredEnvMap;  // prefilltered diffuse cube map
 uniform samplerCube texSourceEnvMap;       // full cube map
 uniform int num_mipmaps; 	       	   // number of mipmaps of texSourceEnvMap
+uniform samplerCube texSpecularEnvMap;     // GGX prefiltered cube map, mipmaps for increasing roughness
+uniform int num_specular_mipmaps;          // last mipmap level of texSpecularEnvMap (roughness = 1)
+uniform sampler2D texBRDFLUT;              // split-sum BRDF integral: scale (r) and bias (g) of F0 for (N.V, roughness)
 
 // Camera/light/matrices
 uniform vec3 cameraPos; 	// View Camera Position
@@ -46,7 +49,7 @@ uniform float gui_LightPower;		// Light power variable
 uniform float gui_LightRadius;		// Light radius variable
 uniform float gui_SpecularIntensity;	// Intensity of Specular effect
 uniform float gui_DiffuseIntensity;	// Intensity of Diffuse effect
-uniform int gui_noPBRRays;		// Number of rays taken in high quality PRB calulations
+uniform int gui_noPBRRays;		// Number of rays taken in high quality PRB calulations (not used by split-sum PBR below)
 
 // UV related variables
 uniform  float gui_depthScale;		// UV relief depth scale 
@@ -283,104 +286,32 @@ vec3 Fresnel_Schlick(float cosT, vec3 F0)
 }
 
 
-// randon number starting seed
-ivec2 seed = ivec2(+64523*length(WSPosition.yz)*gl_FragCoord.y,
-                   +62310*length(WSPosition.xz)*gl_FragCoord.x);
-
-
-// Random number generator based on:
-// http://www.reedbeta.com/blog/2013/01/12/quick-and-easy-gpu-random-numbers-in-d3d11/
-vec2 wang_hash()
-{
-    seed = (seed ^ 61) ^ (seed >> 16);
-    seed *= 9;
-    seed = seed ^ (seed >> 4);
-    seed *= 0x27d4eb2d;
-    seed = seed ^ (seed >> 15);
-    return seed*(1.0 / 4294967296.0);
-}
-
-vec3 calc_random_vec(float roughness,vec3 up,vec3 right,vec3 dir){
-
-    vec2 fseed = clamp(wang_hash(),vec2(0),vec2(1));
-
-
-    float theta = atan(roughness*sqrt(fseed.x)/sqrt(1-fseed.x));
-    float phi   = 4*PI*fseed.y;
-    vec3 temp = cos(phi) * up + sin(phi) * right;
-    return (cos(theta) * dir + sin(theta) * temp);
-}
-
-// Based on:
-// http://www.codinglabs.net/article_physically_based_rendering_cook_torrance.aspx
+// Split-sum approximation of the specular integral:
+// http://blog.selfshadow.com/publications/s2013-shading-course/karis/s2013_pbs_epic_notes_v2.pdf
+// The radiance is prefiltered with GGX lobe (roughness selects the mipmap) and
+// the BRDF integral is read from the lookup table, both computed once per skybox.
 vec4 PBR_Specular(float roughness,
                   vec3 F0,
                   inout vec3 kS,
-                  samplerCube texSourceEnvMap,
+                  samplerCube texSpecularEnvMap,
                   vec3 surfacePosition,
                   vec3 surfaceNormal,vec2 texcoords){
 
-
-
     vec3 v = normalize(cameraPos - surfacePosition);
     vec3 n = surfaceNormal; // approximated normal in world space
-    //vec3 n = normalize(surfaceNormal);// face based normal
     vec3 l = normalize(reflect(-v,n));
-    vec3 h = normalize(l + v);
-
-    vec3 up     = vec3(0,1,0);
-    vec3 right  = normalize(cross(up,l));
-    up          = cross(l,right);
-
-    vec3 radiance  = vec3(0);
-    float  NdotV     = clamp(dot(n, v),0,1);
-
-
-    //int no_mipmap = textureQueryLevels(texSourceEnvMap); // get number of mipmaps
-
-    int no_samples =  gui_noPBRRays;
-    // do the lighting calculation for each fragment.
-
-    float r2 = roughness * roughness;
-    for(int i = 0 ; i < no_samples ; i++ ){
-         vec3 lp =  calc_random_vec(r2,up,right,l);
-
-
-
-         // Calculate the half vector
-         vec3 halfVector = normalize(lp + v);
-
+    float NdotV = clamp(dot(n, v),0.001,1.0);
 
-         float VdotH = clamp(dot( halfVector, v ),0.01,1.0);
-         float HdotN = max(dot( halfVector, n ),0.01);
-         float LdotN = max(dot( lp, n ),0.01);
-         float LdotH = max(dot( lp, halfVector ),0.01);
+    vec3 prefiltered = textureLod( texSpecularEnvMap, l, roughness * num_specular_mipmaps ).rgb;
+    vec2 brdf        = texture( texBRDFLUT, vec2(NdotV, roughness) ).rg;
 
+    float light = max(dot(normalizedLightDirection,l),0.0);
+    light       = 1-exp(-pow((5*gui_LightRadius*light),4));
 
-         vec3 fresnel   = Fresnel_Schlick( (1-VdotH), F0 );
-
-         // Geometry term
-         float geometry = GGX_PartialGeometryTerm_OPT( VdotH, NdotV, r2)
-                        * GGX_PartialGeometryTerm_OPT( LdotH, LdotN, r2);
-
-         // Calculate the Cook-Torrance denominator
-         float denominator = clamp( 4 * (NdotV * HdotN + 0.05) ,0,1);
-
-         kS += fresnel ;
-
-
-         // Accumulate the radiance
-         float light = max(dot(normalizedLightDirection,lp),0.0);         
-         light       = 1-exp(-pow((5*gui_LightRadius*light),4));
-
-         vec3 color = texture( texSourceEnvMap, lp ).rgb * exp(-0.1*gui_LightPower) + gui_LightPower * light *0.4;
-
-         radiance +=  color  * geometry/denominator * fresnel ;
+    vec3 color = prefiltered * exp(-0.1*gui_LightPower) + gui_LightPower * light *0.4;
 
-    }
-    // Scale back for the samples count
-    kS = clamp( kS / no_samples ,0,1);
-    return vec4(radiance / no_samples,1);
+    kS = clamp( Fresnel_Schlick( 1-NdotV, F0 ) ,0,1);
+    return vec4(color * (F0 * brdf.x + brdf.y),1);
 }
 
 vec4 PBR_Specular_SIMPLE(float roughness,
@@ -542,7 +473,7 @@ void main( void )
         }else{
              specular =    PBR_Specular(roughness,
                                         F0,kS,
-                                        texSourceEnvMap,
+                                        texSpecularEnvMap,
                                         WSPosition,
                                         surfaceNormal,texcoords);
         }
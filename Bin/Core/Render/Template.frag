@@ -19,6 +19,9 @@ uniform sampler2D texMaterial;
 uniform samplerCube texPrefilteredEnvMap;  // prefilltered diffuse cube map
 uniform samplerCube texSourceEnvMap;       // full cube map
 uniform int num_mipmaps; 	       	   // number of mipmaps of texSourceEnvMap
+uniform samplerCube texSpecularEnvMap;     // GGX prefiltered cube map, mipmaps for increasing roughness
+uniform int num_specular_mipmaps;          // last mipmap level of texSpecularEnvMap (roughness = 1)
+uniform sampler2D texBRDFLUT;              // split-sum BRDF integral: scale (r) and bias (g) of F0 for (N.V, roughness)
 
 // Camera/light/matrices
 uniform vec3 cameraPos; 	// View Camera Position
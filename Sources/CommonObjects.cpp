@@ -1,4 +1,10 @@
 #include "CommonObjects.h"
+#include "utils/parallel.h"
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
 
 
 SeamlessMode FBOImageProporties::seamlessMode             = SEAMLESS_NONE;
@@ -27,219 +33,336 @@ QString  PostfixNames::metallicName   = "_m";
 
 QString  PostfixNames::outputFormat  = ".png";
 
-bool FBOImages::bUseLinearInterpolation = true;
-
-void TargaImage::write(QImage image, QString fileName){
-
-
-    TargaColorFormat format = TARGA_BGRA;
-    unsigned char   *pixels;
-    int              width,height;
+ChannelPacking::ChannelPacking(TextureTypes type, const QString& postfix):
+    outputType(type),postfix(postfix){
+    for(int c = 0 ; c < 4 ; c++) setConstant(c,1.0);
+}
 
-    width  = image.width();
-    height = image.height();
-    pixels = new unsigned char [width * height * 4];
+void ChannelPacking::setChannel(int channel, TextureTypes source, int sourceChannel){
+    sources  [channel] = source;
+    channels [channel] = sourceChannel;
+    constants[channel] = 0.0;
+}
 
-    unsigned char* imageBuffer  = image.bits();
-    int w = width;
-    int h = height;
+void ChannelPacking::setConstant(int channel, float value){
+    sources  [channel] = PACK_CONSTANT;
+    channels [channel] = 0;
+    constants[channel] = value;
+}
 
-    for(int i = 0; i < height; i++)
-       for(int j = 0; j < width; j++)
-        {
-          pixels[4 * ((h-i-1) * w + j) + 0] = imageBuffer[4 * (i * w + j)+0  ];
-          pixels[4 * ((h-i-1) * w + j) + 1] = imageBuffer[4 * (i * w + j)+1  ];
-          pixels[4 * ((h-i-1) * w + j) + 2] = imageBuffer[4 * (i * w + j)+2  ];
-          pixels[4 * ((h-i-1) * w + j) + 3] = imageBuffer[4 * (i * w + j)+3  ];
+QList<ChannelPacking> ChannelPacking::layout(CompressedFromTypes type){
+    QList<ChannelPacking> images;
+    switch(type){
+        case(H_TO_D_AND_S_TO_N):
+        case(S_TO_D_AND_H_TO_N):{
+            TextureTypes diffuseAlpha = (type == H_TO_D_AND_S_TO_N) ? HEIGHT_TEXTURE   : SPECULAR_TEXTURE;
+            TextureTypes normalAlpha  = (type == H_TO_D_AND_S_TO_N) ? SPECULAR_TEXTURE : HEIGHT_TEXTURE;
+            ChannelPacking diffuse(DIFFUSE_TEXTURE);
+            ChannelPacking normal (NORMAL_TEXTURE);
+            for(int c = 0 ; c < 3 ; c++){
+                diffuse.setChannel(c,DIFFUSE_TEXTURE,c);
+                normal .setChannel(c,NORMAL_TEXTURE ,c);
+            }
+            diffuse.setChannel(3,diffuseAlpha,0);
+            normal .setChannel(3,normalAlpha ,0);
+            images << diffuse << normal;
+            break;
         }
-    bool test = save_targa(fileName.toStdString().c_str(),width,height,format,pixels);
-    if(test == false) qWarning() << "Cannot save image to targa file:" << fileName ;
-    delete[] pixels;
+        case(O_R_M_PACKED):{
+            // diffuse and normal are saved unchanged next to the packed image
+            ChannelPacking diffuse(DIFFUSE_TEXTURE);
+            ChannelPacking normal (NORMAL_TEXTURE);
+            ChannelPacking orm    (SPECULAR_TEXTURE,"_orm");
+            for(int c = 0 ; c < 3 ; c++){
+                diffuse.setChannel(c,DIFFUSE_TEXTURE,c);
+                normal .setChannel(c,NORMAL_TEXTURE ,c);
+            }
+            orm.setChannel(0,OCCLUSION_TEXTURE,0);
+            orm.setChannel(1,ROUGHNESS_TEXTURE,0);
+            orm.setChannel(2,METALLIC_TEXTURE ,0);
+            images << diffuse << normal << orm;
+            break;
+        }
+    }
+    return images;
 }
 
+bool FBOImages::bUseLinearInterpolation = true;
 
+// ------------------------------------------------------- //
+//                  TGA pixel conversions
+// ------------------------------------------------------- //
+// All functions expand pixels to 32 bit BGRA which is the memory layout of
+// QImage::Format_ARGB32 on little endian machines.
+
+static void targaBGRToBGRA(const unsigned char* src, quint32* dst, int count){
+    int x = 0;
+#if defined(__SSSE3__)
+    const __m128i shuffle = _mm_setr_epi8(0,1,2,-1,3,4,5,-1,6,7,8,-1,9,10,11,-1);
+    const __m128i alpha   = _mm_set1_epi32((int)0xFF000000);
+    // each load reads 16 bytes but only 12 are used, stop before the end
+    for(; x + 6 <= count ; x += 4){
+        __m128i bgr = _mm_loadu_si128((const __m128i*)(src + 3*x));
+        _mm_storeu_si128((__m128i*)(dst + x), _mm_or_si128(_mm_shuffle_epi8(bgr,shuffle),alpha));
+    }
+#endif
+    for(; x < count ; x++){
+        const unsigned char* p = src + 3*x;
+        dst[x] = 0xFF000000u | (quint32(p[2]) << 16) | (quint32(p[1]) << 8) | quint32(p[0]);
+    }
+}
 
-bool TargaImage::save_targa (const char *filename, int width, int height,
-                      TargaColorFormat format, unsigned char *pixels)
-
-{
-    // check format of the file
-    if (format != TARGA_BGR && format != TARGA_BGRA && format != TARGA_LUMINANCE)
-        return false;
+static void targaLToBGRA(const unsigned char* src, quint32* dst, int count){
+    int x = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+    for(; x + 16 <= count ; x += 16){
+        __m128i l  = _mm_loadu_si128((const __m128i*)(src + x));
+        __m128i lo = _mm_unpacklo_epi8(l,l);
+        __m128i hi = _mm_unpackhi_epi8(l,l);
+        _mm_storeu_si128((__m128i*)(dst + x +  0), _mm_or_si128(_mm_unpacklo_epi16(lo,lo),alpha));
+        _mm_storeu_si128((__m128i*)(dst + x +  4), _mm_or_si128(_mm_unpackhi_epi16(lo,lo),alpha));
+        _mm_storeu_si128((__m128i*)(dst + x +  8), _mm_or_si128(_mm_unpacklo_epi16(hi,hi),alpha));
+        _mm_storeu_si128((__m128i*)(dst + x + 12), _mm_or_si128(_mm_unpackhi_epi16(hi,hi),alpha));
+    }
+#endif
+    for(; x < count ; x++){
+        dst[x] = 0xFF000000u | (quint32(src[x]) * 0x010101u);
+    }
+}
 
+static void targaToBGRA(const unsigned char* src, quint32* dst, int count, TargaColorFormat format){
+    switch(format){
+        case(TARGA_BGRA):      memcpy(dst,src,count*4);        break;
+        case(TARGA_BGR):       targaBGRToBGRA(src,dst,count);  break;
+        case(TARGA_LUMINANCE): targaLToBGRA(src,dst,count);    break;
+    }
+}
 
-    // open file
-    FILE *tga = fopen (filename,"wb");
+bool TargaImage::write(const QImage& _image, const QString& fileName, bool bRLE){
+    // ARGB32 and RGB32 are already stored as BGRA
+    QImage image = _image;
+    if(image.format() != QImage::Format_ARGB32 && image.format() != QImage::Format_RGB32)
+        image = image.convertToFormat(QImage::Format_ARGB32);
 
-    // check if file is good
-    if (tga == NULL)
+    int width  = image.width();
+    int height = image.height();
+    if(image.isNull() || width > 0xFFFF || height > 0xFFFF){
+        qWarning() << "Cannot save image to targa file:" << fileName << "invalid image size.";
         return false;
+    }
 
-    // create TGA header
     unsigned char header [TARGA_HEADER_SIZE];
-
-    // clear header
     memset (header,0,TARGA_HEADER_SIZE);
-
-    // set proper format for image
-    if (format == TARGA_BGR || format == TARGA_BGRA)
-        header [2] = TARGA_UNCOMP_RGB_IMG;
-    else
-        if (format == TARGA_LUMINANCE)
-            header [2] = TARGA_UNCOMP_BW_IMG;
-
-    // set width
+    header [2]  = bRLE ? TARGA_RLE_RGB_IMG : TARGA_UNCOMP_RGB_IMG;
     header [12] = (unsigned char)width;
     header [13] = (unsigned char)(width >> 8);
-
-    // set height
     header [14] = (unsigned char)height;
     header [15] = (unsigned char)(height >> 8);
+    header [16] = 32;
+    // rows are written from the top, 8 bits of alpha
+    header [17] = TARGA_TOP_LEFT_ORIGIN | 8;
 
-    // set bitrate
-    if (format == TARGA_BGRA)
-        header [16] = 32;
-    else
-        if (format == TARGA_BGR)
-            header [16] = 24;
-        else
-            if (format == TARGA_LUMINANCE)
-                header [16] = 8;
-
-    // write header
-    fwrite (header,TARGA_HEADER_SIZE,1,tga);
-
-    // write data
-    if (format == TARGA_BGRA)
-        fwrite (pixels,width*height*4,1,tga);
-    else
-        if (format == TARGA_BGR)
-            fwrite (pixels,width*height*3,1,tga);
-        else
-            if (format == TARGA_LUMINANCE)
-                fwrite (pixels,width*height,1,tga);
-
-    // close image
-    fclose (tga);
-
-    // done
-    return true;
-}
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly)){
+        qWarning() << "Cannot save image to targa file:" << fileName << file.errorString();
+        return false;
+    }
+    bool bOk = (file.write((const char*)header,TARGA_HEADER_SIZE) == TARGA_HEADER_SIZE);
+
+    if(bRLE){
+        // packets do not cross rows, so each thread encodes its own rows
+        const int minRows = 64;
+        std::vector<QByteArray> chunks(parallelRanges(height,minRows));
+        parallelFor(height,[&](int begin,int end,int range){
+            QByteArray& out = chunks[range];
+            out.reserve((end - begin)*width*2);
+            for(int y = begin ; y < end ; y++){
+                encodeRLE((const quint32*)image.constScanLine(y),width,out);
+            }
+        },minRows);
+        for(size_t c = 0 ; c < chunks.size() && bOk ; c++){
+            bOk = (file.write(chunks[c]) == chunks[c].size());
+        }
+    }else if(image.bytesPerLine() == width*4){
+        qint64 noBytes = qint64(width)*height*4;
+        bOk = bOk && (file.write((const char*)image.constBits(),noBytes) == noBytes);
+    }else{
+        for(int y = 0 ; y < height && bOk ; y++){
+            bOk = (file.write((const char*)image.constScanLine(y),width*4) == width*4);
+        }
+    }
 
+    if(!bOk) qWarning() << "Cannot save image to targa file:" << fileName << file.errorString();
+    file.close();
+    return bOk;
+}
 
-QImage TargaImage::read(QString fileName){
-    int              width,height;
-    TargaColorFormat format;
-    unsigned char   *pixels;
+void TargaImage::encodeRLE(const quint32* row, int width, QByteArray& out){
+    int x = 0;
+    while(x < width){
+        // run of the same pixels
+        int run = 1;
+        while(x + run < width && run < 128 && row[x+run] == row[x]) run++;
+        if(run > 1){
+            out.append(char(0x80 | (run - 1)));
+            out.append((const char*)(row + x),4);
+            x += run;
+            continue;
+        }
+        // raw packet lasts until the next run of at least two pixels
+        int raw = 1;
+        while(x + raw < width && raw < 128 &&
+              !(x + raw + 1 < width && row[x+raw] == row[x+raw+1])) raw++;
+        out.append(char(raw - 1));
+        out.append((const char*)(row + x),4*raw);
+        x += raw;
+    }
+}
 
-    // read TGA from file
-    bool test = load_targa(fileName.toStdString().c_str(),width,height,format,pixels);
+QImage TargaImage::read(const QString& fileName){
+    int width,height;
+    if(!readSize(fileName,width,height)) return QImage(); // return null image
 
-    if(!test) return QImage(0,0);// return null image
-    // allocate image
     QImage image(width,height,QImage::Format_ARGB32);
-
-    unsigned char* imageBuffer  = image.bits();//get pointer do QImage pixels
-    int w = width;
-    int h = height;
-
-    // write data to QImage according to image format
-    if(format == TARGA_BGR){
-
-    for(int i = 0; i < height; i++)
-       for(int j = 0; j < width; j++)
-        {
-          imageBuffer[4 * (i * w + j) + 0] = pixels[3 * ((h-i-1) * w + j)+0  ] ;
-          imageBuffer[4 * (i * w + j) + 1] = pixels[3 * ((h-i-1) * w + j)+1  ] ;
-          imageBuffer[4 * (i * w + j) + 2] = pixels[3 * ((h-i-1) * w + j)+2  ] ;
-          imageBuffer[4 * (i * w + j) + 3] = 255;
-        }
-    }// end of if RGB
-    else if(format == TARGA_BGRA){
-
-    for(int i = 0; i < height; i++)
-       for(int j = 0; j < width; j++)
-        {
-          imageBuffer[4 * (i * w + j) + 0] = pixels[4 * ((h-i-1) * w + j)+0  ] ;
-          imageBuffer[4 * (i * w + j) + 1] = pixels[4 * ((h-i-1) * w + j)+1  ] ;
-          imageBuffer[4 * (i * w + j) + 2] = pixels[4 * ((h-i-1) * w + j)+2  ] ;
-          imageBuffer[4 * (i * w + j) + 3] = pixels[4 * ((h-i-1) * w + j)+3  ] ;
-        }
-    }else {
-    for(int i = 0; i < height; i++)
-       for(int j = 0; j < width; j++)
-        {
-          imageBuffer[4 * (i * w + j) + 0] = pixels[1 * ((h-i-1) * w + j)+0  ] ;
-          imageBuffer[4 * (i * w + j) + 1] = pixels[1 * ((h-i-1) * w + j)+0  ] ;
-          imageBuffer[4 * (i * w + j) + 2] = pixels[1 * ((h-i-1) * w + j)+0  ] ;
-          imageBuffer[4 * (i * w + j) + 3] = 1.0;
-        }
-    }
-    delete[] pixels;
+    if(image.isNull() || !decode(fileName,image.bits(),image.bytesPerLine())) return QImage();
     return image;
 }
 
-bool TargaImage::load_targa (const char *filename, int &width, int &height,
-                      TargaColorFormat &format, unsigned char *&pixels)
-{
-    // set default values
-    pixels = NULL;
+bool TargaImage::readSize(const QString& fileName, int& width, int& height){
     width  = 0;
     height = 0;
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly)) return false;
+    QByteArray data = file.read(TARGA_HEADER_SIZE);
+
+    Header header;
+    if(!readHeader((const unsigned char*)data.constData(),data.size(),header)) return false;
+    if(header.dataOffset > file.size()) return false;
+    width  = header.width;
+    height = header.height;
+    return true;
+}
 
-    //open tga image file
-    FILE *tga = fopen (filename,"rb");
-
-    // check image file
-    if (!tga)
+bool TargaImage::decode(const QString& fileName, unsigned char* pixels, int bytesPerLine, bool bBottomUp){
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly)){
+        qWarning() << "Cannot open targa file:" << fileName << file.errorString();
         return false;
+    }
 
-    // allocate array for header information
-    unsigned char header [TARGA_HEADER_SIZE];
-
-    // read header
-    fread (header,TARGA_HEADER_SIZE,1,tga);
+    // map the file, read it if this is not possible (e.g. Qt resources)
+    qint64 size = file.size();
+    QByteArray buffer;
+    const unsigned char* data = file.map(0,size);
+    if(data == NULL){
+        buffer = file.readAll();
+        data   = (const unsigned char*)buffer.constData();
+        size   = buffer.size();
+    }
 
-    // skeep some fields
-    fseek (tga,header [0],SEEK_CUR);
+    Header header;
+    if(!readHeader(data,size,header) || header.dataOffset > size){
+        qWarning() << "Unsupported targa file:" << fileName;
+        return false;
+    }
 
-    //  read image width
-    width = header [12] + (header [13] << 8);
+    bool bOk = true;
+    if(header.imageType == TARGA_RLE_RGB_IMG || header.imageType == TARGA_RLE_BW_IMG){
+        bOk = decodeRLE(header,data,size,pixels,bytesPerLine,bBottomUp);
+    }else{
+        qint64 rowSize = qint64(header.width)*header.bytesPerPixel;
+        if(header.dataOffset + rowSize*header.height > size){
+            bOk = false;
+        }else{
+            parallelFor(header.height,[&](int begin,int end,int){
+                for(int y = begin ; y < end ; y++){
+                    // y is the row in file
+                    int row = (header.bTopDown != bBottomUp) ? y : header.height - 1 - y;
+                    targaToBGRA(data + header.dataOffset + y*rowSize,
+                                (quint32*)(pixels + qint64(row)*bytesPerLine),
+                                header.width,header.format);
+                }
+            },64);
+        }
+    }
 
-    // read image height
-    height = header [14] + (header [15] << 8);
+    if(!bOk) qWarning() << "Targa file is truncated:" << fileName;
+    return bOk;
+}
 
-    // read file with 24 bbm
-    if (header [2] == TARGA_UNCOMP_RGB_IMG && header [16] == 24)
-    {
-        pixels = new unsigned char [width * height * 3];
-        fread ((void*)pixels,width * height * 3,1,tga);
-        format = TARGA_BGR;
+bool TargaImage::readHeader(const unsigned char* data, qint64 size, Header& header){
+    if(size < TARGA_HEADER_SIZE) return false;
+
+    int idLength          = data[0];
+    int colorMapType      = data[1];
+    int colorMapLength    = data[5] + (data[6] << 8);
+    int colorMapEntryBits = data[7];
+    int bitsPerPixel      = data[16];
+
+    header.imageType     = data[2];
+    header.width         = data[12] + (data[13] << 8);
+    header.height        = data[14] + (data[15] << 8);
+    header.bytesPerPixel = bitsPerPixel / 8;
+    header.bTopDown      = (data[17] & TARGA_TOP_LEFT_ORIGIN) != 0;
+    // skip image ID and color map
+    header.dataOffset    = TARGA_HEADER_SIZE + idLength;
+    if(colorMapType == 1) header.dataOffset += colorMapLength*((colorMapEntryBits + 7)/8);
+
+    bool bColor = (header.imageType == TARGA_UNCOMP_RGB_IMG || header.imageType == TARGA_RLE_RGB_IMG);
+    bool bGray  = (header.imageType == TARGA_UNCOMP_BW_IMG  || header.imageType == TARGA_RLE_BW_IMG);
+    if(bColor && bitsPerPixel == 24)     header.format = TARGA_BGR;
+    else if(bColor && bitsPerPixel == 32) header.format = TARGA_BGRA;
+    else if(bGray  && bitsPerPixel == 8)  header.format = TARGA_LUMINANCE;
+    else{
+        qWarning() << "Unsupported targa image type:" << header.imageType << "bits per pixel:" << bitsPerPixel;
+        return false;
     }
-    else
+    return (header.width > 0 && header.height > 0);
+}
 
-        // read RGBA image (32 bit)
-        if (header [2] == TARGA_UNCOMP_RGB_IMG && header [16] == 32)
-        {
-            pixels = new unsigned char [width * height * 4];
-            fread ((void*)pixels,width * height * 4,1,tga);
-            format = TARGA_BGRA;
-        }
-        else
-
-            // read monocolour image
-            if (header [2] == TARGA_UNCOMP_BW_IMG && header [16] == 8)
-            {
-                pixels = new unsigned char [width * height];
-                fread ((void*)pixels,width * height,1,tga);
-                format = TARGA_LUMINANCE;
+bool TargaImage::decodeRLE(const Header& header, const unsigned char* data, qint64 size,
+                           unsigned char* pixels, int bytesPerLine, bool bBottomUp){
+    const int bpp = header.bytesPerPixel;
+    const unsigned char* src    = data + header.dataOffset;
+    const unsigned char* srcEnd = data + size;
+
+    // raw pixels of one row, packets may continue in the next row
+    QVector<unsigned char> row(header.width*bpp);
+    int  packetCount = 0;
+    bool bRunPacket  = false;
+    const unsigned char* runPixel = NULL;
+
+    for(int y = 0 ; y < header.height ; y++){
+        int x = 0;
+        while(x < header.width){
+            if(packetCount == 0){
+                if(src >= srcEnd) return false;
+                bRunPacket  = (*src & 0x80) != 0;
+                packetCount = (*src & 0x7F) + 1;
+                src++;
+                if(bRunPacket){
+                    if(src + bpp > srcEnd) return false;
+                    runPixel = src;
+                    src     += bpp;
+                }
             }
-            else
-                return false;
 
-    // close image
-    fclose (tga);
+            int n = qMin(packetCount,header.width - x);
+            if(bRunPacket){
+                for(int i = 0 ; i < n ; i++) memcpy(row.data() + (x+i)*bpp,runPixel,bpp);
+            }else{
+                if(src + n*bpp > srcEnd) return false;
+                memcpy(row.data() + x*bpp,src,n*bpp);
+                src += n*bpp;
+            }
+            x           += n;
+            packetCount -= n;
+        }
 
-    // done
+        int dstRow = (header.bTopDown != bBottomUp) ? y : header.height - 1 - y;
+        targaToBGRA(row.constData(),(quint32*)(pixels + qint64(dstRow)*bytesPerLine),
+                    header.width,header.format);
+    }
     return true;
 }
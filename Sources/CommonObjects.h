@@ -6,8 +6,12 @@
 #include <cstdio>
 #include <iostream>
 #include "qopenglerrorcheck.h"
+#include "vrammanager.h"
+#include "renderthread.h"
 #include <QOpenGLFunctions_3_3_Core>
 #include "properties/ImageProperties.peg.h"
+#include "properties/ImageParameters.h"
+#include "utils/textureupload.h"
 #define TAB_SETTINGS 9
 #define TAB_TILING   10
 
@@ -24,6 +28,11 @@
 //#define TEXTURE_FORMAT GL_RGB16F
 #define TEXTURE_FORMAT GL_RGB16F
 #define TEXTURE_3DRENDER_FORMAT GL_RGB16F
+// Single channel formats used by grayscale maps (see FBOImages::textureFormat)
+#define TEXTURE_HEIGHT_FORMAT    GL_R16F
+#define TEXTURE_GRAYSCALE_FORMAT GL_R8
+// Intermediate format of the gray part of the processing (see GLImage::beginSingleChannelStage)
+#define TEXTURE_GRAYSCALE_WORK_FORMAT GL_R16F
 
 #define KEY_SHOW_MATERIALS Qt::Key_S
 
@@ -86,7 +95,8 @@ enum SeamlessMode{
 // Compressed texture type
 enum CompressedFromTypes{
     H_TO_D_AND_S_TO_N = 0,
-    S_TO_D_AND_H_TO_N = 1
+    S_TO_D_AND_H_TO_N = 1,
+    O_R_M_PACKED      = 2  // occlusion, roughness and metallic in RGB of one image
 };
 
 // Selective blur methods
@@ -127,38 +137,65 @@ enum ColorPickerMethod{
 
 enum MaterialIndicesType{
     MATERIALS_DISABLED = -10,
-    MATERIALS_ENABLED = -1
+    MATERIALS_ENABLED = -1,
+    MATERIALS_BATCH = -20 // all materials are processed in one pass
 };
+// maximum number of colors in material texture (IDs are stored as 16 bit integers)
+#define MAX_MATERIALS 1024
 
 
 
 #define TARGA_HEADER_SIZE    0x12
 #define TARGA_UNCOMP_RGB_IMG 0x02
 #define TARGA_UNCOMP_BW_IMG  0x03
+#define TARGA_RLE_RGB_IMG    0x0A
+#define TARGA_RLE_BW_IMG     0x0B
+#define TARGA_TOP_LEFT_ORIGIN 0x20 // bit 5 of image descriptor
 
-// Reading and writing to file TGA image
+// Reading and writing to file TGA image (uncompressed and RLE)
 class TargaImage{
     public:
-    // write QImage to tga file
-    void write(QImage image, QString fileName);
+    /**
+     * @brief write saves image as 32 bit TGA file. Rows are written in QImage
+     * order with top-left origin set in the header, so no flipping is needed.
+     * @param bRLE if true image is RLE compressed
+     * @return false if file could not be written
+     */
+    bool write(const QImage& image, const QString& fileName, bool bRLE = true);
     // return QImage from readed tga file
-    QImage read(QString fileName);
-    private:
+    QImage read(const QString& fileName);
     /**
-     Read tga image to data.
-     * @param filename - path to the image
-     * @param width (output) width of the image
-     * @param height (output) height of the image
-     * @param format (output) format of the image (RGB,RGBA,LUMINANCE)
-     * @param pixels (output) data of pixels
+     * @brief readSize reads only the header of the file.
+     * @return false if the file is not a supported TGA image
+     */
+    bool readSize(const QString& fileName, int& width, int& height);
+    /**
+     * @brief decode reads TGA file (memory mapped) and decodes it directly to
+     * 32 bit BGRA pixels (QImage::Format_ARGB32 layout, GL_BGRA in OpenGL).
+     * @param pixels destination of at least bytesPerLine*height bytes, e.g. mapped PBO
+     * @param bBottomUp if true the first row in the buffer is the bottom row
+     * of the image, as expected by glTexImage2D
      * @return returns true if image was loaded.
      */
-    bool load_targa (const char *filename, int &width, int &height,
-                          TargaColorFormat &format, unsigned char *&pixels);
-    // The same as above but write image to file
-    bool save_targa (const char *filename, int width, int height,
-                          TargaColorFormat format, unsigned char *pixels);
+    bool decode(const QString& fileName, unsigned char* pixels, int bytesPerLine, bool bBottomUp = false);
 
+    private:
+    struct Header{
+        int width;
+        int height;
+        int imageType;
+        int bytesPerPixel;
+        bool bTopDown;  // origin bit
+        int dataOffset; // offset of the pixels from the beginning of the file
+        TargaColorFormat format;
+    };
+    // Parses and validates the header. Returns false for unsupported files.
+    bool readHeader(const unsigned char* data, qint64 size, Header& header);
+    // Decodes pixels of RLE compressed image. Returns false if data is truncated.
+    bool decodeRLE(const Header& header, const unsigned char* data, qint64 size,
+                   unsigned char* pixels, int bytesPerLine, bool bBottomUp);
+    // Appends RLE packets of one BGRA row to out.
+    void encodeRLE(const quint32* row, int width, QByteArray& out);
 
 };
 
@@ -233,6 +270,27 @@ public:
 
 };
 
+#define PACK_CONSTANT -1
+
+/**
+ * @brief The ChannelPacking struct describes one image saved in the compressed
+ * form. Each output channel (R,G,B,A) is copied from a channel of one of the
+ * maps or filled with a constant value.
+ */
+struct ChannelPacking{
+    TextureTypes outputType; // export settings and default postfix are taken from this map
+    QString      postfix;    // used instead of the map postfix if not empty
+    int   sources[4];        // TextureTypes or PACK_CONSTANT
+    int   channels[4];       // channel of the source: 0-R, 1-G, 2-B, 3-A
+    float constants[4];      // values of PACK_CONSTANT channels
+
+    ChannelPacking(TextureTypes type = DIFFUSE_TEXTURE, const QString& postfix = QString());
+    void setChannel(int channel, TextureTypes source, int sourceChannel);
+    void setConstant(int channel, float value);
+    // Returns list of images saved for given compressed form type.
+    static QList<ChannelPacking> layout(CompressedFromTypes type);
+};
+
 
 
 struct RandomTilingMode{
@@ -307,6 +365,29 @@ public:
         bShowTriangleEdges = false;
         bLensFlares        = true;
   }
+  // true if the 3D scene has to be drawn again with the new settings
+  bool sceneChanged(const Display3DSettings& other) const{
+      return depthScale         != other.depthScale         ||
+             uvScale            != other.uvScale            ||
+             uvOffset           != other.uvOffset           ||
+             specularIntensity  != other.specularIntensity  ||
+             diffuseIntensity   != other.diffuseIntensity   ||
+             lightPower         != other.lightPower         ||
+             lightRadius        != other.lightRadius        ||
+             shadingType        != other.shadingType        ||
+             shadingModel       != other.shadingModel       ||
+             bUseCullFace       != other.bUseCullFace       ||
+             bUseSimplePBR      != other.bUseSimplePBR      ||
+             noTessSubdivision  != other.noTessSubdivision  ||
+             noPBRRays          != other.noPBRRays          ||
+             bShowTriangleEdges != other.bShowTriangleEdges;
+  }
+  // true if only the post processing of the scene has to be done again
+  bool postProcessingChanged(const Display3DSettings& other) const{
+      return bBloomEffect       != other.bBloomEffect       ||
+             bDofEffect         != other.bDofEffect         ||
+             bLensFlares        != other.bLensFlares;
+  }
 };
 
 // Wrapper for FBO initialization.
@@ -317,6 +398,7 @@ public:
         if(fbo)
         {
             fbo->release();
+            VRAMManager::released(fbo);
             delete fbo;
         }
 
@@ -342,25 +424,97 @@ public:
         float aniso = 0.0;
         glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &aniso);
         glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, aniso);
+        // single channel textures are sampled as (r,r,r,1) so shaders can still read .rgb
+        if(isSingleChannel(internal_format)){
+            GLint swizzle[4] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+            GLCHK(glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle));
+        }
         GLCHK(glBindTexture(GL_TEXTURE_2D, 0));
-        qDebug() << "FBOImages::creating new FBO(" << width << "," << height << ") with id=" << fbo->texture() ;
+        // single channel FBOs would be stored in TEXTURE_FORMAT otherwise
+        qint64 bytes      = textureMemory(width,height,internal_format);
+        qint64 savedBytes = isSingleChannel(internal_format) ? textureMemory(width,height,TEXTURE_FORMAT) - bytes : 0;
+        VRAMManager::allocated(&fbo,bytes,savedBytes);
+        qDebug() << "FBOImages::creating new FBO(" << width << "," << height << ") with id=" << fbo->texture()
+                 << "size =" << bytes/(1024*1024) << "MB";
     }
     static void resize(QGLFramebufferObject *&src,QGLFramebufferObject *&ref,GLuint internal_format = TEXTURE_FORMAT){
         if(src == NULL){
             GLCHK(FBOImages::create(src ,ref->width(),ref->height(),internal_format));
         }else if( ref->width()  == src->width() &&
-            ref->height() == src->height() ){}else{
+            ref->height() == src->height() &&
+            src->format().internalTextureFormat() == internal_format ){
+            VRAMManager::touch(src);
+        }else{
             GLCHK(FBOImages::create(src ,ref->width(),ref->height(),internal_format));
         }
     }
     static void resize(QGLFramebufferObject *&src,int width, int height,GLuint internal_format = TEXTURE_FORMAT){        
         if(!src){
             GLCHK(FBOImages::create(src ,width,height,internal_format));
-        }else if( width  == src->width() && height == src->height() ){
+        }else if( width  == src->width() && height == src->height() &&
+                  src->format().internalTextureFormat() == internal_format ){
+            VRAMManager::touch(src);
         }else{
             GLCHK(FBOImages::create(src ,width,height,internal_format));
         }
     }
+    /**
+     * @brief textureFormat returns the internal format of the output FBO for given texture type.
+     * Grayscale maps are kept in single channel textures.
+     */
+    static GLuint textureFormat(TextureTypes type){
+        switch(type){
+            case(HEIGHT_TEXTURE):    return TEXTURE_HEIGHT_FORMAT;
+            case(OCCLUSION_TEXTURE):
+            case(ROUGHNESS_TEXTURE):
+            case(METALLIC_TEXTURE):  return TEXTURE_GRAYSCALE_FORMAT;
+            default:                 return TEXTURE_FORMAT;
+        }
+    }
+    // Deletes FBO and removes it from the VRAM accounting.
+    static void remove(QGLFramebufferObject *&fbo){
+        if(fbo == NULL) return;
+        VRAMManager::released(fbo);
+        delete fbo;
+        fbo = NULL;
+    }
+    static bool isSingleChannel(GLuint internal_format){
+        return (internal_format == GL_R8 || internal_format == GL_R16F || internal_format == GL_R32F);
+    }
+    // Estimated size in bytes of the texture together with its mipmaps chain.
+    static qint64 textureMemory(int width,int height,GLuint internal_format){
+        qint64 bytesPerPixel = 4;
+        switch(internal_format){
+            case(GL_R8):      bytesPerPixel = 1; break;
+            case(GL_R16F):    bytesPerPixel = 2; break;
+            case(GL_R32F):    bytesPerPixel = 4; break;
+            case(GL_RGB16F):  bytesPerPixel = 6; break;
+            case(GL_RGBA16F): bytesPerPixel = 8; break;
+            case(GL_RGB32F):  bytesPerPixel = 12;break;
+            case(GL_RGBA32F): bytesPerPixel = 16;break;
+            default: break;
+        }
+        return (qint64(width)*height*bytesPerPixel*4)/3;
+    }
+    /**
+     * @brief toImage same as QGLFramebufferObject::toImage but single channel
+     * FBOs are expanded to gray image (swizzle is not applied to framebuffer reads).
+     */
+    static QImage toImage(QGLFramebufferObject *fbo){
+        VRAMManager::touch(fbo);
+        QImage image = fbo->toImage();
+        if(!isSingleChannel(fbo->format().internalTextureFormat())) return image;
+
+        image = image.convertToFormat(QImage::Format_ARGB32);
+        for(int y = 0 ; y < image.height() ; y++){
+            QRgb* line = (QRgb*)image.scanLine(y);
+            for(int x = 0 ; x < image.width() ; x++){
+                int r   = qRed(line[x]);
+                line[x] = qRgba(r,r,r,qAlpha(line[x]));
+            }
+        }
+        return image;
+    }
 public:
     static bool bUseLinearInterpolation;
 
@@ -388,27 +542,41 @@ struct BaseMapConvLevelProperties{
         conversionBaseMapBlending       = 1.0;
 
     }
-    void fromProperty(QtnPropertySetConvertsionBaseMapLevelProperty& level){
-        conversionBaseMapAmplitude      = level.Amplitude;
-        conversionBaseMapFlatness       = level.Flatness;
-        conversionBaseMapNoIters        = level.NumIters;
-        conversionBaseMapFilterRadius   = level.FilterRadius;
-        conversionBaseMapMixNormals     = level.Edges;
-        conversionBaseMapPreSmoothRadius= level.PreSmoothRadius;
-        conversionBaseMapBlending       = level.Blending;
+    // use BASE_MAP_LEVEL to pass the settings of one level
+    void fromParameters(float amplitude, float flatness, int numIters, float filterRadius,
+                        float edges, float preSmoothRadius, float blending){
+        conversionBaseMapAmplitude      = amplitude;
+        conversionBaseMapFlatness       = flatness;
+        conversionBaseMapNoIters        = numIters;
+        conversionBaseMapFilterRadius   = filterRadius;
+        conversionBaseMapMixNormals     = edges;
+        conversionBaseMapPreSmoothRadius= preSmoothRadius;
+        conversionBaseMapBlending       = blending;
 
     }
 
 };
 
+// Arguments of BaseMapConvLevelProperties::fromParameters taken from
+// ImageParameters, e.g. BASE_MAP_LEVEL(params,LevelSmall)
+#define BASE_MAP_LEVEL(p,level) \
+    (p).BaseMapToOthers_##level##_Amplitude, \
+    (p).BaseMapToOthers_##level##_Flatness, \
+    (p).BaseMapToOthers_##level##_NumIters, \
+    (p).BaseMapToOthers_##level##_FilterRadius, \
+    (p).BaseMapToOthers_##level##_Edges, \
+    (p).BaseMapToOthers_##level##_PreSmoothRadius, \
+    (p).BaseMapToOthers_##level##_Blending
+
 // Main object. Contains information about Image and the post process parameters
 class FBOImageProporties{
 public:
     QtnPropertySetFormImageProp* properties;
     bool bSkipProcessing;
-    QGLFramebufferObject *fbo     ; // output image
+    QGLFramebufferObject *fbo     ; // output image shown by the views (front buffer), use getFBO() to read it
+    QGLFramebufferObject *backFBO ; // output image being rendered, see getBackFBO() and publish()
 
-    GLuint scr_tex_id;       // Id of texture loaded from image, from loaded file
+    GLuint scr_tex_id;       // Id of texture loaded from image, from loaded file (see getSrcTexId)
     GLuint normalMixerInputTexId; // Used only by normal texture
     int scr_tex_width;       // width of the image loaded from file.
     int scr_tex_height;      // height ...
@@ -436,17 +604,35 @@ public:
     static int seamlessSimpleModeDirection;
     static SourceImageType seamlessContrastInputType;
     static bool bSeamlessTranslationsFirst;
-    static int currentMaterialIndeks;
+    static int currentMaterialIndeks; // material ID or one of MaterialIndicesType
+    // Per material settings used when currentMaterialIndeks is MATERIALS_BATCH,
+    // the vector index is the material ID.
+    QVector<ImageParameters> materialBatchParameters;
+    // Settings of the selected material of a hidden image. They are loaded to
+    // the property set when the image is shown (see FormMaterialIndicesManager).
+    ImageParameters detachedParameters;
+    bool bDetachedParameters;
+    GLuint materialIdTexId; // R16UI texture with material ID of each pixel (material texture only)
+    // Host copy of the material IDs, replaced together with the texture when
+    // the mask changes so the CPU filters do not have to read it back.
+    QVector<quint16> materialIds;
+    int materialIdsWidth;
+    int materialIdsHeight;
 
 
      FBOImageProporties(){
         bSkipProcessing = false;
+        bDetachedParameters = false;
         properties      = NULL;
         fbo             = NULL;
+        backFBO         = NULL;
         normalMixerInputTexId = 0;
         glWidget_ptr = NULL;
         bFirstDraw   = true;
         scr_tex_id   = 0;
+        materialIdTexId = 0;
+        materialIdsWidth  = 0;
+        materialIdsHeight = 0;
         conversionHNDepth  = 2.0;
         bConversionBaseMap = false;
         inputImageType = INPUT_NONE;
@@ -464,42 +650,49 @@ public:
         if(properties != NULL && src.properties != NULL ) properties->copyValues(src.properties);
      }
 
+    // Settings used by the render: detached settings of the selected material
+    // or the values of the property set.
+    ImageParameters getParameters() const{
+        if(bDetachedParameters) return detachedParameters;
+        ImageParameters parameters;
+        parameters.fromProperties(*properties);
+        return parameters;
+    }
+
     void init(QImage& image){
         qDebug() << Q_FUNC_INFO;
 
         if(!glWidget_ptr->isValid()){
             qDebug() << "Incorrect Widget pointer. Cannot initialize textures.";
         }
+        runInRenderContext([&](){ initTextures(image); });
+    }
 
-        GLCHK(glWidget_ptr->makeCurrent());
-        if(glIsTexture(scr_tex_id))
-            GLCHK(glWidget_ptr->deleteTexture(scr_tex_id));
-
-        scr_tex_id = bindImageAsTexture(image);
-        GLCHK(glBindTexture(GL_TEXTURE_2D, 0));
-
-        scr_tex_width  = image.width();
-        scr_tex_height = image.height();
-        bFirstDraw = true;
-        qDebug() << "Bind image texture with id: " << scr_tex_id << " w =" << scr_tex_width << " h = " << scr_tex_height;
+    void updateSrcTexId(QGLFramebufferObject* in_ref_fbo){
+        runInRenderContext([&](){ copySrcTexture(in_ref_fbo); });
+    }
 
-        GLuint internal_format = TEXTURE_FORMAT;
-        if(imageType == HEIGHT_TEXTURE) internal_format = TEXTURE_3DRENDER_FORMAT;
-        GLCHK(FBOImages::create(fbo , image.width(), image.height(), internal_format));
+    /**
+     * @brief setMaterialIds uploads material ID of each pixel to materialIdTexId.
+     * @param ids row major IDs, rows ordered from the bottom like in source texture
+     */
+    void setMaterialIds(const QVector<quint16>& ids, int width, int height){
+        runInRenderContext([&](){ uploadMaterialIds(ids,width,height); });
     }
 
-    void updateSrcTexId(QGLFramebufferObject* in_ref_fbo){
-        glWidget_ptr->makeCurrent();
-        if(glIsTexture(scr_tex_id)) glWidget_ptr->deleteTexture(scr_tex_id);
-        QImage image = in_ref_fbo->toImage();
-        scr_tex_id = bindImageAsTexture(image);
+    // Replaces the second input of the normal mixer.
+    void setNormalMixerImage(const QImage& image){
+        runInRenderContext([&](){
+            if(glIsTexture(normalMixerInputTexId)) GLCHK(glDeleteTextures(1, &normalMixerInputTexId));
+            normalMixerInputTexId = bindImageAsTexture(image);
+        });
     }
 
+    // Render thread only, the output FBO is resized by the render.
     void resizeFBO(int width, int height){
-
-        GLuint internal_format = TEXTURE_FORMAT;
-        if(imageType == HEIGHT_TEXTURE) internal_format = TEXTURE_3DRENDER_FORMAT;
-        GLCHK(FBOImages::resize(fbo,width,height,internal_format));
+        // the shown FBO is replaced, views must not draw it in the meantime
+        QMutexLocker locker(&RenderThread::publishMutex);
+        GLCHK(FBOImages::resize(fbo,width,height,FBOImages::textureFormat(imageType)));
         bFirstDraw = true;
     }
 
@@ -508,53 +701,70 @@ public:
      * @return QImage
      */
     QImage getImage(){
-        glWidget_ptr->makeCurrent();
-        return fbo->toImage();
+        QImage image;
+        runInRenderContext([&](){ image = FBOImages::toImage(getFBO()); });
+        return image;
+    }
+
+    /**
+     * @brief getFBO returns the output FBO. The data is uploaded again when
+     * the FBO was moved to host memory (see VRAMManager). The GL context
+     * has to be current.
+     */
+    QGLFramebufferObject* getFBO(){
+        VRAMManager::touch(fbo);
+        return fbo;
+    }
+    /**
+     * @brief getBackFBO returns the FBO the render writes to, it has the size
+     * and format of the output FBO. Render thread only.
+     */
+    QGLFramebufferObject* getBackFBO(){
+        GLCHK(FBOImages::resize(backFBO,fbo,FBOImages::textureFormat(imageType)));
+        return backFBO;
+    }
+    // Render thread: the rendered back buffer becomes the output image.
+    void publish(){
+        QMutexLocker locker(&RenderThread::publishMutex);
+        VRAMManager::swapHandles(&fbo,&backFBO);
+    }
+    // Size of the output image, can be called from any thread.
+    QSize getSize(){
+        QMutexLocker locker(&RenderThread::publishMutex);
+        return (fbo != NULL) ? fbo->size() : QSize();
+    }
+    // Same as getFBO but for the source texture.
+    GLuint getSrcTexId(){
+        return VRAMManager::use(scr_tex_id);
     }
 
     ~FBOImageProporties(){
 
         if(glWidget_ptr != NULL){
             qDebug() << Q_FUNC_INFO;
-            glWidget_ptr->makeCurrent();
-
-            if(glIsTexture(normalMixerInputTexId))
-                GLCHK(glWidget_ptr->deleteTexture(normalMixerInputTexId));
-            if(glIsTexture(scr_tex_id))
-                GLCHK(glWidget_ptr->deleteTexture(scr_tex_id));
-
-            normalMixerInputTexId = 0;
-            scr_tex_id = 0;
-            glWidget_ptr = NULL;            
+            runInRenderContext([&](){ releaseTextures(); });
+            glWidget_ptr = NULL;
             if(properties != NULL ) delete properties;
-            if(fbo        != NULL ) delete fbo;
             properties = NULL;
-            fbo        = NULL;
         }
     }
 
-    static int bindImageAsTexture(QImage image){
+    /**
+     * @brief bindImageAsTexture creates texture with bottom-up rows from image.
+     * The image is uploaded in its own format if possible (see TextureUpload).
+     */
+    static int bindImageAsTexture(const QImage& image){
 
         if (image.isNull()) {
             qDebug() << "bindTexture::Cannot create texture for empty image.";
             return NULL;
         }
-        image = image.convertToFormat(QImage::Format_ARGB32);
-//        QTransform flip_transform;
-//        flip_transform.rotate(180);
-//        flip_transform.transposed();
-//        image = image.transformed(flip_transform);
-        image = image.mirrored();
 
         GLuint texture_id; // get id of new texture
         GLCHK(glGenTextures(1, &texture_id));
         GLCHK(glBindTexture(GL_TEXTURE_2D, texture_id));
 
-        GLCHK(glTexImage2D(
-                  GL_TEXTURE_2D, 0,
-                  GL_RGBA, image.width(), image.height(), 0,
-                  GL_BGRA, GL_UNSIGNED_BYTE, image.bits())
-              );
+        TextureUpload::upload(GL_TEXTURE_2D,image,true);
 
         GLCHK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
         GLCHK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
@@ -562,6 +772,114 @@ public:
         return texture_id;
     }
 
+private:
+    // All GL objects of the images belong to the render context (see RenderThread),
+    // the job is run in place before the render thread is started.
+    void runInRenderContext(const RenderThread::Job& job){
+        if(RenderThread::execute(job)) return;
+        GLCHK(glWidget_ptr->makeCurrent());
+        job();
+    }
+
+    void initTextures(QImage& image){
+        if(glIsTexture(scr_tex_id)){
+            VRAMManager::releasedTexture(scr_tex_id);
+            GLCHK(glDeleteTextures(1, &scr_tex_id));
+        }
+
+        scr_tex_id = bindImageAsTexture(image);
+        VRAMManager::allocatedTexture(scr_tex_id,qint64(image.width())*image.height()*4,
+                                      PostfixNames::getTextureName(imageType) + " source",
+                                      VRAMManager::SPILL);
+        GLCHK(glBindTexture(GL_TEXTURE_2D, 0));
+
+        scr_tex_width  = image.width();
+        scr_tex_height = image.height();
+        bFirstDraw = true;
+        qDebug() << "Bind image texture with id: " << scr_tex_id << " w =" << scr_tex_width << " h = " << scr_tex_height;
+
+        VRAMManager::registerHandle(&fbo,PostfixNames::getTextureName(imageType),VRAMManager::SPILL);
+        // contains the previous frame only, it is recreated by the next render
+        VRAMManager::registerHandle(&backFBO,PostfixNames::getTextureName(imageType) + " back",VRAMManager::EVICT);
+        GLCHK(FBOImages::create(fbo , image.width(), image.height(), FBOImages::textureFormat(imageType)));
+    }
+
+    void copySrcTexture(QGLFramebufferObject* in_ref_fbo){
+        if(glIsTexture(scr_tex_id)){
+            VRAMManager::releasedTexture(scr_tex_id);
+            GLCHK(glDeleteTextures(1, &scr_tex_id));
+        }
+        // copied on GPU, FBO rows have the same order as the source texture
+        int width  = in_ref_fbo->width();
+        int height = in_ref_fbo->height();
+        GLuint fbo_format     = in_ref_fbo->format().internalTextureFormat();
+        GLuint texture_format = FBOImages::isSingleChannel(fbo_format) ? fbo_format : GL_RGBA8;
+
+        GLuint texture_id;
+        GLCHK(glGenTextures(1, &texture_id));
+        GLCHK(glBindTexture(GL_TEXTURE_2D, texture_id));
+        VRAMManager::touch(in_ref_fbo);
+        GLCHK(in_ref_fbo->bind());
+        GLCHK(glCopyTexImage2D(GL_TEXTURE_2D, 0, texture_format, 0, 0, width, height, 0));
+        GLCHK(in_ref_fbo->release());
+        GLCHK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+        GLCHK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+        if(FBOImages::isSingleChannel(texture_format)){
+            GLint swizzle[4] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+            GLCHK(glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle));
+        }
+        GLCHK(glBindTexture(GL_TEXTURE_2D, 0));
+        scr_tex_id = texture_id;
+        qint64 bytes      = FBOImages::textureMemory(width,height,texture_format)*3/4;
+        qint64 savedBytes = FBOImages::textureMemory(width,height,GL_RGBA8)*3/4 - bytes;
+        VRAMManager::allocatedTexture(scr_tex_id,bytes,
+                                      PostfixNames::getTextureName(imageType) + " source",
+                                      VRAMManager::SPILL,savedBytes);
+    }
+
+    void uploadMaterialIds(const QVector<quint16>& ids, int width, int height){
+        if(glIsTexture(materialIdTexId)){
+            VRAMManager::releasedTexture(materialIdTexId);
+            GLCHK(glDeleteTextures(1, &materialIdTexId));
+        }
+        GLCHK(glGenTextures(1, &materialIdTexId));
+        GLCHK(glBindTexture(GL_TEXTURE_2D, materialIdTexId));
+        GLCHK(glPixelStorei(GL_UNPACK_ALIGNMENT, 2));
+        GLCHK(glTexImage2D(GL_TEXTURE_2D, 0, GL_R16UI, width, height, 0,
+                           GL_RED_INTEGER, GL_UNSIGNED_SHORT, ids.constData()));
+        GLCHK(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+        // integer textures cannot be interpolated
+        GLCHK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+        GLCHK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+        GLCHK(glBindTexture(GL_TEXTURE_2D, 0));
+        VRAMManager::allocatedTexture(materialIdTexId,qint64(width)*height*2,"Material IDs");
+
+        materialIds       = ids;
+        materialIdsWidth  = width;
+        materialIdsHeight = height;
+    }
+
+    void releaseTextures(){
+        if(glIsTexture(normalMixerInputTexId))
+            GLCHK(glDeleteTextures(1, &normalMixerInputTexId));
+        if(glIsTexture(scr_tex_id)){
+            VRAMManager::releasedTexture(scr_tex_id);
+            GLCHK(glDeleteTextures(1, &scr_tex_id));
+        }
+        if(glIsTexture(materialIdTexId)){
+            VRAMManager::releasedTexture(materialIdTexId);
+            GLCHK(glDeleteTextures(1, &materialIdTexId));
+        }
+
+        normalMixerInputTexId = 0;
+        materialIdTexId = 0;
+        scr_tex_id = 0;
+        VRAMManager::unregisterHandle(&fbo);
+        VRAMManager::unregisterHandle(&backFBO);
+        FBOImages::remove(fbo);
+        FBOImages::remove(backFBO);
+    }
+
 };
 
 
@@ -1,7 +1,7 @@
 TARGET        = AwesomeBump
 
 TEMPLATE      = app
-CONFIG       += c++11
+CONFIG       += c++11 thread
 QT           += opengl gui widgets
 
 isEmpty(TOP_DIR) {
@@ -25,6 +25,20 @@ PEG_SOURCES += properties/Filter3DDOF.pef \
                properties/ImageProperties.pef \
                properties/Filters3D.pef
 
+# IMAGE_PARAMETERS (properties/ImageParameters.h) has to list all numeric
+# properties of ImageProperties.pef, it is checked before each build
+isEmpty(PYTHON): PYTHON = python
+PYTHON_VERSION = $$system($$PYTHON --version 2>&1)
+contains(PYTHON_VERSION, Python.*){
+    checkparams.target   = check_image_parameters
+    checkparams.commands = $$PYTHON $$PWD/properties/check_image_parameters.py \
+                           $$PWD/properties/ImageProperties.pef $$PWD/properties/ImageParameters.h
+    QMAKE_EXTRA_TARGETS += checkparams
+    PRE_TARGETDEPS      += check_image_parameters
+}else{
+    warning("Python not found, IMAGE_PARAMETERS list will not be checked.")
+}
+
 gl330: DEFINES += USE_OPENGL_330
 
 CONFIG(debug, debug|release): DBG = -dgb
@@ -75,9 +89,18 @@ HEADERS = glwidget.h \
     formimagebase.h \
     dockwidget3dsettings.h \
     gpuinfo.h \
+    vrammanager.h \
+    renderscheduler.h \
+    renderthread.h \
+    imageexporter.h \
+    ddsimage.h \
+    imageloader.h \
+    meshloader.h \
+    skyboxcache.h \
     properties/propertyconstructor.h \
     properties/propertydelegateabfloatslider.h \
     properties/PropertyABColor.h \
+    properties/ImageParameters.h \
     properties/PropertyDelegateABColor.h \
     properties/Dialog3DGeneralSettings.h \
     utils/DebugMetricsMonitor.h \
@@ -85,6 +108,12 @@ HEADERS = glwidget.h \
     utils/qglbuffers.h \
     utils/tinyobj/tiny_obj_loader.h \
     utils/glslshaderparser.h \
+    utils/parallel.h \
+    utils/textureupload.h \
+    utils/texturereadback.h \
+    utils/objparser.h \
+    utils/loadstatus.h \
+    utils/meshsimplifier.h \
     utils/glslparsedshadercontainer.h \
     utils/contextinfo/contextwidget.h \
     utils/contextinfo/renderwindow.h \
@@ -103,6 +132,10 @@ SOURCES = glwidget.cpp \
     formsettingsfield.cpp \
     formsettingscontainer.cpp \
     utils/qglbuffers.cpp \
+    utils/textureupload.cpp \
+    utils/texturereadback.cpp \
+    utils/objparser.cpp \
+    utils/meshsimplifier.cpp \
     dialoglogger.cpp \
     glwidgetbase.cpp \
     formmaterialindicesmanager.cpp \
@@ -111,6 +144,14 @@ SOURCES = glwidget.cpp \
     formimagebase.cpp \
     dockwidget3dsettings.cpp \
     gpuinfo.cpp \
+    vrammanager.cpp \
+    renderscheduler.cpp \
+    renderthread.cpp \
+    imageexporter.cpp \
+    ddsimage.cpp \
+    imageloader.cpp \
+    meshloader.cpp \
+    skyboxcache.cpp \
     properties/Dialog3DGeneralSettings.cpp \
     utils/DebugMetricsMonitor.cpp \
     utils/glslshaderparser.cpp \
@@ -0,0 +1,290 @@
+#include "ddsimage.h"
+#include "utils/parallel.h"
+#include <QFile>
+#include <QDebug>
+#include <QtEndian>
+#include <math.h>
+
+#define DDS_MAGIC               0x20534444 // "DDS "
+#define DDSD_CAPS               0x1
+#define DDSD_HEIGHT             0x2
+#define DDSD_WIDTH              0x4
+#define DDSD_PIXELFORMAT        0x1000
+#define DDSD_MIPMAPCOUNT        0x20000
+#define DDSD_LINEARSIZE         0x80000
+#define DDPF_FOURCC             0x4
+#define DDSCAPS_COMPLEX         0x8
+#define DDSCAPS_TEXTURE         0x1000
+#define DDSCAPS_MIPMAP          0x400000
+#define DDS_FOURCC(a,b,c,d)     (quint32(a) | (quint32(b) << 8) | (quint32(c) << 16) | (quint32(d) << 24))
+
+// ------------------------------------------------------- //
+//                  Block encoders
+// ------------------------------------------------------- //
+
+// 4x4 block of 8 bit values, 8 value mode (a0 > a1)
+static void encodeBC4Block(const quint8* values, quint8* out){
+    int lo = 255, hi = 0;
+    for(int i = 0 ; i < 16 ; i++){
+        lo = qMin(lo,int(values[i]));
+        hi = qMax(hi,int(values[i]));
+    }
+    out[0] = hi;
+    out[1] = lo;
+    quint64 bits = 0;
+    if(hi > lo){
+        int range = hi - lo;
+        for(int i = 0 ; i < 16 ; i++){
+            // position between lo and hi in sevenths, rounded
+            int t   = ((values[i] - lo)*14 + range) / (2*range);
+            int idx = (t == 7) ? 0 : (t == 0) ? 1 : 8 - t;
+            bits |= quint64(idx) << (3*i);
+        }
+    }
+    for(int b = 0 ; b < 6 ; b++) out[2+b] = quint8(bits >> (8*b));
+}
+
+static quint16 toRGB565(const float* c){
+    int r = qBound(0,int(c[0]*31.0f/255.0f + 0.5f),31);
+    int g = qBound(0,int(c[1]*63.0f/255.0f + 0.5f),63);
+    int b = qBound(0,int(c[2]*31.0f/255.0f + 0.5f),31);
+    return quint16((r << 11) | (g << 5) | b);
+}
+
+static void fromRGB565(quint16 c, int* rgb){
+    int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// 4x4 block of RGB colors in 4 color mode (color0 > color1). Endpoints are the
+// extreme colors along the principal axis of the block.
+static void encodeBC1Block(const quint8* rgb, quint8* out){
+    float mean[3] = {0,0,0};
+    for(int i = 0 ; i < 16 ; i++)
+        for(int c = 0 ; c < 3 ; c++) mean[c] += rgb[3*i+c];
+    for(int c = 0 ; c < 3 ; c++) mean[c] /= 16.0f;
+
+    float cov[6] = {0,0,0,0,0,0}; // xx xy xz yy yz zz
+    for(int i = 0 ; i < 16 ; i++){
+        float d[3] = {rgb[3*i+0]-mean[0],rgb[3*i+1]-mean[1],rgb[3*i+2]-mean[2]};
+        cov[0] += d[0]*d[0]; cov[1] += d[0]*d[1]; cov[2] += d[0]*d[2];
+        cov[3] += d[1]*d[1]; cov[4] += d[1]*d[2]; cov[5] += d[2]*d[2];
+    }
+    // power iteration
+    float axis[3] = {1.0f,1.0f,1.0f};
+    for(int it = 0 ; it < 4 ; it++){
+        float a[3] = {cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2],
+                      cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2],
+                      cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2]};
+        float len = qMax(qMax(qAbs(a[0]),qAbs(a[1])),qAbs(a[2]));
+        if(len < 1.0e-6f) break;
+        for(int c = 0 ; c < 3 ; c++) axis[c] = a[c]/len;
+    }
+
+    int minIdx = 0, maxIdx = 0;
+    float minDot = 1.0e30f, maxDot = -1.0e30f;
+    for(int i = 0 ; i < 16 ; i++){
+        float dot = rgb[3*i+0]*axis[0] + rgb[3*i+1]*axis[1] + rgb[3*i+2]*axis[2];
+        if(dot < minDot){ minDot = dot; minIdx = i; }
+        if(dot > maxDot){ maxDot = dot; maxIdx = i; }
+    }
+    float maxColor[3] = {float(rgb[3*maxIdx+0]),float(rgb[3*maxIdx+1]),float(rgb[3*maxIdx+2])};
+    float minColor[3] = {float(rgb[3*minIdx+0]),float(rgb[3*minIdx+1]),float(rgb[3*minIdx+2])};
+    quint16 c0 = toRGB565(maxColor);
+    quint16 c1 = toRGB565(minColor);
+    if(c0 < c1) qSwap(c0,c1);
+
+    out[0] = quint8(c0); out[1] = quint8(c0 >> 8);
+    out[2] = quint8(c1); out[3] = quint8(c1 >> 8);
+    quint32 bits = 0;
+    if(c0 != c1){
+        int palette[4][3];
+        fromRGB565(c0,palette[0]);
+        fromRGB565(c1,palette[1]);
+        for(int c = 0 ; c < 3 ; c++){
+            palette[2][c] = (2*palette[0][c] +   palette[1][c]) / 3;
+            palette[3][c] = (  palette[0][c] + 2*palette[1][c]) / 3;
+        }
+        for(int i = 0 ; i < 16 ; i++){
+            int best = 0, bestDist = 1 << 30;
+            for(int p = 0 ; p < 4 ; p++){
+                int dr = rgb[3*i+0] - palette[p][0];
+                int dg = rgb[3*i+1] - palette[p][1];
+                int db = rgb[3*i+2] - palette[p][2];
+                int dist = dr*dr + dg*dg + db*db;
+                if(dist < bestDist){ bestDist = dist; best = p; }
+            }
+            bits |= quint32(best) << (2*i);
+        }
+    }
+    for(int b = 0 ; b < 4 ; b++) out[4+b] = quint8(bits >> (8*b));
+}
+
+// ------------------------------------------------------- //
+//                  DDSImage
+// ------------------------------------------------------- //
+
+DDSFormat DDSImage::formatForTexture(TextureTypes imageType, const QImage& image){
+    // packed maps keep other map in alpha channel
+    bool bAlpha = false;
+    if(image.hasAlphaChannel()){
+        QImage argb = image.convertToFormat(QImage::Format_ARGB32);
+        for(int y = 0 ; y < argb.height() && !bAlpha ; y++){
+            const QRgb* line = (const QRgb*)argb.constScanLine(y);
+            for(int x = 0 ; x < argb.width() ; x++){
+                if(qAlpha(line[x]) != 255){ bAlpha = true; break; }
+            }
+        }
+    }
+    if(bAlpha) return DDS_BC3;
+    // grayscale maps, independent of the format they are stored in on the GPU
+    switch(imageType){
+        case(NORMAL_TEXTURE):
+            return DDS_BC5;
+        case(HEIGHT_TEXTURE):
+        case(OCCLUSION_TEXTURE):
+        case(ROUGHNESS_TEXTURE):
+        case(METALLIC_TEXTURE):
+            return DDS_BC4;
+        default:
+            return DDS_BC1;
+    }
+}
+
+int DDSImage::blockSize(DDSFormat format){
+    return (format == DDS_BC1 || format == DDS_BC4) ? 8 : 16;
+}
+
+bool DDSImage::write(const QImage& _image, const QString& fileName, DDSFormat format){
+    QImage image = _image.convertToFormat(QImage::Format_ARGB32);
+    if(image.isNull()){
+        qWarning() << "Cannot save image to dds file:" << fileName << "invalid image.";
+        return false;
+    }
+
+    int width   = image.width();
+    int height  = image.height();
+    int noMips  = 1;
+    while((width >> noMips) > 0 || (height >> noMips) > 0) noMips++;
+
+    QByteArray data;
+    data.reserve(int(qint64(width)*height*blockSize(format)/12)); // ~4/3 of the top level
+    QImage level = image;
+    for(int m = 0 ; m < noMips ; m++){
+        if(m > 0) level = downsample(level,format == DDS_BC5);
+        encodeLevel(level,format,data);
+    }
+
+    quint32 fourCC = 0;
+    switch(format){
+        case(DDS_BC1): fourCC = DDS_FOURCC('D','X','T','1'); break;
+        case(DDS_BC3): fourCC = DDS_FOURCC('D','X','T','5'); break;
+        case(DDS_BC4): fourCC = DDS_FOURCC('A','T','I','1'); break;
+        case(DDS_BC5): fourCC = DDS_FOURCC('A','T','I','2'); break;
+    }
+
+    quint32 header[32]; // magic + 124 bytes of DDS_HEADER
+    memset(header,0,sizeof(header));
+    header[0]  = DDS_MAGIC;
+    header[1]  = 124;
+    header[2]  = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+    header[3]  = height;
+    header[4]  = width;
+    header[5]  = ((width+3)/4)*((height+3)/4)*blockSize(format);
+    header[7]  = noMips;
+    header[19] = 32;          // pixel format size
+    header[20] = DDPF_FOURCC;
+    header[21] = fourCC;
+    header[27] = DDSCAPS_COMPLEX | DDSCAPS_TEXTURE | DDSCAPS_MIPMAP;
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    for(int i = 0 ; i < 32 ; i++) header[i] = qToLittleEndian(header[i]);
+#endif
+
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly)){
+        qWarning() << "Cannot save image to dds file:" << fileName << file.errorString();
+        return false;
+    }
+    bool bOk = (file.write((const char*)header,sizeof(header)) == sizeof(header)) &&
+               (file.write(data) == data.size());
+    if(!bOk) qWarning() << "Cannot save image to dds file:" << fileName << file.errorString();
+    file.close();
+    return bOk;
+}
+
+void DDSImage::encodeLevel(const QImage& image, DDSFormat format, QByteArray& out){
+    int width     = image.width();
+    int height    = image.height();
+    int blocksX   = (width  + 3)/4;
+    int blocksY   = (height + 3)/4;
+    int bytesPerBlock = blockSize(format);
+    int offset    = out.size();
+    out.resize(offset + blocksX*blocksY*bytesPerBlock);
+    quint8* blocks = (quint8*)out.data() + offset;
+
+    parallelFor(blocksY,[&](int begin,int end,int){
+        quint8 rgb[48], red[16], green[16], alpha[16];
+        for(int by = begin ; by < end ; by++){
+            for(int bx = 0 ; bx < blocksX ; bx++){
+                // gather the block, edge pixels are repeated in partial blocks
+                for(int py = 0 ; py < 4 ; py++){
+                    const QRgb* line = (const QRgb*)image.constScanLine(qMin(4*by+py,height-1));
+                    for(int px = 0 ; px < 4 ; px++){
+                        QRgb p = line[qMin(4*bx+px,width-1)];
+                        int i = 4*py + px;
+                        rgb[3*i+0] = red[i]   = qRed(p);
+                        rgb[3*i+1] = green[i] = qGreen(p);
+                        rgb[3*i+2] = qBlue(p);
+                        alpha[i]   = qAlpha(p);
+                    }
+                }
+
+                quint8* block = blocks + (by*blocksX + bx)*bytesPerBlock;
+                switch(format){
+                    case(DDS_BC1): encodeBC1Block(rgb,block); break;
+                    case(DDS_BC3): encodeBC4Block(alpha,block);
+                                   encodeBC1Block(rgb,block+8); break;
+                    case(DDS_BC4): encodeBC4Block(red,block);   break;
+                    case(DDS_BC5): encodeBC4Block(red,block);
+                                   encodeBC4Block(green,block+8); break;
+                }
+            }
+        }
+    },16);
+}
+
+QImage DDSImage::downsample(const QImage& image, bool bNormalize){
+    int width  = qMax(1,image.width()/2);
+    int height = qMax(1,image.height()/2);
+    QImage level(width,height,QImage::Format_ARGB32);
+
+    parallelFor(height,[&](int begin,int end,int){
+        for(int y = begin ; y < end ; y++){
+            const QRgb* line0 = (const QRgb*)image.constScanLine(qMin(2*y  ,image.height()-1));
+            const QRgb* line1 = (const QRgb*)image.constScanLine(qMin(2*y+1,image.height()-1));
+            QRgb* dst = (QRgb*)level.scanLine(y);
+            for(int x = 0 ; x < width ; x++){
+                int x0 = qMin(2*x  ,image.width()-1);
+                int x1 = qMin(2*x+1,image.width()-1);
+                QRgb p[4] = {line0[x0],line0[x1],line1[x0],line1[x1]};
+                int r = 0, g = 0, b = 0, a = 0;
+                for(int k = 0 ; k < 4 ; k++){
+                    r += qRed(p[k]); g += qGreen(p[k]); b += qBlue(p[k]); a += qAlpha(p[k]);
+                }
+                if(bNormalize){
+                    float n[3] = {r/510.0f - 1.0f, g/510.0f - 1.0f, b/510.0f - 1.0f};
+                    float len = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+                    if(len > 1.0e-6f){
+                        r = qBound(0,int((n[0]/len*0.5f + 0.5f)*255.0f*4.0f + 0.5f),1020);
+                        g = qBound(0,int((n[1]/len*0.5f + 0.5f)*255.0f*4.0f + 0.5f),1020);
+                        b = qBound(0,int((n[2]/len*0.5f + 0.5f)*255.0f*4.0f + 0.5f),1020);
+                    }
+                }
+                dst[x] = qRgba((r+2)/4,(g+2)/4,(b+2)/4,(a+2)/4);
+            }
+        }
+    },16);
+    return level;
+}
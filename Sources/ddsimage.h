@@ -0,0 +1,39 @@
+#ifndef DDSIMAGE_H
+#define DDSIMAGE_H
+
+#include <QImage>
+#include <QString>
+#include <QByteArray>
+#include "CommonObjects.h"
+
+enum DDSFormat{
+    DDS_BC1 = 0, // DXT1, opaque color
+    DDS_BC3,     // DXT5, color with alpha
+    DDS_BC4,     // ATI1, single channel (red)
+    DDS_BC5      // ATI2, two channels (red and green of normal map)
+};
+
+/**
+ * @brief The DDSImage class writes block compressed DDS files with the full
+ * mipmap chain. Blocks of each level are encoded in parallel by rows of blocks.
+ */
+class DDSImage{
+public:
+    /**
+     * @brief formatForTexture chooses compression for given map: BC5 for normals,
+     * BC4 for grayscale maps (height, occlusion, roughness, metallic), BC1 or BC3 for the others
+     * depending on the content of alpha channel (e.g. packed maps).
+     */
+    static DDSFormat formatForTexture(TextureTypes imageType, const QImage& image);
+    // Returns false if file could not be written.
+    bool write(const QImage& image, const QString& fileName, DDSFormat format);
+
+private:
+    // Encodes one mip level. Pixels are in QImage::Format_ARGB32.
+    void encodeLevel(const QImage& image, DDSFormat format, QByteArray& out);
+    // Next mip level (box filter). Normals are renormalized.
+    QImage downsample(const QImage& image, bool bNormalize);
+    static int blockSize(DDSFormat format);
+};
+
+#endif // DDSIMAGE_H
@@ -1,4 +1,5 @@
 #include "formimagebase.h"
+#include "imageexporter.h"
 QDir* FormImageBase::recentDir;
 
 FormImageBase::FormImageBase(QWidget *parent) : QWidget(parent)
@@ -41,29 +42,24 @@ void FormImageBase::open()
 }
 
 
-void FormImageBase::saveFileToDir(const QString &dir){
+QString FormImageBase::getFileNameInDir(const QString &dir){
+    return dir + "/" + imageName + PostfixNames::getPostfix(imageProp.imageType)
+                     + PostfixNames::outputFormat;
+}
 
-    QString fullFileName = dir + "/" +
-                           imageName + PostfixNames::getPostfix(imageProp.imageType)
-                           + PostfixNames::outputFormat;
-    saveFile(fullFileName);
+void FormImageBase::saveFileToDir(const QString &dir){
+    saveFile(getFileNameInDir(dir));
 }
 
 void FormImageBase::saveImageToDir(const QString &dir,QImage& image){
 
-    QString fullFileName = dir + "/" +
-                           imageName + PostfixNames::getPostfix(imageProp.imageType)
-                           + PostfixNames::outputFormat;
+    QString fullFileName = getFileNameInDir(dir);
 
     qDebug() << "<FormImageProp> save image:" << fullFileName;
     QFileInfo fileInfo(fullFileName);
     (*recentDir).setPath(fileInfo.absolutePath());
 
-    if( PostfixNames::outputFormat.compare(".tga") == 0){
-        TargaImage tgaImage;
-        tgaImage.write(image,fullFileName);
-    }else
-        image.save(fullFileName);
+    ImageExporter::save(image,fullFileName,imageProp.imageType);
 }
 
 void FormImageBase::setImageName(QString name){
@@ -95,7 +91,7 @@ void FormImageBase::save(){
     QFileDialog dialog(this,
                        tr("Save current image to file"),
                        picturesLocations.isEmpty() ? QDir::currentPath() : picturesLocations.first(),
-                       tr("All images (*.png *.jpg  *.tga *.jpeg *.bmp *.tif);;All files (*.*)"));
+                       tr("All images (*.png *.jpg  *.tga *.jpeg *.bmp *.tif *.dds);;All files (*.*)"));
     dialog.setDirectory(recentDir->absolutePath());
     dialog.setAcceptMode(QFileDialog::AcceptSave);
 
@@ -111,14 +107,10 @@ bool FormImageBase::saveFile(const QString &fileName){
     (*recentDir).setPath(fileInfo.absolutePath());
     image = imageProp.getImage();
 
-    if( PostfixNames::outputFormat.compare(".tga") == 0 || fileInfo.completeSuffix().compare("tga") == 0 ){
-        TargaImage tgaImage;
-        tgaImage.write(image,fileName);
-    }else{
-        image.save(fileName);
-    }
-
-    return true;
+    // format is chosen by the suffix, use the output format if there is none
+    if(fileInfo.suffix().isEmpty())
+        return ImageExporter::save(image,fileName + PostfixNames::outputFormat,imageProp.imageType);
+    return ImageExporter::save(image,fileName,imageProp.imageType);
 }
 
 void FormImageBase::dropEvent(QDropEvent *event)
@@ -19,6 +19,8 @@ public:
     virtual FBOImageProporties* getImageProporties(){return &imageProp;}
     virtual void setImageName(QString name);
     virtual QString getImageName();
+    // Output file name of this map in given directory.
+    QString getFileNameInDir(const QString &dir);
     virtual void saveFileToDir(const QString &dir);
     virtual void saveImageToDir(const QString &dir,QImage& image);
     virtual void setImageType(TextureTypes imageType);
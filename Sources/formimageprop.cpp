@@ -48,6 +48,12 @@ FormImageProp::FormImageProp(QMainWindow *parent, QGLWidget* qlW_ptr) :
     bOpenNormalMapMixer   = false;
 
     imageProp.glWidget_ptr = qlW_ptr;
+
+    // preview is processed immediately, full resolution image replaces it later
+    imageLoader = new ImageLoader(this);
+    connect(imageLoader,SIGNAL(previewLoaded(QString,QImage)),this,SLOT(applyLoadedImage(QString,QImage)));
+    connect(imageLoader,SIGNAL(imageLoaded(QString,QImage)),this,SLOT(applyLoadedImage(QString,QImage)));
+    connect(imageLoader,SIGNAL(loadFailed(QString)),this,SLOT(showLoadError(QString)));
     
     connect(ui->pushButtonOpenImage,SIGNAL(released()),this,SLOT(open()));
     connect(ui->pushButtonSaveImage,SIGNAL(released()),this,SLOT(save()));
@@ -271,31 +277,46 @@ FormImageProp::~FormImageProp()
 
 
 
+bool FormImageProp::checkFile(const QString &fileName){
+    if(!ImageLoader::canRead(fileName)){
+        showLoadError(fileName);
+        return false;
+    }
+    return true;
+}
+
 bool FormImageProp::loadFile(const QString &fileName)
 {
-    QFileInfo fileInfo(fileName);
-    QImage _image;
-//    qDebug() << "Opening file: " << fileName;
-    // Targa support added
-    if(fileInfo.completeSuffix().compare("tga") == 0){
-        TargaImage tgaImage;
-        _image = tgaImage.read(fileName);
-    }else{
-        QImageReader loadedImage(fileName);
-        _image = loadedImage.read();
-    }
+    if(!checkFile(fileName)) return false;
+    // mixer texture is not processed so there is no use of preview
+    imageLoader->load(fileName,!imageProp.properties->NormalsMixer.EnableMixer);
+    return true;
+}
 
-    if (_image.isNull()) {
-        QMessageBox::information(this, QGuiApplication::applicationDisplayName(),
-                                 tr("Cannot load %1.").arg(QDir::toNativeSeparators(fileName)));
+bool FormImageProp::loadFileSync(const QString &fileName)
+{
+    imageLoader->cancel();
+    if(!checkFile(fileName)) return false;
+    QImage _image = ImageLoader::read(fileName);
+    if(_image.isNull()){
+        showLoadError(fileName);
         return false;
     }
+    applyLoadedImage(fileName,_image);
+    return true;
+}
+
+void FormImageProp::showLoadError(const QString &fileName){
+    QMessageBox::information(this, QGuiApplication::applicationDisplayName(),
+                             tr("Cannot load %1.").arg(QDir::toNativeSeparators(fileName)));
+}
+
+void FormImageProp::applyLoadedImage(const QString &fileName, const QImage &_image){
+    QFileInfo fileInfo(fileName);
     if(imageProp.properties->NormalsMixer.EnableMixer){
         qDebug() << "<FormImageProp> Open normal mixer image:" << fileName;
 
-        imageProp.glWidget_ptr->makeCurrent();
-        if(glIsTexture(imageProp.normalMixerInputTexId)) imageProp.glWidget_ptr->deleteTexture(imageProp.normalMixerInputTexId);
-        imageProp.normalMixerInputTexId = imageProp.glWidget_ptr->bindTexture(_image,GL_TEXTURE_2D);        
+        imageProp.setNormalMixerImage(_image);
 
         emit imageChanged();
 
@@ -311,10 +332,10 @@ bool FormImageProp::loadFile(const QString &fileName)
         emit imageLoaded(image.width(),image.height());
         if(imageProp.imageType == GRUNGE_TEXTURE)emit imageChanged();
     }
-    return true;
 }
 
 void FormImageProp::pasteImageFromClipboard(QImage& _image){
+    imageLoader->cancel(); // pasted image replaces the file which is still loading
     imageName = "clipboard_image";
     image     = _image;
     imageProp.init(image);
@@ -460,7 +481,8 @@ void FormImageProp::applyHeightNormalToOcclusionConversion(){
 void FormImageProp::showHeightCalculatorDialog(){
 
      //heightCalculator->setImageSize(imageProp.ref_fbo->width(),imageProp.ref_fbo->height());
-     heightCalculator->setImageSize(imageProp.fbo->width(),imageProp.fbo->height());
+     QSize imageSize = imageProp.getSize();
+     heightCalculator->setImageSize(imageSize.width(),imageSize.height());
      unsigned int result = heightCalculator->exec();
      if(result == QDialog::Accepted){
         ui->horizontalSliderConversionHNDepth->setValue(heightCalculator->getDepthInPixels()*5);
@@ -486,9 +508,7 @@ void FormImageProp::pasteNormalFromClipBoard(){
         QPixmap pixmap = qvariant_cast<QPixmap>(mimeData->imageData());
         QImage _image = pixmap.toImage();
 
-        imageProp.glWidget_ptr->makeCurrent();
-        if(glIsTexture(imageProp.normalMixerInputTexId)) imageProp.glWidget_ptr->deleteTexture(imageProp.normalMixerInputTexId);
-        imageProp.normalMixerInputTexId = imageProp.glWidget_ptr->bindTexture(_image,GL_TEXTURE_2D);
+        imageProp.setNormalMixerImage(_image);
         emit imageChanged();
 
     }
@@ -13,6 +13,7 @@
 
 #include "formimagebase.h"
 #include "dialogheightcalculator.h"
+#include "imageloader.h"
 
 
 namespace Ui {
@@ -30,7 +31,10 @@ public:
 
     void setupPopertiesGUI();
     void reloadSettings();
+    // Decodes the file in background, the image is replaced when it is ready.
     bool loadFile(const QString &fileName);
+    // Same as loadFile but returns after the image is loaded (batch mode).
+    bool loadFileSync(const QString &fileName);
 
     ~FormImageProp();
 
@@ -70,6 +74,10 @@ public slots:
     void toggleGrungeImageSettingsGroup(bool toggle);    
     void loadPredefinedGrunge(QString);
 
+private slots:
+    void applyLoadedImage(const QString& fileName, const QImage& image);
+    void showLoadError(const QString& fileName);
+
 signals:
     void reloadSettingsFromConfigFile(TextureTypes type);
     void imageChanged();
@@ -87,10 +95,12 @@ signals:
 private:
 
     void pasteImageFromClipboard(QImage& _image);
+    bool checkFile(const QString &fileName);
 
 
     Ui::FormImageProp *ui;
     DialogHeightCalculator      *heightCalculator;     // height calculator tool
+    ImageLoader                 *imageLoader;          // background decoding of opened files
 
 
 public:
@@ -1,9 +1,13 @@
 #include "formmaterialindicesmanager.h"
 #include "ui_formmaterialindicesmanager.h"
+#include "utils/parallel.h"
 
 FormMaterialIndicesManager::FormMaterialIndicesManager(QMainWindow *parent, QGLWidget* qlW_ptr) :
     FormImageBase(parent),
-    ui(new Ui::FormMaterialIndicesManager)
+    lastMaterialIndex(0),
+    visibleTexture(-1),
+    ui(new Ui::FormMaterialIndicesManager),
+    bSkipUpdating(false)
 {
     ui->setupUi(this);
     imageProp.glWidget_ptr = qlW_ptr;
@@ -55,37 +59,83 @@ void FormMaterialIndicesManager::setImage(QImage _image){
 bool FormMaterialIndicesManager::updateMaterials(QImage& image){
     bSkipUpdating = true;
 
-    // Calculate image color map
-    colorIndices.clear();
-    for(int w = 0 ; w < image.width() ; w++){
-        for(int h = 0 ; h < image.height() ; h++){
-            QRgb pixel          = image.pixel(w,h);
-            QColor bgColor = QColor(pixel);
-            int indeks = bgColor.red()*255*255 + bgColor.green()*255 + bgColor.blue();
-            colorIndices[indeks] = pixel;
-
-    }}
-    if(colorIndices.size() > 32){
+    // Calculate image color map: each thread counts colors in its rows
+    QImage rgbImage = image.convertToFormat(QImage::Format_RGB32);
+    int width  = rgbImage.width();
+    int height = rgbImage.height();
+    const int minRows = 64;
+    std::vector< QHash<QRgb,int> > histograms(parallelRanges(height,minRows));
+    parallelFor(height,[&](int begin,int end,int range){
+        QHash<QRgb,int>& histogram = histograms[range];
+        for(int y = begin ; y < end ; y++){
+            const QRgb* line = (const QRgb*)rgbImage.constScanLine(y);
+            // neighbouring pixels have usually the same color
+            QRgb lastColor = 0;
+            int* lastCount = NULL;
+            for(int x = 0 ; x < width ; x++){
+                QRgb color = line[x] & RGB_MASK;
+                if(lastCount == NULL || color != lastColor){
+                    lastCount = &histogram[color];
+                    lastColor = color;
+                }
+                (*lastCount)++;
+            }
+            if(histogram.size() > MAX_MATERIALS) return; // not a material texture
+        }
+    },minRows);
+
+    QHash<QRgb,int> colorCounts;
+    for(size_t r = 0 ; r < histograms.size() ; r++){
+        QHash<QRgb,int>::const_iterator it = histograms[r].constBegin();
+        for(; it != histograms[r].constEnd(); ++it) colorCounts[it.key()] += it.value();
+    }
+
+    if(colorCounts.size() > MAX_MATERIALS){
     QMessageBox msgBox;
         msgBox.setText("Error: too much colors!");
         msgBox.setInformativeText(" Sorry, but this image does not look like a material texture.\n"
-                                  " Your image contains more than 32 different colors");
+                                  " Your image contains more than "+QString::number(MAX_MATERIALS)+" different colors");
         msgBox.setStandardButtons(QMessageBox::Cancel);
         msgBox.exec();
         bSkipUpdating = false;
         return false;
     }
 
-    typedef std::map<int,QRgb>::iterator it_type;
+    // material ID is the position of the color in sorted list
+    materialColors = colorCounts.keys().toVector();
+    qSort(materialColors);
+    QHash<QRgb,int> materialColorIds;
+    for(int m = 0 ; m < materialColors.size() ; m++) materialColorIds[materialColors[m]] = m;
+
+    // ID texture has the same orientation as the material texture (mirrored)
+    QVector<quint16> ids(width*height);
+    parallelFor(height,[&](int begin,int end,int){
+        for(int y = begin ; y < end ; y++){
+            const QRgb* line = (const QRgb*)rgbImage.constScanLine(y);
+            quint16* out     = ids.data() + (height - 1 - y)*width;
+            QRgb lastColor   = line[0] & RGB_MASK;
+            quint16 lastId   = materialColorIds.value(lastColor);
+            for(int x = 0 ; x < width ; x++){
+                QRgb color = line[x] & RGB_MASK;
+                if(color != lastColor){
+                    lastColor = color;
+                    lastId    = materialColorIds.value(color);
+                }
+                out[x] = lastId;
+            }
+        }
+    },minRows);
+    imageProp.setMaterialIds(ids,width,height);
+
     ui->listWidgetMaterialIndices->clear();
 
     // generate materials list
-    int indeks = 1;
-    for(it_type iterator = colorIndices.begin(); iterator != colorIndices.end(); iterator++) {
-           qDebug() << "Material index:  " << iterator->first << " Color :" << QColor(iterator->second);
+    for(int m = 0 ; m < materialColors.size() ; m++) {
+           qDebug() << "Material index:  " << m << " Color :" << QColor(materialColors[m])
+                    << " Pixels:" << colorCounts[materialColors[m]];
 
-           QListWidgetItem* pItem =new QListWidgetItem("Material"+QString::number(indeks++));
-           QColor mColor = QColor(iterator->second);
+           QListWidgetItem* pItem =new QListWidgetItem("Material"+QString::number(m+1));
+           QColor mColor = QColor(materialColors[m]);
            pItem->setForeground(mColor); // sets red text
            pItem->setBackground(mColor); // sets green background
            QColor textColor = QColor(255-mColor.red(),255-mColor.green(),255-mColor.blue());
@@ -96,14 +146,11 @@ bool FormMaterialIndicesManager::updateMaterials(QImage& image){
 
 
     qDebug() << "Updating material indices. Total indices count:" << ui->listWidgetMaterialIndices->count();
+    attachAllProperties(); // settings of the previous selection become the default
     for(int i = 0 ; i < MATERIAL_TEXTURE ; i++){
-        materialIndices[i].clear();
-        for(int m = 0 ; m < ui->listWidgetMaterialIndices->count() ; m++){
-            QString m_name = ui->listWidgetMaterialIndices->item(m)->text();
-            FBOImageProporties tmp;
-            tmp.copySettings(imagesPointers[i]->imageProp);
-            materialIndices[i][m_name] = tmp;
-        }
+        MaterialSettings settings;
+        settings.store(imagesPointers[i]->imageProp);
+        materialSettings[i].fill(settings,materialColors.size());
     }
 
 
@@ -111,8 +158,7 @@ bool FormMaterialIndicesManager::updateMaterials(QImage& image){
     QString cText = ui->listWidgetMaterialIndices->item(lastMaterialIndex)->text();
     ui->listWidgetMaterialIndices->item(lastMaterialIndex)->setText(cText+" (selected material)");
 
-    QColor bgColor = ui->listWidgetMaterialIndices->item(lastMaterialIndex)->backgroundColor();
-    FBOImageProporties::currentMaterialIndeks = bgColor.red()*255*255 + bgColor.green()*255 + bgColor.blue();
+    FBOImageProporties::currentMaterialIndeks = lastMaterialIndex;
 
     bSkipUpdating = false;
 
@@ -122,27 +168,52 @@ bool FormMaterialIndicesManager::updateMaterials(QImage& image){
 }
 
 
+void FormMaterialIndicesManager::storeCurrentMaterial(){
+    for(int i = 0 ; i < MATERIAL_TEXTURE ; i++){
+        if(lastMaterialIndex >= materialSettings[i].size()) continue;
+        // detached settings were not changed, they are already stored
+        if(imagesPointers[i]->imageProp.bDetachedParameters) continue;
+        materialSettings[i][lastMaterialIndex].store(imagesPointers[i]->imageProp);
+    }
+}
+
+void FormMaterialIndicesManager::attachAllProperties(){
+    for(int i = 0 ; i < MATERIAL_TEXTURE ; i++){
+        FBOImageProporties& current = imagesPointers[i]->imageProp;
+        if(!current.bDetachedParameters) continue;
+        materialSettings[i][lastMaterialIndex].restore(current);
+        imagesPointers[i]->reloadSettings();
+    }
+}
+
+void FormMaterialIndicesManager::setVisibleTexture(int tType){
+    visibleTexture = tType;
+    if(tType < 0 || tType >= MATERIAL_TEXTURE) return;
+    FBOImageProporties& current = imagesPointers[tType]->imageProp;
+    if(!current.bDetachedParameters) return;
+    materialSettings[tType][lastMaterialIndex].restore(current);
+    imagesPointers[tType]->reloadSettings();
+}
+
 void FormMaterialIndicesManager::changeMaterial(int index){
     if(bSkipUpdating) return;
     // copy current settings
     ui->listWidgetMaterialIndices->item(lastMaterialIndex)->setText("Material"+QString::number(lastMaterialIndex+1));
-
-    QString m_name = ui->listWidgetMaterialIndices->item(lastMaterialIndex)->text();
-    for(int i = 0 ; i < MATERIAL_TEXTURE ; i++){
-        materialIndices[i][m_name].copySettings(imagesPointers[i]->imageProp);
-    }
+    storeCurrentMaterial();
 
     lastMaterialIndex = index;
 
     // update current mask color
-    QColor bgColor = ui->listWidgetMaterialIndices->item(lastMaterialIndex)->backgroundColor();
-    FBOImageProporties::currentMaterialIndeks = bgColor.red()*255*255 + bgColor.green()*255 + bgColor.blue();
+    FBOImageProporties::currentMaterialIndeks = lastMaterialIndex;
 
-    // load different material
-    m_name = ui->listWidgetMaterialIndices->item(index)->text();
+    // load different material, only the visible form is updated
     for(int i = 0 ; i < MATERIAL_TEXTURE ; i++){
-        imagesPointers[i]->imageProp.copySettings(materialIndices[i][m_name]);
-        imagesPointers[i]->reloadSettings();
+        if(i == visibleTexture){
+            materialSettings[i][index].restore(imagesPointers[i]->imageProp);
+            imagesPointers[i]->reloadSettings();
+        }else{
+            materialSettings[i][index].detach(imagesPointers[i]->imageProp);
+        }
     }
     QString cText = ui->listWidgetMaterialIndices->item(lastMaterialIndex)->text();
     ui->listWidgetMaterialIndices->item(lastMaterialIndex)->setText(cText+" (selected material)");
@@ -214,6 +285,11 @@ void FormMaterialIndicesManager::toggleMaterials(bool toggle){
     if(toggle == false){
         FBOImageProporties::currentMaterialIndeks = MATERIALS_DISABLED; // render normaly
         emit materialChanged();
+    }else if(prepareMaterialBatch()){ // all materials in one pass
+        FBOImageProporties::currentMaterialIndeks = MATERIALS_BATCH;
+        emit materialChanged();
+        clearMaterialBatch();
+        FBOImageProporties::currentMaterialIndeks = lastMaterialIndex;
     }else{ // if material group is enabled -> replot all materials
 
         int lastMaterial = lastMaterialIndex;
@@ -230,6 +306,66 @@ void FormMaterialIndicesManager::toggleMaterials(bool toggle){
 }
 
 
+// Returns the parameters with values from the parameters buffer replaced by
+// reference ones. If the result is equal to the reference the material differs
+// only in values which can be read per pixel in the shaders.
+static ImageParameters materialStructure(const ImageParameters& p, const ImageParameters& ref){
+    ImageParameters tmp = p;
+
+    tmp.Basic_ColorHue                    = ref.Basic_ColorHue;
+    tmp.Basic_NormalsStep                 = ref.Basic_NormalsStep;
+    tmp.Basic_ColorComponents_InvertRed   = ref.Basic_ColorComponents_InvertRed;
+    tmp.Basic_ColorComponents_InvertGreen = ref.Basic_ColorComponents_InvertGreen;
+    tmp.Basic_ColorComponents_InvertBlue  = ref.Basic_ColorComponents_InvertBlue;
+    tmp.SurfaceDetails_Contrast           = ref.SurfaceDetails_Contrast;
+    tmp.ColorLevels_MinValue              = ref.ColorLevels_MinValue;
+    tmp.ColorLevels_MaxValue              = ref.ColorLevels_MaxValue;
+    tmp.ColorLevels_Offset                = ref.ColorLevels_Offset;
+    tmp.RMFilter_NoiseFilter_Treshold     = ref.RMFilter_NoiseFilter_Treshold;
+    tmp.RMFilter_NoiseFilter_Amplifier    = ref.RMFilter_NoiseFilter_Amplifier;
+    // zero value disables the details filters
+    if((tmp.Basic_SmallDetails > 0.0f) == (ref.Basic_SmallDetails > 0.0f))
+        tmp.Basic_SmallDetails = ref.Basic_SmallDetails;
+    if((tmp.Basic_MediumDetails > 0.0f) == (ref.Basic_MediumDetails > 0.0f))
+        tmp.Basic_MediumDetails = ref.Basic_MediumDetails;
+
+    return tmp;
+}
+
+bool FormMaterialIndicesManager::prepareMaterialBatch(){
+    int noMaterials = ui->listWidgetMaterialIndices->count();
+    if(noMaterials == 0) return false;
+
+    storeCurrentMaterial();
+    for(int i = 0 ; i < MATERIAL_TEXTURE ; i++){
+        FBOImageProporties& current = imagesPointers[i]->imageProp;
+        const MaterialSettings& ref = materialSettings[i][lastMaterialIndex];
+        for(int m = 0 ; m < noMaterials ; m++){
+            const MaterialSettings& material = materialSettings[i][m];
+            if(material.inputImageType    != ref.inputImageType    ||
+               material.conversionHNDepth != ref.conversionHNDepth ||
+               materialStructure(material.parameters,ref.parameters) != ref.parameters){
+                qDebug() << "Materials differ in" << PostfixNames::getTextureName(current.imageType)
+                         << "settings. Processing each material separately.";
+                return false;
+            }
+        }
+    }
+
+    for(int i = 0 ; i < MATERIAL_TEXTURE ; i++){
+        QVector<ImageParameters>& batch = imagesPointers[i]->imageProp.materialBatchParameters;
+        batch.resize(noMaterials);
+        for(int m = 0 ; m < noMaterials ; m++) batch[m] = materialSettings[i][m].parameters;
+    }
+    return true;
+}
+
+void FormMaterialIndicesManager::clearMaterialBatch(){
+    for(int i = 0 ; i < MATERIAL_TEXTURE ; i++){
+        imagesPointers[i]->imageProp.materialBatchParameters.clear();
+    }
+}
+
 void FormMaterialIndicesManager::chooseMaterialByColor(QColor color){
     // check if materials are enabled
     if(FBOImageProporties::currentMaterialIndeks == MATERIALS_DISABLED) return;
@@ -8,7 +8,6 @@
 namespace Ui {
 class FormMaterialIndicesManager;
 }
-typedef std::map<int,QRgb>::iterator it_type;
 class FormMaterialIndicesManager : public FormImageBase
 {
     Q_OBJECT
@@ -25,6 +24,13 @@ public:
     bool updateMaterials(QImage &_image);
     bool isEnabled();
     void disableMaterials();
+    // Fills FBOImageProporties batch data when all materials can be processed in
+    // one pass, i.e. they differ only in settings stored in the parameters buffer.
+    bool prepareMaterialBatch();
+    void clearMaterialBatch();
+    // Loads the selected material to the property sets of the hidden images,
+    // call it before the property sets are read or written directly.
+    void attachAllProperties();
 
     // just pointers to images
     FormImageProp* imagesPointers[7];
@@ -36,6 +42,8 @@ public slots:
     void copyToClipboard();
     void toggleMaterials(bool toggle);// enable disable materials
     void chooseMaterialByColor(QColor color);// takes a color then searches for similar in materials table
+    // Texture type shown in the UI, its property set is loaded when it was detached.
+    void setVisibleTexture(int tType);
 signals:
     void materialChanged();
     void imageLoaded(int width,int height);
@@ -43,16 +51,47 @@ signals:
 protected:
 
     bool loadFile(const QString &fileName);
+    // copy current settings of the selected material
+    void storeCurrentMaterial();
     void pasteImageFromClipboard(QImage& image);
 
 
 
 
 
-    // keep all the settings in one place
-    std::map<QString,FBOImageProporties> materialIndices[7];
-    std::map<int,QRgb> colorIndices;
+    // Settings of one material for one texture type. Only the selected material
+    // of the visible texture is loaded to its property set, the hidden images
+    // get the settings detached (writing a property set emits change signals
+    // and the form has to be reloaded).
+    struct MaterialSettings{
+        ImageParameters parameters;
+        SourceImageType inputImageType;
+        float conversionHNDepth;
+
+        void store(const FBOImageProporties& imageProp){
+            parameters.fromProperties(*imageProp.properties);
+            inputImageType    = imageProp.inputImageType;
+            conversionHNDepth = imageProp.conversionHNDepth;
+        }
+        void restore(FBOImageProporties& imageProp) const{
+            parameters.toProperties(*imageProp.properties);
+            imageProp.bDetachedParameters = false;
+            imageProp.inputImageType    = inputImageType;
+            imageProp.conversionHNDepth = conversionHNDepth;
+        }
+        void detach(FBOImageProporties& imageProp) const{
+            imageProp.detachedParameters  = parameters;
+            imageProp.bDetachedParameters = true;
+            imageProp.inputImageType    = inputImageType;
+            imageProp.conversionHNDepth = conversionHNDepth;
+        }
+    };
+
+    // keep all the settings in one place, vector index is the material ID
+    QVector<MaterialSettings> materialSettings[MATERIAL_TEXTURE];
+    QVector<QRgb> materialColors; // color of each material ID
     int lastMaterialIndex;
+    int visibleTexture; // texture type shown in the UI, -1 when none
     Ui::FormMaterialIndicesManager *ui;
     bool bSkipUpdating;
 };
@@ -38,6 +38,11 @@
 **
 ****************************************************************************/
 #include "glimageeditor.h"
+#include "utils/parallel.h"
+#include <cfloat>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
 
 
 
@@ -47,7 +52,6 @@ GLImage::GLImage(QWidget *parent)
 {
     bShadowRender         = false;
     bSkipProcessing       = false;
-    bRendering            = false;
     bToggleColorPicking   = false;
     conversionType        = CONVERT_NONE;
     uvManilupationMethod  = UV_TRANSLATE;
@@ -72,8 +76,21 @@ GLImage::GLImage(QWidget *parent)
     cornerCursors[1] = QCursor(QPixmap(":/resources/cursors/corner2.png"));
     cornerCursors[2] = QCursor(QPixmap(":/resources/cursors/corner3.png"));
     cornerCursors[3] = QCursor(QPixmap(":/resources/cursors/corner4.png"));
-    activeImage = NULL;
-    connect(this,SIGNAL(rendered()),this,SLOT(copyRenderToPaintFBO()));
+    activeImage    = NULL;
+    currentImage   = NULL;
+    program        = NULL;
+    gui            = NULL;
+    displayProgram = NULL;
+    display_vao    = 0;
+    displaySubroutine = 0;
+    resize_width   = 0;
+    resize_height  = 0;
+
+    // Images create their FBOs when they are loaded, this can happen before
+    // initializeGL so the render context has to exist already.
+    renderThread = new RenderThread(context()->contextHandle(),this);
+    renderThread->start();
+    connect(this,SIGNAL(published(int,double,bool)),this,SLOT(framePublished(int,double,bool)));
 }
 
 GLImage::~GLImage()
@@ -83,35 +100,59 @@ GLImage::~GLImage()
 
 void GLImage::cleanup()
 {
+  if(renderThread == NULL) return;
+  // processing objects belong to the render context
+  renderThread->invoke([this](){
+    if(program == NULL) return; // initializeGL was not called
+    normalizationReadback.release();
+    averageColorFBO->bindDefault();
+    typedef std::map<std::string,QOpenGLShaderProgram*>::iterator it_type;
+    qDebug() << "Removing GLImage filters:";
+    for(it_type iterator = filter_programs.begin(); iterator != filter_programs.end(); iterator++) {
+        qDebug() << "Removing filter:" << QString(iterator->first.c_str());
+        delete iterator->second;
+    }
+
+    FBOImages::remove(averageColorFBO);
+    FBOImages::remove(samplerFBO1);
+    FBOImages::remove(samplerFBO2);
+    for(int i = 0; i < 4 ; i++){
+        FBOImages::remove(auxColorFBOs[i]);
+    }
+    for(int i = 0; i < 2 ; i++){
+        FBOImages::remove(auxGrayFBOs[i]);
+    }
+    FBOImages::remove(workFBO);
+
+    for(int i = 0; i < 3 ; i++){
+        FBOImages::remove(auxFBO0BMLevels[i]);
+        FBOImages::remove(auxFBO1BMLevels[i]);
+        FBOImages::remove(auxFBO2BMLevels[i]);
+    }
+    FBOImages::remove(paintFBO);
+    FBOImages::remove(packFBO);
+    FBOImages::remove(renderFBO);
+
+
+#ifndef USE_OPENGL_330
+    delete program;
+#endif
+    program = NULL;
+    filter_programs.clear();
+
+    GLCHK(glDeleteBuffers(sizeof(vbos)/sizeof(GLuint), &vbos[0]));
+    GLCHK(glDeleteVertexArrays(1, &screen_vao));
+    GLCHK(glDeleteBuffers(1, &materialParamsBuffer));
+    GLCHK(glDeleteTextures(1, &materialParamsTexture));
+  });
+  renderThread->stop();
+
   makeCurrent();
-  averageColorFBO->bindDefault();
-  typedef std::map<std::string,QOpenGLShaderProgram*>::iterator it_type;
-  qDebug() << "Removing GLImage filters:";
-  for(it_type iterator = filter_programs.begin(); iterator != filter_programs.end(); iterator++) {
-      qDebug() << "Removing filter:" << QString(iterator->first.c_str());
-      delete iterator->second;
-  }
-
-  delete averageColorFBO;
-  delete samplerFBO1;
-  delete samplerFBO2;
-  delete auxFBO1;
-  delete auxFBO2;
-  delete auxFBO3;
-  delete auxFBO4;
-
-  for(int i = 0; i < 3 ; i++){
-      delete auxFBO0BMLevels[i] ;
-      delete auxFBO1BMLevels[i] ;
-      delete auxFBO2BMLevels[i] ;
-  }
-  delete  paintFBO;
-  delete renderFBO;
-
-
-  GLCHK(glDeleteBuffers(sizeof(vbos)/sizeof(GLuint), &vbos[0]));
-  GLCHK(glDeleteVertexArrays(1, &screen_vao));
+  delete displayProgram;
+  displayProgram = NULL;
+  if(gui != NULL) GLCHK(gui->glDeleteVertexArrays(1, &display_vao));
   doneCurrent();
+  renderThread = NULL; // deleted with the widget
 }
 
 QSize GLImage::minimumSizeHint() const
@@ -125,20 +166,86 @@ QSize GLImage::sizeHint() const
     return QSize(500, 400);
 }
 
+// Source of all filters, see createFilterProgram.
+static QString filtersShaderCode(){
+    QFile fFile(":/resources/shaders/filters.frag");
+    fFile.open(QFile::ReadOnly);
+    QTextStream inf(&fFile);
+    return inf.readAll();
+}
+
 void GLImage::initializeGL()
 {
 
-    initializeOpenGLFunctions();
-
     qDebug() << "calling " << Q_FUNC_INFO;
-    
+
+    // the widget context only draws the published frames
+    gui = context()->contextHandle()->versionFunctions<OPENGL_FUNCTIONS>();
+    gui->initializeOpenGLFunctions();
+
     QColor clearColor = QColor::fromCmykF(0.79, 0.79, 0.79, 0.0).dark();
-    GLCHK( glClearColor((GLfloat)clearColor.red() / 255.0, (GLfloat)clearColor.green() / 255.0,
+    GLCHK( gui->glClearColor((GLfloat)clearColor.red() / 255.0, (GLfloat)clearColor.green() / 255.0,
 			(GLfloat)clearColor.blue() / 255.0, (GLfloat)clearColor.alpha() / 255.0) );
-    GLCHK( glEnable(GL_MULTISAMPLE) );
-    GLCHK( glEnable(GL_DEPTH_TEST) );
+    GLCHK( gui->glEnable(GL_MULTISAMPLE) );
+    GLCHK( gui->glEnable(GL_DEPTH_TEST) );
+
+    renderThread->invoke([this](){ initializeRenderContext(); });
+
+    // Uniforms are stored in the program, so the view draws with its own
+    // copy of the normal filter. Buffers are shared, VAOs are not.
+    QOpenGLShader vshader(QOpenGLShader::Vertex);
+    vshader.compileSourceFile(":/resources/shaders/filters.vert");
+#ifdef USE_OPENGL_330
+    displayProgram = createFilterProgram(&vshader,"#version 330 core\n"
+                                                  "#define USE_OPENGL_330\n"
+                                                  "#define mode_normal_filter_330\n" + filtersShaderCode());
+#else
+    displayProgram = createFilterProgram(&vshader,"#version 400 core\n" + filtersShaderCode());
+    GLCHK( displaySubroutine = gui->glGetSubroutineIndex(displayProgram->programId(),GL_FRAGMENT_SHADER,"mode_normal_filter") );
+#endif
+    GLCHK( gui->glGenVertexArrays(1, &display_vao) );
+    GLCHK( gui->glBindVertexArray(display_vao) );
+    GLCHK( gui->glBindBuffer(GL_ARRAY_BUFFER, vbos[0]) );
+    GLCHK( gui->glEnableVertexAttribArray(0) );
+    GLCHK( gui->glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,sizeof(float)*3,(void*)0) );
+    GLCHK( gui->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbos[2]) );
+    GLCHK( gui->glBindVertexArray(0) );
+
+    emit readyGL();
+}
+
+/**
+ * @brief createFilterProgram links the filters program in the current context.
+ * Shaders and programs have no parent, they are created in the render thread.
+ */
+QOpenGLShaderProgram* GLImage::createFilterProgram(QOpenGLShader* vshader, const QString& fragmentCode){
 
+    QOpenGLShader fshader(QOpenGLShader::Fragment);
+    fshader.compileSourceCode(fragmentCode);
+    if (!fshader.log().isEmpty()) qDebug() << fshader.log();
 
+    QOpenGLShaderProgram* filterProgram = new QOpenGLShaderProgram();
+    filterProgram->addShader(vshader);
+    filterProgram->addShader(&fshader);
+    filterProgram->bindAttributeLocation("positionIn", 0);
+    GLCHK( filterProgram->link() );
+
+    GLCHK( filterProgram->bind() );
+    GLCHK( filterProgram->setUniformValue("layerA" , 0) );
+    GLCHK( filterProgram->setUniformValue("layerB" , 1) );
+    GLCHK( filterProgram->setUniformValue("layerC" , 2) );
+    GLCHK( filterProgram->setUniformValue("layerD" , 3) );
+    GLCHK( filterProgram->setUniformValue("materialIdTexture" ,10) );
+    GLCHK( filterProgram->setUniformValue("materialParameters" ,11) );
+    GLCHK( filterProgram->release() );
+    filterProgram->removeAllShaders();
+    return filterProgram;
+}
+
+void GLImage::initializeRenderContext()
+{
+
+    initializeOpenGLFunctions();
 
     QVector<QString> filters_list;
     filters_list.push_back("mode_normal_filter");
@@ -176,19 +283,17 @@ void GLImage::initializeGL()
     filters_list.push_back("mode_grunge_normal_warp_filter");
     filters_list.push_back("mode_normal_angle_correction_filter");
     filters_list.push_back("mode_add_noise_filter");
+    filters_list.push_back("mode_pack_channels_filter");
 
 
 
     qDebug() << "Loading filters (fragment shader)";
-    QOpenGLShader *vshader = new QOpenGLShader(QOpenGLShader::Vertex, this);
+    QOpenGLShader *vshader = new QOpenGLShader(QOpenGLShader::Vertex);
     vshader->compileSourceFile(":/resources/shaders/filters.vert");
     if (!vshader->log().isEmpty()) qDebug() << vshader->log();
     else qDebug() << "done";
 
-    QFile fFile(":/resources/shaders/filters.frag");
-    fFile.open(QFile::ReadOnly);
-    QTextStream inf(&fFile);
-    QString shaderCode = inf.readAll();
+    QString shaderCode = filtersShaderCode();
 
 #ifdef USE_OPENGL_330
 
@@ -199,26 +304,8 @@ void GLImage::initializeGL()
                             "#define USE_OPENGL_330\n"
                             "#define "+filters_list[filter]+"_330\n" ;
 
-        QOpenGLShader *fshader = new QOpenGLShader(QOpenGLShader::Fragment, this);
-        fshader->compileSourceCode(preambule + shaderCode);
-        if (!fshader->log().isEmpty()) qDebug() << fshader->log();
-
-        program = new QOpenGLShaderProgram(this);
-        program->addShader(vshader);
-        program->addShader(fshader);
-        program->bindAttributeLocation("positionIn", 0);
-        GLCHK( program->link() );
-
-        GLCHK( program->bind() );
-        GLCHK( program->setUniformValue("layerA" , 0) );
-        GLCHK( program->setUniformValue("layerB" , 1) );
-        GLCHK( program->setUniformValue("layerC" , 2) );
-        GLCHK( program->setUniformValue("layerD" , 3) );
-        GLCHK( program->setUniformValue("materialTexture" ,10) );
-
+        program = createFilterProgram(vshader,preambule + shaderCode);
         filter_programs[filters_list[filter].toStdString()] = program;
-        GLCHK( program->release());
-        delete fshader;
 
     }
 
@@ -231,28 +318,10 @@ void GLImage::initializeGL()
     qDebug() << "Loading filters (vertex shader)";
     QString preambule = "#version 400 core\n";
 
-    QOpenGLShader *fshader = new QOpenGLShader(QOpenGLShader::Fragment, this);
-    fshader->compileSourceCode(preambule + shaderCode);
-    if (!fshader->log().isEmpty()) qDebug() << fshader->log();
-    else qDebug() << "done";
-
-
-
-    program = new QOpenGLShaderProgram(this);
-    program->addShader(vshader);
-    program->addShader(fshader);
-    program->bindAttributeLocation("positionIn", 0);
-    GLCHK( program->link() );
-
+    program = createFilterProgram(vshader,preambule + shaderCode);
     GLCHK( program->bind() );
-    GLCHK( program->setUniformValue("layerA" , 0) );
-    GLCHK( program->setUniformValue("layerB" , 1) );
-    GLCHK( program->setUniformValue("layerC" , 2) );
-    GLCHK( program->setUniformValue("layerD" , 3) );
-    GLCHK( program->setUniformValue("materialTexture" ,10) );
 
     delete vshader;
-    delete fshader;
 
 
     GLCHK( subroutines["mode_normal_filter"]               = glGetSubroutineIndex(program->programId(),GL_FRAGMENT_SHADER,"mode_normal_filter") );
@@ -290,16 +359,27 @@ void GLImage::initializeGL()
     GLCHK( subroutines["mode_grunge_normal_warp_filter"]   = glGetSubroutineIndex(program->programId(),GL_FRAGMENT_SHADER,"mode_grunge_normal_warp_filter" ) );
     GLCHK( subroutines["mode_normal_angle_correction_filter"]   = glGetSubroutineIndex(program->programId(),GL_FRAGMENT_SHADER,"mode_normal_angle_correction_filter" ) );
     GLCHK( subroutines["mode_add_noise_filter"]            = glGetSubroutineIndex(program->programId(),GL_FRAGMENT_SHADER,"mode_add_noise_filter" ) );
+    GLCHK( subroutines["mode_pack_channels_filter"]        = glGetSubroutineIndex(program->programId(),GL_FRAGMENT_SHADER,"mode_pack_channels_filter" ) );
 
 
 #endif
 
     makeScreenQuad();
 
+    GLCHK( glGenBuffers(1, &materialParamsBuffer) );
+    GLCHK( glGenTextures(1, &materialParamsTexture) );
+
     averageColorFBO = NULL;
     samplerFBO1     = NULL;
     samplerFBO2     = NULL;
+    VRAMManager::registerHandle(&averageColorFBO,"GLImage::averageColorFBO");
+    VRAMManager::registerHandle(&samplerFBO1    ,"GLImage::samplerFBO1");
+    VRAMManager::registerHandle(&samplerFBO2    ,"GLImage::samplerFBO2");
     FBOImages::create(averageColorFBO,256,256);
+    // only the last mipmap level is read (average color)
+    GLCHK( glBindTexture(GL_TEXTURE_2D, averageColorFBO->texture()) );
+    GLCHK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST) );
+    GLCHK( glBindTexture(GL_TEXTURE_2D, 0) );
     FBOImages::create(samplerFBO1,1024,1024);
     FBOImages::create(samplerFBO2,1024,1024);
 
@@ -307,96 +387,194 @@ void GLImage::initializeGL()
     auxFBO2 = NULL;
     auxFBO3 = NULL;
     auxFBO4 = NULL;
+    for(int i = 0; i < 4 ; i++) auxColorFBOs[i] = NULL;
+    for(int i = 0; i < 2 ; i++) auxGrayFBOs[i]  = NULL;
+    workFBO = NULL;
     for(int i = 0; i < 3 ; i++){
         auxFBO0BMLevels[i] = NULL;
         auxFBO1BMLevels[i] = NULL;
         auxFBO2BMLevels[i] = NULL;
     }
     paintFBO   = NULL;
-    emit readyGL();
+    packFBO    = NULL;
+
+    // intermediate FBOs keep no data after render so they can be deleted
+    for(int i = 0; i < 4 ; i++){
+        VRAMManager::registerHandle(&auxColorFBOs[i],"GLImage::auxFBO",VRAMManager::EVICT);
+    }
+    for(int i = 0; i < 2 ; i++){
+        VRAMManager::registerHandle(&auxGrayFBOs[i],"GLImage::auxGrayFBO",VRAMManager::EVICT);
+    }
+    VRAMManager::registerHandle(&workFBO,"GLImage::workFBO",VRAMManager::EVICT);
+    for(int i = 0; i < 3 ; i++){
+        VRAMManager::registerHandle(&auxFBO0BMLevels[i],"GLImage::auxFBOBMLevels",VRAMManager::EVICT);
+        VRAMManager::registerHandle(&auxFBO1BMLevels[i],"GLImage::auxFBOBMLevels",VRAMManager::EVICT);
+        VRAMManager::registerHandle(&auxFBO2BMLevels[i],"GLImage::auxFBOBMLevels",VRAMManager::EVICT);
+    }
+    VRAMManager::registerHandle(&paintFBO ,"GLImage::paintFBO");
+    VRAMManager::registerHandle(&packFBO  ,"GLImage::packFBO");
+    VRAMManager::registerHandle(&renderFBO,"GLImage::renderFBO");
 }
 
 void GLImage::paintGL()
 {
-
-    // Perform filters on images and render the final result to renderFBO
-    // avoid rendering function if there is rendered something already
-    if(!bSkipProcessing && !bRendering){        
-        bRendering = true;
-        render();
+    // Perform filters on images in the render thread, the view shows the
+    // last published frame until the new one is ready (see framePublished)
+    if(!bSkipProcessing && currentImage != NULL){
+        RenderRequest request = makeRenderRequest(currentImage);
+        if(bShadowRender || conversionType != CONVERT_NONE || bToggleColorPicking){
+            // shadow renders, conversions and color picking read the results immediately
+            renderThread->invoke([this,request](){ processRequest(request); });
+        }else{
+            // all changes made before the frame starts are collapsed to single render
+            renderThread->post([this,request](){ processRequest(request); },
+                               displayJobKey(currentImage->imageType));
+        }
     }
 
-
     bSkipProcessing = false;
     conversionType  = CONVERT_NONE;
 
-    // Draw current FBO using current image after rendering the paintFBO will be replaced
-    if(!bShadowRender){
-
-        //if (!activeImage) return;
-        if (paintFBO != NULL){ // since grunge map can be different we need to calculate ratio each time
-          fboRatio = float(paintFBO->width())/paintFBO->height();
-          orthographicProjHeight = (1+zoom)/windowRatio;
-          orthographicProjWidth  = (1+zoom)/fboRatio;
-        }
-        GLCHK( glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT) );
-        GLCHK( glDisable(GL_CULL_FACE) );
-        GLCHK( glDisable(GL_DEPTH_TEST) );
-
-        GLCHK(glBindVertexArray(screen_vao));
-        // positions
-        GLCHK(glBindBuffer(GL_ARRAY_BUFFER, vbos[0]));
-        GLCHK(glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,sizeof(float)*3,(void*)0));
-        // indices
-        GLCHK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbos[2]));
-
-        QGLFramebufferObject* activeFBO     = paintFBO;
-
-        #ifdef USE_OPENGL_330
-            program = filter_programs["mode_normal_filter"];
-            program->bind();
-        #else
-            GLCHK(glUniformSubroutinesuiv( GL_FRAGMENT_SHADER, 1, &subroutines["mode_normal_filter"]));
-        #endif
-
-        // Displaying new image
-        activeFBO->bindDefault();
-        program->setUniformValue("quad_draw_mode", 1);
+    if(!bShadowRender) drawPaintFBO();
+}
+
+void GLImage::renderImage(FBOImageProporties* image){
+    if(image == NULL) return;
+    RenderRequest request = makeRenderRequest(image);
+    request.conversionType  = CONVERT_NONE;
+    request.bSkipProcessing = false;
+    request.bColorPicking   = false;
+    renderThread->post([this,request](){ processRequest(request); },
+                       displayJobKey(image->imageType));
+}
+
+/**
+ * @brief makeRenderRequest copies everything the render of the image depends
+ * on, so the GUI can change the settings while the frame is processed.
+ */
+RenderRequest GLImage::makeRenderRequest(FBOImageProporties* image){
+    RenderRequest request;
+    request.image           = image;
+    request.conversionType  = conversionType;
+    request.bShadowRender   = bShadowRender || image != currentImage;
+    request.bSkipProcessing = bSkipProcessing;
+    request.bColorPicking   = bToggleColorPicking;
+    request.resizeWidth     = resize_width;
+    request.resizeHeight    = resize_height;
+    for(int i = 0 ; i < 4 ; i++){
+        request.cornerPositions[i]       = cornerPositions[i];
+        request.grungeCornerPositions[i] = grungeCornerPositions[i];
+    }
+    request.cornerWeights   = cornerWeights;
+    request.perspectiveMode = gui_perspective_mode;
+
+    request.seamlessMode                = FBOImageProporties::seamlessMode;
+    request.seamlessSimpleModeRadius    = FBOImageProporties::seamlessSimpleModeRadius;
+    request.seamlessMirroModeType       = FBOImageProporties::seamlessMirroModeType;
+    request.seamlessRandomTiling        = FBOImageProporties::seamlessRandomTiling;
+    request.seamlessContrastStrenght    = FBOImageProporties::seamlessContrastStrenght;
+    request.seamlessContrastPower       = FBOImageProporties::seamlessContrastPower;
+    request.seamlessSimpleModeDirection = FBOImageProporties::seamlessSimpleModeDirection;
+    request.seamlessContrastInputType   = FBOImageProporties::seamlessContrastInputType;
+    request.bSeamlessTranslationsFirst  = FBOImageProporties::bSeamlessTranslationsFirst;
+
+    request.currentMaterialIndeks               = FBOImageProporties::currentMaterialIndeks;
+    request.bConversionBaseMap                  = FBOImageProporties::bConversionBaseMap;
+    request.bConversionBaseMapShowHeightTexture = FBOImageProporties::bConversionBaseMapShowHeightTexture;
+
+    for(int t = 0 ; t < MAX_TEXTURES_TYPE ; t++){
+        FBOImageProporties* target = getTargetImage(TextureTypes(t));
+        if(target == NULL || target->properties == NULL) continue;
+        RenderRequest::ImageState& state = request.images[t];
+        state.parameters        = target->getParameters();
+        state.inputImageType    = target->inputImageType;
+        state.bSkipProcessing   = target->bSkipProcessing;
+        state.conversionHNDepth = target->conversionHNDepth;
+    }
+    request.materialBatchParameters = image->materialBatchParameters;
+    return request;
+}
+
+void GLImage::processRequest(const RenderRequest& request){
+    frame       = request;
+    activeImage = request.image;
+    render();
+}
+
+void GLImage::drawPaintFBO(){
+    // the render thread must not swap the buffers while the frame is drawn
+    QMutexLocker locker(&RenderThread::publishMutex);
+    if (paintFBO == NULL) return; // nothing was published yet
+    // since grunge map can be different we need to calculate ratio each time
+    fboRatio = float(paintFBO->width())/paintFBO->height();
+    orthographicProjHeight = (1+zoom)/windowRatio;
+    orthographicProjWidth  = (1+zoom)/fboRatio;
+    GLCHK( gui->glBindFramebuffer(GL_FRAMEBUFFER, 0) );
+    GLCHK( gui->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT) );
+    GLCHK( gui->glDisable(GL_CULL_FACE) );
+    GLCHK( gui->glDisable(GL_DEPTH_TEST) );
+
+    GLCHK( gui->glBindVertexArray(display_vao) );
+    GLCHK( displayProgram->bind() );
+    #ifndef USE_OPENGL_330
+        GLCHK( gui->glUniformSubroutinesuiv( GL_FRAGMENT_SHADER, 1, &displaySubroutine) );
+    #endif
 
-        GLCHK( glViewport(0,0,width(),height()) );
-        GLCHK( glActiveTexture(GL_TEXTURE0) );
-        GLCHK( glBindTexture(GL_TEXTURE_2D, activeFBO->texture()) );
-
-        QMatrix4x4 m;
-        m.ortho(0,orthographicProjWidth,0,orthographicProjHeight,-1,1);
-        GLCHK( program->setUniformValue("ProjectionMatrix", m) );
-        m.setToIdentity();
-        m.translate(xTranslation,yTranslation,0);
-        GLCHK( program->setUniformValue("ModelViewMatrix", m) );
-        GLCHK( program->setUniformValue("material_id", int(-1)) );
-        GLCHK( glDrawElements(GL_TRIANGLES, 3*2, GL_UNSIGNED_INT, 0) );
-        GLCHK( program->setUniformValue("quad_draw_mode", int(0)) );        
-        GLCHK(glBindVertexArray(0));
+    // Displaying new image
+    displayProgram->setUniformValue("quad_draw_mode", 1);
+
+    GLCHK( gui->glViewport(0,0,width(),height()) );
+    GLCHK( gui->glActiveTexture(GL_TEXTURE0) );
+    GLCHK( gui->glBindTexture(GL_TEXTURE_2D, paintFBO->texture()) );
+
+    QMatrix4x4 m;
+    m.ortho(0,orthographicProjWidth,0,orthographicProjHeight,-1,1);
+    GLCHK( displayProgram->setUniformValue("ProjectionMatrix", m) );
+    m.setToIdentity();
+    m.translate(xTranslation,yTranslation,0);
+    GLCHK( displayProgram->setUniformValue("ModelViewMatrix", m) );
+    GLCHK( displayProgram->setUniformValue("material_id", int(-1)) );
+    GLCHK( gui->glDrawElements(GL_TRIANGLES, 3*2, GL_UNSIGNED_INT, 0) );
+    GLCHK( gui->glBindVertexArray(0) );
+    GLCHK( displayProgram->release() );
+    RenderThread::frontBuffersUsed();
+}
+
+void GLImage::framePublished(int tType, double msec, bool bDisplayed){
+    emit renderFinished(tType,msec);
+    emit imagePublished(tType);
+    if(!bDisplayed) return; // shadow render, nothing to show
+    emit rendered();
+    // the view has switched to another image in the meantime
+    if(currentImage == NULL || currentImage->imageType != tType) return;
+    if(currentImage->bFirstDraw){
+        qDebug() << "Doing first draw of" << PostfixNames::getTextureName(currentImage->imageType) << " texture.";
+        resetView();
+        currentImage->bFirstDraw = false;
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
+    makeCurrent();
+    drawPaintFBO();
+    swapBuffers();
+}
+void GLImage::processRequest(const RenderRequest& request){
+    frame       = request;
+    activeImage = request.image;
+    render();
 }
 
-
-
+/**
+ * @brief render processes activeImage with the settings of the current frame
+ * (see processRequest). Runs in the render thread. The result is written to
+ * the back buffers and published by swapping them with the front buffers.
+ */
 void GLImage::render(){
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     if (!activeImage) return;
-    if ( activeImage->fbo){ // since grunge map can be different we need to calculate ratio each time
-      fboRatio = float(activeImage->fbo->width())/activeImage->fbo->height();
-      orthographicProjHeight = (1+zoom)/windowRatio;
-      orthographicProjWidth  = (1+zoom)/fboRatio;
-    }
-    // do not clear the background during rendering process
-    if(!bShadowRender){
-        GLCHK( glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT) );
-    }
+    renderTimer.start();
+    VRAMManager::nextFrame();
+    // back buffers were shown by the views until the previous publish
+    RenderThread::waitForFrontBuffers();
 
     GLCHK( glDisable(GL_CULL_FACE) );
     GLCHK( glDisable(GL_DEPTH_TEST) );
@@ -408,20 +586,21 @@ void GLImage::render(){
     // indices
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbos[2]);
 
-    QGLFramebufferObject* activeFBO = activeImage->fbo;
+    QGLFramebufferObject* activeFBO = activeImage->getFBO();
+    QGLFramebufferObject* pickingFBO = NULL; // color image shown when colors are picked
 
 
     bool bTransformUVs = true; // images which depend on others will not be affected by UV changes again
     bool bSkipStandardProcessing = false;
 
 
-    if((activeImage->bSkipProcessing) && (activeImage->imageType != MATERIAL_TEXTURE)) bSkipProcessing = true;// do not process images when is disabled
-    if(bToggleColorPicking) bSkipStandardProcessing = true;
+    if((FrameImage(activeImage).bSkipProcessing) && (activeImage->imageType != MATERIAL_TEXTURE)) frame.bSkipProcessing = true;// do not process images when is disabled
+    if(frame.bColorPicking) bSkipStandardProcessing = true;
 
 
-    if(!bSkipProcessing == true){
+    if(!frame.bSkipProcessing == true){
     // resizing the FBOs in case of convertion procedure
-    switch(conversionType){
+    switch(frame.conversionType){
         case(CONVERT_FROM_H_TO_N):
 
         break;
@@ -432,34 +611,45 @@ void GLImage::render(){
 
         break;
         case(CONVERT_RESIZE): // apply resize textures
-            activeImage->resizeFBO(resize_width,resize_height);
-            // pointers were changed in resize function
-            activeFBO  = activeImage->fbo;
+            activeImage->resizeFBO(frame.resizeWidth,frame.resizeHeight);
 
             bSkipStandardProcessing = true;
         break;
         default:
         break;
     }
+    // the image is processed in the back buffer, the shown one is not changed
+    activeFBO = activeImage->getBackFBO();
 
     // create or resize when image was changed
-    FBOImages::resize(auxFBO1,activeFBO->width(),activeFBO->height());
-    FBOImages::resize(auxFBO2,activeFBO->width(),activeFBO->height());
-    FBOImages::resize(auxFBO3,activeFBO->width(),activeFBO->height());
-    FBOImages::resize(auxFBO4,activeFBO->width(),activeFBO->height());
+    for(int i = 0; i < 4 ; i++){
+        FBOImages::resize(auxColorFBOs[i],activeFBO->width(),activeFBO->height());
+    }
+    auxFBO1 = auxColorFBOs[0];
+    auxFBO2 = auxColorFBOs[1];
+    auxFBO3 = auxColorFBOs[2];
+    auxFBO4 = auxColorFBOs[3];
+
+    // Grayscale maps are stored in single channel FBOs, but the input may
+    // still be a color image (e.g. diffuse), so the first passes are done in
+    // auxFBO4 (it is used only by the diffuse conversion) and the pipeline
+    // continues in single channel FBOs when the image becomes gray.
+    bSingleChannelStage = false;
+    if(FBOImages::isSingleChannel(activeFBO->format().internalTextureFormat())){
+        activeFBO = auxFBO4;
+    }
     // allocate additional FBOs when conversion from BaseMap is enabled
-    if(activeImage->imageType == DIFFUSE_TEXTURE && activeImage->bConversionBaseMap){
+    if(activeImage->imageType == DIFFUSE_TEXTURE && frame.bConversionBaseMap){
         for(int i = 0; i < 3 ; i++){
             FBOImages::resize(auxFBO0BMLevels[i],activeFBO->width()/pow(2,i+1),activeFBO->height()/pow(2,i+1));
             FBOImages::resize(auxFBO1BMLevels[i],activeFBO->width()/pow(2,i+1),activeFBO->height()/pow(2,i+1));
             FBOImages::resize(auxFBO2BMLevels[i],activeFBO->width()/pow(2,i+1),activeFBO->height()/pow(2,i+1));
         }
-    }else{// other wise "delete" unnecessary FBOs (I know this is stupid...)
-        int small_w_h = 1;
+    }else{// other wise delete unnecessary FBOs
         for(int i = 0; i < 3 ; i++){
-            FBOImages::resize(auxFBO0BMLevels[i],small_w_h,small_w_h);
-            FBOImages::resize(auxFBO1BMLevels[i],small_w_h,small_w_h);
-            FBOImages::resize(auxFBO2BMLevels[i],small_w_h,small_w_h);
+            FBOImages::remove(auxFBO0BMLevels[i]);
+            FBOImages::remove(auxFBO1BMLevels[i]);
+            FBOImages::remove(auxFBO2BMLevels[i]);
         }
     }
 
@@ -467,16 +657,14 @@ void GLImage::render(){
     GLCHK( program->setUniformValue("gui_image_type", activeImage->imageType) );    
     GLCHK( program->setUniformValue("gui_depth", float(1.0)) );
     GLCHK( program->setUniformValue("gui_mode_dgaussian", 1) );
-    GLCHK( program->setUniformValue("material_id", int(activeImage->currentMaterialIndeks) ) );
+    GLCHK( program->setUniformValue("material_id", int(frame.currentMaterialIndeks) ) );
+    if(frame.currentMaterialIndeks == MATERIALS_BATCH){
+        if(isMaterialBatch()) uploadMaterialParameters();
+        setMaterialBatchUniforms();
+    }
     openGL330ForceTexType = activeImage->imageType;
 
 
-    if(activeImage->bFirstDraw){
-        resetView();
-        qDebug() << "Doing first draw of" << PostfixNames::getTextureName(activeImage->imageType) << " texture.";
-        activeImage->bFirstDraw = false;
-    }
-
     // skip all precessing when material tab is selected
     if(activeImage->imageType == MATERIAL_TEXTURE){
         bSkipStandardProcessing = true;
@@ -488,11 +676,11 @@ void GLImage::render(){
     }
 
     GLCHK( glActiveTexture(GL_TEXTURE10) );
-    GLCHK( glBindTexture(GL_TEXTURE_2D, targetImageMaterial->scr_tex_id) );
+    GLCHK( glBindTexture(GL_TEXTURE_2D, targetImageMaterial->materialIdTexId) );
     GLCHK( glActiveTexture(GL_TEXTURE0) );
 
-//    if(int(activeImage->currentMaterialIndeks) < 0){
-        copyTex2FBO(activeImage->scr_tex_id,activeImage->fbo);
+//    if(int(frame.currentMaterialIndeks) < 0){
+        copyTex2FBO(activeImage->getSrcTexId(),activeFBO);
 //    }
 
     // in some cases the output image will be taken from other sources
@@ -503,24 +691,24 @@ void GLImage::render(){
         case(NORMAL_TEXTURE):{
         // Choosing proper action
 
-        switch(activeImage->inputImageType){
+        switch(FrameImage(activeImage).inputImageType){
             case(INPUT_FROM_NORMAL_INPUT):
-                if(conversionType == CONVERT_FROM_H_TO_N){
-                    applyHeightToNormal(targetImageHeight->fbo,activeFBO);
+                if(frame.conversionType == CONVERT_FROM_H_TO_N){
+                    applyHeightToNormal(targetImageHeight->getFBO(),activeFBO);
                     bTransformUVs = false;
                 }
                 break;
             case(INPUT_FROM_HEIGHT_INPUT):
                 // transform height before  normal calculation
 
-                if(conversionType == CONVERT_NONE){
+                if(frame.conversionType == CONVERT_NONE){
                     // perspective transformation treats differently normal texture
                     // change for a moment the texture type to performe transformations
 
                     openGL330ForceTexType = HEIGHT_TEXTURE;// used for GL3.30 version
                     GLCHK( program->setUniformValue("gui_image_type", HEIGHT_TEXTURE) );
 
-                    copyTex2FBO(targetImageHeight->scr_tex_id,activeFBO);
+                    copyTex2FBO(targetImageHeight->getSrcTexId(),activeFBO);
                     applyAllUVsTransforms(activeFBO);
 
                     copyFBO(activeFBO,auxFBO1);
@@ -529,14 +717,14 @@ void GLImage::render(){
                     openGL330ForceTexType = activeImage->imageType;
                     bTransformUVs = false;
                 }else{                    
-                    copyTex2FBO(targetImageHeight->scr_tex_id,activeFBO);
+                    copyTex2FBO(targetImageHeight->getSrcTexId(),activeFBO);
                 }
 
                 break;
             case(INPUT_FROM_HEIGHT_OUTPUT):
-                applyHeightToNormal(targetImageHeight->fbo,activeFBO);
+                applyHeightToNormal(targetImageHeight->getFBO(),activeFBO);
 
-                if(!targetImageHeight->bSkipProcessing)bTransformUVs = false;
+                if(!FrameImage(targetImageHeight).bSkipProcessing)bTransformUVs = false;
                 break;
             default: break;
         }
@@ -547,23 +735,23 @@ void GLImage::render(){
         case(SPECULAR_TEXTURE):{
         // Choosing proper action
 
-        switch(activeImage->inputImageType){
+        switch(FrameImage(activeImage).inputImageType){
             case(INPUT_FROM_SPECULAR_INPUT):
                 // do nothing
                 break;
             case(INPUT_FROM_HEIGHT_INPUT):                
-                copyTex2FBO(targetImageHeight->scr_tex_id,activeFBO);                
+                copyTex2FBO(targetImageHeight->getSrcTexId(),activeFBO);                
                 break;
             case(INPUT_FROM_HEIGHT_OUTPUT):
-                copyFBO(targetImageHeight->fbo,activeFBO);
-                if(!targetImageHeight->bSkipProcessing) bTransformUVs = false;
+                copyFBO(targetImageHeight->getFBO(),activeFBO);
+                if(!FrameImage(targetImageHeight).bSkipProcessing) bTransformUVs = false;
                 break;
             case(INPUT_FROM_DIFFUSE_INPUT):                
-                copyTex2FBO(targetImageDiffuse->scr_tex_id,activeFBO);                
+                copyTex2FBO(targetImageDiffuse->getSrcTexId(),activeFBO);                
                 break;
             case(INPUT_FROM_DIFFUSE_OUTPUT):
-                copyFBO(targetImageDiffuse->fbo,activeFBO);
-                if(!targetImageDiffuse->bSkipProcessing) bTransformUVs = false;
+                copyFBO(targetImageDiffuse->getFBO(),activeFBO);
+                if(!FrameImage(targetImageDiffuse).bSkipProcessing) bTransformUVs = false;
                 break;
             default: break;
         }
@@ -574,15 +762,15 @@ void GLImage::render(){
         case(OCCLUSION_TEXTURE):{
         // Choosing proper action
 
-        switch(activeImage->inputImageType){
+        switch(FrameImage(activeImage).inputImageType){
             case(INPUT_FROM_OCCLUSION_INPUT):
 
-                if(conversionType == CONVERT_FROM_HN_TO_OC){
+                if(frame.conversionType == CONVERT_FROM_HN_TO_OC){
                     // Ambient occlusion is calculated from normal and height map, so
                     // some part of processing is skiped                    
-                    applyOcclusionFilter(targetImageHeight->fbo->texture(),targetImageNormal->fbo->texture(),activeFBO);
+                    applyOcclusionFilter(targetImageHeight->getFBO()->texture(),targetImageNormal->getFBO()->texture(),activeFBO);
                     bSkipStandardProcessing =  true;
-                    if(!targetImageHeight->bSkipProcessing && !targetImageNormal->bSkipProcessing) bTransformUVs = false;
+                    if(!FrameImage(targetImageHeight).bSkipProcessing && !FrameImage(targetImageNormal).bSkipProcessing) bTransformUVs = false;
                     qDebug() << "Calculation AO from Normal and Height";
                 }
 
@@ -590,13 +778,13 @@ void GLImage::render(){
             case(INPUT_FROM_HI_NI):
                 // Ambient occlusion is calculated from normal and height map, so
                 // some part of processing is skiped
-                applyOcclusionFilter(targetImageHeight->scr_tex_id,targetImageNormal->scr_tex_id,activeFBO);
+                applyOcclusionFilter(targetImageHeight->getSrcTexId(),targetImageNormal->getSrcTexId(),activeFBO);
 
 
                 break;     
             case(INPUT_FROM_HO_NO):
-                applyOcclusionFilter(targetImageHeight->fbo->texture(),targetImageNormal->fbo->texture(),activeFBO);
-                if(!targetImageHeight->bSkipProcessing && !targetImageNormal->bSkipProcessing) bTransformUVs = false;
+                applyOcclusionFilter(targetImageHeight->getFBO()->texture(),targetImageNormal->getFBO()->texture(),activeFBO);
+                if(!FrameImage(targetImageHeight).bSkipProcessing && !FrameImage(targetImageNormal).bSkipProcessing) bTransformUVs = false;
                 break;
             default: break;
         }
@@ -605,14 +793,15 @@ void GLImage::render(){
         //
         // ----------------------------------------------------
         case(HEIGHT_TEXTURE):{
-        if(conversionType == CONVERT_FROM_N_TO_H){
-            applyNormalToHeight(activeImage,targetImageNormal->fbo,activeFBO,auxFBO1);
+        if(frame.conversionType == CONVERT_FROM_N_TO_H){
+            activeFBO = beginSingleChannelStage(activeFBO);
+            applyNormalToHeight(activeImage,targetImageNormal->getFBO(),activeFBO,auxFBO1);
             applyCPUNormalizationFilter(auxFBO1,activeFBO);
             applyAddNoiseFilter(activeFBO,auxFBO1);
             copyFBO(auxFBO1,activeFBO);
 
             targetImageHeight->updateSrcTexId(activeFBO);
-            if(!targetImageNormal->bSkipProcessing)  bTransformUVs = false;
+            if(!FrameImage(targetImageNormal).bSkipProcessing)  bTransformUVs = false;
         }
         // ----------------------------------------------------
         //
@@ -621,23 +810,23 @@ void GLImage::render(){
         case(ROUGHNESS_TEXTURE):{
         // Choosing proper action
 
-        switch(activeImage->inputImageType){
+        switch(FrameImage(activeImage).inputImageType){
             case(INPUT_FROM_ROUGHNESS_INPUT):
                 // do nothing
                 break;
             case(INPUT_FROM_HEIGHT_INPUT):                
-                copyTex2FBO(targetImageHeight->scr_tex_id,activeFBO);
+                copyTex2FBO(targetImageHeight->getSrcTexId(),activeFBO);
                 break;
             case(INPUT_FROM_HEIGHT_OUTPUT):
-                copyFBO(targetImageHeight->fbo,activeFBO);
-                if(!targetImageHeight->bSkipProcessing)  bTransformUVs = false;
+                copyFBO(targetImageHeight->getFBO(),activeFBO);
+                if(!FrameImage(targetImageHeight).bSkipProcessing)  bTransformUVs = false;
                 break;
             case(INPUT_FROM_DIFFUSE_INPUT):                
-                copyTex2FBO(targetImageDiffuse->scr_tex_id,activeFBO);
+                copyTex2FBO(targetImageDiffuse->getSrcTexId(),activeFBO);
                 break;
             case(INPUT_FROM_DIFFUSE_OUTPUT):
-                copyFBO(targetImageDiffuse->fbo,activeFBO);
-                if(!targetImageDiffuse->bSkipProcessing)  bTransformUVs = false;
+                copyFBO(targetImageDiffuse->getFBO(),activeFBO);
+                if(!FrameImage(targetImageDiffuse).bSkipProcessing)  bTransformUVs = false;
                 break;
             default: break;
         }
@@ -647,23 +836,23 @@ void GLImage::render(){
         case(METALLIC_TEXTURE):{
         // Choosing proper action
 
-        switch(activeImage->inputImageType){
+        switch(FrameImage(activeImage).inputImageType){
             case(INPUT_FROM_METALLIC_INPUT):
                 // do nothing
                 break;
             case(INPUT_FROM_HEIGHT_INPUT):                
-                copyTex2FBO(targetImageHeight->scr_tex_id,activeFBO);
+                copyTex2FBO(targetImageHeight->getSrcTexId(),activeFBO);
                 break;
             case(INPUT_FROM_HEIGHT_OUTPUT):
-                copyFBO(targetImageHeight->fbo,activeFBO);
-                if(!targetImageHeight->bSkipProcessing)  bTransformUVs = false;
+                copyFBO(targetImageHeight->getFBO(),activeFBO);
+                if(!FrameImage(targetImageHeight).bSkipProcessing)  bTransformUVs = false;
                 break;
             case(INPUT_FROM_DIFFUSE_INPUT):                
-                copyTex2FBO(targetImageDiffuse->scr_tex_id,activeFBO);
+                copyTex2FBO(targetImageDiffuse->getSrcTexId(),activeFBO);
                 break;
             case(INPUT_FROM_DIFFUSE_OUTPUT):
-                copyFBO(targetImageDiffuse->fbo,activeFBO);
-                if(!targetImageDiffuse->bSkipProcessing)  bTransformUVs = false;
+                copyFBO(targetImageDiffuse->getFBO(),activeFBO);
+                if(!FrameImage(targetImageDiffuse).bSkipProcessing)  bTransformUVs = false;
                 break;
             default: break;
         }
@@ -677,10 +866,10 @@ void GLImage::render(){
     };
 
     // apply grunge filter when enabled
-    if(conversionType == CONVERT_NONE && GrungeProp.OverallWeight != 0.0f ){
+    if(frame.conversionType == CONVERT_NONE && GrungeParams.Grunge_OverallWeight != 0.0f ){
         if(activeImage->imageType < MATERIAL_TEXTURE){
 
-            copyTex2FBO(targetImageGrunge->fbo->texture(),auxFBO2);
+            copyTex2FBO(targetImageGrunge->getFBO()->texture(),auxFBO2);
             // when user choose source image "output" type one must
             // transform grunge map additionally
             if(bTransformUVs == false) applyAllUVsTransforms(auxFBO2); // auxFBO1 is used inside
@@ -692,7 +881,7 @@ void GLImage::render(){
 
     // Transform UVs in some cases
 
-    if(conversionType == CONVERT_NONE && bTransformUVs){
+    if(frame.conversionType == CONVERT_NONE && bTransformUVs){
 
         applyAllUVsTransforms(activeFBO);
     }
@@ -718,11 +907,13 @@ void GLImage::render(){
 
 
 
-    if(BasicProp.GrayScale.EnableGrayScale ||
+    if(ActiveParams.Basic_GrayScale_EnableGrayScale ||
             activeImage->imageType == ROUGHNESS_TEXTURE ||
             activeImage->imageType == OCCLUSION_TEXTURE ||
             activeImage->imageType == HEIGHT_TEXTURE ){
-        applyGrayScaleFilter(auxFBO1,activeFBO);
+        QGLFramebufferObject* colorFBO = auxFBO1;
+        activeFBO = beginSingleChannelStage(activeFBO);
+        applyGrayScaleFilter(colorFBO,activeFBO);
     }else{
         copyFBO(auxFBO1,activeFBO);
     }
@@ -730,7 +921,7 @@ void GLImage::render(){
 
 
     // specular manipulation
-    if(SurfaceDetailsProp.EnableSurfaceDetails && activeImage->imageType != HEIGHT_TEXTURE){
+    if(ActiveParams.SurfaceDetails_EnableSurfaceDetails && activeImage->imageType != HEIGHT_TEXTURE){
         applyDGaussiansFilter(activeFBO,auxFBO2,auxFBO1);
         //copyFBO(auxFBO1,activeFBO);
         applyContrastFilter(auxFBO1,activeFBO);
@@ -738,7 +929,7 @@ void GLImage::render(){
 
 
     // Removing shading...
-    if(activeImage->properties->EnableRemoveShading){
+    if(ActiveParams.EnableRemoveShading){
 
 
         applyRemoveLowFreqFilter(activeFBO,auxFBO1,auxFBO2);
@@ -752,7 +943,7 @@ void GLImage::render(){
 
 
         applyRemoveShadingFilter(auxFBO2,
-                                targetImageOcclusion->fbo,
+                                targetImageOcclusion->getFBO(),
                                 activeFBO,
                                 auxFBO1);
         copyFBO(auxFBO1,activeFBO);
@@ -762,26 +953,26 @@ void GLImage::render(){
 
 
 
-    if(BasicProp.EnhanceDetails > 0){
-        for(int i = 0 ; i < BasicProp.EnhanceDetails ; i++ ){
+    if(ActiveParams.Basic_EnhanceDetails > 0){
+        for(int i = 0 ; i < ActiveParams.Basic_EnhanceDetails ; i++ ){
             applyGaussFilter(activeFBO,auxFBO2,auxFBO1,1);
             applyOverlayFilter(activeFBO,auxFBO1,auxFBO2);
             copyFBO(auxFBO2,activeFBO);
         }
     }
 
-    if(BasicProp.SmallDetails  > 0.0f){
+    if(ActiveParams.Basic_SmallDetails  > 0.0f){
         applySmallDetailsFilter(activeFBO,auxFBO2,auxFBO1);
         copyFBO(auxFBO1,activeFBO);
     }
 
 
-    if(BasicProp.MediumDetails > 0.0f){
+    if(ActiveParams.Basic_MediumDetails > 0.0f){
         applyMediumDetailsFilter(activeFBO,auxFBO2,auxFBO1);
         copyFBO(auxFBO1,activeFBO);
     }
 
-    if(BasicProp.SharpenBlur != 0){
+    if(ActiveParams.Basic_SharpenBlur != 0){
         applySharpenBlurFilter(activeFBO,auxFBO2,auxFBO1);
         copyFBO(auxFBO1,activeFBO);
     }
@@ -800,7 +991,7 @@ void GLImage::render(){
     // so use same filters for them
     if( (activeImage->imageType == ROUGHNESS_TEXTURE ||
          activeImage->imageType == METALLIC_TEXTURE )
-        && RMFilterProp.Filter == COLOR_FILTER::Noise ){
+        && ActiveParams.RMFilter_Filter == COLOR_FILTER::Noise ){
         // processing surface
         applyRoughnessFilter(activeFBO,auxFBO2,auxFBO1);
         copyFBO(auxFBO1,activeFBO);
@@ -809,8 +1000,11 @@ void GLImage::render(){
 
     if(activeImage->imageType == ROUGHNESS_TEXTURE ||
        activeImage->imageType == METALLIC_TEXTURE){
-        if(RMFilterProp.Filter == COLOR_FILTER::Color){
-            applyRoughnessColorFilter(activeFBO,auxFBO1);            
+        if(ActiveParams.RMFilter_Filter == COLOR_FILTER::Color){
+            // the color mask is gray
+            QGLFramebufferObject* colorFBO = activeFBO;
+            activeFBO = beginSingleChannelStage(activeFBO);
+            applyRoughnessColorFilter(colorFBO,auxFBO1);
             copyFBO(auxFBO1,activeFBO);
         }
     }
@@ -826,7 +1020,7 @@ void GLImage::render(){
         applyNormalsStepFilter(activeFBO,auxFBO1);
 
         // apply normal mixer filter
-        if(NormalMixerProp.EnableMixer && activeImage->normalMixerInputTexId != 0){
+        if(ActiveParams.NormalsMixer_EnableMixer && activeImage->normalMixerInputTexId != 0){
             applyNormalMixerFilter(auxFBO1,activeFBO);
         }else{// otherwise skip
             copyFBO(auxFBO1,activeFBO);
@@ -837,9 +1031,9 @@ void GLImage::render(){
     // diffuse processing pipeline
     // -------------------------------------------------------- //
 
-    if(!bToggleColorPicking) // skip this step if the Color picking is enabled
+    if(!frame.bColorPicking) // skip this step if the Color picking is enabled
     if(activeImage->imageType == DIFFUSE_TEXTURE &&
-            (activeImage->bConversionBaseMap || conversionType == CONVERT_FROM_D_TO_O )){
+            (frame.bConversionBaseMap || frame.conversionType == CONVERT_FROM_D_TO_O )){
 
         // create mipmaps
         copyTex2FBO(activeFBO->texture(),auxFBO0BMLevels[0]);
@@ -848,10 +1042,10 @@ void GLImage::render(){
         // calculate normal for orginal image
 
 
-        activeImage->baseMapConvLevels[0].fromProperty(BaseMapToOthersProp.LevelSmall);
-        activeImage->baseMapConvLevels[1].fromProperty(BaseMapToOthersProp.LevelMedium);
-        activeImage->baseMapConvLevels[2].fromProperty(BaseMapToOthersProp.LevelBig);
-        activeImage->baseMapConvLevels[3].fromProperty(BaseMapToOthersProp.LevelHuge);
+        activeImage->baseMapConvLevels[0].fromParameters(BASE_MAP_LEVEL(ActiveParams,LevelSmall));
+        activeImage->baseMapConvLevels[1].fromParameters(BASE_MAP_LEVEL(ActiveParams,LevelMedium));
+        activeImage->baseMapConvLevels[2].fromParameters(BASE_MAP_LEVEL(ActiveParams,LevelBig));
+        activeImage->baseMapConvLevels[3].fromParameters(BASE_MAP_LEVEL(ActiveParams,LevelHuge));
 
         applyBaseMapConversion(activeFBO,auxFBO2,auxFBO1,activeImage->baseMapConvLevels[0]);
 
@@ -871,13 +1065,13 @@ void GLImage::render(){
         applyNormalAngleCorrectionFilter(activeFBO,auxFBO1);
         copyTex2FBO(auxFBO1->texture(),activeFBO);
 
-        if(conversionType == CONVERT_FROM_D_TO_O){
+        if(frame.conversionType == CONVERT_FROM_D_TO_O){
             applyNormalToHeight(targetImageHeight,activeFBO,auxFBO1,auxFBO2);
             applyCPUNormalizationFilter(auxFBO2,auxFBO1);
             applyAddNoiseFilter(auxFBO1,auxFBO2);
             copyFBO(auxFBO2,auxFBO1);
 
-        }else if(activeImage->bConversionBaseMapShowHeightTexture){
+        }else if(frame.bConversionBaseMapShowHeightTexture){
             applyNormalToHeight(targetImageHeight,activeFBO,auxFBO1,auxFBO2);
             applyCPUNormalizationFilter(auxFBO2,activeFBO);
         }
@@ -886,12 +1080,12 @@ void GLImage::render(){
 
 
     // copying the conversion results to proper textures
-    switch(conversionType){
+    switch(frame.conversionType){
         case(CONVERT_FROM_H_TO_N):
         if(activeImage->imageType == NORMAL_TEXTURE){
 
-            copyFBO(activeFBO,targetImageNormal->fbo);
-            targetImageNormal->updateSrcTexId(targetImageNormal->fbo);
+            copyFBO(activeFBO,targetImageNormal->getFBO());
+            targetImageNormal->updateSrcTexId(targetImageNormal->getFBO());
         }
 
         break;
@@ -901,33 +1095,34 @@ void GLImage::render(){
             }
         break;
         case(CONVERT_FROM_D_TO_O):        
-            copyFBO(activeFBO,targetImageNormal->fbo);
-            targetImageNormal->updateSrcTexId(targetImageNormal->fbo);
-
+            copyFBO(activeFBO,targetImageNormal->getFBO());
+            targetImageNormal->updateSrcTexId(targetImageNormal->getFBO());
 
-            copyFBO(auxFBO1,targetImageHeight->fbo);
-            targetImageHeight->updateSrcTexId(targetImageHeight->fbo);
 
+            copyFBO(auxFBO1,targetImageHeight->getFBO());
+            targetImageHeight->updateSrcTexId(targetImageHeight->getFBO());
 
-            applyOcclusionFilter(targetImageHeight->scr_tex_id,targetImageNormal->scr_tex_id,targetImageOcclusion->fbo);
 
-            targetImageOcclusion->updateSrcTexId(targetImageOcclusion->fbo);
+            applyOcclusionFilter(targetImageHeight->getSrcTexId(),targetImageNormal->getSrcTexId(),targetImageOcclusion->getFBO());
 
-            copyTex2FBO(activeImage->scr_tex_id,targetImageSpecular->fbo);
-            targetImageSpecular->updateSrcTexId(targetImageSpecular->fbo);
+            targetImageOcclusion->updateSrcTexId(targetImageOcclusion->getFBO());
 
+            copyTex2FBO(activeImage->getSrcTexId(),targetImageSpecular->getFBO());
+            targetImageSpecular->updateSrcTexId(targetImageSpecular->getFBO());
 
-            copyTex2FBO(activeImage->scr_tex_id,targetImageRoughness->fbo);
-            targetImageRoughness->updateSrcTexId(targetImageRoughness->fbo);
 
+            // roughness and metallic outputs are single channel so keep the colors in auxFBO3
+            copyTex2FBO(activeImage->getSrcTexId(),auxFBO3);
+            targetImageRoughness->updateSrcTexId(auxFBO3);
+            copyFBO(auxFBO3,targetImageRoughness->getFBO());
 
-            copyTex2FBO(activeImage->scr_tex_id,targetImageMetallic->fbo);
-            targetImageMetallic->updateSrcTexId(targetImageMetallic->fbo);
+            targetImageMetallic->updateSrcTexId(auxFBO3);
+            copyFBO(auxFBO3,targetImageMetallic->getFBO());
 
         break;
         case(CONVERT_FROM_HN_TO_OC):
             //copyFBO(activeFBO,targetImageOcclusion->ref_fbo);
-            copyFBO(activeFBO,targetImageOcclusion->fbo);
+            copyFBO(activeFBO,targetImageOcclusion->getFBO());
             targetImageOcclusion->updateSrcTexId(activeFBO);
 
         break;
@@ -937,23 +1132,81 @@ void GLImage::render(){
     }
 
 
-    activeFBO = activeImage->fbo;
+    QGLFramebufferObject* backFBO = activeImage->getBackFBO();
+    if(activeFBO != backFBO){
+        // colors are picked from the screen so show the image before it is converted to gray
+        if(frame.bColorPicking) pickingFBO = activeFBO;
+        // metallic without gray scale or color filter is still a color image
+        if(!bSingleChannelStage && activeImage->imageType == METALLIC_TEXTURE){
+            applyGrayScaleFilter(activeFBO,backFBO);
+        }else{
+            copyFBO(activeFBO,backFBO);
+        }
+    }
+    activeFBO = backFBO;
+    auxFBO1 = auxFBO2 = auxFBO3 = auxFBO4 = NULL;
 
     }// end of skip processing
 
-
-
-    bSkipProcessing = false;
-    conversionType  = CONVERT_NONE;
-
-    if(!bShadowRender){
+    bool bProcessed = !frame.bSkipProcessing;
+    if(!frame.bShadowRender){
         GLCHK(FBOImages::resize(renderFBO,activeFBO->width(),activeFBO->height()));
         GLCHK( program->setUniformValue("material_id", int(-1)) );
-        GLCHK(applyNormalFilter(activeFBO,renderFBO));
+        GLCHK(applyNormalFilter(pickingFBO != NULL ? pickingFBO : activeFBO,renderFBO));
     }
-    emit rendered();
     GLCHK(glBindVertexArray(0));
     GLCHK(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+
+    // The frame is published when the GPU has finished it, so the views never
+    // sample a half written image. The GUI thread does not wait here.
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,0);
+    glClientWaitSync(fence,GL_SYNC_FLUSH_COMMANDS_BIT,GL_TIMEOUT_IGNORED);
+    glDeleteSync(fence);
+    double msec = renderTimer.nsecsElapsed() / 1.0e6;
+
+    if(bProcessed) activeImage->publish();
+    if(!frame.bShadowRender){
+        QMutexLocker locker(&RenderThread::publishMutex);
+        VRAMManager::swapHandles(&paintFBO,&renderFBO);
+    }
+    // release intermediates not used in this frame when out of memory budget
+    VRAMManager::enforceBudget();
+
+    // range of the CPU normalization is known now, render again if it changed
+    // (unless newer request of this image is already queued)
+    if(!frame.bShadowRender && frame.conversionType == CONVERT_NONE && !renderThread->isStale()
+       && normalizationReadback.isPending() && updateNormalizationRange(false)){
+        QMetaObject::invokeMethod(this,"updateGL",Qt::QueuedConnection);
+    }
+    emit published(activeImage->imageType,msec,!frame.bShadowRender);
+}
+
+/**
+ * @brief beginSingleChannelStage is called when the image processed for a
+ * single channel output becomes gray. Following passes write one channel only:
+ * auxFBO1 and auxFBO2 are switched to single channel FBOs and the processing
+ * continues in the back buffer (height) or in 16 bit workFBO (8 bit outputs).
+ * Does nothing for color outputs or when the stage has already begun.
+ * @param activeFBO FBO processed so far, it keeps the data
+ * @return FBO used as activeFBO by the rest of the pipeline
+ */
+QGLFramebufferObject* GLImage::beginSingleChannelStage(QGLFramebufferObject* activeFBO){
+    QGLFramebufferObject* backFBO = activeImage->getBackFBO();
+    GLuint format = backFBO->format().internalTextureFormat();
+    if(bSingleChannelStage || !FBOImages::isSingleChannel(format)) return activeFBO;
+    bSingleChannelStage = true;
+
+    int width  = backFBO->width();
+    int height = backFBO->height();
+    for(int i = 0; i < 2 ; i++){
+        FBOImages::resize(auxGrayFBOs[i],width,height,TEXTURE_GRAYSCALE_WORK_FORMAT);
+    }
+    auxFBO1 = auxGrayFBOs[0];
+    auxFBO2 = auxGrayFBOs[1];
+
+    if(format == TEXTURE_GRAYSCALE_WORK_FORMAT) return backFBO;
+    FBOImages::resize(workFBO,width,height,TEXTURE_GRAYSCALE_WORK_FORMAT);
+    return workFBO;
 }
 
 void GLImage::showEvent(QShowEvent* event){
@@ -970,13 +1223,13 @@ void GLImage::resizeFBO(int width, int height){
 
 void GLImage::resetView(){
 
-    if (!activeImage) return;
-
-    makeCurrent();
+    if (!currentImage) return;
+    QSize imageSize = currentImage->getSize();
+    if (imageSize.isEmpty()) return;
 
     zoom = 0;
     windowRatio = float(width())/height();
-    fboRatio    = float(activeImage->fbo->width())/activeImage->fbo->height();
+    fboRatio    = float(imageSize.width())/imageSize.height();
     // openGL window dimensions
     orthographicProjHeight = (1+zoom)/windowRatio;
     orthographicProjWidth = (1+zoom)/fboRatio;
@@ -994,8 +1247,6 @@ void GLImage::resetView(){
     // setting the image in the center
     xTranslation = orthographicProjWidth /2;
     yTranslation = orthographicProjHeight/2;
-
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void GLImage::resizeGL(int width, int height)
@@ -1003,17 +1254,15 @@ void GLImage::resizeGL(int width, int height)
   qDebug() << "Resizing GL image to (" << width << ", " << height << ")";
   windowRatio = float(width)/height;
   if (isValid()) {
-    GLCHK( glViewport(0, 0, width, height) );
-
-    if (activeImage && activeImage->fbo){
-      fboRatio = float(activeImage->fbo->width())/activeImage->fbo->height();
+    QSize imageSize = currentImage ? currentImage->getSize() : QSize();
+    if (!imageSize.isEmpty()){
+      fboRatio = float(imageSize.width())/imageSize.height();
       orthographicProjHeight = (1+zoom)/windowRatio;
       orthographicProjWidth = (1+zoom)/fboRatio;
     } else {
       qWarning() << Q_FUNC_INFO;
-      if (!activeImage) qWarning() << "  activeImage is null";
-      else
-	if (!activeImage->fbo) qWarning() << "  activeImage->fbo is null";
+      if (!currentImage) qWarning() << "  currentImage is null";
+      else qWarning() << "  currentImage->fbo is null";
     }
   } else
     qDebug() << Q_FUNC_INFO << "invalid context.";
@@ -1023,7 +1272,7 @@ void GLImage::resizeGL(int width, int height)
 
 
 void GLImage::setActiveImage(FBOImageProporties* ptr){
-        activeImage = ptr;        
+        currentImage = ptr;
         updateGLNow();
 }
 void GLImage::enableShadowRender(bool enable){
@@ -1109,10 +1358,10 @@ void GLImage::applyHeightToNormal(QGLFramebufferObject* inputFBO,
 #endif
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
-    GLCHK( program->setUniformValue("gui_hn_conversion_depth", activeImage->conversionHNDepth) );
+    GLCHK( program->setUniformValue("gui_hn_conversion_depth", FrameImage(activeImage).conversionHNDepth) );
     GLCHK( glViewport(0,0,inputFBO->width(),inputFBO->height()) );
     GLCHK( outputFBO->bind() );
-    GLCHK( glBindTexture(GL_TEXTURE_2D, inputFBO->texture()) );
+    GLCHK( glBindTexture(GL_TEXTURE_2D, VRAMManager::use(inputFBO->texture())) );
     GLCHK( glDrawElements(GL_TRIANGLES, 3*2, GL_UNSIGNED_INT, 0) );
     GLCHK( outputFBO->bindDefault() );
 }
@@ -1133,7 +1382,7 @@ void GLImage::applyColorHueFilter(  QGLFramebufferObject* inputFBO,
 
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );   
-    GLCHK( program->setUniformValue("gui_hue"   , float(activeImage->properties->Basic.ColorHue)) );
+    GLCHK( program->setUniformValue("gui_hue"   , float(ActiveParams.Basic_ColorHue)) );
 
 
     GLCHK( glBindTexture(GL_TEXTURE_2D, inputFBO->texture()) );
@@ -1145,7 +1394,7 @@ void GLImage::applyPerspectiveTransformFilter(  QGLFramebufferObject* inputFBO,
                                                 QGLFramebufferObject* outputFBO){
 
     // when materials texture is enabled UV transformation are disabled
-    if(FBOImageProporties::currentMaterialIndeks != MATERIALS_DISABLED){
+    if(frame.currentMaterialIndeks != MATERIALS_DISABLED){
         copyFBO(inputFBO,outputFBO);
         return;
     }
@@ -1163,19 +1412,19 @@ void GLImage::applyPerspectiveTransformFilter(  QGLFramebufferObject* inputFBO,
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
     if(activeImage->imageType == GRUNGE_TEXTURE){
-        GLCHK( program->setUniformValue("corner1"  , grungeCornerPositions[0]) );
-        GLCHK( program->setUniformValue("corner2"  , grungeCornerPositions[1]) );
-        GLCHK( program->setUniformValue("corner3"  , grungeCornerPositions[2]) );
-        GLCHK( program->setUniformValue("corner4"  , grungeCornerPositions[3]) );
+        GLCHK( program->setUniformValue("corner1"  , frame.grungeCornerPositions[0]) );
+        GLCHK( program->setUniformValue("corner2"  , frame.grungeCornerPositions[1]) );
+        GLCHK( program->setUniformValue("corner3"  , frame.grungeCornerPositions[2]) );
+        GLCHK( program->setUniformValue("corner4"  , frame.grungeCornerPositions[3]) );
     }else{
-        GLCHK( program->setUniformValue("corner1"  , cornerPositions[0]) );
-        GLCHK( program->setUniformValue("corner2"  , cornerPositions[1]) );
-        GLCHK( program->setUniformValue("corner3"  , cornerPositions[2]) );
-        GLCHK( program->setUniformValue("corner4"  , cornerPositions[3]) );
+        GLCHK( program->setUniformValue("corner1"  , frame.cornerPositions[0]) );
+        GLCHK( program->setUniformValue("corner2"  , frame.cornerPositions[1]) );
+        GLCHK( program->setUniformValue("corner3"  , frame.cornerPositions[2]) );
+        GLCHK( program->setUniformValue("corner4"  , frame.cornerPositions[3]) );
     }
-    GLCHK( program->setUniformValue("corners_weights"  , cornerWeights) );
+    GLCHK( program->setUniformValue("corners_weights"  , frame.cornerWeights) );
     GLCHK( program->setUniformValue("uv_scaling_mode", 0) );
-    GLCHK( program->setUniformValue("gui_perspective_mode"  , gui_perspective_mode) );
+    GLCHK( program->setUniformValue("gui_perspective_mode"  , frame.perspectiveMode) );
 
     GLCHK( glActiveTexture(GL_TEXTURE0) );
     GLCHK( glBindTexture(GL_TEXTURE_2D, inputFBO->texture()) );
@@ -1263,15 +1512,15 @@ void GLImage::applyRemoveShadingFilter(QGLFramebufferObject* inputFBO,
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
 
-    GLCHK( program->setUniformValue("gui_remove_shading",RemoveShadingProp.RemoveShadingByGaussian));
-    GLCHK( program->setUniformValue("gui_ao_cancellation",RemoveShadingProp.AOCancellation ));
+    GLCHK( program->setUniformValue("gui_remove_shading",ActiveParams.RemoveShading_RemoveShadingByGaussian));
+    GLCHK( program->setUniformValue("gui_ao_cancellation",ActiveParams.RemoveShading_AOCancellation ));
 
     GLCHK( glViewport(0,0,inputFBO->width(),inputFBO->height()) );
     GLCHK( outputFBO->bind() );
     GLCHK( glActiveTexture(GL_TEXTURE0) );
     GLCHK( glBindTexture(GL_TEXTURE_2D, inputFBO->texture()) );
     GLCHK( glActiveTexture(GL_TEXTURE1) );
-    GLCHK( glBindTexture(GL_TEXTURE_2D, aoMaskFBO->texture()) );
+    GLCHK( glBindTexture(GL_TEXTURE_2D, VRAMManager::use(aoMaskFBO->texture())) );
     GLCHK( glActiveTexture(GL_TEXTURE2) );
     GLCHK( glBindTexture(GL_TEXTURE_2D, refFBO->texture()) );
     GLCHK( glDrawElements(GL_TRIANGLES, 3*2, GL_UNSIGNED_INT, 0) );
@@ -1283,38 +1532,14 @@ void GLImage::applyRemoveLowFreqFilter(QGLFramebufferObject* inputFBO,
                                        QGLFramebufferObject* auxFBO,
                                        QGLFramebufferObject* outputFBO){
 
-    applyGaussFilter(inputFBO,samplerFBO1,samplerFBO2,RemoveShadingProp.LowFrequencyFilterRadius*50);
+    applyGaussFilter(inputFBO,samplerFBO1,samplerFBO2,ActiveParams.RemoveShading_LowFrequencyFilterRadius*50);
 
-    // calculating the average color on CPU
+    // the average color is the last mipmap level of the downscaled input,
+    // it is read by the shader so the pipeline does not wait for the GPU
     applyNormalFilter(inputFBO,averageColorFBO); // copy large file to smaller FBO (save time!)
-
-
     GLCHK( glActiveTexture(GL_TEXTURE0) );
     GLCHK( glBindTexture(GL_TEXTURE_2D, averageColorFBO->texture()) );
-
-    GLint textureWidth, textureHeight;
-    GLCHK( glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH , &textureWidth ) );
-    GLCHK( glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &textureHeight) );
-
-    float* img = new float[textureWidth*textureHeight*3];
-    float ave_color[3] = {0,0,0};
-
-    GLCHK( glGetTexImage(	GL_TEXTURE_2D,0,GL_RGB,GL_FLOAT,img) );
-
-
-    for(int i = 0 ; i < textureWidth*textureHeight ; i++){
-        for(int c = 0 ; c < 3 ; c++){
-             ave_color[c] += img[3*i+c];
-        }
-    }
-
-    // normalization sum
-    ave_color[0] /= (textureWidth*textureHeight);
-    ave_color[1] /= (textureWidth*textureHeight);
-    ave_color[2] /= (textureWidth*textureHeight);
-    delete[] img;
-
-    QVector3D aveColor = QVector3D(ave_color[0],ave_color[1],ave_color[2]);
+    GLCHK( glGenerateMipmap(GL_TEXTURE_2D) );
 
 #ifdef USE_OPENGL_330
     program = filter_programs["mode_remove_low_freq_filter"];
@@ -1326,8 +1551,7 @@ void GLImage::applyRemoveLowFreqFilter(QGLFramebufferObject* inputFBO,
 
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
-    GLCHK( program->setUniformValue("average_color"  , aveColor ) );
-    GLCHK( program->setUniformValue("gui_remove_shading_lf_blending"  , RemoveShadingProp.LowFrequencyFilterBlending ) );
+    GLCHK( program->setUniformValue("gui_remove_shading_lf_blending"  , ActiveParams.RemoveShading_LowFrequencyFilterBlending ) );
 
     GLCHK( outputFBO->bind() );
     GLCHK( glViewport(0,0,outputFBO->width(),outputFBO->height()) );
@@ -1336,6 +1560,8 @@ void GLImage::applyRemoveLowFreqFilter(QGLFramebufferObject* inputFBO,
     GLCHK( glBindTexture(GL_TEXTURE_2D, inputFBO->texture()) );
     GLCHK( glActiveTexture(GL_TEXTURE1) );
     GLCHK( glBindTexture(GL_TEXTURE_2D, samplerFBO2->texture()) );
+    GLCHK( glActiveTexture(GL_TEXTURE2) );
+    GLCHK( glBindTexture(GL_TEXTURE_2D, averageColorFBO->texture()) );
     GLCHK( glDrawElements(GL_TRIANGLES, 3*2, GL_UNSIGNED_INT, 0) );
     GLCHK( glActiveTexture(GL_TEXTURE0) );
     outputFBO->bindDefault();
@@ -1376,25 +1602,25 @@ void GLImage::applySeamlessLinearFilter(QGLFramebufferObject* inputFBO,
                                        QGLFramebufferObject* outputFBO){
 
     // when materials texture is enabled UV transformation are disabled
-    if(FBOImageProporties::currentMaterialIndeks != MATERIALS_DISABLED){
+    if(frame.currentMaterialIndeks != MATERIALS_DISABLED){
         copyFBO(inputFBO,outputFBO);
         return;
     }
-    switch(FBOImageProporties::seamlessContrastInputType){
+    switch(frame.seamlessContrastInputType){
         default:
         case(INPUT_FROM_HEIGHT_INPUT):
             //copyFBO(targetImageHeight->ref_fbo,activeImage->aux2_fbo);
-            copyTex2FBO(targetImageHeight->scr_tex_id,auxFBO2);
+            copyTex2FBO(targetImageHeight->getSrcTexId(),auxFBO2);
             break;
         case(INPUT_FROM_DIFFUSE_INPUT):
             //copyFBO(targetImageDiffuse->ref_fbo,activeImage->aux2_fbo);
-            copyTex2FBO(targetImageDiffuse->scr_tex_id,auxFBO2);
+            copyTex2FBO(targetImageDiffuse->getSrcTexId(),auxFBO2);
             break;
     };
 
     // when translations are applied first one has to translate
     // alse the contrast mask image
-    if(FBOImageProporties::bSeamlessTranslationsFirst){
+    if(frame.bSeamlessTranslationsFirst){
         applyPerspectiveTransformFilter(auxFBO2,outputFBO);// the output is save to auxFBO1
     }
 
@@ -1412,13 +1638,13 @@ void GLImage::applySeamlessLinearFilter(QGLFramebufferObject* inputFBO,
 
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
-    GLCHK( program->setUniformValue("make_seamless_radius"           , FBOImageProporties::seamlessSimpleModeRadius) );
-    GLCHK( program->setUniformValue("gui_seamless_contrast_strenght" , FBOImageProporties::seamlessContrastStrenght) );
-    GLCHK( program->setUniformValue("gui_seamless_contrast_power"    , FBOImageProporties::seamlessContrastPower) );
+    GLCHK( program->setUniformValue("make_seamless_radius"           , frame.seamlessSimpleModeRadius) );
+    GLCHK( program->setUniformValue("gui_seamless_contrast_strenght" , frame.seamlessContrastStrenght) );
+    GLCHK( program->setUniformValue("gui_seamless_contrast_power"    , frame.seamlessContrastPower) );
 
 
     GLCHK( glViewport(0,0,inputFBO->width(),inputFBO->height()) );
-    switch(FBOImageProporties::seamlessSimpleModeDirection){
+    switch(frame.seamlessSimpleModeDirection){
         default:
         case(0)://XY
         GLCHK( program->setUniformValue("gui_seamless_mode"         , (int)0) ); // horizontal filtering
@@ -1465,23 +1691,23 @@ void GLImage::applySeamlessFilter(QGLFramebufferObject* inputFBO,
                                   QGLFramebufferObject* outputFBO){
 
     // when materials texture is enabled UV transformation are disabled
-    if(FBOImageProporties::currentMaterialIndeks != MATERIALS_DISABLED){
+    if(frame.currentMaterialIndeks != MATERIALS_DISABLED){
         copyFBO(inputFBO,outputFBO);
         return;
     }
-    switch(FBOImageProporties::seamlessContrastInputType){
+    switch(frame.seamlessContrastInputType){
         default:
         case(INPUT_FROM_HEIGHT_INPUT):            
-            copyTex2FBO(targetImageHeight->scr_tex_id,auxFBO1);
+            copyTex2FBO(targetImageHeight->getSrcTexId(),auxFBO1);
             break;
         case(INPUT_FROM_DIFFUSE_INPUT):            
-            copyTex2FBO(targetImageDiffuse->scr_tex_id,auxFBO1);
+            copyTex2FBO(targetImageDiffuse->getSrcTexId(),auxFBO1);
             break;
     };
 
     // when translations are applied first one has to translate
     // alse the contrast mask image
-    if(FBOImageProporties::bSeamlessTranslationsFirst){
+    if(frame.bSeamlessTranslationsFirst){
       applyPerspectiveTransformFilter(auxFBO1,outputFBO);// the output is save to auxFBO2
     }
 
@@ -1496,19 +1722,19 @@ void GLImage::applySeamlessFilter(QGLFramebufferObject* inputFBO,
 
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
-    GLCHK( program->setUniformValue("make_seamless_radius"      , FBOImageProporties::seamlessSimpleModeRadius) );
-    GLCHK( program->setUniformValue("gui_seamless_contrast_strenght" , FBOImageProporties::seamlessContrastStrenght) );
-    GLCHK( program->setUniformValue("gui_seamless_contrast_power"    , FBOImageProporties::seamlessContrastPower) );
-    GLCHK( program->setUniformValue("gui_seamless_mode"         , (int)FBOImageProporties::seamlessMode) );
-    GLCHK( program->setUniformValue("gui_seamless_mirror_type"  , FBOImageProporties::seamlessMirroModeType) );
+    GLCHK( program->setUniformValue("make_seamless_radius"      , frame.seamlessSimpleModeRadius) );
+    GLCHK( program->setUniformValue("gui_seamless_contrast_strenght" , frame.seamlessContrastStrenght) );
+    GLCHK( program->setUniformValue("gui_seamless_contrast_power"    , frame.seamlessContrastPower) );
+    GLCHK( program->setUniformValue("gui_seamless_mode"         , (int)frame.seamlessMode) );
+    GLCHK( program->setUniformValue("gui_seamless_mirror_type"  , frame.seamlessMirroModeType) );
 
     // sending the random angles
     QMatrix3x3 random_angles;
-    for(int i = 0; i < 9; i++)random_angles.data()[i] = FBOImageProporties::seamlessRandomTiling.angles[i];
+    for(int i = 0; i < 9; i++)random_angles.data()[i] = frame.seamlessRandomTiling.angles[i];
     GLCHK( program->setUniformValue("gui_seamless_random_angles" , random_angles) );
-    GLCHK( program->setUniformValue("gui_seamless_random_phase" , FBOImageProporties::seamlessRandomTiling.common_phase) );
-    GLCHK( program->setUniformValue("gui_seamless_random_inner_radius" , FBOImageProporties::seamlessRandomTiling.inner_radius) );
-    GLCHK( program->setUniformValue("gui_seamless_random_outer_radius" , FBOImageProporties::seamlessRandomTiling.outer_radius) );
+    GLCHK( program->setUniformValue("gui_seamless_random_phase" , frame.seamlessRandomTiling.common_phase) );
+    GLCHK( program->setUniformValue("gui_seamless_random_inner_radius" , frame.seamlessRandomTiling.inner_radius) );
+    GLCHK( program->setUniformValue("gui_seamless_random_outer_radius" , frame.seamlessRandomTiling.outer_radius) );
 
     GLCHK( glViewport(0,0,inputFBO->width(),inputFBO->height()) );
 
@@ -1540,8 +1766,8 @@ void GLImage::applyDGaussiansFilter(QGLFramebufferObject* inputFBO,
     GLCHK( glUniformSubroutinesuiv( GL_FRAGMENT_SHADER, 1, &subroutines["mode_gauss_filter"]) );
 #endif
 
-    GLCHK( program->setUniformValue("gui_gauss_radius", int(SurfaceDetailsProp.Radius)) );
-    GLCHK( program->setUniformValue("gui_gauss_w", SurfaceDetailsProp.WeightA) );
+    GLCHK( program->setUniformValue("gui_gauss_radius", int(ActiveParams.SurfaceDetails_Radius)) );
+    GLCHK( program->setUniformValue("gui_gauss_w", ActiveParams.SurfaceDetails_WeightA) );
 
 
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
@@ -1562,7 +1788,7 @@ void GLImage::applyDGaussiansFilter(QGLFramebufferObject* inputFBO,
     GLCHK( glBindTexture(GL_TEXTURE_2D, auxFBO->texture()) );
     GLCHK( glDrawElements(GL_TRIANGLES, 3*2, GL_UNSIGNED_INT, 0) );
 
-    GLCHK( program->setUniformValue("gui_gauss_w", SurfaceDetailsProp.WeightB) );
+    GLCHK( program->setUniformValue("gui_gauss_w", ActiveParams.SurfaceDetails_WeightB) );
 
 
     GLCHK( auxFBO->bind() );
@@ -1585,7 +1811,7 @@ void GLImage::applyDGaussiansFilter(QGLFramebufferObject* inputFBO,
 #endif
 
     GLCHK( program->setUniformValue("gui_mode_dgaussian", 1) );
-    GLCHK( program->setUniformValue("gui_specular_amplifier", SurfaceDetailsProp.Amplifier) );
+    GLCHK( program->setUniformValue("gui_specular_amplifier", ActiveParams.SurfaceDetails_Amplifier) );
 
     GLCHK( auxFBO->bind() );
     GLCHK( glActiveTexture(GL_TEXTURE0) );
@@ -1616,7 +1842,7 @@ void GLImage::applyContrastFilter(QGLFramebufferObject* inputFBO,
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
 
-    GLCHK( program->setUniformValue("gui_specular_contrast", SurfaceDetailsProp.Contrast) );
+    GLCHK( program->setUniformValue("gui_specular_contrast", ActiveParams.SurfaceDetails_Contrast) );
     GLCHK( program->setUniformValue("gui_specular_brightness", 0.0f) );//not used since offset does the same
 
     
@@ -1640,7 +1866,7 @@ void GLImage::applySmallDetailsFilter(QGLFramebufferObject* inputFBO,
 #endif
 
 
-    GLCHK( program->setUniformValue("gui_depth", BasicProp.DetailDepth) );
+    GLCHK( program->setUniformValue("gui_depth", ActiveParams.Basic_DetailDepth) );
     GLCHK( program->setUniformValue("gui_gauss_radius", int(3.0)) );
     GLCHK( program->setUniformValue("gui_gauss_w", float(3.0)) );
 
@@ -1692,7 +1918,7 @@ void GLImage::applySmallDetailsFilter(QGLFramebufferObject* inputFBO,
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
 
-    GLCHK( program->setUniformValue("gui_small_details", BasicProp.SmallDetails) );
+    GLCHK( program->setUniformValue("gui_small_details", ActiveParams.Basic_SmallDetails) );
     GLCHK( glViewport(0,0,inputFBO->width(),inputFBO->height()) );
     GLCHK( outputFBO->bind() );
     GLCHK( glActiveTexture(GL_TEXTURE0) );
@@ -1719,7 +1945,7 @@ void GLImage::applyMediumDetailsFilter(QGLFramebufferObject* inputFBO,
     GLCHK( glUniformSubroutinesuiv( GL_FRAGMENT_SHADER, 1, &subroutines["mode_gauss_filter"]) );
 #endif
 
-    GLCHK( program->setUniformValue("gui_depth", BasicProp.DetailDepth) );
+    GLCHK( program->setUniformValue("gui_depth", ActiveParams.Basic_DetailDepth) );
     GLCHK( program->setUniformValue("gui_gauss_radius", int(15.0)) );
     GLCHK( program->setUniformValue("gui_gauss_w", float(15.0)) );
 
@@ -1755,7 +1981,7 @@ void GLImage::applyMediumDetailsFilter(QGLFramebufferObject* inputFBO,
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
 
-    program->setUniformValue("gui_small_details", BasicProp.MediumDetails);
+    program->setUniformValue("gui_small_details", ActiveParams.Basic_MediumDetails);
     glViewport(0,0,inputFBO->width(),inputFBO->height());
     GLCHK( auxFBO->bind() );
     GLCHK( glActiveTexture(GL_TEXTURE0) );
@@ -1791,29 +2017,29 @@ void GLImage::applyGrayScaleFilter(QGLFramebufferObject* inputFBO,
     GLCHK( program->setUniformValue("gui_gray_scale_max_color_defined",false) );
     GLCHK( program->setUniformValue("gui_gray_scale_min_color_defined",false) );
 
-    if(activeImage->bConversionBaseMap){
-        if(QColor(BaseMapToOthersProp.MaxColor.value()).red() >= 0){
+    if(frame.bConversionBaseMap){
+        if(QColor::fromRgba(ActiveParams.BaseMapToOthers_MaxColor).red() >= 0){
 
-            QColor color = QColor(BaseMapToOthersProp.MaxColor.value());
+            QColor color = QColor::fromRgba(ActiveParams.BaseMapToOthers_MaxColor);
             QVector3D dcolor(color.redF(),color.greenF(),color.blueF());
             GLCHK( program->setUniformValue("gui_gray_scale_max_color_defined",true) );
             GLCHK( program->setUniformValue("gui_gray_scale_max_color",dcolor) );
         }
-        if(QColor(BaseMapToOthersProp.MinColor.value()).red() >= 0){
-            QColor color = QColor(BaseMapToOthersProp.MinColor.value());
+        if(QColor::fromRgba(ActiveParams.BaseMapToOthers_MinColor).red() >= 0){
+            QColor color = QColor::fromRgba(ActiveParams.BaseMapToOthers_MinColor);
             QVector3D dcolor(color.redF(),color.greenF(),color.blueF());
             GLCHK( program->setUniformValue("gui_gray_scale_min_color_defined",true) );
             GLCHK( program->setUniformValue("gui_gray_scale_min_color",dcolor) );
         }
-        GLCHK( program->setUniformValue("gui_gray_scale_range_tol",float(BaseMapToOthersProp.ColorBalance*10)) );
+        GLCHK( program->setUniformValue("gui_gray_scale_range_tol",float(ActiveParams.BaseMapToOthers_ColorBalance*10)) );
     }
 
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
 
-    GLCHK( program->setUniformValue("gui_gray_scale_preset",QVector3D(BasicProp.GrayScale.GrayScaleR,
-                                                                      BasicProp.GrayScale.GrayScaleG,
-                                                                      BasicProp.GrayScale.GrayScaleB)) );
+    GLCHK( program->setUniformValue("gui_gray_scale_preset",QVector3D(ActiveParams.Basic_GrayScale_GrayScaleR,
+                                                                      ActiveParams.Basic_GrayScale_GrayScaleG,
+                                                                      ActiveParams.Basic_GrayScale_GrayScaleB)) );
 
     GLCHK( glViewport(0,0,inputFBO->width(),inputFBO->height()) );
     GLCHK( outputFBO->bind() );
@@ -1837,9 +2063,9 @@ void GLImage::applyInvertComponentsFilter(QGLFramebufferObject* inputFBO,
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
 
-    GLCHK( program->setUniformValue("gui_inverted_components"  , QVector3D(BasicProp.ColorComponents.InvertRed,
-                                                                           BasicProp.ColorComponents.InvertGreen,
-                                                                           BasicProp.ColorComponents.InvertBlue)) );
+    GLCHK( program->setUniformValue("gui_inverted_components"  , QVector3D(ActiveParams.Basic_ColorComponents_InvertRed,
+                                                                           ActiveParams.Basic_ColorComponents_InvertGreen,
+                                                                           ActiveParams.Basic_ColorComponents_InvertBlue)) );
 
     GLCHK( glViewport(0,0,inputFBO->width(),inputFBO->height()) );
     GLCHK( outputFBO->bind() );
@@ -1864,7 +2090,7 @@ void GLImage::applySharpenBlurFilter(QGLFramebufferObject* inputFBO,
 
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
-    GLCHK( program->setUniformValue("gui_sharpen_blur", BasicProp.SharpenBlur) );
+    GLCHK( program->setUniformValue("gui_sharpen_blur", ActiveParams.Basic_SharpenBlur) );
 
     GLCHK( glViewport(0,0,inputFBO->width(),inputFBO->height()) );
 
@@ -1895,7 +2121,7 @@ void GLImage::applyNormalsStepFilter(QGLFramebufferObject* inputFBO,
 
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
-    GLCHK( program->setUniformValue("gui_normals_step", BasicProp.NormalsStep) );
+    GLCHK( program->setUniformValue("gui_normals_step", ActiveParams.Basic_NormalsStep) );
 
     GLCHK( glViewport(0,0,inputFBO->width(),inputFBO->height()) );
     GLCHK( outputFBO->bind() );
@@ -1919,11 +2145,11 @@ void GLImage::applyNormalMixerFilter(QGLFramebufferObject* inputFBO,
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
 
-    GLCHK( program->setUniformValue("gui_normal_mixer_depth",NormalMixerProp.Depth*2 ) );
-    GLCHK( program->setUniformValue("gui_normal_mixer_angle",NormalMixerProp.Angle/180.0f*3.1415926f) );
-    GLCHK( program->setUniformValue("gui_normal_mixer_scale",NormalMixerProp.Scale) );
-    GLCHK( program->setUniformValue("gui_normal_mixer_pos_x",NormalMixerProp.PosX) );
-    GLCHK( program->setUniformValue("gui_normal_mixer_pos_y",NormalMixerProp.PosY) );
+    GLCHK( program->setUniformValue("gui_normal_mixer_depth",ActiveParams.NormalsMixer_Depth*2 ) );
+    GLCHK( program->setUniformValue("gui_normal_mixer_angle",ActiveParams.NormalsMixer_Angle/180.0f*3.1415926f) );
+    GLCHK( program->setUniformValue("gui_normal_mixer_scale",ActiveParams.NormalsMixer_Scale) );
+    GLCHK( program->setUniformValue("gui_normal_mixer_pos_x",ActiveParams.NormalsMixer_PosX) );
+    GLCHK( program->setUniformValue("gui_normal_mixer_pos_y",ActiveParams.NormalsMixer_PosY) );
 
     GLCHK( glViewport(0,0,inputFBO->width(),inputFBO->height()) );
     GLCHK( outputFBO->bind() );
@@ -2010,7 +2236,7 @@ void GLImage::applyNormalToHeight(FBOImageProporties* image,QGLFramebufferObject
                                   QGLFramebufferObject* outputFBO){
 
 
-
+    VRAMManager::touch(normalFBO);
     applyGrayScaleFilter(normalFBO,heightFBO);
 
 #ifdef USE_OPENGL_330
@@ -2041,14 +2267,14 @@ void GLImage::applyNormalToHeight(FBOImageProporties* image,QGLFramebufferObject
     // used to force propper height levels in the bump map
     // since user wants to have defined min/max colors to be 0 or 1
     // in the height map. In case of other conversion this is no more used.
-    if(activeImage->bConversionBaseMap){
+    if(frame.bConversionBaseMap){
         GLCHK( glActiveTexture(GL_TEXTURE2) );
         GLCHK( glBindTexture(GL_TEXTURE_2D, auxFBO4->texture()) );
     }
 
     GLCHK( glDrawElements(GL_TRIANGLES, 3*2, GL_UNSIGNED_INT, 0) );
 
-    for(int i = 0; i < image->properties->NormalHeightConv.Huge ; i++){
+    for(int i = 0; i < FrameImage(image).parameters.NormalHeightConv_Huge ; i++){
         GLCHK( program->setUniformValue("hn_min_max_scale",QVector3D(-0.0,1.0,pow(2.0,5))) );
         GLCHK( heightFBO->bind() );
         GLCHK( glActiveTexture(GL_TEXTURE0) );
@@ -2061,7 +2287,7 @@ void GLImage::applyNormalToHeight(FBOImageProporties* image,QGLFramebufferObject
         GLCHK( glDrawElements(GL_TRIANGLES, 3*2, GL_UNSIGNED_INT, 0) );
     }
 
-    for(int i = 0; i < image->properties->NormalHeightConv.VeryLarge ; i++){
+    for(int i = 0; i < FrameImage(image).parameters.NormalHeightConv_VeryLarge ; i++){
         GLCHK( program->setUniformValue("hn_min_max_scale",QVector3D(-0.0,1.0,pow(2.0,4))) );
         GLCHK( heightFBO->bind() );
         GLCHK( glActiveTexture(GL_TEXTURE0) );
@@ -2074,7 +2300,7 @@ void GLImage::applyNormalToHeight(FBOImageProporties* image,QGLFramebufferObject
         GLCHK( glDrawElements(GL_TRIANGLES, 3*2, GL_UNSIGNED_INT, 0) );
     }
 
-    for(int i = 0; i < image->properties->NormalHeightConv.Large ; i++){
+    for(int i = 0; i < FrameImage(image).parameters.NormalHeightConv_Large ; i++){
         GLCHK( program->setUniformValue("hn_min_max_scale",QVector3D(-0.0,1.0,pow(2.0,3))) );
         GLCHK( heightFBO->bind() );
         GLCHK( glActiveTexture(GL_TEXTURE0) );
@@ -2088,7 +2314,7 @@ void GLImage::applyNormalToHeight(FBOImageProporties* image,QGLFramebufferObject
 
     }
 
-    for(int i = 0; i < image->properties->NormalHeightConv.Medium; i++){
+    for(int i = 0; i < FrameImage(image).parameters.NormalHeightConv_Medium; i++){
         GLCHK( program->setUniformValue("hn_min_max_scale",QVector3D(-0.0,1.0,pow(2.0,2))) );
         GLCHK( heightFBO->bind() );
         GLCHK( glActiveTexture(GL_TEXTURE0) );
@@ -2100,7 +2326,7 @@ void GLImage::applyNormalToHeight(FBOImageProporties* image,QGLFramebufferObject
         GLCHK( glBindTexture(GL_TEXTURE_2D, heightFBO->texture()) );
         GLCHK( glDrawElements(GL_TRIANGLES, 3*2, GL_UNSIGNED_INT, 0) );
     }
-    for(int i = 0; i < image->properties->NormalHeightConv.Small; i++){
+    for(int i = 0; i < FrameImage(image).parameters.NormalHeightConv_Small; i++){
         GLCHK( program->setUniformValue("hn_min_max_scale",QVector3D(-0.0,1.0,pow(2.0,1))) );
         GLCHK( heightFBO->bind() );
         GLCHK( glActiveTexture(GL_TEXTURE0) );
@@ -2112,7 +2338,7 @@ void GLImage::applyNormalToHeight(FBOImageProporties* image,QGLFramebufferObject
         GLCHK( glBindTexture(GL_TEXTURE_2D, heightFBO->texture()) );
         GLCHK( glDrawElements(GL_TRIANGLES, 3*2, GL_UNSIGNED_INT, 0) );
     }
-    for(int i = 0; i < image->properties->NormalHeightConv.VerySmall; i++){
+    for(int i = 0; i < FrameImage(image).parameters.NormalHeightConv_VerySmall; i++){
         GLCHK( program->setUniformValue("hn_min_max_scale",QVector3D(-0.0,1.0,pow(2.0,0))) );
         GLCHK( heightFBO->bind() );
         GLCHK( glActiveTexture(GL_TEXTURE0) );
@@ -2144,8 +2370,8 @@ void GLImage::applyNormalAngleCorrectionFilter(QGLFramebufferObject* inputFBO,
 
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
-    GLCHK( program->setUniformValue("base_map_angle_correction"  , BaseMapToOthersProp.AngleCorrection/180.0f*3.1415926f) );
-    GLCHK( program->setUniformValue("base_map_angle_weight"      , BaseMapToOthersProp.AngleWeight) );
+    GLCHK( program->setUniformValue("base_map_angle_correction"  , ActiveParams.BaseMapToOthers_AngleCorrection/180.0f*3.1415926f) );
+    GLCHK( program->setUniformValue("base_map_angle_weight"      , ActiveParams.BaseMapToOthers_AngleWeight) );
 
     GLCHK( glViewport(0,0,inputFBO->width(),inputFBO->height()) );
     GLCHK( outputFBO->bind() );
@@ -2197,10 +2423,10 @@ void GLImage::applyMixNormalLevels(GLuint level0,
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
 
-    GLCHK( program->setUniformValue("gui_base_map_w0"  , activeImage->properties->BaseMapToOthers.WeightSmall ) );
-    GLCHK( program->setUniformValue("gui_base_map_w1"  , activeImage->properties->BaseMapToOthers.WeightMedium ) );
-    GLCHK( program->setUniformValue("gui_base_map_w2"  , activeImage->properties->BaseMapToOthers.WeightBig) );
-    GLCHK( program->setUniformValue("gui_base_map_w3"  , activeImage->properties->BaseMapToOthers.WeightHuge ) );
+    GLCHK( program->setUniformValue("gui_base_map_w0"  , ActiveParams.BaseMapToOthers_WeightSmall ) );
+    GLCHK( program->setUniformValue("gui_base_map_w1"  , ActiveParams.BaseMapToOthers_WeightMedium ) );
+    GLCHK( program->setUniformValue("gui_base_map_w2"  , ActiveParams.BaseMapToOthers_WeightBig) );
+    GLCHK( program->setUniformValue("gui_base_map_w3"  , ActiveParams.BaseMapToOthers_WeightHuge ) );
 
     GLCHK( glViewport(0,0,outputFBO->width(),outputFBO->height()) );
     GLCHK( outputFBO->bind() );
@@ -2219,72 +2445,112 @@ void GLImage::applyMixNormalLevels(GLuint level0,
     GLCHK( outputFBO->bindDefault() );
 }
 
+// Updates lo and hi with min and max of each channel of count RGB pixels.
+static void rgbMinMax(const float* p, int count, float* lo, float* hi){
+    int x = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+    // four pixels are loaded as three vectors with rotated channels:
+    // (r g b r) (g b r g) (b r g b), lanes are merged per channel at the end
+    if(count >= 4){
+        __m128 lo0 = _mm_setr_ps(lo[0],lo[1],lo[2],lo[0]), hi0 = _mm_setr_ps(hi[0],hi[1],hi[2],hi[0]);
+        __m128 lo1 = _mm_setr_ps(lo[1],lo[2],lo[0],lo[1]), hi1 = _mm_setr_ps(hi[1],hi[2],hi[0],hi[1]);
+        __m128 lo2 = _mm_setr_ps(lo[2],lo[0],lo[1],lo[2]), hi2 = _mm_setr_ps(hi[2],hi[0],hi[1],hi[2]);
+        for(; x + 4 <= count ; x += 4){
+            const float* q = p + 3*x;
+            __m128 v0 = _mm_loadu_ps(q);
+            __m128 v1 = _mm_loadu_ps(q + 4);
+            __m128 v2 = _mm_loadu_ps(q + 8);
+            lo0 = _mm_min_ps(lo0,v0); hi0 = _mm_max_ps(hi0,v0);
+            lo1 = _mm_min_ps(lo1,v1); hi1 = _mm_max_ps(hi1,v1);
+            lo2 = _mm_min_ps(lo2,v2); hi2 = _mm_max_ps(hi2,v2);
+        }
+        float l[12], h[12];
+        _mm_storeu_ps(l,lo0); _mm_storeu_ps(l + 4,lo1); _mm_storeu_ps(l + 8,lo2);
+        _mm_storeu_ps(h,hi0); _mm_storeu_ps(h + 4,hi1); _mm_storeu_ps(h + 8,hi2);
+        // lane k of the 12 floats holds channel k % 3
+        for(int k = 0 ; k < 12 ; k++){
+            lo[k % 3] = qMin(lo[k % 3],l[k]);
+            hi[k % 3] = qMax(hi[k % 3],h[k]);
+        }
+    }
+#endif
+    for(; x < count ; x++){
+        const float* q = p + 3*x;
+        lo[0] = qMin(lo[0],q[0]); hi[0] = qMax(hi[0],q[0]);
+        lo[1] = qMin(lo[1],q[1]); hi[1] = qMax(hi[1],q[1]);
+        lo[2] = qMin(lo[2],q[2]); hi[2] = qMax(hi[2],q[2]);
+    }
+}
+
+// Computes min and max of RGB pixels of each material. Pixels with ID not
+// smaller than noMaterials are skipped. If ids is NULL all pixels belong to
+// material 0. Empty materials have min bigger than max.
+static void materialMinMax(const float* img, const quint16* ids, int noPixels,
+                           int noMaterials, float* mmin, float* mmax){
+    const int minPixels = 64*1024;
+    int noRanges = parallelRanges(noPixels,minPixels);
+    std::vector<float> rangeMin(noRanges*3*noMaterials, FLT_MAX);
+    std::vector<float> rangeMax(noRanges*3*noMaterials,-FLT_MAX);
+
+    parallelFor(noPixels,[&](int begin,int end,int range){
+        float* rmin = rangeMin.data() + range*3*noMaterials;
+        float* rmax = rangeMax.data() + range*3*noMaterials;
+        int i = begin;
+        while(i < end){
+            // masks consist of large areas of the same material, find the end
+            // of the span and reduce it with SIMD
+            int m       = (ids == NULL) ? 0   : ids[i];
+            int spanEnd = (ids == NULL) ? end : i + 1;
+            if(ids != NULL) while(spanEnd < end && ids[spanEnd] == m) spanEnd++;
+
+            if(m < noMaterials){
+                rgbMinMax(img + 3*i,spanEnd - i,rmin + 3*m,rmax + 3*m);
+            }
+            i = spanEnd;
+        }
+    },minPixels);
+
+    for(int k = 0 ; k < 3*noMaterials ; k++){
+        mmin[k] = FLT_MAX;
+        mmax[k] =-FLT_MAX;
+        for(int r = 0 ; r < noRanges ; r++){
+            mmin[k] = qMin(mmin[k],rangeMin[r*3*noMaterials+k]);
+            mmax[k] = qMax(mmax[k],rangeMax[r*3*noMaterials+k]);
+        }
+    }
+}
+
 void GLImage::applyCPUNormalizationFilter(QGLFramebufferObject* inputFBO,
                                           QGLFramebufferObject* outputFBO){
 
-
-
-
-    GLCHK( glActiveTexture(GL_TEXTURE0) );
-    GLCHK( glBindTexture(GL_TEXTURE_2D, inputFBO->texture()) );
-    GLint textureWidth, textureHeight;
-    GLCHK( glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &textureWidth) );
-    GLCHK( glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &textureHeight) );
-
-    float* img = new float[textureWidth*textureHeight*3];
-
-    GLCHK( glGetTexImage(GL_TEXTURE_2D,0,GL_RGB,GL_FLOAT,img) );
-
-    float min[3] = {img[0],img[1],img[2]};
-    float max[3] = {img[0],img[1],img[2]};
-
-    // if materials are enabled one must calulate height only in the
-    // region of selected material color
-    if(FBOImageProporties::currentMaterialIndeks != MATERIALS_DISABLED){
-        QImage maskImage = targetImageMaterial->getImage();
-        int currentMaterialIndex = FBOImageProporties::currentMaterialIndeks;
-        // number of components
-        int nc = maskImage. byteCount () / (textureWidth*textureHeight) ;
-        bool bFirstTimeChecked = true;
-        unsigned char * data = maskImage.bits();
-        for(int i = 0 ; i < textureWidth*textureHeight ; i++){
-            int materialColor = data[nc*i+0]*255*255 + data[nc*i+1]*255 + data[nc*i+2];
-            if(materialColor == currentMaterialIndex){
-                if(bFirstTimeChecked){
-                    for(int c = 0 ; c < 3 ; c++){
-                        min[c] = img[3*i+c];
-                        max[c] = max[c];
-                    }
-                    bFirstTimeChecked = false;
-                }// end of if first time
-
-                for(int c = 0 ; c < 3 ; c++){
-                    if( max[c] < img[3*i+c] ) max[c] = img[3*i+c];
-                    if( min[c] > img[3*i+c] ) min[c] = img[3*i+c];
-                }
-            }// end of if material colors are same
-        }// end of loop over image
-
-    }else{// if materials are disabled calculate
-        for(int i = 0 ; i < textureWidth*textureHeight ; i++){
+    // The input is copied to a pixel buffer without waiting for the GPU.
+    // Conversions need the range of this very image so they wait for the copy,
+    // interactive renders use the range of the previous frame and the frame
+    // is rendered again when the range changes (see render).
+    int noRanges = 1 + (isMaterialBatch() ? frame.materialBatchParameters.size() : 0);
+    bool bWait = frame.bShadowRender || frame.conversionType != CONVERT_NONE
+              || normalizeMin.size() != 3*noRanges
+              || normalizationReadback.getWidth()  != inputFBO->width()
+              || normalizationReadback.getHeight() != inputFBO->height();
+    if(normalizationReadback.isPending()) updateNormalizationRange(false);
+    normalizationReadback.start(inputFBO);
+    if(bWait) updateNormalizationRange(true);
+
+    if(normalizeMin.size() != 3*noRanges){
+        normalizeMin.fill(0.0f,3*noRanges);
+        normalizeMax.fill(1.0f,3*noRanges);
+    }
+    if(isMaterialBatch()){
+        for(int m = 0 ; m < noRanges-1 ; m++){
+            float* row = materialParams.data() + m*MATERIAL_PARAMS_COUNT;
             for(int c = 0 ; c < 3 ; c++){
-                if( max[c] < img[3*i+c] ) max[c] = img[3*i+c];
-                if( min[c] > img[3*i+c] ) min[c] = img[3*i+c];
+                row[MATERIAL_PARAM_NORMALIZE_MIN+c] = normalizeMin[3*(m+1)+c];
+                row[MATERIAL_PARAM_NORMALIZE_MAX+c] = normalizeMax[3*(m+1)+c];
             }
         }
-    }// end of if materials are enables
-
-    // prevent from singularities
-    for(int k = 0; k < 3 ; k ++)
-    if(qAbs(min[k] - max[k]) < 0.0001) max[k] += 0.1;
-
-
-    qDebug() << "Image normalization:";
-    qDebug() << "Min color = (" << min[0] << "," << min[1] << "," << min[2] << ")"  ;
-    qDebug() << "Max color = (" << max[0] << "," << max[1] << "," << max[2] << ")"  ;
-
+        updateMaterialParametersBuffer();
+    }
 
-    delete[] img;
 #ifdef USE_OPENGL_330
     program = filter_programs["mode_normalize_filter"];
     program->bind();
@@ -2299,8 +2565,8 @@ void GLImage::applyCPUNormalizationFilter(QGLFramebufferObject* inputFBO,
 
     GLCHK( outputFBO->bind() );
     GLCHK( glViewport(0,0,inputFBO->width(),inputFBO->height()) );
-    GLCHK( program->setUniformValue("min_color",QVector3D(min[0],min[1],min[2])) );
-    GLCHK( program->setUniformValue("max_color",QVector3D(max[0],max[1],max[2])) );
+    GLCHK( program->setUniformValue("min_color",QVector3D(normalizeMin[0],normalizeMin[1],normalizeMin[2])) );
+    GLCHK( program->setUniformValue("max_color",QVector3D(normalizeMax[0],normalizeMax[1],normalizeMax[2])) );
     GLCHK( glActiveTexture(GL_TEXTURE0) );
     GLCHK( glBindTexture(GL_TEXTURE_2D, inputFBO->texture()) );
     GLCHK( glDrawElements(GL_TRIANGLES, 3*2, GL_UNSIGNED_INT, 0) );
@@ -2310,6 +2576,99 @@ void GLImage::applyCPUNormalizationFilter(QGLFramebufferObject* inputFBO,
 
 }
 
+/**
+ * @brief updateNormalizationRange computes the range of the CPU normalization
+ * from the finished copy of normalizationReadback.
+ * @param bWait wait for the GPU if the copy is not finished yet
+ * @return true if the range differs from the previous one
+ */
+bool GLImage::updateNormalizationRange(bool bWait){
+
+    if(!normalizationReadback.isReady(bWait)) return false;
+    const float* img = normalizationReadback.map();
+    if(img == NULL) return false;
+
+    int textureWidth  = normalizationReadback.getWidth();
+    int textureHeight = normalizationReadback.getHeight();
+
+    // material IDs have the same layout as the image read above
+    const quint16* ids = NULL;
+    if(frame.currentMaterialIndeks != MATERIALS_DISABLED){
+        if(targetImageMaterial->materialIdsWidth  == textureWidth &&
+           targetImageMaterial->materialIdsHeight == textureHeight){
+            ids = targetImageMaterial->materialIds.constData();
+        }else{
+            qWarning() << "Material mask size differs from the normalized image. Materials are ignored.";
+        }
+    }
+
+    int noPixels = textureWidth*textureHeight;
+    float min[3];
+    float max[3];
+    QVector<float> newMin;
+    QVector<float> newMax;
+    // in batch mode each material is normalized with its own range
+    if(isMaterialBatch()){
+        int noMaterials = frame.materialBatchParameters.size();
+        QVector<float> mmin(3*noMaterials, FLT_MAX);
+        QVector<float> mmax(3*noMaterials,-FLT_MAX);
+        if(ids != NULL) materialMinMax(img,ids,noPixels,noMaterials,mmin.data(),mmax.data());
+
+        for(int k = 0 ; k < 3*noMaterials ; k++){
+            // empty material or flat image
+            if(mmin[k] > mmax[k]){
+                mmin[k] = 0.0f;
+                mmax[k] = 1.0f;
+            }
+            if(qAbs(mmin[k] - mmax[k]) < 0.0001) mmax[k] += 0.1;
+        }
+        newMin = mmin;
+        newMax = mmax;
+        materialMinMax(img,NULL,noPixels,1,min,max);
+
+    // if materials are enabled one must calulate height only in the
+    // region of selected material
+    }else if(ids != NULL && frame.currentMaterialIndeks >= 0){
+        int currentMaterialIndex = frame.currentMaterialIndeks;
+        QVector<float> mmin(3*(currentMaterialIndex+1));
+        QVector<float> mmax(3*(currentMaterialIndex+1));
+        // IDs of other materials which are bigger than selected one are skipped
+        materialMinMax(img,ids,noPixels,currentMaterialIndex+1,mmin.data(),mmax.data());
+        for(int c = 0 ; c < 3 ; c++){
+            min[c] = mmin[3*currentMaterialIndex+c];
+            max[c] = mmax[3*currentMaterialIndex+c];
+        }
+    }else{// if materials are disabled calculate
+        materialMinMax(img,NULL,noPixels,1,min,max);
+    }// end of if materials are enables
+
+    // selected material is not present in the image
+    if(min[0] > max[0]){
+        for(int c = 0 ; c < 3 ; c++){
+            min[c] = img[c];
+            max[c] = img[c];
+        }
+    }
+    normalizationReadback.unmap();
+
+    // prevent from singularities
+    for(int k = 0; k < 3 ; k ++)
+    if(qAbs(min[k] - max[k]) < 0.0001) max[k] += 0.1;
+
+    for(int c = 2 ; c >= 0 ; c--){
+        newMin.prepend(min[c]);
+        newMax.prepend(max[c]);
+    }
+    bool bChanged = (newMin != normalizeMin || newMax != normalizeMax);
+    normalizeMin  = newMin;
+    normalizeMax  = newMax;
+
+    qDebug() << "Image normalization:";
+    qDebug() << "Min color = (" << min[0] << "," << min[1] << "," << min[2] << ")"  ;
+    qDebug() << "Max color = (" << max[0] << "," << max[1] << "," << max[2] << ")"  ;
+    return bChanged;
+}
+
 void GLImage::applyAddNoiseFilter(QGLFramebufferObject* inputFBO,
                                   QGLFramebufferObject* outputFBO){
 
@@ -2323,7 +2682,7 @@ void GLImage::applyAddNoiseFilter(QGLFramebufferObject* inputFBO,
 
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
-    GLCHK( program->setUniformValue("gui_add_noise_amp"  , float(targetImageHeight->properties->NormalHeightConv.NoiseLevel/100.0) ));
+    GLCHK( program->setUniformValue("gui_add_noise_amp"  , float(FrameImage(targetImageHeight).parameters.NormalHeightConv_NoiseLevel/100.0) ));
 
     GLCHK( glViewport(0,0,inputFBO->width(),inputFBO->height()) );
     GLCHK( outputFBO->bind() );
@@ -2395,18 +2754,19 @@ void GLImage::applyOcclusionFilter(GLuint height_tex,GLuint normal_tex,
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
 
-    GLCHK( program->setUniformValue("gui_ssao_no_iters"   ,AOProp.NumIters) );
-    GLCHK( program->setUniformValue("gui_ssao_depth"      ,AOProp.Depth) );
-    GLCHK( program->setUniformValue("gui_ssao_bias"       ,AOProp.Bias) );
-    GLCHK( program->setUniformValue("gui_ssao_intensity"  ,AOProp.Intensity) );
+    GLCHK( program->setUniformValue("gui_ssao_no_iters"   ,ActiveParams.AO_NumIters) );
+    GLCHK( program->setUniformValue("gui_ssao_depth"      ,ActiveParams.AO_Depth) );
+    GLCHK( program->setUniformValue("gui_ssao_bias"       ,ActiveParams.AO_Bias) );
+    GLCHK( program->setUniformValue("gui_ssao_intensity"  ,ActiveParams.AO_Intensity) );
 
+    VRAMManager::touch(outputFBO);
     GLCHK( glViewport(0,0,outputFBO->width(),outputFBO->height()) );
     GLCHK( outputFBO->bind() );
 
     GLCHK( glActiveTexture(GL_TEXTURE0) );
-    GLCHK( glBindTexture(GL_TEXTURE_2D, height_tex) );
+    GLCHK( glBindTexture(GL_TEXTURE_2D, VRAMManager::use(height_tex)) );
     GLCHK( glActiveTexture(GL_TEXTURE1) );
-    GLCHK( glBindTexture(GL_TEXTURE_2D, normal_tex) );
+    GLCHK( glBindTexture(GL_TEXTURE_2D, VRAMManager::use(normal_tex)) );
 
     GLCHK( glDrawElements(GL_TRIANGLES, 3*2, GL_UNSIGNED_INT, 0) );
     GLCHK( glActiveTexture(GL_TEXTURE0) );
@@ -2429,11 +2789,11 @@ void GLImage::applyHeightProcessingFilter(QGLFramebufferObject* inputFBO,
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
 
-    GLCHK( program->setUniformValue("gui_height_proc_min_value"   ,ColorLevelsProp.MinValue) );
-    GLCHK( program->setUniformValue("gui_height_proc_max_value"   ,ColorLevelsProp.MaxValue) );
-    GLCHK( program->setUniformValue("gui_height_proc_ave_radius"  ,int(ColorLevelsProp.DetailsRadius*100.0) ));
-    GLCHK( program->setUniformValue("gui_height_proc_offset_value",ColorLevelsProp.Offset) );
-    GLCHK( program->setUniformValue("gui_height_proc_normalization",ColorLevelsProp.EnableNormalization) );
+    GLCHK( program->setUniformValue("gui_height_proc_min_value"   ,ActiveParams.ColorLevels_MinValue) );
+    GLCHK( program->setUniformValue("gui_height_proc_max_value"   ,ActiveParams.ColorLevels_MaxValue) );
+    GLCHK( program->setUniformValue("gui_height_proc_ave_radius"  ,int(ActiveParams.ColorLevels_DetailsRadius*100.0) ));
+    GLCHK( program->setUniformValue("gui_height_proc_offset_value",ActiveParams.ColorLevels_Offset) );
+    GLCHK( program->setUniformValue("gui_height_proc_normalization",ActiveParams.ColorLevels_EnableNormalization) );
 
     GLCHK( glViewport(0,0,inputFBO->width(),inputFBO->height()) );
     GLCHK( outputFBO->bind() );
@@ -2475,7 +2835,7 @@ void GLImage::applyRoughnessFilter(QGLFramebufferObject* inputFBO,
                                     QGLFramebufferObject* outputFBO){
 
     // do the gaussian filter
-    applyGaussFilter(inputFBO,auxFBO,outputFBO,int(RMFilterProp.NoiseFilter.Depth));
+    applyGaussFilter(inputFBO,auxFBO,outputFBO,int(ActiveParams.RMFilter_NoiseFilter_Depth));
 
     copyFBO(outputFBO,auxFBO);
 
@@ -2490,9 +2850,9 @@ void GLImage::applyRoughnessFilter(QGLFramebufferObject* inputFBO,
 
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
-    GLCHK( program->setUniformValue("gui_roughness_depth"     ,  RMFilterProp.NoiseFilter.Depth ) );
-    GLCHK( program->setUniformValue("gui_roughness_treshold"  ,  RMFilterProp.NoiseFilter.Treshold) );
-    GLCHK( program->setUniformValue("gui_roughness_amplifier"  , RMFilterProp.NoiseFilter.Amplifier) );
+    GLCHK( program->setUniformValue("gui_roughness_depth"     ,  ActiveParams.RMFilter_NoiseFilter_Depth ) );
+    GLCHK( program->setUniformValue("gui_roughness_treshold"  ,  ActiveParams.RMFilter_NoiseFilter_Treshold) );
+    GLCHK( program->setUniformValue("gui_roughness_amplifier"  , ActiveParams.RMFilter_NoiseFilter_Amplifier) );
 
 
     GLCHK( glViewport(0,0,inputFBO->width(),inputFBO->height()) );
@@ -2522,16 +2882,16 @@ void GLImage::applyRoughnessColorFilter(QGLFramebufferObject* inputFBO,
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
 
-    QColor color = QColor(RMFilterProp.ColorFilter.PickColor);
+    QColor color = QColor::fromRgba(ActiveParams.RMFilter_ColorFilter_PickColor);
     QVector3D dcolor(color.redF(),color.greenF(),color.blueF());
 
     GLCHK( program->setUniformValue("gui_roughness_picked_color"  , dcolor ) );
-    GLCHK( program->setUniformValue("gui_roughness_color_method"  , (int)RMFilterProp.ColorFilter.Method) );
-    GLCHK( program->setUniformValue("gui_roughness_color_offset"  , RMFilterProp.ColorFilter.Bias ) );
-    GLCHK( program->setUniformValue("gui_roughness_color_global_offset"  , RMFilterProp.ColorFilter.Offset) );
+    GLCHK( program->setUniformValue("gui_roughness_color_method"  , (int)ActiveParams.RMFilter_ColorFilter_Method) );
+    GLCHK( program->setUniformValue("gui_roughness_color_offset"  , ActiveParams.RMFilter_ColorFilter_Bias ) );
+    GLCHK( program->setUniformValue("gui_roughness_color_global_offset"  , ActiveParams.RMFilter_ColorFilter_Offset) );
 
-    GLCHK( program->setUniformValue("gui_roughness_invert_mask"   , RMFilterProp.ColorFilter.InvertColors ) );
-    GLCHK( program->setUniformValue("gui_roughness_color_amplifier", RMFilterProp.ColorFilter.Amplifier ) );
+    GLCHK( program->setUniformValue("gui_roughness_invert_mask"   , ActiveParams.RMFilter_ColorFilter_InvertColors ) );
+    GLCHK( program->setUniformValue("gui_roughness_color_amplifier", ActiveParams.RMFilter_ColorFilter_Amplifier ) );
 
     GLCHK( glViewport(0,0,inputFBO->width(),inputFBO->height()) );
     GLCHK( outputFBO->bind() );
@@ -2551,11 +2911,12 @@ void GLImage::copyFBO(QGLFramebufferObject* src,QGLFramebufferObject* dst){
 #else
     GLCHK( glUniformSubroutinesuiv( GL_FRAGMENT_SHADER, 1, &subroutines["mode_normal_filter"]) );
 #endif
+    VRAMManager::touch(dst);
     GLCHK( dst->bind() );
     GLCHK( glViewport(0,0,dst->width(),dst->height()) );    
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
-    GLCHK( glBindTexture(GL_TEXTURE_2D, src->texture()) );
+    GLCHK( glBindTexture(GL_TEXTURE_2D, VRAMManager::use(src->texture())) );
     GLCHK( glDrawElements(GL_TRIANGLES, 3*2, GL_UNSIGNED_INT, 0) );
     src->bindDefault();
 }
@@ -2570,22 +2931,23 @@ void GLImage::copyTex2FBO(GLuint src_tex_id,QGLFramebufferObject* dst){
     GLCHK( glUniformSubroutinesuiv( GL_FRAGMENT_SHADER, 1, &subroutines["mode_normal_filter"]) );
 #endif
 
+    VRAMManager::touch(dst);
     GLCHK( dst->bind() );
     GLCHK( glViewport(0,0,dst->width(),dst->height()) );
 
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
-    GLCHK( glBindTexture(GL_TEXTURE_2D, src_tex_id) );
+    GLCHK( glBindTexture(GL_TEXTURE_2D, VRAMManager::use(src_tex_id)) );
     GLCHK( glDrawElements(GL_TRIANGLES, 3*2, GL_UNSIGNED_INT, 0) );
     dst->bindDefault();
 }
 
 void GLImage::applyAllUVsTransforms(QGLFramebufferObject* inoutFBO){
-    if(FBOImageProporties::bSeamlessTranslationsFirst){
+    if(frame.bSeamlessTranslationsFirst){
       applyPerspectiveTransformFilter(inoutFBO,auxFBO1);// the output is save to activeFBO
     }
     // Making seamless...
-    switch(FBOImageProporties::seamlessMode){
+    switch(frame.seamlessMode){
         case(SEAMLESS_SIMPLE):
             applySeamlessLinearFilter(inoutFBO,auxFBO1); //  the output is save to activeFBO
             break;
@@ -2597,7 +2959,7 @@ void GLImage::applyAllUVsTransforms(QGLFramebufferObject* inoutFBO){
         case(SEAMLESS_NONE):
         default: break;
     }
-    if(!FBOImageProporties::bSeamlessTranslationsFirst){
+    if(!frame.bSeamlessTranslationsFirst){
       applyPerspectiveTransformFilter(inoutFBO,auxFBO1);// the output is save to activeFBO
     }
 }
@@ -2622,7 +2984,7 @@ void GLImage::applyGrungeImageFilter (QGLFramebufferObject* inputFBO,
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
 
 
-    GLCHK( program->setUniformValue("gui_hn_conversion_depth", 2*GrungeOnImageProp.GrungeWeight * GrungeProp.OverallWeight) );
+    GLCHK( program->setUniformValue("gui_hn_conversion_depth", 2*ActiveParams.GrungeOnImage_GrungeWeight * GrungeParams.Grunge_OverallWeight) );
     GLCHK( glViewport(0,0,auxFBO3->width(),auxFBO3->height()) );
     GLCHK( auxFBO3->bind() );
     GLCHK( glBindTexture(GL_TEXTURE_2D, grungeFBO->texture()) );
@@ -2639,7 +3001,7 @@ void GLImage::applyGrungeImageFilter (QGLFramebufferObject* inputFBO,
 
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
-    float weight = 2*GrungeOnImageProp.ImageWeight;
+    float weight = 2*ActiveParams.GrungeOnImage_ImageWeight;
 
     GLCHK( program->setUniformValue("gui_normal_mixer_depth", weight) );
     GLCHK( program->setUniformValue("gui_normal_mixer_angle", 0.0f) );
@@ -2672,10 +3034,10 @@ void GLImage::applyGrungeImageFilter (QGLFramebufferObject* inputFBO,
 
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
-    float weight = GrungeOnImageProp.GrungeWeight * GrungeProp.OverallWeight;
+    float weight = ActiveParams.GrungeOnImage_GrungeWeight * GrungeParams.Grunge_OverallWeight;
 
     GLCHK( program->setUniformValue("gui_grunge_overall_weight"  , weight ) );
-    GLCHK( program->setUniformValue("gui_grunge_blending_mode"  , (int)GrungeOnImageProp.BlendingMode) );
+    GLCHK( program->setUniformValue("gui_grunge_blending_mode"  , (int)ActiveParams.GrungeOnImage_BlendingMode) );
 
 
 
@@ -2707,15 +3069,15 @@ void GLImage::applyGrungeRandomizationFilter(QGLFramebufferObject* inputFBO,
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
     QMatrix3x3 random_angles;
-    qsrand(GrungeProp.Randomize);
+    qsrand(GrungeParams.Grunge_Randomize);
     for(int i = 0; i < 9; i++)random_angles.data()[i] = 3.1415*qrand()/(RAND_MAX+0.0);
     GLCHK( program->setUniformValue("gui_seamless_random_angles" , random_angles) );
     float phase = 3.1415*qrand()/(RAND_MAX+0.0);
     GLCHK( program->setUniformValue("gui_seamless_random_phase" , phase) );
-    GLCHK( program->setUniformValue("gui_grunge_radius"    , GrungeProp.Scale) );
-    GLCHK( program->setUniformValue("gui_grunge_brandomize" , bool(GrungeProp.Randomize!=0)) );
+    GLCHK( program->setUniformValue("gui_grunge_radius"    , GrungeParams.Grunge_Scale) );
+    GLCHK( program->setUniformValue("gui_grunge_brandomize" , bool(GrungeParams.Grunge_Randomize!=0)) );
 
-    GLCHK( program->setUniformValue("gui_grunge_translations" , int(GrungeProp.RandomTranslations) ) );
+    GLCHK( program->setUniformValue("gui_grunge_translations" , int(GrungeParams.Grunge_RandomTranslations) ) );
 
 
     GLCHK( glViewport(0,0,inputFBO->width(),inputFBO->height()) );
@@ -2723,7 +3085,7 @@ void GLImage::applyGrungeRandomizationFilter(QGLFramebufferObject* inputFBO,
     GLCHK( glActiveTexture(GL_TEXTURE0) );
     GLCHK( glBindTexture(GL_TEXTURE_2D, inputFBO->texture()) );
     GLCHK( glActiveTexture(GL_TEXTURE1) );
-    GLCHK( glBindTexture(GL_TEXTURE_2D, targetImageGrunge->fbo->texture()) );
+    GLCHK( glBindTexture(GL_TEXTURE_2D, targetImageGrunge->getFBO()->texture()) );
     GLCHK( glDrawElements(GL_TRIANGLES, 3*2, GL_UNSIGNED_INT, 0) );
     GLCHK( glActiveTexture(GL_TEXTURE0) );
     outputFBO->bindDefault();
@@ -2744,14 +3106,14 @@ void GLImage::applyGrungeWarpNormalFilter(QGLFramebufferObject* inputFBO,
 
     GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,1.0)) );
     GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0,0.0)) );
-    GLCHK( program->setUniformValue("grunge_normal_warp"  , GrungeProp.NormalWarp) );
+    GLCHK( program->setUniformValue("grunge_normal_warp"  , GrungeParams.Grunge_NormalWarp) );
 
     GLCHK( glViewport(0,0,outputFBO->width(),outputFBO->height()) );
     GLCHK( outputFBO->bind() );
     GLCHK( glActiveTexture(GL_TEXTURE0) );
     GLCHK( glBindTexture(GL_TEXTURE_2D, inputFBO->texture()) );
     GLCHK( glActiveTexture(GL_TEXTURE1) );
-    GLCHK( glBindTexture(GL_TEXTURE_2D, targetImageNormal->scr_tex_id) );
+    GLCHK( glBindTexture(GL_TEXTURE_2D, targetImageNormal->getSrcTexId()) );
     GLCHK( glDrawElements(GL_TRIANGLES, 3*2, GL_UNSIGNED_INT, 0) );
     GLCHK( glActiveTexture(GL_TEXTURE0) );
     outputFBO->bindDefault();
@@ -2765,7 +3127,8 @@ void GLImage::updateProgramUniforms(int step){
         GLCHK( program->setUniformValue("gui_image_type", openGL330ForceTexType) );
         GLCHK( program->setUniformValue("gui_depth", float(1.0)) );
         GLCHK( program->setUniformValue("gui_mode_dgaussian", 1) );
-        GLCHK( program->setUniformValue("material_id", int(activeImage->currentMaterialIndeks) ) );
+        GLCHK( program->setUniformValue("material_id", int(frame.currentMaterialIndeks) ) );
+        if(frame.currentMaterialIndeks == MATERIALS_BATCH) setMaterialBatchUniforms();
 
         if(activeImage->imageType == MATERIAL_TEXTURE){
 
@@ -2778,6 +3141,157 @@ void GLImage::updateProgramUniforms(int step){
 
 }
 
+FBOImageProporties* GLImage::getTargetImage(TextureTypes type){
+    switch(type){
+        case(DIFFUSE_TEXTURE):   return targetImageDiffuse;
+        case(NORMAL_TEXTURE):    return targetImageNormal;
+        case(SPECULAR_TEXTURE):  return targetImageSpecular;
+        case(HEIGHT_TEXTURE):    return targetImageHeight;
+        case(OCCLUSION_TEXTURE): return targetImageOcclusion;
+        case(ROUGHNESS_TEXTURE): return targetImageRoughness;
+        case(METALLIC_TEXTURE):  return targetImageMetallic;
+        case(GRUNGE_TEXTURE):    return targetImageGrunge;
+        case(MATERIAL_TEXTURE):  return targetImageMaterial;
+        default: return NULL;
+    }
+}
+
+QImage GLImage::packChannels(const ChannelPacking& packing){
+    QImage image;
+    renderThread->invoke([&](){ image = renderPackChannels(packing); });
+    return image;
+}
+
+QImage GLImage::renderPackChannels(const ChannelPacking& packing){
+
+    // each distinct source map is bound to one of the layers A-D
+    QGLFramebufferObject* layers[4] = {NULL,NULL,NULL,NULL};
+    int noLayers = 0;
+    int packLayers[4];
+    for(int c = 0 ; c < 4 ; c++){
+        packLayers[c] = PACK_CONSTANT;
+        if(packing.sources[c] == PACK_CONSTANT) continue;
+        FBOImageProporties* image = getTargetImage(TextureTypes(packing.sources[c]));
+        if(image == NULL || image->getFBO() == NULL){
+            qWarning() << "GLImage::packChannels: source map" << packing.sources[c] << "is not available.";
+            return QImage();
+        }
+        for(int l = 0 ; l < noLayers ; l++){
+            if(layers[l] == image->getFBO()) packLayers[c] = l;
+        }
+        if(packLayers[c] == PACK_CONSTANT){
+            packLayers[c]      = noLayers;
+            layers[noLayers++] = image->getFBO();
+        }
+    }
+    QGLFramebufferObject* sizeFBO = (noLayers > 0) ? layers[0] : getTargetImage(packing.outputType)->getFBO();
+    int width  = sizeFBO->width();
+    int height = sizeFBO->height();
+
+    FBOImages::resize(packFBO,width,height,GL_RGBA8);
+
+#ifdef USE_OPENGL_330
+    program = filter_programs["mode_pack_channels_filter"];
+    GLCHK( program->bind() );
+#else
+    GLCHK( program->bind() );
+    GLCHK( glUniformSubroutinesuiv( GL_FRAGMENT_SHADER, 1, &subroutines["mode_pack_channels_filter"]) );
+#endif
+
+    GLCHK( program->setUniformValue("material_id", int(MATERIALS_DISABLED)) );
+    GLCHK( program->setUniformValue("quad_draw_mode", int(0)) );
+    // image is drawn upside down so the rows are read back in QImage order
+    GLCHK( program->setUniformValue("quad_scale", QVector2D(1.0,-1.0)) );
+    GLCHK( program->setUniformValue("quad_pos"  , QVector2D(0.0, 1.0)) );
+    GLCHK( program->setUniformValue("pack_layers"   , packLayers[0],packLayers[1],packLayers[2],packLayers[3]) );
+    GLCHK( program->setUniformValue("pack_channels" , packing.channels[0],packing.channels[1],
+                                                      packing.channels[2],packing.channels[3]) );
+    GLCHK( program->setUniformValue("pack_constants", QVector4D(packing.constants[0],packing.constants[1],
+                                                                packing.constants[2],packing.constants[3])) );
+
+    GLCHK( glDisable(GL_CULL_FACE) );
+    GLCHK( glDisable(GL_DEPTH_TEST) );
+    GLCHK( glBindVertexArray(screen_vao) );
+    GLCHK( glBindBuffer(GL_ARRAY_BUFFER, vbos[0]) );
+    GLCHK( glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,sizeof(float)*3,(void*)0) );
+    GLCHK( glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbos[2]) );
+
+    for(int l = 0 ; l < noLayers ; l++){
+        GLCHK( glActiveTexture(GL_TEXTURE0+l) );
+        GLCHK( glBindTexture(GL_TEXTURE_2D, VRAMManager::use(layers[l]->texture())) );
+    }
+    GLCHK( glViewport(0,0,width,height) );
+    GLCHK( packFBO->bind() );
+    GLCHK( glDrawElements(GL_TRIANGLES, 3*2, GL_UNSIGNED_INT, 0) );
+
+    // read directly into ARGB32 layout, without premultiplication and conversions
+    QImage image(width,height,QImage::Format_ARGB32);
+    GLCHK( glPixelStorei(GL_PACK_ALIGNMENT, 4) );
+    GLCHK( glReadPixels(0,0,width,height,GL_BGRA,GL_UNSIGNED_INT_8_8_8_8_REV,image.bits()) );
+    GLCHK( packFBO->bindDefault() );
+
+    for(int l = noLayers-1 ; l >= 0 ; l--){
+        GLCHK( glActiveTexture(GL_TEXTURE0+l) );
+        GLCHK( glBindTexture(GL_TEXTURE_2D, 0) );
+    }
+    GLCHK( glBindVertexArray(0) );
+    GLCHK( program->release() );
+    FBOImages::remove(packFBO);
+    return image;
+}
+
+bool GLImage::isMaterialBatch(){
+    return activeImage != NULL
+        && frame.currentMaterialIndeks == MATERIALS_BATCH
+        && !frame.materialBatchParameters.isEmpty();
+}
+
+void GLImage::uploadMaterialParameters(){
+    int noMaterials = frame.materialBatchParameters.size();
+    materialParams.fill(0.0f, noMaterials*MATERIAL_PARAMS_COUNT);
+
+    for(int m = 0 ; m < noMaterials ; m++){
+        const ImageParameters& p = frame.materialBatchParameters[m];
+        float* row = materialParams.data() + m*MATERIAL_PARAMS_COUNT;
+        row[MATERIAL_PARAM_HUE]                 = p.Basic_ColorHue;
+        row[MATERIAL_PARAM_SMALL_DETAILS]       = p.Basic_SmallDetails;
+        row[MATERIAL_PARAM_MEDIUM_DETAILS]      = p.Basic_MediumDetails;
+        row[MATERIAL_PARAM_CONTRAST]            = p.SurfaceDetails_Contrast;
+        row[MATERIAL_PARAM_INVERT_R]            = p.Basic_ColorComponents_InvertRed;
+        row[MATERIAL_PARAM_INVERT_G]            = p.Basic_ColorComponents_InvertGreen;
+        row[MATERIAL_PARAM_INVERT_B]            = p.Basic_ColorComponents_InvertBlue;
+        row[MATERIAL_PARAM_NORMALS_STEP]        = p.Basic_NormalsStep;
+        row[MATERIAL_PARAM_HEIGHT_MIN]          = p.ColorLevels_MinValue;
+        row[MATERIAL_PARAM_HEIGHT_MAX]          = p.ColorLevels_MaxValue;
+        row[MATERIAL_PARAM_HEIGHT_OFFSET]       = p.ColorLevels_Offset;
+        row[MATERIAL_PARAM_ROUGHNESS_TRESHOLD]  = p.RMFilter_NoiseFilter_Treshold;
+        row[MATERIAL_PARAM_ROUGHNESS_AMPLIFIER] = p.RMFilter_NoiseFilter_Amplifier;
+        // updated by applyCPUNormalizationFilter
+        for(int c = 0 ; c < 3 ; c++){
+            row[MATERIAL_PARAM_NORMALIZE_MIN+c] = 0.0f;
+            row[MATERIAL_PARAM_NORMALIZE_MAX+c] = 1.0f;
+        }
+    }
+    updateMaterialParametersBuffer();
+}
+
+void GLImage::updateMaterialParametersBuffer(){
+    GLCHK( glBindBuffer(GL_TEXTURE_BUFFER, materialParamsBuffer) );
+    GLCHK( glBufferData(GL_TEXTURE_BUFFER, materialParams.size()*sizeof(float), materialParams.constData(), GL_DYNAMIC_DRAW) );
+    GLCHK( glBindBuffer(GL_TEXTURE_BUFFER, 0) );
+
+    GLCHK( glActiveTexture(GL_TEXTURE11) );
+    GLCHK( glBindTexture(GL_TEXTURE_BUFFER, materialParamsTexture) );
+    GLCHK( glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, materialParamsBuffer) );
+    GLCHK( glActiveTexture(GL_TEXTURE0) );
+}
+
+void GLImage::setMaterialBatchUniforms(){
+    // images without per material settings (e.g. grunge) use the uniforms only
+    int noMaterials = isMaterialBatch() ? frame.materialBatchParameters.size() : 0;
+    GLCHK( program->setUniformValue("material_count", noMaterials) );
+}
+
 void GLImage::makeScreenQuad()
 {
 
@@ -2859,17 +3373,15 @@ void GLImage::wheelEvent(QWheelEvent *event){
     //resizeGL(width(),height());
     windowRatio = float(width())/height();
     if (isValid()) {
-      GLCHK( glViewport(0, 0, width(), height()) );
-
-      if (activeImage && activeImage->fbo){
-        fboRatio = float(activeImage->fbo->width())/activeImage->fbo->height();
+      QSize imageSize = currentImage ? currentImage->getSize() : QSize();
+      if (!imageSize.isEmpty()){
+        fboRatio = float(imageSize.width())/imageSize.height();
         orthographicProjHeight = (1+zoom)/windowRatio;
         orthographicProjWidth = (1+zoom)/fboRatio;
       } else {
         qWarning() << Q_FUNC_INFO;
-        if (!activeImage) qWarning() << "  activeImage is null";
-        else
-      if (!activeImage->fbo) qWarning() << "  activeImage->fbo is null";
+        if (!currentImage) qWarning() << "  currentImage is null";
+        else qWarning() << "  currentImage->fbo is null";
       }
     } else
       qDebug() << Q_FUNC_INFO << "invalid context.";
@@ -2885,7 +3397,7 @@ void GLImage::wheelEvent(QWheelEvent *event){
 void GLImage::relativeMouseMoveEvent(int dx, int dy, bool* wrapMouse, Qt::MouseButtons buttons)
 {
 
-    if(activeImage->imageType != GRUNGE_TEXTURE)
+    if(currentImage->imageType != GRUNGE_TEXTURE)
     if(FBOImageProporties::currentMaterialIndeks != MATERIALS_DISABLED && buttons & Qt::LeftButton){
         QMessageBox msgBox;
         msgBox.setText("Warning!");
@@ -2895,7 +3407,7 @@ void GLImage::relativeMouseMoveEvent(int dx, int dy, bool* wrapMouse, Qt::MouseB
         return;
     }
 
-    if(activeImage->imageType == MATERIAL_TEXTURE && buttons & Qt::LeftButton){
+    if(currentImage->imageType == MATERIAL_TEXTURE && buttons & Qt::LeftButton){
         QMessageBox msgBox;
         msgBox.setText("Warning!");
         msgBox.setInformativeText("Sorry, but you cannot modify UV's mapping of materials texture. This texture is static.");
@@ -2904,7 +3416,7 @@ void GLImage::relativeMouseMoveEvent(int dx, int dy, bool* wrapMouse, Qt::MouseB
         return;
     }
 
-    if(activeImage->imageType == GRUNGE_TEXTURE && buttons & Qt::LeftButton){
+    if(currentImage->imageType == GRUNGE_TEXTURE && buttons & Qt::LeftButton){
         QMessageBox msgBox;
         msgBox.setText("Warning!");
         msgBox.setInformativeText("Sorry, but you cannot modify UV's mapping of Grunge texture. Try Diffuse or height texture.");
@@ -2913,7 +3425,7 @@ void GLImage::relativeMouseMoveEvent(int dx, int dy, bool* wrapMouse, Qt::MouseB
         return;
     }
 
-    if(activeImage->imageType == OCCLUSION_TEXTURE && buttons & Qt::LeftButton){
+    if(currentImage->imageType == OCCLUSION_TEXTURE && buttons & Qt::LeftButton){
         QMessageBox msgBox;
         msgBox.setText("Warning!");
         msgBox.setInformativeText("Sorry, but you cannot modify UV's mapping of occlusion texture. Try Diffuse or height texture.");
@@ -2921,7 +3433,7 @@ void GLImage::relativeMouseMoveEvent(int dx, int dy, bool* wrapMouse, Qt::MouseB
         msgBox.exec();
         return;
     }
-    if(activeImage->imageType == NORMAL_TEXTURE && (buttons & Qt::LeftButton)){
+    if(currentImage->imageType == NORMAL_TEXTURE && (buttons & Qt::LeftButton)){
         QMessageBox msgBox;
         msgBox.setText("Warning!");
         msgBox.setInformativeText("Sorry, but you cannot modify UV's mapping of normal texture. Try Diffuse or height texture.");
@@ -2929,7 +3441,7 @@ void GLImage::relativeMouseMoveEvent(int dx, int dy, bool* wrapMouse, Qt::MouseB
         msgBox.exec();
         return;
     }
-    if(activeImage->imageType == METALLIC_TEXTURE && (buttons & Qt::LeftButton)){
+    if(currentImage->imageType == METALLIC_TEXTURE && (buttons & Qt::LeftButton)){
         QMessageBox msgBox;
         msgBox.setText("Warning!");
         msgBox.setInformativeText("Sorry, but you cannot modify UV's mapping of metallic texture. Try Diffuse or height texture.");
@@ -2938,7 +3450,7 @@ void GLImage::relativeMouseMoveEvent(int dx, int dy, bool* wrapMouse, Qt::MouseB
         return;
     }
 
-    if(activeImage->imageType == ROUGHNESS_TEXTURE && (buttons & Qt::LeftButton)){
+    if(currentImage->imageType == ROUGHNESS_TEXTURE && (buttons & Qt::LeftButton)){
         QMessageBox msgBox;
         msgBox.setText("Warning!");
         msgBox.setInformativeText("Sorry, but you cannot modify UV's mapping of roughness texture. Try Diffuse or height texture.");
@@ -2946,7 +3458,7 @@ void GLImage::relativeMouseMoveEvent(int dx, int dy, bool* wrapMouse, Qt::MouseB
         msgBox.exec();
         return;
     }
-    if(activeImage->imageType == SPECULAR_TEXTURE && (buttons & Qt::LeftButton)){
+    if(currentImage->imageType == SPECULAR_TEXTURE && (buttons & Qt::LeftButton)){
         QMessageBox msgBox;
         msgBox.setText("Warning!");
         msgBox.setInformativeText("Sorry, but you cannot modify UV's mapping of specular texture. Try Diffuse or height texture.");
@@ -2973,7 +3485,7 @@ void GLImage::relativeMouseMoveEvent(int dx, int dy, bool* wrapMouse, Qt::MouseB
                 QVector2D dmouse = QVector2D(-dx*(float(orthographicProjWidth)/width()),dy*(float(orthographicProjHeight)/height()));
                 for(int i = 0; i < 4 ; i++){
                     averagePos += cornerPositions[i]*0.25;
-                    if(activeImage->imageType == GRUNGE_TEXTURE) grungeCornerPositions[i] += dmouse;
+                    if(currentImage->imageType == GRUNGE_TEXTURE) grungeCornerPositions[i] += dmouse;
                     else cornerPositions[i] += dmouse;
                 }
                 repaint();
@@ -2981,7 +3493,7 @@ void GLImage::relativeMouseMoveEvent(int dx, int dy, bool* wrapMouse, Qt::MouseB
         break;
         // grab corners in perspective correction tool
         case(UV_GRAB_CORNERS):
-            if(activeImage->imageType == GRUNGE_TEXTURE) break;
+            if(currentImage->imageType == GRUNGE_TEXTURE) break;
             if(draggingCorner == -1){
             setCursor(Qt::OpenHandCursor);
             for(int i = 0; i < 4 ; i++){
@@ -3007,7 +3519,7 @@ void GLImage::relativeMouseMoveEvent(int dx, int dy, bool* wrapMouse, Qt::MouseB
             }
         break;
         case(UV_SCALE_XY):
-            if(activeImage->imageType == GRUNGE_TEXTURE) break;
+            if(currentImage->imageType == GRUNGE_TEXTURE) break;
             setCursor(Qt::OpenHandCursor);
             if(buttons & Qt::LeftButton){ // drag image
                 setCursor(Qt::SizeAllCursor);
@@ -3054,7 +3566,8 @@ void GLImage::mousePressEvent(QMouseEvent *event)
     // In case of color picking: emit and stop picking
     if(bToggleColorPicking){
         vector< unsigned char > pixels( 1 * 1 * 4 );
-        glReadPixels(event->pos().x(), height()-event->pos().y(), 1, 1,GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+        makeCurrent();
+        GLCHK( gui->glReadPixels(event->pos().x(), height()-event->pos().y(), 1, 1,GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]) );
         QVector4D color(pixels[0],pixels[1],pixels[2],pixels[3]);
         qDebug() << "Picked pixel (" << event->pos().x() << " , " << height()-event->pos().y() << ") with color:" << color;
 
@@ -3091,10 +3604,3 @@ void GLImage::pickImageColor( QtnPropertyABColor* property) {
         setCursor(Qt::PointingHandCursor);
     repaint();
 }
-
-void GLImage::copyRenderToPaintFBO(){
-     GLCHK(FBOImages::resize(paintFBO,renderFBO->width(),renderFBO->height()));
-     GLCHK( program->setUniformValue("material_id", int(-1)) );
-     copyFBO(renderFBO,paintFBO);
-     bRendering      = false;
-}
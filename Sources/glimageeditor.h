@@ -42,6 +42,7 @@
 ****************************************************************************/
 
 #include <QWidget>
+#include <QElapsedTimer>
 #include <QtOpenGL>
 
 
@@ -50,6 +51,8 @@
 #include <map>
 #include "CommonObjects.h"
 #include "formmaterialindicesmanager.h"
+#include "renderthread.h"
+#include "utils/texturereadback.h"
 
 #ifdef USE_OPENGL_330
     #include <QOpenGLFunctions_3_3_Core>
@@ -59,16 +62,78 @@
     #define OPENGL_FUNCTIONS QOpenGLFunctions_4_1_Core
 #endif
 
-#define BasicProp activeImage->properties->Basic
-#define RemoveShadingProp activeImage->properties->RemoveShading
-#define ColorLevelsProp activeImage->properties->ColorLevels
-#define SurfaceDetailsProp activeImage->properties->SurfaceDetails
-#define AOProp activeImage->properties->AO
-#define GrungeProp targetImageGrunge->properties->Grunge
-#define GrungeOnImageProp activeImage->properties->GrungeOnImage
-#define NormalMixerProp activeImage->properties->NormalsMixer
-#define BaseMapToOthersProp activeImage->properties->BaseMapToOthers
-#define RMFilterProp activeImage->properties->RMFilter
+// Settings of the images in the frame being rendered (see RenderRequest)
+#define FrameImage(image) frame.images[(image)->imageType]
+#define ActiveParams FrameImage(activeImage).parameters
+#define GrungeParams frame.images[GRUNGE_TEXTURE].parameters
+
+// Columns of the per material parameters buffer used when all materials
+// are processed in one pass. Must match the defines in filters.frag
+enum MaterialParameter{
+    MATERIAL_PARAM_HUE = 0,
+    MATERIAL_PARAM_SMALL_DETAILS,
+    MATERIAL_PARAM_MEDIUM_DETAILS,
+    MATERIAL_PARAM_CONTRAST,
+    MATERIAL_PARAM_INVERT_R,
+    MATERIAL_PARAM_INVERT_G,
+    MATERIAL_PARAM_INVERT_B,
+    MATERIAL_PARAM_NORMALS_STEP,
+    MATERIAL_PARAM_HEIGHT_MIN,
+    MATERIAL_PARAM_HEIGHT_MAX,
+    MATERIAL_PARAM_HEIGHT_OFFSET,
+    MATERIAL_PARAM_ROUGHNESS_TRESHOLD,
+    MATERIAL_PARAM_ROUGHNESS_AMPLIFIER,
+    MATERIAL_PARAM_NORMALIZE_MIN,     // three components
+    MATERIAL_PARAM_NORMALIZE_MAX = MATERIAL_PARAM_NORMALIZE_MIN + 3,
+    MATERIAL_PARAMS_COUNT        = MATERIAL_PARAM_NORMALIZE_MAX + 3
+};
+
+/**
+ * @brief The RenderRequest struct is a copy of everything the render reads
+ * from the GUI. It is taken when the frame is requested, so the render thread
+ * never reads the property sets or the view state which the GUI changes.
+ */
+struct RenderRequest{
+    struct ImageState{
+        ImageParameters parameters;
+        SourceImageType inputImageType;
+        bool  bSkipProcessing;
+        float conversionHNDepth;
+        ImageState():parameters(),inputImageType(INPUT_NONE),bSkipProcessing(false),conversionHNDepth(2.0){}
+    };
+
+    FBOImageProporties* image; // image to render
+    ConversionType conversionType;
+    bool bShadowRender;
+    bool bSkipProcessing;
+    bool bColorPicking;
+    int  resizeWidth;
+    int  resizeHeight;
+
+    // perspective transformation
+    QVector2D cornerPositions[4];
+    QVector2D grungeCornerPositions[4];
+    QVector4D cornerWeights;
+    int perspectiveMode;
+
+    // seamless settings (static members of FBOImageProporties)
+    SeamlessMode seamlessMode;
+    float seamlessSimpleModeRadius;
+    int seamlessMirroModeType;
+    RandomTilingMode seamlessRandomTiling;
+    float seamlessContrastStrenght;
+    float seamlessContrastPower;
+    int seamlessSimpleModeDirection;
+    SourceImageType seamlessContrastInputType;
+    bool bSeamlessTranslationsFirst;
+
+    int  currentMaterialIndeks;
+    bool bConversionBaseMap;
+    bool bConversionBaseMapShowHeightTexture;
+
+    ImageState images[MAX_TEXTURES_TYPE];
+    QVector<ImageParameters> materialBatchParameters; // of the rendered image
+};
 
 //! [0]
 class GLImage : public GLWidgetBase , protected OPENGL_FUNCTIONS
@@ -83,12 +148,24 @@ public:
     QSize minimumSizeHint() const;
     QSize sizeHint() const;
     void setActiveImage(FBOImageProporties* ptr);
-    FBOImageProporties* getActiveImage(){return activeImage;}
+    FBOImageProporties* getActiveImage(){return currentImage;}
     void enableShadowRender(bool enable);
     void setConversionType(ConversionType conversionType);
     ConversionType getConversionType();
     void updateCornersPosition(QVector2D dc1,QVector2D dc2,QVector2D dc3,QVector2D dc4);
+    /**
+     * @brief renderImage queues the render of given image. It is shown when
+     * it is the active image, otherwise it is a shadow render. Newer request
+     * of the same image replaces the queued one.
+     */
+    void renderImage(FBOImageProporties* image);
     void render();
+    /**
+     * @brief packChannels renders image described by packing from the output
+     * maps and reads back only the packed result. Waits for the render thread.
+     * @return ARGB32 image or null image if one of the source maps is missing
+     */
+    QImage packChannels(const ChannelPacking& packing);
 
 
     FBOImageProporties* targetImageDiffuse;
@@ -112,11 +189,15 @@ public slots:
     void toggleColorPicking(bool toggle);
     void pickImageColor(QtnPropertyABColor *property);
 
-    void copyRenderToPaintFBO(); // when image is rendered copy it to paintFBO in order to display result
+    void framePublished(int tType, double msec, bool bDisplayed); // show the new frame
 signals:
     void rendered();
     void readyGL();
+    void renderFinished(int tType, double msec); // GPU finished the frame of tType, time since its submission
+    void imagePublished(int tType); // new output of tType can be used by other views
     void colorPicked(QVector4D color);
+    // emitted by the render thread when the image tType was published
+    void published(int tType, double msec, bool bDisplayed);
 //! [2]
 protected:
     void mousePressEvent(QMouseEvent *event);
@@ -156,6 +237,7 @@ public:
 
     void applyCPUNormalizationFilter(QGLFramebufferObject* inputFBO,
                                   QGLFramebufferObject* outputFBO);
+    bool updateNormalizationRange(bool bWait);
 
     void applyAddNoiseFilter(QGLFramebufferObject* inputFBO,
                              QGLFramebufferObject* outputFBO);
@@ -274,26 +356,57 @@ public:
     void updateProgramUniforms(int step);
 //! [3]
 private:
+    // Job keys of RenderThread::post, newer display request of the same
+    // image replaces the queued one.
+    static int displayJobKey(int tType){ return 1 + tType; }
+    RenderRequest makeRenderRequest(FBOImageProporties* image);
+    void processRequest(const RenderRequest& request); // render thread
+    void initializeRenderContext();
+    QOpenGLShaderProgram* createFilterProgram(QOpenGLShader* vshader, const QString& fragmentCode);
+    QImage renderPackChannels(const ChannelPacking& packing);
     void makeScreenQuad();
-
+    QGLFramebufferObject* beginSingleChannelStage(QGLFramebufferObject* activeFBO);
+    // material batch mode (see FBOImageProporties::materialBatchParameters)
+    bool isMaterialBatch();
+    void uploadMaterialParameters();
+    void updateMaterialParametersBuffer();
+    void setMaterialBatchUniforms();
+    FBOImageProporties* getTargetImage(TextureTypes type);
+
+    // GUI thread
+    FBOImageProporties* currentImage; // shown image
+    OPENGL_FUNCTIONS* gui;            // functions of the widget context
+    QOpenGLShaderProgram* displayProgram; // uniforms are shared, so the view has its own program
+    GLuint display_vao;               // VAOs are not shared between contexts
+    GLuint displaySubroutine;
+    RenderThread* renderThread;
+
+    // render thread
+    RenderRequest frame;
     QOpenGLShaderProgram *program;
     FBOImageProporties* activeImage;
     QGLFramebufferObject* averageColorFBO; // small FBO used for calculation of average color
     QGLFramebufferObject* samplerFBO1; // FBO with size 1024x1024
     QGLFramebufferObject* samplerFBO2; // FBO with size 1024x1024 used for different processing
-    // FBOs used in image processing
+    // FBOs used in image processing, they point to auxColorFBOs or auxGrayFBOs
+    // depending on the current stage of the pipeline (valid only in render)
     QGLFramebufferObject* auxFBO1;
     QGLFramebufferObject* auxFBO2;
     QGLFramebufferObject* auxFBO3;
     QGLFramebufferObject* auxFBO4;
+    QGLFramebufferObject* auxColorFBOs[4]; // full format intermediates
+    QGLFramebufferObject* auxGrayFBOs[2];  // single channel auxFBO1 and auxFBO2
+    QGLFramebufferObject* workFBO;  // single channel processing of 8 bit outputs
+    bool bSingleChannelStage;       // the rest of current render is done in single channel FBOs
 
     QGLFramebufferObject* auxFBO1BMLevels[3]; // 2 times smaller. 4 and 8
     QGLFramebufferObject* auxFBO2BMLevels[3]; //
     QGLFramebufferObject* auxFBO0BMLevels[3]; //
 
     //
-    QGLFramebufferObject* paintFBO;  // Used for painting texture
-    QGLFramebufferObject* renderFBO; // Used for rendering to it
+    QGLFramebufferObject* paintFBO;  // front buffer drawn by the view
+    QGLFramebufferObject* packFBO;   // output of channel packing, released after readback
+    QGLFramebufferObject* renderFBO; // back buffer, swapped with paintFBO when published
 
     std::map<std::string,GLuint> subroutines;
     std::map<std::string,QOpenGLShaderProgram*> filter_programs; // all filters in one array    
@@ -301,6 +414,9 @@ private:
     ConversionType conversionType;
 
     GLuint screen_vao;
+    GLuint materialParamsBuffer;  // per material settings, row for each material
+    GLuint materialParamsTexture; // texture buffer attached to unit 11
+    QVector<float> materialParams;
     bool bShadowRender;
     bool bSkipProcessing;   // draw quad but skip all the processing step (using during mouse interaction)
     float windowRatio;      // window width-height ratio
@@ -341,7 +457,17 @@ private:
     TextureTypes openGL330ForceTexType;
 
     // rendering variables
-    bool bRendering;//define if opengl is currently rendering some textures
+    QElapsedTimer renderTimer; // started when the frame is submitted
+
+    // Input of the CPU normalization is copied to pixel buffer, interactive
+    // renders use the range of the previous copy.
+    TextureReadback normalizationReadback;
+    // first three values are the range of the whole image, then three for
+    // each material in batch mode
+    QVector<float> normalizeMin;
+    QVector<float> normalizeMax;
+
+    void drawPaintFBO();
 };
 
 
@@ -60,6 +60,21 @@ GLWidget::GLWidget(QWidget *parent, QGLWidget * shareWidget)
     bToggleMetallicView     = true;
 
     m_env_map               = NULL;
+    m_prefiltered_env_map   = NULL;
+    m_specular_env_map      = NULL;
+    m_brdf_lut              = NULL;
+    skyBoxCache             = new SkyBoxCache();
+
+    meshLoader              = new MeshLoader(this);
+    pending_mesh            = NULL;
+    meshProgress            = NULL;
+    bCameraMoving           = false;
+    bSceneDirty             = true;
+    bPostDirty              = true;
+    bMaterialsShown         = false;
+    renderedShader          = NULL;
+    connect(meshLoader,SIGNAL(meshLoaded(Mesh*)),this,SLOT(meshLoaded(Mesh*)));
+    connect(meshLoader,SIGNAL(progressChanged(int)),this,SLOT(meshLoadingProgress(int)));
 
     setCursor(Qt::PointingHandCursor);
     lightCursor = QCursor(QPixmap(":/resources/cursors/lightCursor.png"));
@@ -70,6 +85,7 @@ GLWidget::GLWidget(QWidget *parent, QGLWidget * shareWidget)
     colorFBO = NULL;
     outputFBO= NULL;
     auxFBO   = NULL;
+    sceneFBO = NULL;
     for(int i = 0; i < 4; i++){
        glowInputColor[i]  = NULL;
        glowOutputColor[i] = NULL;
@@ -91,6 +107,8 @@ GLWidget::~GLWidget()
 
 void GLWidget::cleanup()
 {   
+    meshLoader->cancel();
+    closeMeshProgress();
     makeCurrent();
     deleteFBOs();
 
@@ -107,13 +125,16 @@ void GLWidget::cleanup()
     delete line_program;
     delete skybox_program;
     delete env_program;
+    delete env_specular_program;
 
     delete mesh;
+    delete pending_mesh;
+    pending_mesh = NULL;
     delete skybox_mesh;
     delete env_mesh;
     delete quad_mesh;
-    delete m_env_map;
-    delete m_prefiltered_env_map;
+    delete skyBoxCache;
+    delete m_brdf_lut;
 
     doneCurrent();
 }
@@ -139,6 +160,7 @@ void GLWidget::resetCameraPosition(){
     camera.reset();
     newCamera.reset();
     cameraInterpolation = 1.0;
+    bSceneDirty = true;
     emit changeCamPositionApplied(false);
     updateGL();
 }
@@ -146,36 +168,43 @@ void GLWidget::resetCameraPosition(){
 
 void GLWidget::toggleDiffuseView(bool enable){
     bToggleDiffuseView = enable;
+    bSceneDirty = true;
     updateGL();
 }
 
 void GLWidget::toggleSpecularView(bool enable){
     bToggleSpecularView = enable;
+    bSceneDirty = true;
     updateGL();
 }
 
 void GLWidget::toggleOcclusionView(bool enable){
     bToggleOcclusionView = enable;
+    bSceneDirty = true;
     updateGL();
 }
 
 void GLWidget::toggleNormalView(bool enable){
     bToggleNormalView = enable;
+    bSceneDirty = true;
     updateGL();
 }
 
 void GLWidget::toggleHeightView(bool enable){
     bToggleHeightView = enable;
+    bSceneDirty = true;
     updateGL();
 }
 
 void GLWidget::toggleRoughnessView(bool enable){
     bToggleRoughnessView = enable;
+    bSceneDirty = true;
     updateGL();
 
 }
 void GLWidget::toggleMetallicView(bool enable){
     bToggleMetallicView = enable;
+    bSceneDirty = true;
     updateGL();
 }
 
@@ -282,6 +311,8 @@ void GLWidget::initializeGL()
 
         currentShader->program->setUniformValue("texPrefilteredEnvMap", 8);
         currentShader->program->setUniformValue("texSourceEnvMap"     , 9);
+        currentShader->program->setUniformValue("texSpecularEnvMap"   , 10);
+        currentShader->program->setUniformValue("texBRDFLUT"          , 11);
 
         GLCHK(currentShader->program->release());
         Dialog3DGeneralSettings::updateParsedShaders();
@@ -327,6 +358,8 @@ void GLWidget::initializeGL()
 
     line_program->setUniformValue("texPrefilteredEnvMap", 8);
     line_program->setUniformValue("texSourceEnvMap"     , 9);
+    line_program->setUniformValue("texSpecularEnvMap"   , 10);
+    line_program->setUniformValue("texBRDFLUT"          , 11);
 
 
     if(vshader  != NULL) delete vshader;
@@ -388,6 +421,23 @@ void GLWidget::initializeGL()
     GLCHK(env_program->bind());
     env_program->setUniformValue("texEnv" , 0);
 
+    // GGX prefiltering uses the same geometry, only fragment shader differs
+    delete fshader;
+    qDebug() << "Loading specular enviromental shader (fragment shader)";
+    fshader = new QOpenGLShader(QOpenGLShader::Fragment, this);
+    fshader->compileSourceFile(":/resources/shaders/env_specular.frag");
+    if (!fshader->log().isEmpty()) qDebug() << fshader->log();
+    else qDebug() << "done";
+
+    env_specular_program = new QOpenGLShaderProgram(this);
+    env_specular_program->addShader(vshader);
+    env_specular_program->addShader(gshader);
+    env_specular_program->addShader(fshader);
+
+    GLCHK(env_specular_program->link());
+    GLCHK(env_specular_program->bind());
+    env_specular_program->setUniformValue("texEnv" , 0);
+
 
     if(vshader  != NULL) delete vshader;
     if(fshader  != NULL) delete fshader;
@@ -474,8 +524,7 @@ void GLWidget::initializeGL()
     skybox_mesh = new Mesh(QString(RESOURCE_BASE) + "Core/3D/","sky_cube.obj");
     env_mesh    = new Mesh(QString(RESOURCE_BASE) + "Core/3D/","sky_cube_env.obj");
     quad_mesh   = new Mesh(QString(RESOURCE_BASE) + "Core/3D/","quad.obj");
-
-    m_prefiltered_env_map = new GLTextureCube(512);
+    m_brdf_lut  = new GLTextureBRDF();
 
     resizeFBOs();
     emit readyGL();
@@ -497,7 +546,82 @@ void GLWidget::paintGL()
         double w = cameraInterpolation;
         camera.position = camera.position*(1-w) + newCamera.position * w;
         cameraInterpolation += 0.01;
+        bSceneDirty = true;
+    }
+
+    // material preview (M key) changes the shading and skips post processing
+    bool bShowMaterials = (keyPressed == KEY_SHOW_MATERIALS);
+    if(bShowMaterials != bMaterialsShown || currentShader != renderedShader){
+        bSceneDirty = true;
     }
+    // first frames are drawn several times, see GLWidgetBase::updateGL()
+    if(!eventLoopStarted) bSceneDirty = true;
+
+    if(bSceneDirty){
+        // the render thread must not swap the images while they are sampled
+        RenderThread::publishMutex.lock();
+        paintScene();
+        RenderThread::frontBuffersUsed();
+        RenderThread::publishMutex.unlock();
+        bMaterialsShown = bShowMaterials;
+        renderedShader  = currentShader;
+        // keep the scene, so only post processing can be done next time
+        if(!bShowMaterials) copyTexToFBO(colorFBO->fbo->texture(),sceneFBO->fbo);
+    }else if(bPostDirty && !bShowMaterials){
+        copyTexToFBO(sceneFBO->fbo->texture(),colorFBO->fbo);
+    }
+
+    colorFBO->bindDefault();
+
+    GLCHK( glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT) );
+
+    // do post processing if materials are not shown
+    if( !bShowMaterials ){
+
+        // otherwise outputFBO still contains the last processed frame
+        if(bSceneDirty || bPostDirty){
+
+            copyTexToFBO(colorFBO->fbo->texture(),outputFBO->fbo);
+
+            // -----------------------------------------------------------
+            // Post processing:
+            // 1. Bloom (can be disabled/enabled by gui)
+            // -----------------------------------------------------------
+            // enable of disable bloom effect
+            if(display3Dparameters.bBloomEffect){
+                 applyGlowFilter(outputFBO->fbo);
+            }// end of if bloom effect
+
+            // -----------------------------------------------------------
+            // Post processing:
+            // 2. DOF (can be disabled/enabled by gui)
+            // -----------------------------------------------------------
+            if(display3Dparameters.bDofEffect){
+                applyDofFilter(colorFBO->fbo->texture(),outputFBO->fbo);
+            }
+
+            // -----------------------------------------------------------
+            // Post processing:
+            // 3. Lens Flares (can be disabled/enabled by gui)
+            // -----------------------------------------------------------
+            if(display3Dparameters.bLensFlares){
+                applyLensFlaresFilter(colorFBO->fbo->texture(),outputFBO->fbo);
+            }
+            applyToneFilter(colorFBO->fbo->texture(),outputFBO->fbo);
+        }
+        applyNormalFilter(outputFBO->fbo->texture());
+
+    }else{ // end of if SHOW MATERIALS TEXTURE DISABLED
+        GLCHK( applyNormalFilter(colorFBO->fbo->texture()));
+    }
+    bSceneDirty = false;
+    bPostDirty  = false;
+    GLCHK( filter_program->release() );
+    emit renderGL();
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void GLWidget::paintScene(){
 
     // setting the camera viewpoint
     viewMatrix = camera.updateCamera();
@@ -613,6 +737,7 @@ void GLWidget::paintGL()
 
         // number of mipmaps
         GLCHK( program_ptr->setUniformValue("num_mipmaps"   , m_env_map->numMipmaps ) );
+        GLCHK( program_ptr->setUniformValue("num_specular_mipmaps", m_specular_env_map->numMipmaps ) );
         // 3D settings
         GLCHK( program_ptr->setUniformValue("gui_bUseCullFace"   , display3Dparameters.bUseCullFace) );
         GLCHK( program_ptr->setUniformValue("gui_bUseSimplePBR"  , display3Dparameters.bUseSimplePBR) );
@@ -644,10 +769,22 @@ void GLWidget::paintGL()
 
             int tindeks = 0;
 
+            // maps disabled in the 3D view are bound but not sampled, so they may stay in host memory
+            bool bShown[MATERIAL_TEXTURE+1] = {
+                bToggleDiffuseView && !FBOImageProporties::bConversionBaseMap,
+                bToggleNormalView, bToggleSpecularView, bToggleHeightView,
+                bToggleOcclusionView, bToggleRoughnessView, bToggleMetallicView, true };
+            QList<QGLFramebufferObject**> visibleFBOs;
             for(tindeks = 0 ; tindeks <= MATERIAL_TEXTURE ; tindeks++){ // skip grunge texture (not used in 3D view)
+                GLuint textureId = (*(fboIdPtrs[tindeks]))->texture();
+                if(bShown[tindeks]){
+                    visibleFBOs.append(fboIdPtrs[tindeks]);
+                    VRAMManager::use(textureId);
+                }
                 GLCHK( glActiveTexture(GL_TEXTURE0+tindeks) );
-                GLCHK( glBindTexture(GL_TEXTURE_2D, (*(fboIdPtrs[tindeks]))->texture()) );
+                GLCHK( glBindTexture(GL_TEXTURE_2D, textureId) );
             }
+            VRAMManager::setVisible("3D view",visibleFBOs);
 
             GLCHK( glActiveTexture(GL_TEXTURE0 + tindeks ) );
             GLCHK(m_prefiltered_env_map->bind());
@@ -655,7 +792,15 @@ void GLWidget::paintGL()
             tindeks++;
             GLCHK( glActiveTexture(GL_TEXTURE0 + tindeks) );
             GLCHK( m_env_map->bind());
-            GLCHK( mesh->drawMesh() );
+
+            tindeks++;
+            GLCHK( glActiveTexture(GL_TEXTURE0 + tindeks) );
+            GLCHK( m_specular_env_map->bind());
+
+            tindeks++;
+            GLCHK( glActiveTexture(GL_TEXTURE0 + tindeks) );
+            GLCHK( m_brdf_lut->bind());
+            GLCHK( mesh->drawMesh(false,selectMeshLod()) );
             // set default active texture
             glActiveTexture(GL_TEXTURE0);
         }
@@ -673,53 +818,12 @@ void GLWidget::paintGL()
     // set to which FBO result will be drawn
     GLuint attachments2[1] = { GL_COLOR_ATTACHMENT0 };
     glDrawBuffers(1,  attachments2);
-    colorFBO->bindDefault();
-
-    GLCHK( glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT) );
-
-    // do post processing if materials are not shown
-    if( keyPressed != KEY_SHOW_MATERIALS ){
-
-        copyTexToFBO(colorFBO->fbo->texture(),outputFBO->fbo);
-
-        // -----------------------------------------------------------
-        // Post processing:
-        // 1. Bloom (can be disabled/enabled by gui)
-        // -----------------------------------------------------------
-        // enable of disable bloom effect
-        if(display3Dparameters.bBloomEffect){
-             applyGlowFilter(outputFBO->fbo);
-        }// end of if bloom effect
-
-        // -----------------------------------------------------------
-        // Post processing:
-        // 2. DOF (can be disabled/enabled by gui)
-        // -----------------------------------------------------------
-        if(display3Dparameters.bDofEffect){
-            applyDofFilter(colorFBO->fbo->texture(),outputFBO->fbo);            
-        }
-
-        // -----------------------------------------------------------
-        // Post processing:
-        // 3. Lens Flares (can be disabled/enabled by gui)
-        // -----------------------------------------------------------
-        if(display3Dparameters.bLensFlares){
-            applyLensFlaresFilter(colorFBO->fbo->texture(),outputFBO->fbo);
-        }
-        applyToneFilter(colorFBO->fbo->texture(),outputFBO->fbo);
-        applyNormalFilter(outputFBO->fbo->texture());
-
-    }else{ // end of if SHOW MATERIALS TEXTURE DISABLED
-        GLCHK( applyNormalFilter(colorFBO->fbo->texture()));
-    }
-    GLCHK( filter_program->release() );
-    emit renderGL();
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void GLWidget::bakeEnviromentalMaps(){
-    if(bDiffuseMapBaked) return;
+    if(bDiffuseMapBaked || m_prefiltered_env_map == NULL) return;
     bDiffuseMapBaked = true;
+    bSceneDirty      = true;
     // ---------------------------------------------------------
     // Drawing env - one pass method
     // ---------------------------------------------------------
@@ -742,10 +846,45 @@ void GLWidget::bakeEnviromentalMaps(){
     GLCHK( glActiveTexture(GL_TEXTURE0) );
     GLCHK( m_env_map->bind());
     GLCHK( env_mesh->drawMesh(true) );
+    env_program->release();
+
+    // ---------------------------------------------------------
+    // GGX prefiltered env. map - one pass per roughness level
+    // ---------------------------------------------------------
+    env_specular_program->bind();
+    int levels = m_specular_env_map->numMipmaps + 1;
+    for(int level = 0 ; level < levels ; level++){
+        int size = qMax(1,SPECULAR_ENV_MAP_SIZE >> level);
+        m_specular_env_map->bindFBO(level);
+        glViewport(0, 0, size, size);
+        GLCHK( env_specular_program->setUniformValue("roughness", levels > 1 ? float(level)/(levels-1) : 0.0f) );
+        GLCHK( env_mesh->drawMesh(true) );
+    }
+    env_specular_program->release();
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glViewport(0, 0, width(), height()) ;
-    env_program->release();
+
+    // next time this skybox is loaded from the cache
+    skyBoxCache->store(skyBoxName);
+}
+
+int GLWidget::selectMeshLod(){
+    if(mesh->getNoLods() <= 1) return 0;
+    if(bCameraMoving || cameraInterpolation < 1.0) return mesh->getNoLods()-1;
+
+    // projected radius of the mesh bounding sphere in pixels
+    QVector3D centre = modelViewMatrix.map(mesh->centre_of_mass);
+    float radius     = qMax(modelViewMatrix.mapVector(QVector3D(mesh->radius,0,0)).length(),
+                            modelViewMatrix.mapVector(QVector3D(0,mesh->radius,0)).length());
+    float distance   = -centre.z();
+    if(distance <= radius) return 0; // camera inside the bounding sphere
+    float projected  = radius / (distance * qTan(qDegreesToRadians(zoom/2))) * height()/2;
+    float pixels     = qMin(float(M_PI)*projected*projected, float(width()*height()));
+    float budget     = pixels * MESH_LOD_TRIANGLES_PER_PIXEL;
+    // every patch is subdivided further by the tessellation shader
+    if(display3Dparameters.shadingType == SHADING_TESSELATION) budget /= qMax(1,display3Dparameters.noTessSubdivision);
+    return mesh->selectLod(int(qMin(budget,1.0E9f)));
 }
 
 void GLWidget::resizeGL(int width, int height)
@@ -754,6 +893,7 @@ void GLWidget::resizeGL(int width, int height)
     ratio = float(width)/height;
     deleteFBOs();
     resizeFBOs();
+    bSceneDirty = true;
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     // SHITFIX => bake enviromental maps again, this will slow down GUI when
     // resizing windows, but helps to prevent some bug in rendering
@@ -766,6 +906,11 @@ void GLWidget::mousePressEvent(QMouseEvent *event)
 {
     GLWidgetBase::mousePressEvent(event);
 
+    // rotation and panning are drawn with the coarsest level of detail
+    bCameraMoving = (event->buttons() & (Qt::LeftButton | Qt::RightButton)) &&
+                    keyPressed != Qt::Key_Shift && keyPressed != KEY_SHOW_MATERIALS;
+    if(bCameraMoving && mesh->getNoLods() > 1) bSceneDirty = true;
+
     setCursor(Qt::ClosedHandCursor);
     if (event->buttons() & Qt::RightButton) {
         setCursor(Qt::SizeAllCursor);
@@ -822,6 +967,11 @@ void GLWidget::mousePressEvent(QMouseEvent *event)
 void GLWidget::mouseReleaseEvent(QMouseEvent *event){
     setCursor(Qt::PointingHandCursor);
     event->accept();
+    if(bCameraMoving){
+        bCameraMoving = false;
+        if(mesh->getNoLods() > 1) bSceneDirty = true;
+        updateGL(); // full detail again
+    }
 }
 
 
@@ -860,8 +1010,10 @@ void GLWidget::relativeMouseMoveEvent(int dx, int dy, bool* wrapMouse, Qt::Mouse
 
     }else if (buttons & Qt::LeftButton) {
         camera.rotateView(dx/1.0,dy/1.0);
+        bSceneDirty = true;
     } else if (buttons & Qt::RightButton) {
         camera.position +=QVector3D(dx/500.0,dy/500.0,0)*camera.radius;
+        bSceneDirty = true;
     } else if (buttons & Qt::MiddleButton) {
 
         lightPosition += QVector4D(0.05*dx,-0.05*dy,-0,0);
@@ -870,6 +1022,7 @@ void GLWidget::relativeMouseMoveEvent(int dx, int dy, bool* wrapMouse, Qt::Mouse
         if(lightPosition.y() > +10.0) lightPosition.setY(+10.0);
         if(lightPosition.y() < -10.0) lightPosition.setY(-10.0);
         lightDirection.rotateView(-2*dx/1.0,2*dy/1.0);
+        bSceneDirty = true;
     }else{
         *wrapMouse = false;
     }
@@ -879,6 +1032,7 @@ void GLWidget::relativeMouseMoveEvent(int dx, int dy, bool* wrapMouse, Qt::Mouse
 void GLWidget::wheelEvent(QWheelEvent *event){
     int numDegrees = -event->delta();
     camera.mouseWheelMove((numDegrees));
+    bSceneDirty = true;
 
     updateGL();
 }
@@ -936,6 +1090,7 @@ void GLWidget::setPointerToTexture(QGLFramebufferObject **pointer, TextureTypes
         default:
             break;
     }
+    bSceneDirty = true;
 }
 
 QPointF GLWidget::pixelPosToViewPos(const QPointF& p)
@@ -963,27 +1118,29 @@ void GLWidget::loadMeshFromFile()
 
 bool GLWidget::loadMeshFile(const QString &fileName, bool bAddExtension)
 {
+    // previous request and its upload are dropped
+    cancelMeshLoading();
 
-    // loading new mesh
-    Mesh* new_mesh;
+    // loading new mesh in background, current mesh is drawn until the new one is uploaded
+    pending_mesh_file = fileName;
     if(bAddExtension){
-      new_mesh = new Mesh(QString(RESOURCE_BASE) + "Core/3D/",fileName+QString(".obj"));
+        meshLoader->load(QString(RESOURCE_BASE) + "Core/3D/",fileName+QString(".obj"));
     }else{
-        new_mesh = new Mesh(QString(""),fileName);
+        meshLoader->load(QString(""),fileName);
     }
 
-    if(new_mesh->isLoaded()){
-         if(mesh != NULL) delete mesh;
-         mesh = new_mesh;
-         recentMeshDir->setPath(fileName);
-         if( new_mesh->getMeshLog() != QString("")  ){
-             QMessageBox msgBox;
-             msgBox.setText("Warning! There were some problems during model loading.");
-             msgBox.setInformativeText("Loader message:\n"+new_mesh->getMeshLog());
-             msgBox.setStandardButtons(QMessageBox::Cancel);
-             msgBox.exec();
-         }
-    }else{
+    meshProgress = new QProgressDialog(tr("Loading mesh: ") + QFileInfo(fileName).fileName(),tr("Cancel"),0,1000,this);
+    meshProgress->setWindowModality(Qt::NonModal);
+    meshProgress->setMinimumDuration(500);
+    meshProgress->setAutoClose(false);
+    meshProgress->setAutoReset(false);
+    connect(meshProgress,SIGNAL(canceled()),this,SLOT(cancelMeshLoading()));
+    return true;
+}
+
+void GLWidget::meshLoaded(Mesh* new_mesh){
+    if(!new_mesh->isProcessed()){
+        closeMeshProgress();
         QMessageBox msgBox;
         msgBox.setText("Error! Cannot load given model.");
         msgBox.setInformativeText("Sorry, but the loaded mesh is incorrect.\nLoader message:\n"+new_mesh->getMeshLog());
@@ -991,10 +1148,60 @@ bool GLWidget::loadMeshFile(const QString &fileName, bool bAddExtension)
         msgBox.setStandardButtons(QMessageBox::Cancel);
         msgBox.exec();
         delete new_mesh;
+        return;
+    }
+    pending_mesh = new_mesh;
+    uploadPendingMesh();
+}
+
+void GLWidget::uploadPendingMesh(){
+    if(pending_mesh == NULL) return; // cancelled
+
+    makeCurrent();
+    if(!pending_mesh->upload(MESH_UPLOAD_CHUNK_SIZE)){
+        // last 10% of the progress is the upload
+        if(meshProgress != NULL) meshProgress->setValue(900 + int(100*pending_mesh->uploadProgress()));
+        QTimer::singleShot(0,this,SLOT(uploadPendingMesh())); // next part after pending events
+        return;
     }
 
+    Mesh* new_mesh = pending_mesh;
+    pending_mesh   = NULL;
+    if(mesh != NULL) delete mesh;
+    mesh = new_mesh;
+    recentMeshDir->setPath(pending_mesh_file);
+    closeMeshProgress();
+    bSceneDirty = true;
     updateGL();
-    return true;
+
+    if( new_mesh->getMeshLog() != QString("")  ){
+        QMessageBox msgBox;
+        msgBox.setText("Warning! There were some problems during model loading.");
+        msgBox.setInformativeText("Loader message:\n"+new_mesh->getMeshLog());
+        msgBox.setStandardButtons(QMessageBox::Cancel);
+        msgBox.exec();
+    }
+}
+
+void GLWidget::cancelMeshLoading(){
+    meshLoader->cancel();
+    if(pending_mesh != NULL){
+        makeCurrent();
+        delete pending_mesh;
+        pending_mesh = NULL;
+    }
+    closeMeshProgress();
+}
+
+void GLWidget::meshLoadingProgress(int permille){
+    if(meshProgress != NULL) meshProgress->setValue(permille*9/10);
+}
+
+void GLWidget::closeMeshProgress(){
+    if(meshProgress == NULL) return;
+    meshProgress->disconnect(this);
+    meshProgress->deleteLater();
+    meshProgress = NULL;
 }
 
 void GLWidget::chooseMeshFile(const QString &fileName){
@@ -1013,10 +1220,15 @@ void GLWidget::chooseSkyBox(QString cubeMapName,bool bFirstTime){
          << QString(RESOURCE_BASE) + "Core/2D/skyboxes/" + cubeMapName + "/negz.jpg";
 
     qDebug() << "Reading new cube map:" << list;
-    bDiffuseMapBaked = false;
 
-    if(m_env_map != NULL) delete m_env_map;
-    m_env_map     = new GLTextureCube(list);
+    SkyBoxCache::Entry skyBox = skyBoxCache->get(cubeMapName,list,512,
+                                                 SPECULAR_ENV_MAP_SIZE,SPECULAR_ENV_MAP_LEVELS);
+    m_env_map             = skyBox.envMap;
+    m_prefiltered_env_map = skyBox.prefilteredEnvMap;
+    m_specular_env_map    = skyBox.specularEnvMap;
+    bDiffuseMapBaked      = skyBox.bBaked;
+    skyBoxName            = cubeMapName;
+    bSceneDirty           = true;
 
     if(m_env_map->failed()){
         qWarning() << "Cannot load cube map: check if images listed above exist.";
@@ -1028,6 +1240,9 @@ void GLWidget::chooseSkyBox(QString cubeMapName,bool bFirstTime){
 
 void GLWidget::updatePerformanceSettings(Display3DSettings settings){
 
+    // bloom, DOF and lens flares are applied to the last scene again
+    if(display3Dparameters.sceneChanged(settings)) bSceneDirty = true;
+    if(display3Dparameters.postProcessingChanged(settings)) bPostDirty = true;
     display3Dparameters = settings;
     updateGL();
 }
@@ -1124,13 +1339,28 @@ void GLWidget::recompileRenderShader(){
 
     currentShader->program->setUniformValue("texPrefilteredEnvMap", 8);
     currentShader->program->setUniformValue("texSourceEnvMap"     , 9);
+    currentShader->program->setUniformValue("texSpecularEnvMap"   , 10);
+    currentShader->program->setUniformValue("texBRDFLUT"          , 11);
 
     GLCHK(currentShader->program->release());
     Dialog3DGeneralSettings::updateParsedShaders();
+    bSceneDirty = true;
     updateGL();
 
 }
 
+void GLWidget::texturesChanged(){
+    bSceneDirty = true;
+    updateGL();
+}
+
+void GLWidget::settings3DChanged(){
+    // custom shader parameters are copied to the shader when the scene is drawn
+    if(Dialog3DGeneralSettings::uniformsChanged()) bSceneDirty = true;
+    bPostDirty = true;
+    updateGL();
+}
+
 // ------------------------------------------------------------------------------- //
 //                          POST PROCESSING TOOLS
 // ------------------------------------------------------------------------------- //
@@ -1147,6 +1377,9 @@ void GLWidget::resizeFBOs(){
 
     if(auxFBO != NULL) delete auxFBO;
     auxFBO = new GLFrameBufferObject(width(),height());
+
+    if(sceneFBO != NULL) delete sceneFBO;
+    sceneFBO = new GLFrameBufferObject(width(),height());
     // initializing/resizing glow FBOS
     for(int i = 0; i < 4 ; i++){
 
@@ -1167,10 +1400,12 @@ void GLWidget::deleteFBOs(){
     delete colorFBO;
     delete outputFBO;
     delete auxFBO;
+    delete sceneFBO;
     // reset pointers
     colorFBO = NULL;
     outputFBO = NULL;
     auxFBO = NULL;
+    sceneFBO = NULL;
     for(int i = 0; i < 4 ; i++){
         if(glowInputColor[i]  != NULL){
             delete glowInputColor[i];
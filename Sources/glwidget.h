@@ -44,11 +44,14 @@
 #include <QGLWidget>
 #include <QtOpenGL>
 #include <qmath.h>
+#include <QProgressDialog>
 
 #include "CommonObjects.h"
 #include "camera.h"
 #include "utils/Mesh.hpp"
 #include "utils/qglbuffers.h"
+#include "skyboxcache.h"
+#include "meshloader.h"
 #include "glwidgetbase.h"
 #include "glimageeditor.h"
 #include "properties/Dialog3DGeneralSettings.h"
@@ -58,6 +61,15 @@
 #define currentShader   Dialog3DGeneralSettings::currentRenderShader
 #define glslShadersList Dialog3DGeneralSettings::glslParsedShaders
 
+// GGX prefiltered env. map: roughness 0..1 is mapped to mipmap levels 0..LEVELS-1
+#define SPECULAR_ENV_MAP_SIZE   256
+#define SPECULAR_ENV_MAP_LEVELS 6
+// loaded meshes are sent to the GPU in parts of this size, one part per event loop pass
+#define MESH_UPLOAD_CHUNK_SIZE  (16 << 20)
+// level of detail is chosen to draw about this many triangles per covered pixel
+// (about half of the triangles face the camera)
+#define MESH_LOD_TRIANGLES_PER_PIXEL 2
+
 
 #ifdef USE_OPENGL_330
     #include <QOpenGLFunctions_3_3_Core>
@@ -105,6 +117,15 @@ public slots:
     void chooseSkyBox(QString cubeMapName, bool bFirstTime = false);
     void updatePerformanceSettings(Display3DSettings settings);
     void recompileRenderShader(); // read and compile custom fragment shader again, can be called from 3D settings GUI.
+    void texturesChanged();       // maps were processed again, the scene has to be redrawn
+    void settings3DChanged();     // post processing or custom shader parameters were changed in 3D settings GUI
+
+private slots:
+    // background mesh loading
+    void meshLoaded(Mesh* new_mesh);
+    void uploadPendingMesh();
+    void cancelMeshLoading();
+    void meshLoadingProgress(int permille);
 
 signals:
     void renderGL();
@@ -133,11 +154,15 @@ private:
                       QMatrix4x4 &modelview, QMatrix4x4 &projection,
                       QVector4D& objectCoordinate);
 
-    void bakeEnviromentalMaps(); // calculate prefiltered enviromental map
+    void bakeEnviromentalMaps(); // calculate prefiltered enviromental maps
+    void closeMeshProgress();
+    int  selectMeshLod(); // level of detail of the mesh for the current view
+    void paintScene();    // draw skybox and mesh to colorFBO
 
     QOpenGLShaderProgram *line_program; // same as "program" but instead of triangles lines are used
     QOpenGLShaderProgram *skybox_program;
     QOpenGLShaderProgram *env_program;
+    QOpenGLShaderProgram *env_specular_program;
 
     QGLFramebufferObject**  fboIdPtrs[8];
 
@@ -175,10 +200,27 @@ private:
     Mesh* mesh; // displayed 3d mesh
     Mesh* skybox_mesh; // sky box cube
     Mesh* env_mesh;                       // one trinagle used for calculation of prefiltered env. map
+    MeshLoader* meshLoader;               // reads new meshes in background
+    Mesh* pending_mesh;                   // loaded mesh which is being uploaded, "mesh" is drawn meanwhile
+    QString pending_mesh_file;
+    QProgressDialog* meshProgress;        // exists only while a mesh is loading
+    bool bCameraMoving;                   // camera is dragged, the coarsest level of detail is drawn
+
+    // The last frame is reused when nothing changed: the scene is drawn only when
+    // camera, light, mesh, textures or shading settings changed, the post processing
+    // only when the scene or the post processing settings changed.
+    bool bSceneDirty;
+    bool bPostDirty;
+    bool bMaterialsShown;                 // material preview was drawn in the last frame
+    GLSLShaderParser* renderedShader;     // custom shader used in the last frame
 
     GLTextureCube* m_env_map;             // orginal cube map
     GLTextureCube* m_prefiltered_env_map; // filtered lambertian cube map
+    GLTextureCube* m_specular_env_map;    // GGX filtered cube map, one mipmap per roughness
+    GLTextureBRDF* m_brdf_lut;            // split-sum BRDF integral, same for all skyboxes
     bool bDiffuseMapBaked;                // prevent program from calculating diffuse env. map many times
+    SkyBoxCache* skyBoxCache;             // owns the cube maps above
+    QString skyBoxName;
 
     GLImage* glImagePtr;
 
@@ -189,6 +231,7 @@ private:
     GLFrameBufferObject* colorFBO;
     GLFrameBufferObject* outputFBO;
     GLFrameBufferObject* auxFBO;
+    GLFrameBufferObject* sceneFBO;        // copy of the last scene, post processing filters overwrite colorFBO
     // glow FBOs
     GLFrameBufferObject* glowInputColor[4];
     GLFrameBufferObject* glowOutputColor[4];
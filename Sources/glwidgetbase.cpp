@@ -8,10 +8,10 @@ GLWidgetBase::GLWidgetBase(const QGLFormat& format, QWidget *parent, QGLWidget *
     : QGLWidget(format, parent, shareWidget),
       updateIsQueued(false),
       mouseUpdateIsQueued(false),
-      eventLoopStarted(false),
       dx(0),
       dy(0),
       buttons(0),
+      eventLoopStarted(false),
       keyPressed((Qt::Key)0)
 {
     connect(this, &GLWidgetBase::updateGLLater, this, &GLWidgetBase::updateGLNow, Qt::QueuedConnection);
@@ -48,12 +48,12 @@ private:
     bool updateIsQueued;
     bool mouseUpdateIsQueued;
     bool blockMouseMovement;
-    bool eventLoopStarted;
 
     int dx, dy;
     Qt::MouseButtons buttons;
 
 protected:
+    bool eventLoopStarted; // first mouse event was handled, see updateGL()
     Qt::Key keyPressed;
     QCursor centerCamCursor;
 };
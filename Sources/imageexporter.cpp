@@ -0,0 +1,85 @@
+#include "imageexporter.h"
+#include "ddsimage.h"
+#include "utils/parallel.h"
+#include <QImageWriter>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QDebug>
+
+ExportPreset ImageExporter::preset = EXPORT_PRESET_BALANCED;
+
+bool ImageExporter::save(const QImage& image, const QString& fileName, TextureTypes imageType){
+    QString suffix = QFileInfo(fileName).suffix().toLower();
+    if(suffix == "tga"){
+        TargaImage tgaImage;
+        return tgaImage.write(image,fileName,preset != EXPORT_PRESET_FAST);
+    }
+    if(suffix == "dds"){
+        DDSImage ddsImage;
+        return ddsImage.write(image,fileName,DDSImage::formatForTexture(imageType,image));
+    }
+
+    QImageWriter writer(fileName);
+    if(suffix == "png"){
+        // Qt maps quality [0,100] to zlib level [9,0]
+        switch(preset){
+            case(EXPORT_PRESET_FAST):     writer.setQuality(89); break; // level 1
+            case(EXPORT_PRESET_BALANCED): break;                        // libpng default
+            case(EXPORT_PRESET_MAX):      writer.setQuality(0);  break; // level 9
+        }
+    }else if(suffix == "tif" || suffix == "tiff"){
+        // 0 - no compression, 1 - LZW
+        writer.setCompression(preset == EXPORT_PRESET_FAST ? 0 : 1);
+    }
+
+    if(!writer.write(image)){
+        qWarning() << "Cannot save image to file:" << fileName << writer.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool ImageExporter::save(const QList<QImage>& images, const QStringList& fileNames,
+                         const QList<TextureTypes>& imageTypes){
+    int noImages = qMin(qMin(images.size(),fileNames.size()),imageTypes.size());
+    QVector<int> results(noImages,0);
+
+    QElapsedTimer timer;
+    timer.start();
+    parallelFor(noImages,[&](int begin,int end,int){
+        for(int i = begin ; i < end ; i++){
+            results[i] = save(images[i],fileNames[i],imageTypes[i]);
+        }
+    });
+    qDebug() << "ImageExporter:: saved" << noImages << "images in"
+             << timer.elapsed() << "[ms] preset:" << getPresetName();
+
+    return !results.contains(0);
+}
+
+void ImageExporter::setPreset(ExportPreset _preset){
+    preset = _preset;
+}
+
+ExportPreset ImageExporter::getPreset(){
+    return preset;
+}
+
+bool ImageExporter::setPreset(const QString& name){
+    if(name == "fast")          preset = EXPORT_PRESET_FAST;
+    else if(name == "balanced") preset = EXPORT_PRESET_BALANCED;
+    else if(name == "max")      preset = EXPORT_PRESET_MAX;
+    else{
+        qWarning() << "ImageExporter:: unknown export preset" << name;
+        return false;
+    }
+    return true;
+}
+
+QString ImageExporter::getPresetName(){
+    switch(preset){
+        case(EXPORT_PRESET_FAST): return "fast";
+        case(EXPORT_PRESET_MAX):  return "max";
+        default:                  return "balanced";
+    }
+}
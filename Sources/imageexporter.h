@@ -0,0 +1,40 @@
+#ifndef IMAGEEXPORTER_H
+#define IMAGEEXPORTER_H
+
+#include <QImage>
+#include <QList>
+#include <QStringList>
+#include "CommonObjects.h"
+
+enum ExportPreset{
+    EXPORT_PRESET_FAST = 0, // fastest encoding for iterations
+    EXPORT_PRESET_BALANCED,
+    EXPORT_PRESET_MAX       // smallest files for final export
+};
+
+/**
+ * @brief The ImageExporter class writes the output maps. The format is chosen
+ * by the file suffix and the encoder settings (PNG zlib level, TIFF
+ * compression, TGA RLE) by the current export preset. DDS files are block
+ * compressed with the format chosen by the texture type. Several maps are
+ * encoded in parallel, one map per thread.
+ */
+class ImageExporter
+{
+public:
+    static bool save(const QImage& image, const QString& fileName, TextureTypes imageType);
+    // Saves images[i] to fileNames[i] in parallel. Returns false if any image failed.
+    static bool save(const QList<QImage>& images, const QStringList& fileNames,
+                     const QList<TextureTypes>& imageTypes);
+
+    static void         setPreset(ExportPreset preset);
+    static ExportPreset getPreset();
+    // Preset names used in the command line: fast, balanced, max.
+    static bool    setPreset(const QString& name);
+    static QString getPresetName();
+
+private:
+    static ExportPreset preset;
+};
+
+#endif // IMAGEEXPORTER_H
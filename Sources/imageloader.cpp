@@ -0,0 +1,138 @@
+#include "imageloader.h"
+#include "CommonObjects.h"
+#include <QImageReader>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QThread>
+#include <QDebug>
+
+int ImageLoader::previewSize      = 1024;
+int ImageLoader::previewThreshold = 2048;
+
+class ImageLoader::Task : public QRunnable
+{
+public:
+    Task(ImageLoader* loader, int request, const QString& fileName, bool bPreview):
+        loader(loader),request(request),fileName(fileName),bPreview(bPreview){}
+
+    void run(){
+        bool bPreviewSent = false;
+        if(bPreview && isCurrent()){
+            QImage preview = ImageLoader::readPreview(fileName);
+            bPreviewSent = !preview.isNull();
+            if(bPreviewSent) send(STAGE_PREVIEW,preview);
+        }
+        if(!isCurrent()) return; // cancelled, skip the full decode
+
+        QImage image = ImageLoader::read(fileName);
+        // Other formats (e.g. PNG) cannot be decoded at lower resolution, but
+        // a large image is still sent scaled first: the GUI shows and processes
+        // the small image much faster than the full one which follows.
+        if(bPreview && !bPreviewSent && !image.isNull() && isCurrent()
+           && qMax(image.width(),image.height()) > previewThreshold){
+            send(STAGE_PREVIEW,image.scaled(previewSize,previewSize,Qt::KeepAspectRatio,Qt::FastTransformation));
+        }
+        send(image.isNull() ? STAGE_FAILED : STAGE_FULL,image);
+    }
+
+private:
+    bool isCurrent(){
+        return loader->currentRequest.load() == request;
+    }
+    void send(int stage, const QImage& image){
+        QMetaObject::invokeMethod(loader,"deliver",Qt::QueuedConnection,
+                                  Q_ARG(int,request),Q_ARG(int,stage),
+                                  Q_ARG(QString,fileName),Q_ARG(QImage,image));
+    }
+
+    ImageLoader* loader;
+    int     request;
+    QString fileName;
+    bool    bPreview;
+};
+
+ImageLoader::ImageLoader(QObject *parent) :
+    QObject(parent),
+    currentRequest(0),
+    bLoading(false)
+{
+    // cancelled decodes cannot be interrupted, new requests must not wait for them
+    pool.setMaxThreadCount(qMax(2,QThread::idealThreadCount()));
+}
+
+ImageLoader::~ImageLoader(){
+    cancel();
+    pool.waitForDone();
+}
+
+QImage ImageLoader::read(const QString& fileName){
+    QFileInfo fileInfo(fileName);
+    if(fileInfo.completeSuffix().compare("tga") == 0){
+        TargaImage tgaImage;
+        return tgaImage.read(fileName);
+    }
+    QImageReader reader(fileName);
+    return reader.read();
+}
+
+bool ImageLoader::canRead(const QString& fileName){
+    QFileInfo fileInfo(fileName);
+    if(!fileInfo.isFile() || !fileInfo.isReadable()) return false;
+    if(fileInfo.completeSuffix().compare("tga") == 0){
+        int width, height;
+        TargaImage tgaImage;
+        return tgaImage.readSize(fileName,width,height);
+    }
+    QImageReader reader(fileName);
+    return reader.canRead();
+}
+
+QImage ImageLoader::readPreview(const QString& fileName){
+    if(QFileInfo(fileName).completeSuffix().compare("tga") == 0) return QImage();
+
+    QImageReader reader(fileName);
+    // Only the JPEG decoder reduces the resolution while decoding (DCT scaling).
+    // Other handlers, e.g. PNG, report ScaledSize but decode the full image and
+    // scale it afterwards, so the preview would be as slow as the full image.
+    QByteArray format = reader.format().toLower();
+    if(format != "jpeg" && format != "jpg") return QImage();
+    QSize size = reader.size();
+    if(!size.isValid() || qMax(size.width(),size.height()) <= previewSize) return QImage();
+
+    reader.setScaledSize(size.scaled(previewSize,previewSize,Qt::KeepAspectRatio));
+    return reader.read();
+}
+
+void ImageLoader::load(const QString& fileName, bool bPreview){
+    int request = currentRequest.fetchAndAddOrdered(1) + 1;
+    bLoading    = true;
+    qDebug() << "ImageLoader:: loading" << fileName << "in background";
+    pool.start(new Task(this,request,fileName,bPreview));
+}
+
+void ImageLoader::cancel(){
+    currentRequest.fetchAndAddOrdered(1);
+    bLoading = false;
+}
+
+bool ImageLoader::isLoading() const{
+    return bLoading;
+}
+
+void ImageLoader::deliver(int request, int stage, const QString& fileName, const QImage& image){
+    if(request != currentRequest.load()) return; // result of cancelled request
+
+    switch(stage){
+        case(STAGE_PREVIEW):
+            emit previewLoaded(fileName,image);
+            break;
+        case(STAGE_FULL):
+            bLoading = false;
+            emit imageLoaded(fileName,image);
+            break;
+        default:
+            bLoading = false;
+            emit loadFailed(fileName);
+            break;
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef IMAGELOADER_H
+#define IMAGELOADER_H
+
+#include <QObject>
+#include <QImage>
+#include <QThreadPool>
+#include <QAtomicInt>
+
+/**
+ * @brief The ImageLoader class decodes image files in a worker thread so the
+ * GUI is not blocked by large files. For JPEG files, which can be decoded
+ * directly at reduced resolution, a preview is delivered first and the full
+ * resolution image follows. Other formats are decoded once; images larger
+ * than previewThreshold are delivered scaled down first, right before the
+ * full resolution image.
+ * Each new request cancels the previous one: its results are dropped and
+ * decoding stops at the next stage.
+ */
+class ImageLoader : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ImageLoader(QObject *parent = 0);
+    ~ImageLoader();
+
+    // Decodes image in the calling thread. TGA files are read by TargaImage.
+    static QImage read(const QString& fileName);
+    // Fast check (file header only) if the file can be decoded.
+    static bool canRead(const QString& fileName);
+
+    /**
+     * @brief load starts decoding of the file in background.
+     * @param bPreview if false only the full resolution image is delivered
+     */
+    void load(const QString& fileName, bool bPreview = true);
+    void cancel();
+    bool isLoading() const;
+
+    static int previewSize;      // maximal width or height of the preview image
+    static int previewThreshold; // decoded images bigger than that are sent scaled first
+
+signals:
+    void previewLoaded(const QString& fileName, const QImage& image);
+    void imageLoaded(const QString& fileName, const QImage& image);
+    void loadFailed(const QString& fileName);
+
+private slots:
+    void deliver(int request, int stage, const QString& fileName, const QImage& image);
+
+private:
+    enum Stage{
+        STAGE_PREVIEW = 0,
+        STAGE_FULL,
+        STAGE_FAILED
+    };
+    class Task;
+    static QImage readPreview(const QString& fileName);
+
+    QThreadPool pool;
+    QAtomicInt  currentRequest; // requests with different ID are cancelled
+    bool        bLoading;
+};
+
+#endif // IMAGELOADER_H
@@ -44,6 +44,7 @@
 #include <QGLFormat>
 #include <QSurfaceFormat>
 #include <QtDebug>
+#include <QCommandLineParser>
 
 #include "mainwindow.h"
 #include "glimageeditor.h"
@@ -214,7 +215,18 @@ int main(int argc, char *argv[])
 {
     QApplication app(argc, argv);
 
-
+    QCommandLineParser parser;
+    QCommandLineOption helpOption = parser.addHelpOption();
+    QCommandLineOption exportPresetOption("export-preset",
+                                          "Encoder settings of saved images: fast, balanced or max.",
+                                          "preset");
+    parser.addOption(exportPresetOption);
+    // process() would exit on unknown options, e.g. -psn_* added by macOS
+    // Finder, so they are only reported
+    if(!parser.parse(app.arguments())){
+        qWarning() << "Ignoring command line arguments:" << parser.errorText();
+    }
+    if(parser.isSet(helpOption)) parser.showHelp();
 
     regABSliderDelegates();
     regABColorDelegates();
@@ -312,6 +324,9 @@ int main(int argc, char *argv[])
         QObject::connect(&window,SIGNAL(initProgress(int)),&sp,SLOT(setProgress(int)));
         QObject::connect(&window,SIGNAL(initMessage(const QString&)),&sp,SLOT(setMessage(const QString&)));
         window.initializeApp();
+        // command line overrides the settings from config file
+        if(parser.isSet(exportPresetOption))
+            window.setExportPreset(parser.value(exportPresetOption));
         window.setWindowTitle(AWESOME_BUMP_VERSION);
         window.resize(window.sizeHint());
         int desktopArea = QApplication::desktop()->width() *
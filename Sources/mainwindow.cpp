@@ -11,6 +11,9 @@
 #include "dockwidget3dsettings.h"
 
 #include "gpuinfo.h"
+#include "renderscheduler.h"
+#include "imageexporter.h"
+#include <QSignalMapper>
 #include <Property.h>
 #include <PropertySet.h>
 #include "properties/Dialog3DGeneralSettings.h"
@@ -36,10 +39,15 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->setupUi(this);
 
     statusLabel = new QLabel("GPU memory status: n/a");
+    renderStatusLabel = new QLabel("Render: n/a");
 #ifdef Q_OS_MAC
     if(!statusLabel->testAttribute(Qt::WA_MacNormalSize)) statusLabel->setAttribute(Qt::WA_MacSmallSize);
+    if(!renderStatusLabel->testAttribute(Qt::WA_MacNormalSize)) renderStatusLabel->setAttribute(Qt::WA_MacSmallSize);
 #endif
 
+    renderScheduler    = new RenderScheduler(this);
+    imageChangedMapper = new QSignalMapper(this);
+
     glImage          = new GLImage(this);
     glWidget         = new GLWidget(this,glImage);
 }
@@ -133,6 +141,7 @@ void MainWindow::initializeApp()
     //                      GUI setup
     // ------------------------------------------------------
     ui->statusbar->addWidget(statusLabel);
+    ui->statusbar->addPermanentWidget(renderStatusLabel);
 
 
 
@@ -159,7 +168,7 @@ void MainWindow::initializeApp()
 
     dialog3dGeneralSettings = new Dialog3DGeneralSettings(this);
     connect(ui->pushButton3DGeneralSettings,SIGNAL(released()),dialog3dGeneralSettings,SLOT(show()));
-    connect(dialog3dGeneralSettings,SIGNAL(signalPropertyChanged()),glWidget,SLOT(repaint()));
+    connect(dialog3dGeneralSettings,SIGNAL(signalPropertyChanged()),glWidget,SLOT(settings3DChanged()));
     connect(dialog3dGeneralSettings,SIGNAL(signalRecompileCustomShader()),glWidget,SLOT(recompileRenderShader()));
 
     ui->verticalLayout3DImage->addWidget(glWidget);
@@ -183,6 +192,9 @@ void MainWindow::initializeApp()
     
     connect(ui->tabWidget,SIGNAL(currentChanged(int)),this,SLOT(updateImage(int)));
     connect(ui->tabWidget,SIGNAL(tabBarClicked(int)),this,SLOT(updateImage(int)));
+    // material switching updates only the property set of the visible tab
+    connect(ui->tabWidget,SIGNAL(currentChanged(int)),materialManager,SLOT(setVisibleTexture(int)));
+    materialManager->setVisibleTexture(ui->tabWidget->currentIndex());
     
     // imageChange and imageLoaded signals
     connect(diffuseImageProp    ,SIGNAL(imageChanged()),this,SLOT(checkWarnings()));
@@ -194,14 +206,31 @@ void MainWindow::initializeApp()
     connect(roughnessImageProp  ,SIGNAL(imageChanged()),glImage,SLOT(imageChanged()));
     connect(metallicImageProp   ,SIGNAL(imageChanged()),glImage,SLOT(imageChanged()));
 
-    connect(diffuseImageProp    ,SIGNAL(imageChanged()),this,SLOT(updateDiffuseImage()));
-    connect(normalImageProp     ,SIGNAL(imageChanged()),this,SLOT(updateNormalImage()));
-    connect(specularImageProp   ,SIGNAL(imageChanged()),this,SLOT(updateSpecularImage()));
-    connect(heightImageProp     ,SIGNAL(imageChanged()),this,SLOT(updateHeightImage()));
-    connect(occlusionImageProp  ,SIGNAL(imageChanged()),this,SLOT(updateOcclusionImage()));
-    connect(roughnessImageProp  ,SIGNAL(imageChanged()),this,SLOT(updateRoughnessImage()));
-    connect(metallicImageProp   ,SIGNAL(imageChanged()),this,SLOT(updateMetallicImage()));
-    connect(grungeImageProp     ,SIGNAL(imageChanged()),this,SLOT(updateGrungeImage()));
+    // property changes are not rendered immediately, the scheduler
+    // collects them and replots each texture at most once per frame
+    connect(diffuseImageProp    ,SIGNAL(imageChanged()),imageChangedMapper,SLOT(map()));
+    connect(normalImageProp     ,SIGNAL(imageChanged()),imageChangedMapper,SLOT(map()));
+    connect(specularImageProp   ,SIGNAL(imageChanged()),imageChangedMapper,SLOT(map()));
+    connect(heightImageProp     ,SIGNAL(imageChanged()),imageChangedMapper,SLOT(map()));
+    connect(occlusionImageProp  ,SIGNAL(imageChanged()),imageChangedMapper,SLOT(map()));
+    connect(roughnessImageProp  ,SIGNAL(imageChanged()),imageChangedMapper,SLOT(map()));
+    connect(metallicImageProp   ,SIGNAL(imageChanged()),imageChangedMapper,SLOT(map()));
+    connect(grungeImageProp     ,SIGNAL(imageChanged()),imageChangedMapper,SLOT(map()));
+    imageChangedMapper->setMapping(diffuseImageProp   ,DIFFUSE_TEXTURE);
+    imageChangedMapper->setMapping(normalImageProp    ,NORMAL_TEXTURE);
+    imageChangedMapper->setMapping(specularImageProp  ,SPECULAR_TEXTURE);
+    imageChangedMapper->setMapping(heightImageProp    ,HEIGHT_TEXTURE);
+    imageChangedMapper->setMapping(occlusionImageProp ,OCCLUSION_TEXTURE);
+    imageChangedMapper->setMapping(roughnessImageProp ,ROUGHNESS_TEXTURE);
+    imageChangedMapper->setMapping(metallicImageProp  ,METALLIC_TEXTURE);
+    imageChangedMapper->setMapping(grungeImageProp    ,GRUNGE_TEXTURE);
+    connect(imageChangedMapper,SIGNAL(mapped(int)),renderScheduler,SLOT(invalidate(int)));
+    connect(renderScheduler,SIGNAL(renderRequested(int)),this,SLOT(scheduledUpdate(int)));
+    connect(renderScheduler,SIGNAL(statisticsChanged(QString)),renderStatusLabel,SLOT(setText(QString)));
+    // next texture is rendered when GPU finished the previous one
+    connect(glImage,SIGNAL(renderFinished(int,double)),renderScheduler,SLOT(renderFinished(int,double)));
+    // 3D view is redrawn when the processed maps are published by the render thread
+    connect(glImage,SIGNAL(imagePublished(int)),glWidget,SLOT(texturesChanged()));
 
     qDebug() << "Initialization: Connections and actions.";
     INIT_PROGRESS(50, "Connections and actions.");
@@ -281,6 +310,7 @@ void MainWindow::initializeApp()
     connect(ui->pushButtonToggleMetallic      ,SIGNAL(toggled(bool)),glWidget,SLOT(toggleMetallicView(bool)));
     connect(ui->pushButtonSaveCurrentSettings ,SIGNAL(released()),this,SLOT(saveSettings()));
     connect(ui->comboBoxImageOutputFormat     ,SIGNAL(activated(int)),this,SLOT(setOutputFormat(int)));
+    connect(ui->comboBoxExportPreset          ,SIGNAL(activated(int)),this,SLOT(setExportPreset(int)));
 
     // Other staff
 
@@ -459,6 +489,7 @@ void MainWindow::initializeApp()
 
 
     logAction = new QAction("Show log file",this);
+    vramAction = new QAction("Show texture memory usage",this);
     dialogLogger    = new DialogLogger(this);
     dialogShortcuts = new DialogShortcuts(this);
     //dialogLogger->setModal(true);
@@ -467,6 +498,7 @@ void MainWindow::initializeApp()
     connect(aboutAction, SIGNAL(triggered()), this, SLOT(about()));
     connect(aboutQtAction, SIGNAL(triggered()), this, SLOT(aboutQt()));
     connect(logAction, SIGNAL(triggered()), dialogLogger, SLOT(showLog()));
+    connect(vramAction, SIGNAL(triggered()), this, SLOT(showVRAMUsage()));
     connect(shortcutsAction, SIGNAL(triggered()), dialogShortcuts, SLOT(show()));
 
 
@@ -474,6 +506,7 @@ void MainWindow::initializeApp()
     help->addAction(aboutAction);
     help->addAction(aboutQtAction);
     help->addAction(logAction);
+    help->addAction(vramAction);
     help->addAction(shortcutsAction);
 
     QAction *action = ui->toolBar->toggleViewAction();
@@ -512,6 +545,7 @@ MainWindow::~MainWindow()
     delete grungeImageProp;
     delete metallicImageProp;
     delete statusLabel;
+    delete renderStatusLabel;
     delete glImage;
     delete glWidget;
     delete abSettings;
@@ -539,6 +573,8 @@ void MainWindow::showEvent(QShowEvent* event){
 }
 
 void MainWindow::replotAllImages(){
+    // everything is replotted below, pending property changes are not needed
+    renderScheduler->cancel();
     FBOImageProporties* lastActive = glImage->getActiveImage();
     glImage->enableShadowRender(true);
 
@@ -560,7 +596,7 @@ void MainWindow::replotAllImages(){
 
     glImage->enableShadowRender(false);
     glImage->setActiveImage(lastActive);
-    glWidget->update();
+    glWidget->texturesChanged();
     
     QGLContext* glContext = (QGLContext *) glWidget->context();
     GLCHK( glContext->makeCurrent() );
@@ -571,6 +607,10 @@ void MainWindow::replotAllImages(){
     
     GLint gpuMemTotal = glGpu.getTotalMem();
     GLint gpuMemAvail = glGpu.getAvailMem();
+    // use 80% of the GPU memory when budget was not defined by user
+    if(abSettings->vram_budget_mb <= 0 && gpuMemTotal > 0)
+        VRAMManager::setBudget(qint64(gpuMemTotal) * 1024 * 8 / 10);
+
     if(gpuMemTotal > 0)
     {
         menu_text = QString("GPU memory used:") + QString::number(float(gpuMemTotal - gpuMemAvail) / 1024.0f) + QString("[MB]")
@@ -581,6 +621,16 @@ void MainWindow::replotAllImages(){
     {
         menu_text = QString("GPU memory free:") + QString::number(float(gpuMemAvail) / 1024.0f) + QString("[MB]");
     }
+    menu_text += QString(" Textures:") + QString::number(VRAMManager::getUsedMemory() / (1024*1024)) + QString("[MB]")
+               + QString(" Saved:") + QString::number(VRAMManager::getSavedMemory() / (1024*1024)) + QString("[MB]");
+    if(VRAMManager::getBudget() > 0)
+        menu_text += QString(" Budget:") + QString::number(VRAMManager::getBudget() / (1024*1024)) + QString("[MB]")
+                   + QString(" In RAM:") + QString::number(VRAMManager::getSpilledMemory() / (1024*1024)) + QString("[MB]")
+                   + QString(" Evictions:") + QString::number(VRAMManager::getNoEvictions());
+    qDebug() << "RenderScheduler:: requests" << renderScheduler->getNoRequests()
+             << "renders" << renderScheduler->getNoRenders()
+             << "dropped" << renderScheduler->getNoDropped()
+             << "average time" << renderScheduler->getAverageRenderTime() << "ms";
 
     statusLabel->setText(menu_text);
 #endif
@@ -590,6 +640,7 @@ void MainWindow::materialsToggled(bool toggle){
     static bool bLastValue;
     ui->pushButtonMaterialWarning->setVisible(toggle);
     ui->pushButtonUVWarning->setVisible(FBOImageProporties::seamlessMode != SEAMLESS_NONE);
+    materialManager->attachAllProperties();
     if(toggle){
 
         bLastValue = diffuseImageProp->imageProp.properties->BaseMapToOthers.EnableConversion;
@@ -746,6 +797,7 @@ bool MainWindow::saveAllImages(const QString &dir){
     }
 
     qDebug() << Q_FUNC_INFO << "Saving to dir:" << fileInfo.absoluteFilePath();
+    recentDir.setPath(fileInfo.absoluteFilePath());
 
     diffuseImageProp   ->setImageName(ui->lineEditOutputName->text());
     normalImageProp    ->setImageName(ui->lineEditOutputName->text());
@@ -761,132 +813,59 @@ bool MainWindow::saveAllImages(const QString &dir){
     ui->progressBar->setValue(0);
 
     if(!bSaveCompressedFormImages){
-        ui->labelProgressInfo->setText("Saving diffuse image...");
-        if(bSaveCheckedImages*ui->checkBoxSaveDiffuse->isChecked() || !bSaveCheckedImages ){
-            diffuseImageProp ->saveFileToDir(dir);
-        }
-        ui->progressBar->setValue(15);
-
-
-        ui->labelProgressInfo->setText("Saving normal image...");
-        if(bSaveCheckedImages*ui->checkBoxSaveNormal->isChecked() || !bSaveCheckedImages ){
-            normalImageProp  ->saveFileToDir(dir);
+        FormImageProp* maps[7]       = {diffuseImageProp,normalImageProp,specularImageProp,heightImageProp,
+                                        occlusionImageProp,roughnessImageProp,metallicImageProp};
+        QCheckBox*     checkBoxes[7] = {ui->checkBoxSaveDiffuse,ui->checkBoxSaveNormal,ui->checkBoxSaveSpecular,ui->checkBoxSaveHeight,
+                                        ui->checkBoxSaveOcclusion,ui->checkBoxSaveRoughness,ui->checkBoxSaveMetallic};
 
+        // images are read from GPU here, encoding is done in parallel afterwards
+        ui->labelProgressInfo->setText("Preparing images...");
+        QList<QImage>       images;
+        QStringList         fileNames;
+        QList<TextureTypes> imageTypes;
+        for(int i = 0 ; i < 7 ; i++){
+            if(bSaveCheckedImages && !checkBoxes[i]->isChecked()) continue;
+            images     << maps[i]->getImageProporties()->getImage();
+            fileNames  << maps[i]->getFileNameInDir(dir);
+            imageTypes << maps[i]->getImageProporties()->imageType;
         }
         ui->progressBar->setValue(30);
-        ui->labelProgressInfo->setText("Saving specular image...");
-        if(bSaveCheckedImages*ui->checkBoxSaveSpecular->isChecked() || !bSaveCheckedImages ){
-            specularImageProp->saveFileToDir(dir);
-
-        }
-        ui->progressBar->setValue(45);
-
-        ui->labelProgressInfo->setText("Saving height image...");
-        if(bSaveCheckedImages*ui->checkBoxSaveHeight->isChecked() || !bSaveCheckedImages ){
-            occlusionImageProp  ->saveFileToDir(dir);
-        }
-
-        ui->progressBar->setValue(60);
-        ui->labelProgressInfo->setText("Saving occlusion image...");
-        if(bSaveCheckedImages*ui->checkBoxSaveOcclusion->isChecked() || !bSaveCheckedImages ){
-            heightImageProp  ->saveFileToDir(dir);
-        }
-
-        ui->progressBar->setValue(75);
-        ui->labelProgressInfo->setText("Saving roughness image...");
-        if(bSaveCheckedImages*ui->checkBoxSaveRoughness->isChecked() || !bSaveCheckedImages ){
-            roughnessImageProp  ->saveFileToDir(dir);
-        }
+        ui->labelProgressInfo->setText("Saving images...");
+        QCoreApplication::processEvents();
 
-        ui->progressBar->setValue(90);
-        ui->labelProgressInfo->setText("Saving metallic image...");
-        if(bSaveCheckedImages*ui->checkBoxSaveMetallic->isChecked() || !bSaveCheckedImages ){
-            metallicImageProp ->saveFileToDir(dir);
+        if(!ImageExporter::save(images,fileNames,imageTypes)){
+            qWarning() << "Some of the images were not saved to:" << dir;
         }
         ui->progressBar->setValue(100);
 
     }else{ // if using compressed format
         QCoreApplication::processEvents();
-        glImage->makeCurrent();
-
-        QGLFramebufferObject* diffuseFBOImage  = diffuseImageProp->getImageProporties()->fbo;
-        QGLFramebufferObject* normalFBOImage   = normalImageProp->getImageProporties()->fbo;
-        QGLFramebufferObject* specularFBOImage = specularImageProp->getImageProporties()->fbo;
-        QGLFramebufferObject* heightFBOImage   = heightImageProp->getImageProporties()->fbo;
-
-        QImage diffuseImage = diffuseFBOImage->toImage() ;
-        QImage normalImage  = normalFBOImage->toImage();
-        QImage heightImage  = specularFBOImage->toImage();
-        QImage specularImage= heightFBOImage->toImage();
 
         ui->progressBar->setValue(20);
         ui->labelProgressInfo->setText("Preparing images...");
-
         QCoreApplication::processEvents();
 
-        QImage newDiffuseImage = QImage(diffuseImage.width(), diffuseImage.height(), QImage::Format_ARGB32);
-        QImage newNormalImage  = QImage(diffuseImage.width(), diffuseImage.height(), QImage::Format_ARGB32);
-
-
-
-        unsigned char* newDiffuseBuffer  = newDiffuseImage.bits();
-        unsigned char* newNormalBuffer   = newNormalImage.bits();
-        unsigned char* srcDiffuseBuffer  = diffuseImage.bits();
-        unsigned char* srcNormalBuffer   = normalImage.bits();
-        unsigned char* srcSpecularBuffer = specularImage.bits();
-        unsigned char* srcHeightBuffer   = heightImage.bits();
-
-        //...
-
-        int w = diffuseImage.width();
-        int h = diffuseImage.height();
-
-        // putting height or specular color to alpha channel according to compression type
-        switch(ui->comboBoxSaveAsOptions->currentIndex()){
-            case( H_TO_D_AND_S_TO_N ):
-
-            for(int i = 0; i <h; i++){
-             for(int j = 0; j < w; j++){
-              newDiffuseBuffer[4 * (i * w + j) + 0] = srcDiffuseBuffer[4 * (i * w + j)+0  ] ;
-              newDiffuseBuffer[4 * (i * w + j) + 1] = srcDiffuseBuffer[4 * (i * w + j)+1  ] ;
-              newDiffuseBuffer[4 * (i * w + j) + 2] = srcDiffuseBuffer[4 * (i * w + j)+2  ] ;
-              newDiffuseBuffer[4 * (i * w + j) + 3] = srcHeightBuffer[4 * (i * w + j)+0  ] ;
-
-              newNormalBuffer[4 * (i * w + j) + 0] = srcNormalBuffer[4 * (i * w + j)+0  ] ;
-              newNormalBuffer[4 * (i * w + j) + 1] = srcNormalBuffer[4 * (i * w + j)+1  ] ;
-              newNormalBuffer[4 * (i * w + j) + 2] = srcNormalBuffer[4 * (i * w + j)+2  ] ;
-              newNormalBuffer[4 * (i * w + j) + 3] = srcSpecularBuffer[4 * (i * w + j)+0  ] ;
-             }
-            }
-
-            break;
-            case( S_TO_D_AND_H_TO_N):
-
-            for(int i = 0; i <h; i++){
-             for(int j = 0; j < w; j++){
-              newDiffuseBuffer[4 * (i * w + j) + 0] = srcDiffuseBuffer[4 * (i * w + j)+0  ] ;
-              newDiffuseBuffer[4 * (i * w + j) + 1] = srcDiffuseBuffer[4 * (i * w + j)+1  ] ;
-              newDiffuseBuffer[4 * (i * w + j) + 2] = srcDiffuseBuffer[4 * (i * w + j)+2  ] ;
-              newDiffuseBuffer[4 * (i * w + j) + 3] = srcSpecularBuffer[4 * (i * w + j)+0  ] ;
-
-              newNormalBuffer[4 * (i * w + j) + 0] = srcNormalBuffer[4 * (i * w + j)+0  ] ;
-              newNormalBuffer[4 * (i * w + j) + 1] = srcNormalBuffer[4 * (i * w + j)+1  ] ;
-              newNormalBuffer[4 * (i * w + j) + 2] = srcNormalBuffer[4 * (i * w + j)+2  ] ;
-              newNormalBuffer[4 * (i * w + j) + 3] = srcHeightBuffer[4 * (i * w + j)+0  ] ;
-             }
-            }
-            break;
+        // channels are packed on GPU, only the packed images are read back
+        QList<ChannelPacking> layout = ChannelPacking::layout(CompressedFromTypes(ui->comboBoxSaveAsOptions->currentIndex()));
+        QList<QImage>       images;
+        QStringList         fileNames;
+        QList<TextureTypes> imageTypes;
+        foreach(const ChannelPacking& packing, layout){
+            QImage image = glImage->packChannels(packing);
+            if(image.isNull()) continue;
+            QString postfix = packing.postfix.isEmpty() ? PostfixNames::getPostfix(packing.outputType) : packing.postfix;
+            images     << image;
+            fileNames  << dir + "/" + ui->lineEditOutputName->text() + postfix + PostfixNames::outputFormat;
+            imageTypes << packing.outputType;
         }
 
-
         ui->progressBar->setValue(50);
-        ui->labelProgressInfo->setText("Saving diffuse image...");
-
-        diffuseImageProp->saveImageToDir(dir,newDiffuseImage);
+        ui->labelProgressInfo->setText("Saving images...");
+        QCoreApplication::processEvents();
 
-        ui->progressBar->setValue(80);
-        ui->labelProgressInfo->setText("Saving diffuse image...");
-        normalImageProp->saveImageToDir(dir,newNormalImage);
+        if(!ImageExporter::save(images,fileNames,imageTypes)){
+            qWarning() << "Some of the images were not saved to:" << dir;
+        }
 
     }// end of saveAsCompressedFormat
 
@@ -912,134 +891,70 @@ void MainWindow::saveCompressedForm(){
 
 void MainWindow::updateDiffuseImage(){
     ui->lineEditOutputName->setText(diffuseImageProp->getImageName());
-    updateImageInformation();   
-    glImage->repaint();
+    updateImageInformation();
+    glImage->renderImage(diffuseImageProp->getImageProporties());
 
-    // replot normal if height was changed in attached mode
+    // replot maps attached to the diffuse output in the next frames
     if(specularImageProp->getImageProporties()->inputImageType == INPUT_FROM_DIFFUSE_OUTPUT){
-        glImage->enableShadowRender(true);
-        updateImage(SPECULAR_TEXTURE);
-        //glImage->updateGL();
-        glImage->enableShadowRender(false);
-        // set height tab back again
-        updateImage(DIFFUSE_TEXTURE);
+        renderScheduler->invalidate(SPECULAR_TEXTURE);
     }
-
-    // replot normal if height was changed in attached mode
     if(roughnessImageProp->getImageProporties()->inputImageType == INPUT_FROM_DIFFUSE_OUTPUT){
-        glImage->enableShadowRender(true);
-        updateImage(ROUGHNESS_TEXTURE);
-        //glImage->updateGL();
-        glImage->enableShadowRender(false);
-        // set height tab back again
-        updateImage(DIFFUSE_TEXTURE);
+        renderScheduler->invalidate(ROUGHNESS_TEXTURE);
     }
-
-    // replot normal if height was changed in attached mode
     if(metallicImageProp->getImageProporties()->inputImageType == INPUT_FROM_DIFFUSE_OUTPUT){
-        glImage->enableShadowRender(true);
-        updateImage(METALLIC_TEXTURE);
-        //glImage->updateGL();
-        glImage->enableShadowRender(false);
-        // set height tab back again
-        updateImage(DIFFUSE_TEXTURE);
+        renderScheduler->invalidate(METALLIC_TEXTURE);
     }
-
-    glWidget->repaint();
 }
 void MainWindow::updateNormalImage(){
     ui->lineEditOutputName->setText(normalImageProp->getImageName());
-    glImage->repaint();
+    glImage->renderImage(normalImageProp->getImageProporties());
 
-    // replot normal if  was changed in attached mode
+    // replot occlusion if normal was changed in attached mode
     if(occlusionImageProp->getImageProporties()->inputImageType == INPUT_FROM_HO_NO){
-        glImage->enableShadowRender(true);
-        updateImage(OCCLUSION_TEXTURE);
-        //glImage->updateGL();
-        glImage->enableShadowRender(false);
-        // set height tab back again
-        updateImage(NORMAL_TEXTURE);
+        renderScheduler->invalidate(OCCLUSION_TEXTURE);
     }
-
-    glWidget->repaint();
 }
 void MainWindow::updateSpecularImage(){
     ui->lineEditOutputName->setText(specularImageProp->getImageName());
-    glImage->repaint();
-    glWidget->repaint();
+    glImage->renderImage(specularImageProp->getImageProporties());
 }
 void MainWindow::updateHeightImage(){
     ui->lineEditOutputName->setText(heightImageProp->getImageName());
-    glImage->repaint();
-
+    glImage->renderImage(heightImageProp->getImageProporties());
 
-    // replot normal if height was changed in attached mode
+    // replot maps attached to the height output in the next frames,
+    // each of them is rendered when the height is finished
     if(normalImageProp->getImageProporties()->inputImageType == INPUT_FROM_HEIGHT_OUTPUT){
-        glImage->enableShadowRender(true);
-        updateImage(NORMAL_TEXTURE);
-        //glImage->updateGL();
-        glImage->enableShadowRender(false);
-        // set height tab back again
-        updateImage(HEIGHT_TEXTURE);
+        renderScheduler->invalidate(NORMAL_TEXTURE);
     }
-    // replot normal if  was changed in attached mode
     if(specularImageProp->getImageProporties()->inputImageType == INPUT_FROM_HEIGHT_OUTPUT){
-        glImage->enableShadowRender(true);
-        updateImage(SPECULAR_TEXTURE);
-        //glImage->updateGL();
-        glImage->enableShadowRender(false);
-        // set height tab back again
-        updateImage(HEIGHT_TEXTURE);
+        renderScheduler->invalidate(SPECULAR_TEXTURE);
     }
-
-    // replot normal if  was changed in attached mode
     if(occlusionImageProp->getImageProporties()->inputImageType == INPUT_FROM_HI_NI||
        occlusionImageProp->getImageProporties()->inputImageType == INPUT_FROM_HO_NO){
-        glImage->enableShadowRender(true);
-        updateImage(OCCLUSION_TEXTURE);
-        //glImage->updateGL();
-        glImage->enableShadowRender(false);
-        // set height tab back again
-        updateImage(HEIGHT_TEXTURE);
+        renderScheduler->invalidate(OCCLUSION_TEXTURE);
     }
-
-    // replot normal if  was changed in attached mode
     if(roughnessImageProp->getImageProporties()->inputImageType == INPUT_FROM_HEIGHT_OUTPUT){
-        glImage->enableShadowRender(true);
-        updateImage(ROUGHNESS_TEXTURE);
-        //glImage->updateGL();
-        glImage->enableShadowRender(false);
-        // set height tab back again
-        updateImage(HEIGHT_TEXTURE);
+        renderScheduler->invalidate(ROUGHNESS_TEXTURE);
     }
-    // replot normal if  was changed in attached mode
     if(metallicImageProp->getImageProporties()->inputImageType == INPUT_FROM_HEIGHT_OUTPUT){
-        glImage->enableShadowRender(true);
-        updateImage(METALLIC_TEXTURE);
-        //glImage->updateGL();
-        glImage->enableShadowRender(false);
-        // set height tab back again
-        updateImage(HEIGHT_TEXTURE);
+        renderScheduler->invalidate(METALLIC_TEXTURE);
     }
-    glWidget->repaint();
 }
 
 void MainWindow::updateOcclusionImage(){
     ui->lineEditOutputName->setText(occlusionImageProp->getImageName());
-    glImage->repaint();
-    glWidget->repaint();
+    glImage->renderImage(occlusionImageProp->getImageProporties());
 }
 
 void MainWindow::updateRoughnessImage(){
     ui->lineEditOutputName->setText(roughnessImageProp->getImageName());
-    glImage->repaint();
-    glWidget->repaint();
+    glImage->renderImage(roughnessImageProp->getImageProporties());
 }
 
 void MainWindow::updateMetallicImage(){
     ui->lineEditOutputName->setText(metallicImageProp->getImageName());
-    glImage->repaint();
-    glWidget->repaint();
+    glImage->renderImage(metallicImageProp->getImageProporties());
 }
 
 void MainWindow::updateGrungeImage(){
@@ -1050,16 +965,47 @@ void MainWindow::updateGrungeImage(){
     if(test){
         replotAllImages();
 
-    }else{ // otherwise replot only the grunge map
-        glImage->repaint();
-        glWidget->repaint();
+    }else{ // otherwise replot only the grunge map, it is not shown in 3D view
+        glImage->renderImage(grungeImageProp->getImageProporties());
+    }
+}
+
+void MainWindow::scheduledUpdate(int tType){
+    switch(tType){
+        case(DIFFUSE_TEXTURE):
+            updateDiffuseImage();
+            break;
+        case(NORMAL_TEXTURE):
+            updateNormalImage();
+            break;
+        case(SPECULAR_TEXTURE):
+            updateSpecularImage();
+            break;
+        case(HEIGHT_TEXTURE):
+            updateHeightImage();
+            break;
+        case(OCCLUSION_TEXTURE):
+            updateOcclusionImage();
+            break;
+        case(ROUGHNESS_TEXTURE):
+            updateRoughnessImage();
+            break;
+        case(METALLIC_TEXTURE):
+            updateMetallicImage();
+            break;
+        case(GRUNGE_TEXTURE):
+            updateGrungeImage();
+            break;
+        default:
+            break;
     }
 }
 
 void MainWindow::updateImageInformation(){
 
-    ui->labelCurrentImageWidth ->setNum(diffuseImageProp->getImageProporties()->fbo->width());
-    ui->labelCurrentImageHeight->setNum(diffuseImageProp->getImageProporties()->fbo->height());
+    QSize imageSize = diffuseImageProp->getImageProporties()->getSize();
+    ui->labelCurrentImageWidth ->setNum(imageSize.width());
+    ui->labelCurrentImageHeight->setNum(imageSize.height());
 }
 
 void MainWindow::initializeGL(){  
@@ -1157,7 +1103,7 @@ void MainWindow::updateImage(int tType){
     if (imageProp->bLoading != NULL){
         imageProp->bLoading = false;
     }
-    glWidget->update();
+    glWidget->texturesChanged();
 }
 
 void MainWindow::changeWidth (int size=0){
@@ -1194,7 +1140,7 @@ void MainWindow::applyResizeImage(){
     glImage->setActiveImage(lastActive);
     replotAllImages();
     updateImageInformation();
-    glWidget->repaint();
+    glWidget->texturesChanged();
     // replot all material group after image resize
 
     FBOImageProporties::currentMaterialIndeks = materiaIndex;
@@ -1221,7 +1167,7 @@ void MainWindow::applyResizeImage(int width, int height){
     glImage->setActiveImage(lastActive);
     replotAllImages();
     updateImageInformation();
-    glWidget->repaint();
+    glWidget->texturesChanged();
 
     // replot all material group after image resize
     FBOImageProporties::currentMaterialIndeks = materiaIndex;
@@ -1261,7 +1207,7 @@ void MainWindow::applyScaleImage(){
     glImage->setActiveImage(lastActive);
     replotAllImages();
     updateImageInformation();
-    glWidget->repaint();
+    glWidget->texturesChanged();
 
     // replot all material group after image resize
     FBOImageProporties::currentMaterialIndeks = materiaIndex;
@@ -1411,7 +1357,7 @@ void MainWindow::runBatch(){
         QString imagePath = sourceFolder + "/" + imageName;
 
         qDebug() << "Processing image: " << imagePath;
-        diffuseImageProp->loadFile(imagePath);
+        diffuseImageProp->loadFileSync(imagePath);
         convertFromBase();
         saveAllImages(outputFolder);
 
@@ -1506,7 +1452,7 @@ void MainWindow::convertFromBase(){
     replotAllImages();
 
     glImage->setActiveImage(lastActive);
-    glWidget->update();
+    glWidget->texturesChanged();
     qDebug() << "Conversion from Base to others applied";
 }
 
@@ -1552,7 +1498,7 @@ void MainWindow::updateSliders(){
     if(ui->radioButtonSeamlessSimpleDirY ->isChecked()) FBOImageProporties::seamlessSimpleModeDirection = 2;
 
     glImage ->repaint();
-    glWidget->repaint();
+    glWidget->texturesChanged();
 
 }
 
@@ -1578,6 +1524,7 @@ QSize MainWindow::sizeHint() const
 }
 
 void MainWindow::loadImageSettings(TextureTypes type){
+    materialManager->attachAllProperties();
 
     switch(type){
         case(DIFFUSE_TEXTURE):            
@@ -1607,7 +1554,7 @@ void MainWindow::loadImageSettings(TextureTypes type){
         default: qWarning() << "Trying to load non supported image! Given textureType:" << type;
     }
     glImage ->repaint();
-    glWidget->repaint();
+    glWidget->texturesChanged();
 }
 
 void MainWindow::showSettingsManager(){
@@ -1665,12 +1612,14 @@ void MainWindow::saveSettings(){
 
     // other parameters
     abSettings->use_texture_interpolation=ui->checkBoxUseLinearTextureInterpolation->isChecked();
+    abSettings->export_preset=ui->comboBoxExportPreset->currentIndex();
     abSettings->mouse_sensitivity=ui->spinBoxMouseSensitivity->value();
     abSettings->font_size=ui->spinBoxFontSize->value();
     abSettings->mouse_loop=ui->checkBoxToggleMouseLoop->isChecked();
 
     dock3Dsettings->saveSettings(abSettings);
 
+    materialManager->attachAllProperties();
 
     abSettings->Diffuse  .copyValues(diffuseImageProp   ->imageProp.properties);
     abSettings->Specular .copyValues(specularImageProp  ->imageProp.properties);
@@ -1707,6 +1656,14 @@ void MainWindow::setOutputFormat(int index=0){
     PostfixNames::outputFormat = ui->comboBoxImageOutputFormat->currentText();
 }
 
+void MainWindow::setExportPreset(int index){
+    ImageExporter::setPreset(ExportPreset(index));
+}
+
+void MainWindow::setExportPreset(const QString& name){
+    if(ImageExporter::setPreset(name)) ui->comboBoxExportPreset->setCurrentIndex(ImageExporter::getPreset());
+}
+
 void MainWindow::loadSettings(){
     static bool bFirstTime = true;
 
@@ -1727,6 +1684,7 @@ void MainWindow::loadSettings(){
     QString name = abSettings->settings_name.value();
     ui->pushButtonProjectManager->setText("Project manager (" + name + ")");
 
+    materialManager->attachAllProperties();
     diffuseImageProp    ->imageProp.properties->copyValues(&abSettings->Diffuse);
     specularImageProp   ->imageProp.properties->copyValues(&abSettings->Specular);
     normalImageProp     ->imageProp.properties->copyValues(&abSettings->Normal);
@@ -1765,6 +1723,10 @@ void MainWindow::loadSettings(){
 
     ui->checkBoxUseLinearTextureInterpolation->setChecked(abSettings->use_texture_interpolation);
     FBOImages::bUseLinearInterpolation = ui->checkBoxUseLinearTextureInterpolation->isChecked();
+    ui->comboBoxExportPreset->setCurrentIndex(abSettings->export_preset);
+    setExportPreset(ui->comboBoxExportPreset->currentIndex());
+    if(abSettings->vram_budget_mb > 0)
+        VRAMManager::setBudget(qint64(abSettings->vram_budget_mb) * 1024 * 1024);
     ui->comboBoxGUIStyle->setCurrentText(abSettings->gui_style);
 
     // UV Settings
@@ -1801,7 +1763,7 @@ void MainWindow::loadSettings(){
 
     replotAllImages();
     glImage ->repaint();
-    glWidget->repaint();
+    glWidget->texturesChanged();
     bFirstTime = false;
 
 }
@@ -1821,3 +1783,17 @@ void MainWindow::aboutQt()
 {
     QMessageBox::aboutQt(this, tr(AWESOME_BUMP_VERSION));
 }
+
+void MainWindow::showVRAMUsage()
+{
+    VRAMManager::report();
+    QString text = QString("Textures: ") + QString::number(VRAMManager::getUsedMemory() / (1024*1024)) + QString(" MB\n")
+                 + QString("Moved to RAM: ") + QString::number(VRAMManager::getSpilledMemory() / (1024*1024)) + QString(" MB\n")
+                 + QString("Saved by single channel maps: ") + QString::number(VRAMManager::getSavedMemory() / (1024*1024)) + QString(" MB\n\n");
+    QMap<QString,qint64> usage = VRAMManager::getUsageByOwner();
+    QMap<QString,qint64>::const_iterator it = usage.constBegin();
+    for(; it != usage.constEnd(); ++it){
+        text += it.key() + QString(": ") + QString::number(it.value() / (1024*1024)) + QString(" MB\n");
+    }
+    QMessageBox::information(this, tr("Texture memory usage"), text);
+}
@@ -13,6 +13,7 @@
 
 class QAction;
 class QLabel;
+class QSignalMapper;
 
 class GLWidget;
 class GLImage;
@@ -23,6 +24,7 @@ class DockWidget3DSettings;
 class Dialog3DGeneralSettings;
 class DialogLogger;
 class DialogShortcuts;
+class RenderScheduler;
 
 namespace Ui {
 class MainWindow;
@@ -53,6 +55,7 @@ public slots:
 
     void aboutQt();
     void about();
+    void showVRAMUsage();
   
 	void initializeApp();
 
@@ -70,6 +73,9 @@ public slots:
     void loadImageSettings(TextureTypes type);
     void showSettingsManager();
     void setOutputFormat(int index);
+    void setExportPreset(int index);
+    // preset given by name, used by the command line
+    void setExportPreset(const QString& name);
     void replotAllImages();
     void materialsToggled(bool toggle);
     void checkWarnings();
@@ -101,6 +107,8 @@ public slots:
     void updateRoughnessImage();
     void updateMetallicImage();
     void updateGrungeImage();
+    // called by render scheduler at most once per frame
+    void scheduledUpdate(int tType);
     // repaint selected tab
     void updateImage(int tab);
     void updateImageInformation();
@@ -180,9 +188,15 @@ private:
     QAction *aboutQtAction;
     QAction *aboutAction;
     QAction *logAction; // show logger
+    QAction *vramAction; // show texture memory used by each owner
     QAction *shortcutsAction; // show key shortcuts
 
     QLabel  *statusLabel;
+    QLabel  *renderStatusLabel;
+
+    // collapses imageChanged signals into one render per frame
+    RenderScheduler* renderScheduler;
+    QSignalMapper*   imageChangedMapper;
 
     DialogLogger* dialogLogger;
     DialogShortcuts* dialogShortcuts;
@@ -0,0 +1,83 @@
+#include "meshloader.h"
+#include <QRunnable>
+#include <QDebug>
+
+class MeshLoader::Task : public QRunnable
+{
+public:
+    Task(MeshLoader* loader, int request, const QString& dir, const QString& name,
+         QSharedPointer<LoadStatus> status):
+        loader(loader),request(request),dir(dir),name(name),status(status){}
+
+    void run(){
+        if(status->isCanceled()) return;
+        Mesh* mesh = new Mesh(dir,name,status.data());
+        if(status->isCanceled()){
+            delete mesh;
+            return;
+        }
+        QMetaObject::invokeMethod(loader,"deliver",Qt::QueuedConnection,
+                                  Q_ARG(int,request),Q_ARG(void*,mesh));
+    }
+
+private:
+    MeshLoader* loader;
+    int     request;
+    QString dir;
+    QString name;
+    QSharedPointer<LoadStatus> status;
+};
+
+MeshLoader::MeshLoader(QObject *parent) :
+    QObject(parent),
+    currentRequest(0),
+    bLoading(false)
+{
+    // cancelled loads stop at the next check, new requests must not wait for them
+    pool.setMaxThreadCount(2);
+    progressTimer.setInterval(100);
+    connect(&progressTimer,SIGNAL(timeout()),this,SLOT(checkProgress()));
+}
+
+MeshLoader::~MeshLoader(){
+    cancel();
+    pool.waitForDone();
+}
+
+void MeshLoader::load(const QString& dir, const QString& name){
+    cancel();
+    int request = currentRequest.fetchAndAddOrdered(1) + 1;
+    status      = QSharedPointer<LoadStatus>(new LoadStatus());
+    bLoading    = true;
+    qDebug() << "MeshLoader:: loading" << dir + name << "in background";
+    pool.start(new Task(this,request,dir,name,status));
+    progressTimer.start();
+    emit progressChanged(0);
+}
+
+void MeshLoader::cancel(){
+    currentRequest.fetchAndAddOrdered(1);
+    if(!status.isNull()) status->cancel();
+    status.clear();
+    progressTimer.stop();
+    bLoading = false;
+}
+
+bool MeshLoader::isLoading() const{
+    return bLoading;
+}
+
+void MeshLoader::checkProgress(){
+    if(!status.isNull()) emit progressChanged(status->progress());
+}
+
+void MeshLoader::deliver(int request, void* mesh){
+    if(request != currentRequest.load()){ // result of cancelled request
+        delete (Mesh*)mesh;
+        return;
+    }
+    progressTimer.stop();
+    status.clear();
+    bLoading = false;
+    emit meshLoaded((Mesh*)mesh);
+}
@@ -0,0 +1,49 @@
+#ifndef MESHLOADER_H
+#define MESHLOADER_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QSharedPointer>
+#include <QTimer>
+#include "utils/Mesh.hpp"
+
+/**
+ * @brief The MeshLoader class reads and processes OBJ files in a worker
+ * thread (parsing, tangents, smoothed normals, disk cache), so the GUI and the
+ * 3D view stay interactive. The delivered mesh is not uploaded yet, this has
+ * to be done with Mesh::upload() in the GL thread. Each new request cancels
+ * the previous one: its processing stops at the next check and its result is
+ * dropped.
+ */
+class MeshLoader : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MeshLoader(QObject *parent = 0);
+    ~MeshLoader();
+
+    void load(const QString& dir, const QString& name);
+    void cancel();
+    bool isLoading() const;
+
+signals:
+    // the receiver takes the ownership, check Mesh::isProcessed() for errors
+    void meshLoaded(Mesh* mesh);
+    void progressChanged(int permille);
+
+private slots:
+    void deliver(int request, void* mesh);
+    void checkProgress();
+
+private:
+    class Task;
+
+    QThreadPool pool;
+    QAtomicInt  currentRequest; // requests with different ID are cancelled
+    QSharedPointer<LoadStatus> status; // status of the current request
+    QTimer      progressTimer;
+    bool        bLoading;
+};
+
+#endif // MESHLOADER_H
@@ -160,6 +160,17 @@ void Dialog3DGeneralSettings::setUniforms(){
     parsedShader->setParsedUniforms();
 }
 
+bool Dialog3DGeneralSettings::uniformsChanged(){
+    GLSLShaderParser* parsedShader = currentRenderShader;
+    int maxParams      = settings3D->ParsedShader.MaxParams;
+    int noParsedParams = parsedShader->uniforms.size();
+    for(int i = 0 ; i < qMin(noParsedParams,maxParams) ; i++){
+        QtnPropertyFloat* p = (QtnPropertyFloat*)(settings3D->ParsedShader.findChildProperty(i+1));
+        if(parsedShader->uniforms[i].value != (float)p->value()) return true;
+    }
+    return false;
+}
+
 Dialog3DGeneralSettings::~Dialog3DGeneralSettings()
 {
     qDebug() << "calling" << Q_FUNC_INFO;
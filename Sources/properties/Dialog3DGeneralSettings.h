@@ -33,6 +33,7 @@ public slots:
     void shaderChanged(int index);
     static void updateParsedShaders();
     static void setUniforms();
+    static bool uniformsChanged(); // true if parameters differ from the ones set by setUniforms()
 signals:
     void signalPropertyChanged();
     void signalRecompileCustomShader();
@@ -0,0 +1,177 @@
+#ifndef IMAGEPARAMETERS_H
+#define IMAGEPARAMETERS_H
+
+#include <QColor>
+#include <type_traits>
+#include "ImageProperties.peg.h"
+
+/**
+ * List of all numeric settings of QtnPropertySetFormImageProp (see
+ * ImageProperties.pef): PARAM(type, field name, property path). Strings and
+ * buttons are not listed, they are shared by all materials. Enums are stored
+ * as int and colors as QRgb. The build runs check_image_parameters.py, which
+ * fails when the list does not match the numeric properties of the pef file.
+ */
+#define IMAGE_PARAMETERS(PARAM) \
+    PARAM(int,   ImageType,                                   ImageType) \
+    PARAM(int,   GrungeOnImage_BlendingMode,                  GrungeOnImage.BlendingMode) \
+    PARAM(float, GrungeOnImage_ImageWeight,                   GrungeOnImage.ImageWeight) \
+    PARAM(float, GrungeOnImage_GrungeWeight,                  GrungeOnImage.GrungeWeight) \
+    PARAM(float, Grunge_OverallWeight,                        Grunge.OverallWeight) \
+    PARAM(int,   Grunge_Randomize,                            Grunge.Randomize) \
+    PARAM(float, Grunge_Scale,                                Grunge.Scale) \
+    PARAM(float, Grunge_NormalWarp,                           Grunge.NormalWarp) \
+    PARAM(bool,  Grunge_RandomTranslations,                   Grunge.RandomTranslations) \
+    PARAM(bool,  Grunge_ReplotAll,                            Grunge.ReplotAll) \
+    PARAM(bool,  Basic_GrayScale_EnableGrayScale,             Basic.GrayScale.EnableGrayScale) \
+    PARAM(float, Basic_GrayScale_GrayScaleR,                  Basic.GrayScale.GrayScaleR) \
+    PARAM(float, Basic_GrayScale_GrayScaleG,                  Basic.GrayScale.GrayScaleG) \
+    PARAM(float, Basic_GrayScale_GrayScaleB,                  Basic.GrayScale.GrayScaleB) \
+    PARAM(bool,  Basic_ColorComponents_InvertAll,             Basic.ColorComponents.InvertAll) \
+    PARAM(bool,  Basic_ColorComponents_InvertRed,             Basic.ColorComponents.InvertRed) \
+    PARAM(bool,  Basic_ColorComponents_InvertBlue,            Basic.ColorComponents.InvertBlue) \
+    PARAM(bool,  Basic_ColorComponents_InvertGreen,           Basic.ColorComponents.InvertGreen) \
+    PARAM(float, Basic_ColorHue,                              Basic.ColorHue) \
+    PARAM(int,   Basic_EnhanceDetails,                        Basic.EnhanceDetails) \
+    PARAM(float, Basic_SmallDetails,                          Basic.SmallDetails) \
+    PARAM(float, Basic_MediumDetails,                         Basic.MediumDetails) \
+    PARAM(float, Basic_DetailDepth,                           Basic.DetailDepth) \
+    PARAM(int,   Basic_SharpenBlur,                           Basic.SharpenBlur) \
+    PARAM(float, Basic_NormalsStep,                           Basic.NormalsStep) \
+    PARAM(bool,  EnableRemoveShading,                         EnableRemoveShading) \
+    PARAM(int,   RemoveShading_RemoveShadingByGaussian,       RemoveShading.RemoveShadingByGaussian) \
+    PARAM(float, RemoveShading_AOCancellation,                RemoveShading.AOCancellation) \
+    PARAM(float, RemoveShading_LowFrequencyFilterBlending,    RemoveShading.LowFrequencyFilterBlending) \
+    PARAM(float, RemoveShading_LowFrequencyFilterRadius,      RemoveShading.LowFrequencyFilterRadius) \
+    PARAM(bool,  ColorLevels_EnableNormalization,             ColorLevels.EnableNormalization) \
+    PARAM(float, ColorLevels_MinValue,                        ColorLevels.MinValue) \
+    PARAM(float, ColorLevels_MaxValue,                        ColorLevels.MaxValue) \
+    PARAM(float, ColorLevels_DetailsRadius,                   ColorLevels.DetailsRadius) \
+    PARAM(float, ColorLevels_Offset,                          ColorLevels.Offset) \
+    PARAM(bool,  SurfaceDetails_EnableSurfaceDetails,         SurfaceDetails.EnableSurfaceDetails) \
+    PARAM(float, SurfaceDetails_WeightA,                      SurfaceDetails.WeightA) \
+    PARAM(float, SurfaceDetails_WeightB,                      SurfaceDetails.WeightB) \
+    PARAM(int,   SurfaceDetails_Radius,                       SurfaceDetails.Radius) \
+    PARAM(float, SurfaceDetails_Contrast,                     SurfaceDetails.Contrast) \
+    PARAM(float, SurfaceDetails_Amplifier,                    SurfaceDetails.Amplifier) \
+    PARAM(int,   AO_NumIters,                                 AO.NumIters) \
+    PARAM(float, AO_Intensity,                                AO.Intensity) \
+    PARAM(float, AO_Bias,                                     AO.Bias) \
+    PARAM(float, AO_Depth,                                    AO.Depth) \
+    PARAM(bool,  NormalsMixer_EnableMixer,                    NormalsMixer.EnableMixer) \
+    PARAM(float, NormalsMixer_Depth,                          NormalsMixer.Depth) \
+    PARAM(float, NormalsMixer_Scale,                          NormalsMixer.Scale) \
+    PARAM(float, NormalsMixer_Angle,                          NormalsMixer.Angle) \
+    PARAM(float, NormalsMixer_PosX,                           NormalsMixer.PosX) \
+    PARAM(float, NormalsMixer_PosY,                           NormalsMixer.PosY) \
+    PARAM(bool,  BaseMapToOthers_EnableConversion,            BaseMapToOthers.EnableConversion) \
+    PARAM(bool,  BaseMapToOthers_EnableHeightPreview,         BaseMapToOthers.EnableHeightPreview) \
+    PARAM(float, BaseMapToOthers_WeightSmall,                 BaseMapToOthers.WeightSmall) \
+    PARAM(float, BaseMapToOthers_WeightMedium,                BaseMapToOthers.WeightMedium) \
+    PARAM(float, BaseMapToOthers_WeightBig,                   BaseMapToOthers.WeightBig) \
+    PARAM(float, BaseMapToOthers_WeightHuge,                  BaseMapToOthers.WeightHuge) \
+    PARAM(int,   BaseMapToOthers_ImageDetails,                BaseMapToOthers.ImageDetails) \
+    PARAM(float, BaseMapToOthers_LevelSmall_PreSmoothRadius,  BaseMapToOthers.LevelSmall.PreSmoothRadius) \
+    PARAM(float, BaseMapToOthers_LevelSmall_FilterRadius,     BaseMapToOthers.LevelSmall.FilterRadius) \
+    PARAM(int,   BaseMapToOthers_LevelSmall_NumIters,         BaseMapToOthers.LevelSmall.NumIters) \
+    PARAM(float, BaseMapToOthers_LevelSmall_Amplitude,        BaseMapToOthers.LevelSmall.Amplitude) \
+    PARAM(float, BaseMapToOthers_LevelSmall_Flatness,         BaseMapToOthers.LevelSmall.Flatness) \
+    PARAM(float, BaseMapToOthers_LevelSmall_Edges,            BaseMapToOthers.LevelSmall.Edges) \
+    PARAM(float, BaseMapToOthers_LevelSmall_Blending,         BaseMapToOthers.LevelSmall.Blending) \
+    PARAM(float, BaseMapToOthers_LevelMedium_PreSmoothRadius, BaseMapToOthers.LevelMedium.PreSmoothRadius) \
+    PARAM(float, BaseMapToOthers_LevelMedium_FilterRadius,    BaseMapToOthers.LevelMedium.FilterRadius) \
+    PARAM(int,   BaseMapToOthers_LevelMedium_NumIters,        BaseMapToOthers.LevelMedium.NumIters) \
+    PARAM(float, BaseMapToOthers_LevelMedium_Amplitude,       BaseMapToOthers.LevelMedium.Amplitude) \
+    PARAM(float, BaseMapToOthers_LevelMedium_Flatness,        BaseMapToOthers.LevelMedium.Flatness) \
+    PARAM(float, BaseMapToOthers_LevelMedium_Edges,           BaseMapToOthers.LevelMedium.Edges) \
+    PARAM(float, BaseMapToOthers_LevelMedium_Blending,        BaseMapToOthers.LevelMedium.Blending) \
+    PARAM(float, BaseMapToOthers_LevelBig_PreSmoothRadius,    BaseMapToOthers.LevelBig.PreSmoothRadius) \
+    PARAM(float, BaseMapToOthers_LevelBig_FilterRadius,       BaseMapToOthers.LevelBig.FilterRadius) \
+    PARAM(int,   BaseMapToOthers_LevelBig_NumIters,           BaseMapToOthers.LevelBig.NumIters) \
+    PARAM(float, BaseMapToOthers_LevelBig_Amplitude,          BaseMapToOthers.LevelBig.Amplitude) \
+    PARAM(float, BaseMapToOthers_LevelBig_Flatness,           BaseMapToOthers.LevelBig.Flatness) \
+    PARAM(float, BaseMapToOthers_LevelBig_Edges,              BaseMapToOthers.LevelBig.Edges) \
+    PARAM(float, BaseMapToOthers_LevelBig_Blending,           BaseMapToOthers.LevelBig.Blending) \
+    PARAM(float, BaseMapToOthers_LevelHuge_PreSmoothRadius,   BaseMapToOthers.LevelHuge.PreSmoothRadius) \
+    PARAM(float, BaseMapToOthers_LevelHuge_FilterRadius,      BaseMapToOthers.LevelHuge.FilterRadius) \
+    PARAM(int,   BaseMapToOthers_LevelHuge_NumIters,          BaseMapToOthers.LevelHuge.NumIters) \
+    PARAM(float, BaseMapToOthers_LevelHuge_Amplitude,         BaseMapToOthers.LevelHuge.Amplitude) \
+    PARAM(float, BaseMapToOthers_LevelHuge_Flatness,          BaseMapToOthers.LevelHuge.Flatness) \
+    PARAM(float, BaseMapToOthers_LevelHuge_Edges,             BaseMapToOthers.LevelHuge.Edges) \
+    PARAM(float, BaseMapToOthers_LevelHuge_Blending,          BaseMapToOthers.LevelHuge.Blending) \
+    PARAM(float, BaseMapToOthers_AngleWeight,                 BaseMapToOthers.AngleWeight) \
+    PARAM(float, BaseMapToOthers_AngleCorrection,             BaseMapToOthers.AngleCorrection) \
+    PARAM(float, BaseMapToOthers_ColorBalance,                BaseMapToOthers.ColorBalance) \
+    PARAM(QRgb,  BaseMapToOthers_MinColor,                    BaseMapToOthers.MinColor) \
+    PARAM(QRgb,  BaseMapToOthers_MaxColor,                    BaseMapToOthers.MaxColor) \
+    PARAM(int,   RMFilter_Filter,                             RMFilter.Filter) \
+    PARAM(float, RMFilter_NoiseFilter_Depth,                  RMFilter.NoiseFilter.Depth) \
+    PARAM(float, RMFilter_NoiseFilter_Treshold,               RMFilter.NoiseFilter.Treshold) \
+    PARAM(float, RMFilter_NoiseFilter_Amplifier,              RMFilter.NoiseFilter.Amplifier) \
+    PARAM(bool,  RMFilter_ColorFilter_InvertColors,           RMFilter.ColorFilter.InvertColors) \
+    PARAM(QRgb,  RMFilter_ColorFilter_PickColor,              RMFilter.ColorFilter.PickColor) \
+    PARAM(int,   RMFilter_ColorFilter_Method,                 RMFilter.ColorFilter.Method) \
+    PARAM(float, RMFilter_ColorFilter_Bias,                   RMFilter.ColorFilter.Bias) \
+    PARAM(float, RMFilter_ColorFilter_Amplifier,              RMFilter.ColorFilter.Amplifier) \
+    PARAM(float, RMFilter_ColorFilter_Offset,                 RMFilter.ColorFilter.Offset) \
+    PARAM(int,   NormalHeightConv_NoiseLevel,                 NormalHeightConv.NoiseLevel) \
+    PARAM(int,   NormalHeightConv_Huge,                       NormalHeightConv.Huge) \
+    PARAM(int,   NormalHeightConv_VeryLarge,                  NormalHeightConv.VeryLarge) \
+    PARAM(int,   NormalHeightConv_Large,                      NormalHeightConv.Large) \
+    PARAM(int,   NormalHeightConv_Medium,                     NormalHeightConv.Medium) \
+    PARAM(int,   NormalHeightConv_Small,                      NormalHeightConv.Small) \
+    PARAM(int,   NormalHeightConv_VerySmall,                  NormalHeightConv.VerySmall)
+
+/**
+ * @brief The ImageParameters struct is a flat, trivially copyable copy of the
+ * image settings. It is used to keep settings of each material and to upload
+ * them to the GPU. Only the visible image has its settings in the property set
+ * which is bound to the UI, switching material copies one struct.
+ */
+struct ImageParameters{
+#define IMAGE_PARAMETER_FIELD(type, name, path) type name;
+    IMAGE_PARAMETERS(IMAGE_PARAMETER_FIELD)
+#undef IMAGE_PARAMETER_FIELD
+
+    // Read all values from the property set.
+    void fromProperties(const QtnPropertySetFormImageProp& p){
+#define IMAGE_PARAMETER_GET(type, name, path) name = getValue(p.path);
+        IMAGE_PARAMETERS(IMAGE_PARAMETER_GET)
+#undef IMAGE_PARAMETER_GET
+    }
+
+    // Write all values to the property set.
+    void toProperties(QtnPropertySetFormImageProp& p) const{
+#define IMAGE_PARAMETER_SET(type, name, path) setValue(p.path,name);
+        IMAGE_PARAMETERS(IMAGE_PARAMETER_SET)
+#undef IMAGE_PARAMETER_SET
+    }
+
+    bool operator==(const ImageParameters& other) const{
+#define IMAGE_PARAMETER_COMPARE(type, name, path) if(name != other.name) return false;
+        IMAGE_PARAMETERS(IMAGE_PARAMETER_COMPARE)
+#undef IMAGE_PARAMETER_COMPARE
+        return true;
+    }
+    bool operator!=(const ImageParameters& other) const{
+        return !(*this == other);
+    }
+
+private:
+    static float getValue(const QtnPropertyFloat& p){ return p.value(); }
+    static int   getValue(const QtnPropertyInt&   p){ return p.value(); }
+    static bool  getValue(const QtnPropertyBool&  p){ return p.value(); }
+    static int   getValue(const QtnPropertyEnum&  p){ return p.value(); }
+    static QRgb  getValue(const QtnPropertyQColor& p){ return p.value().rgba(); }
+
+    static void setValue(QtnPropertyFloat& p, float v){ p.setValue(v); }
+    static void setValue(QtnPropertyInt&   p, int   v){ p.setValue(v); }
+    static void setValue(QtnPropertyBool&  p, bool  v){ p.setValue(v); }
+    static void setValue(QtnPropertyEnum&  p, int   v){ p.setValue(v); }
+    static void setValue(QtnPropertyQColor& p, QRgb v){ p.setValue(QColor::fromRgba(v)); }
+};
+
+static_assert(std::is_trivially_copyable<ImageParameters>::value,
+              "ImageParameters has to be copied with memcpy");
+
+#endif // IMAGEPARAMETERS_H
@@ -0,0 +1,124 @@
+#!/usr/bin/env python
+"""
+Checks that the IMAGE_PARAMETERS list in ImageParameters.h contains every
+numeric property of the FormImageProp set in ImageProperties.pef, with the
+matching type and field name. Run by the build, fails when they differ.
+
+usage: check_image_parameters.py ImageProperties.pef ImageParameters.h
+"""
+import re
+import sys
+
+# pef property type -> type of the ImageParameters field, None when the
+# property is not stored per material (strings and buttons)
+FIELD_TYPES = {
+    "Bool":    "bool",
+    "Int":     "int",
+    "Float":   "float",
+    "Enum":    "int",
+    "QColor":  "QRgb",
+    "ABColor": "QRgb",
+    "QString": None,
+    "Button":  None,
+}
+
+TOKEN = re.compile(r'//[^\n]*|/\*.*?\*/|"(?:\\.|[^"\\])*"|[A-Za-z_]\w*|\S', re.S)
+
+
+def tokenize(text):
+    lines = [l for l in text.splitlines() if not l.lstrip().startswith("#")]
+    for token in TOKEN.findall("\n".join(lines)):
+        if token.startswith("//") or token.startswith("/*") or token.startswith('"'):
+            continue
+        yield token
+
+
+def skip_block(tokens, i):
+    """Returns index after the block which starts at tokens[i] == '{'."""
+    depth = 0
+    while i < len(tokens):
+        if tokens[i] == "{":
+            depth += 1
+        elif tokens[i] == "}":
+            depth -= 1
+            if depth == 0:
+                return i + 1
+        i += 1
+    raise ValueError("unbalanced braces")
+
+
+def parse_sets(tokens):
+    """Returns {set name: [(kind, type or set name, member name)]}."""
+    sets = {}
+    i = 0
+    while i < len(tokens):
+        if tokens[i] == "property_set":
+            name = tokens[i + 1]
+            i += 2
+            members = []
+            sets[name] = members
+            assert tokens[i] == "{", name
+            i += 1
+            while tokens[i] != "}":
+                if tokens[i] == "extern":
+                    # extern property_set SetName MemberName { ... }
+                    members.append(("set", tokens[i + 2], tokens[i + 3]))
+                    i += 4
+                elif tokens[i] in FIELD_TYPES:
+                    members.append(("value", tokens[i], tokens[i + 1]))
+                    i += 2
+                else:
+                    i += 1  # attributes of the set, e.g. displayName = ...;
+                    continue
+                if tokens[i] == "{":
+                    i = skip_block(tokens, i)
+            i += 1
+        elif tokens[i] == "{":
+            i = skip_block(tokens, i)  # enums
+        else:
+            i += 1
+    return sets
+
+
+def flatten(sets, name, prefix=""):
+    for kind, type_name, member in sets[name]:
+        path = prefix + member
+        if kind == "set":
+            for item in flatten(sets, type_name, path + "."):
+                yield item
+        elif FIELD_TYPES[type_name] is not None:
+            yield path, FIELD_TYPES[type_name]
+
+
+def main(pef_file, header_file):
+    with open(pef_file) as f:
+        sets = parse_sets(list(tokenize(f.read())))
+    expected = dict(flatten(sets, "FormImageProp"))
+
+    with open(header_file) as f:
+        header = f.read()
+    listed = {}
+    errors = []
+    for type_name, name, path in re.findall(r"PARAM\(\s*(\w+)\s*,\s*(\w+)\s*,\s*([\w.]+)\s*\)", header):
+        listed[path] = type_name
+        if name != path.replace(".", "_"):
+            errors.append("%s: field name should be %s" % (name, path.replace(".", "_")))
+
+    for path in sorted(set(expected) - set(listed)):
+        errors.append("%s (%s) is missing in IMAGE_PARAMETERS" % (path, expected[path]))
+    for path in sorted(set(listed) - set(expected)):
+        errors.append("%s is not a numeric property of FormImageProp" % path)
+    for path in sorted(set(listed) & set(expected)):
+        if listed[path] != expected[path]:
+            errors.append("%s has type %s, expected %s" % (path, listed[path], expected[path]))
+
+    for error in errors:
+        sys.stderr.write("%s: error: %s\n" % (header_file, error))
+    return 1 if errors else 0
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 3:
+        sys.stderr.write(__doc__)
+        sys.exit(2)
+    sys.exit(main(sys.argv[1], sys.argv[2]))
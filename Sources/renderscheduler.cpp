@@ -0,0 +1,112 @@
+#include "renderscheduler.h"
+
+RenderScheduler::RenderScheduler(QObject *parent) :
+    QObject(parent),
+    bFrameInFlight(false),
+    frameType(-1),
+    frameInterval(16),
+    noRequests(0),
+    noRenders(0),
+    noDropped(0),
+    lastRenderTime(0.0),
+    averageRenderTime(0.0)
+{
+    frameTimer.setSingleShot(true);
+    connect(&frameTimer,SIGNAL(timeout()),this,SLOT(flush()));
+    lastFlushTimer.start();
+}
+
+void RenderScheduler::setFrameInterval(int msec){
+    frameInterval = qMax(0,msec);
+}
+
+int RenderScheduler::getFrameInterval() const{
+    return frameInterval;
+}
+
+int RenderScheduler::getNoRequests() const{
+    return noRequests;
+}
+
+int RenderScheduler::getNoRenders() const{
+    return noRenders;
+}
+
+int RenderScheduler::getNoDropped() const{
+    return noDropped;
+}
+
+double RenderScheduler::getLastRenderTime() const{
+    return lastRenderTime;
+}
+
+double RenderScheduler::getAverageRenderTime() const{
+    return averageRenderTime;
+}
+
+bool RenderScheduler::isPending() const{
+    return !dirtyTypes.isEmpty();
+}
+
+void RenderScheduler::invalidate(int tType){
+    noRequests++;
+    if(dirtyTypes.contains(tType)){
+        noDropped++; // previous state was never displayed
+    }else{
+        dirtyTypes.append(tType);
+    }
+
+    if(frameTimer.isActive()) return;
+    // wait until the end of the current frame, if the last render took longer
+    // than one frame the next one is started as soon as the event loop is free
+    int delay = frameInterval - int(lastFlushTimer.elapsed());
+    frameTimer.start(qMax(0,delay));
+}
+
+void RenderScheduler::cancel(){
+    frameTimer.stop();
+    noDropped += dirtyTypes.size();
+    dirtyTypes.clear();
+}
+
+void RenderScheduler::flush(){
+    frameTimer.stop();
+    if(dirtyTypes.isEmpty()) return;
+    // do not queue another pipeline while the GPU is still busy, the frame
+    // is rescheduled by renderFinished. Frames which were never finished
+    // (e.g. nothing was rendered) block the queue for a few frames only.
+    int maxWait = 8*qMax(frameInterval,16);
+    if(bFrameInFlight && lastFlushTimer.elapsed() < maxWait){
+        frameTimer.start(maxWait - int(lastFlushTimer.elapsed()));
+        return;
+    }
+    lastFlushTimer.restart();
+
+    // other dirty types and new invalidations go to the next frames
+    int tType = dirtyTypes.takeFirst();
+    bFrameInFlight = true;
+    frameType      = tType;
+    emit renderRequested(tType);
+    noRenders++;
+
+    if(!dirtyTypes.isEmpty()) frameTimer.start(frameInterval);
+}
+
+void RenderScheduler::renderFinished(int tType, double msec){
+    if(!bFrameInFlight || tType != frameType) return; // not requested by the scheduler
+    bFrameInFlight = false;
+
+    averageRenderTime = (averageRenderTime == 0.0) ? msec
+                                                   : 0.9*averageRenderTime + 0.1*msec;
+    lastRenderTime    = msec;
+
+    QString info = QString("Render:") + QString::number(lastRenderTime,'f',1) + QString("[ms]")
+                 + QString(" Avg:") + QString::number(averageRenderTime,'f',1) + QString("[ms]")
+                 + QString(" Dropped:") + QString::number(noDropped) + QString("/") + QString::number(noRequests);
+    emit statisticsChanged(info);
+
+    if(!dirtyTypes.isEmpty()){
+        int delay = frameInterval - int(lastFlushTimer.elapsed());
+        frameTimer.start(qMax(0,delay));
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef RENDERSCHEDULER_H
+#define RENDERSCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QList>
+
+/**
+ * @brief The RenderScheduler class collects image invalidations coming from the
+ * property widgets and replots them at most once per display frame. Repeated
+ * invalidations of the same texture type between two frames are collapsed into
+ * a single render which is always done on the latest state of the properties.
+ * Collapsed requests are counted as dropped.
+ * Only one texture type is rendered per frame, the next one is started when the
+ * GPU finished the frame of the requested type (see renderFinished) so the
+ * pipelines of several textures are never queued at once. Maps attached to the
+ * rendered one are invalidated again by the receiver and go to the next frames.
+ */
+class RenderScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RenderScheduler(QObject *parent = 0);
+
+    // Minimal time between two pipeline executions (default 60 FPS).
+    void setFrameInterval(int msec);
+    int  getFrameInterval() const;
+
+    int    getNoRequests() const;
+    int    getNoRenders() const;
+    int    getNoDropped() const;
+    // Duration of the last and averaged render in milliseconds, measured from
+    // the submission until the GPU finished the frame.
+    double getLastRenderTime() const;
+    double getAverageRenderTime() const;
+    bool   isPending() const;
+
+signals:
+    // Emitted once per frame for the oldest invalidated texture type.
+    void renderRequested(int tType);
+    void statisticsChanged(const QString& info);
+
+public slots:
+    // Marks given texture type as dirty. Rendering is postponed to the next frame.
+    void invalidate(int tType);
+    // Forget all pending invalidations e.g. when all images were replotted anyway.
+    void cancel();
+    // Render the oldest pending invalidation, the others go to the next frames.
+    void flush();
+    // Called when the frame of tType was finished by the GPU, frames of
+    // other types (e.g. replot of all images) are ignored.
+    void renderFinished(int tType, double msec);
+
+private:
+    QTimer        frameTimer;
+    QElapsedTimer lastFlushTimer;
+    QList<int>    dirtyTypes; // in order of invalidation
+    bool   bFrameInFlight; // rendered frame was not finished by the GPU yet
+    int    frameType;      // texture type of the frame in flight
+    int    frameInterval;
+    int    noRequests;
+    int    noRenders;
+    int    noDropped;
+    double lastRenderTime;
+    double averageRenderTime;
+};
+
+#endif // RENDERSCHEDULER_H
@@ -0,0 +1,170 @@
+#include "renderthread.h"
+#include "qopenglerrorcheck.h"
+#include <QOpenGLFunctions_3_3_Core>
+#include <QCoreApplication>
+#include <QDebug>
+
+RenderThread* RenderThread::renderThread = NULL;
+QMutex        RenderThread::publishMutex;
+QMutex        RenderThread::fenceMutex;
+QMap<QOpenGLContext*,GLsync> RenderThread::readFences;
+
+RenderThread::RenderThread(QOpenGLContext* shareContext, QObject *parent) :
+    QThread(parent),
+    runningKey(0),
+    noDropped(0),
+    bStop(false)
+{
+    context = new QOpenGLContext();
+    context->setFormat(shareContext->format());
+    context->setShareContext(shareContext);
+    if(!context->create()){
+        qWarning() << "RenderThread:: cannot create shared context.";
+    }
+    surface = new QOffscreenSurface();
+    surface->setFormat(context->format());
+    surface->create();
+    context->moveToThread(this);
+    renderThread = this;
+}
+
+RenderThread::~RenderThread(){
+    stop();
+    if(renderThread == this) renderThread = NULL;
+    delete context;
+    delete surface;
+}
+
+RenderThread* RenderThread::instance(){
+    return renderThread;
+}
+
+bool RenderThread::execute(const Job& job){
+    if(renderThread == NULL) return false;
+    renderThread->invoke(job);
+    return true;
+}
+
+void RenderThread::post(const Job& job, int key){
+    QMutexLocker locker(&mutex);
+    if(key != 0){
+        for(int i = 0 ; i < jobs.size() ; i++){
+            if(jobs[i].key != key) continue;
+            jobs.removeAt(i);
+            noDropped++;
+            break;
+        }
+    }
+    QueuedJob queued;
+    queued.job = job;
+    queued.key = key;
+    jobs.append(queued);
+    condition.wakeOne();
+}
+
+void RenderThread::invoke(const Job& job){
+    if(QThread::currentThread() == this){
+        job();
+        return;
+    }
+    if(!isRunning()){
+        // thread was stopped (exit), run the job here in the render context
+        QOpenGLContext* current        = QOpenGLContext::currentContext();
+        QSurface*       currentSurface = (current != NULL) ? current->surface() : NULL;
+        if(context->thread() == QThread::currentThread() && context->makeCurrent(surface)){
+            job();
+            context->doneCurrent();
+        }else{
+            qWarning() << "RenderThread:: render context is not available, job skipped.";
+        }
+        if(current != NULL) current->makeCurrent(currentSurface);
+        return;
+    }
+
+    bool bDone = false;
+    QueuedJob queued;
+    queued.key = 0;
+    queued.job = [&](){
+        job();
+        QMutexLocker locker(&mutex);
+        bDone = true;
+        doneCondition.wakeAll();
+    };
+    QMutexLocker locker(&mutex);
+    jobs.prepend(queued);
+    condition.wakeOne();
+    while(!bDone) doneCondition.wait(&mutex);
+}
+
+bool RenderThread::isStale(){
+    QMutexLocker locker(&mutex);
+    if(runningKey == 0) return false;
+    foreach(const QueuedJob& queued, jobs){
+        if(queued.key == runningKey) return true;
+    }
+    return false;
+}
+
+int RenderThread::getNoDropped(){
+    QMutexLocker locker(&mutex);
+    return noDropped;
+}
+
+void RenderThread::stop(){
+    mutex.lock();
+    bStop = true;
+    condition.wakeOne();
+    mutex.unlock();
+    wait();
+}
+
+void RenderThread::run(){
+    if(!context->isValid() || !context->makeCurrent(surface)){
+        qWarning() << "RenderThread:: cannot make the render context current.";
+    }
+
+    mutex.lock();
+    while(!bStop){
+        if(jobs.isEmpty()){
+            condition.wait(&mutex);
+            continue;
+        }
+        QueuedJob queued = jobs.takeFirst();
+        runningKey = queued.key;
+        mutex.unlock();
+        queued.job();
+        mutex.lock();
+        runningKey = 0;
+    }
+    // posted jobs are dropped, nobody waits for them
+    jobs.clear();
+    mutex.unlock();
+
+    context->doneCurrent();
+    context->moveToThread(QCoreApplication::instance()->thread());
+}
+
+void RenderThread::frontBuffersUsed(){
+    QOpenGLContext* current = QOpenGLContext::currentContext();
+    QOpenGLFunctions_3_3_Core* gl = (current != NULL) ? current->versionFunctions<QOpenGLFunctions_3_3_Core>() : NULL;
+    if(gl == NULL) return;
+
+    QMutexLocker locker(&fenceMutex);
+    GLsync& fence = readFences[current];
+    if(fence != 0) gl->glDeleteSync(fence);
+    fence = gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,0);
+    // the fence is waited for in the render context
+    gl->glFlush();
+}
+
+void RenderThread::waitForFrontBuffers(){
+    QOpenGLContext* current = QOpenGLContext::currentContext();
+    QOpenGLFunctions_3_3_Core* gl = (current != NULL) ? current->versionFunctions<QOpenGLFunctions_3_3_Core>() : NULL;
+    if(gl == NULL) return;
+
+    // does not block the CPU, the GPU waits before the next commands
+    QMutexLocker locker(&fenceMutex);
+    foreach(GLsync fence, readFences){
+        if(fence != 0) GLCHK( gl->glWaitSync(fence,0,GL_TIMEOUT_IGNORED) );
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef RENDERTHREAD_H
+#define RENDERTHREAD_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+#include <QMap>
+#include <QOpenGLContext>
+#include <QOffscreenSurface>
+#include <functional>
+
+/**
+ * @brief The RenderThread class runs the image processing in its own thread,
+ * with its own context shared with the 2D view. The context owns all FBOs and
+ * VAOs of the processing pipeline, other contexts may use only their textures.
+ * Jobs are queued by the GUI thread:
+ *  - post() returns immediately, a queued job which was not started yet is
+ *    replaced by a newer one with the same key (the stale request is dropped),
+ *  - invoke() waits for the job, it is used when the caller needs the result
+ *    (e.g. conversions, export or FBO creation).
+ * Results are published by swapping the front and back buffers under
+ * publishMutex, the GUI draws the front buffers only.
+ */
+class RenderThread : public QThread
+{
+    Q_OBJECT
+public:
+    typedef std::function<void()> Job;
+
+    // Has to be created in the GUI thread.
+    RenderThread(QOpenGLContext* shareContext, QObject *parent = 0);
+    ~RenderThread();
+
+    /**
+     * @brief post queues the job and returns. Queued job with the same key
+     * is dropped, jobs with key 0 are never dropped.
+     */
+    void post(const Job& job, int key = 0);
+    /**
+     * @brief invoke runs the job in the render context and waits until it is
+     * done. It is run before the posted jobs. Called from the render thread
+     * the job is run immediately and when the thread is not running (exit)
+     * the render context is made current in the calling thread.
+     */
+    void invoke(const Job& job);
+    // Render thread only: newer job with the key of the running one was posted.
+    bool isStale();
+    int  getNoDropped();
+    void stop();
+
+    // Render thread of the application, NULL when there is none.
+    static RenderThread* instance();
+    // Same as instance()->invoke(job), returns false when there is no render thread.
+    static bool execute(const Job& job);
+
+    // Guards the pointers of the front buffers. The render thread swaps
+    // them under this lock and the GUI holds it while it draws them.
+    static QMutex publishMutex;
+    // GUI: called in the current context after a draw which sampled the front buffers.
+    static void frontBuffersUsed();
+    // Render thread: the GPU waits for the draws of the front buffers, called
+    // before the back buffers (former front buffers) are written again.
+    static void waitForFrontBuffers();
+
+protected:
+    void run();
+
+private:
+    struct QueuedJob{
+        Job job;
+        int key;
+    };
+
+    QOpenGLContext*    context;
+    QOffscreenSurface* surface;
+    QMutex           mutex;
+    QWaitCondition   condition;     // new job or stop
+    QWaitCondition   doneCondition; // invoked job finished
+    QList<QueuedJob> jobs;
+    int              runningKey;
+    int              noDropped;
+    bool             bStop;
+
+    static RenderThread* renderThread;
+    static QMutex fenceMutex;
+    static QMap<QOpenGLContext*,GLsync> readFences; // last draw of the front buffers in each context
+};
+
+#endif // RENDERTHREAD_H
@@ -0,0 +1,82 @@
+#version 330 core
+
+// Uniform variables
+uniform samplerCube texEnv;
+uniform float roughness; // roughness of the baked mipmap level
+
+
+// output color
+out vec4 FragColor;
+
+// input variables
+in vec3 WSNormal;
+
+
+const float PI         = 3.1415926;
+const uint  NO_SAMPLES = 128u;
+
+// Low discrepancy sequence, see:
+// http://holger.dammertz.org/stuff/notes_HammersleyOnHemisphere.html
+vec2 hammersley(uint i){
+    uint bits = i;
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return vec2(float(i)/float(NO_SAMPLES), float(bits) * 2.3283064365386963e-10);
+}
+
+vec3 importanceSampleGGX(vec2 Xi, float alpha, vec3 N, vec3 T, vec3 B){
+    float phi      = 2 * PI * Xi.x;
+    float cosTheta = sqrt((1 - Xi.y) / (1 + (alpha*alpha - 1) * Xi.y));
+    float sinTheta = sqrt(1 - cosTheta * cosTheta);
+    return normalize(sinTheta * cos(phi) * T + sinTheta * sin(phi) * B + cosTheta * N);
+}
+
+float GGX_Distribution(float NdotH, float alpha){
+    float alpha2 = alpha * alpha;
+    float den    = NdotH * NdotH * (alpha2 - 1) + 1;
+    return alpha2 / (PI * den * den);
+}
+
+// Prefiltered radiance for the split-sum approximation (N = V = R), based on:
+// http://blog.selfshadow.com/publications/s2013-shading-course/karis/s2013_pbs_epic_notes_v2.pdf
+// Samples are taken from the mipmaps of the source map (filtered importance sampling)
+// so few samples are enough even for very rough surfaces.
+void main( void )
+{
+    vec3 N = normalize(WSNormal);
+    if(roughness <= 0.0){
+        FragColor = vec4(textureLod(texEnv, N, 0).rgb,1);
+        return;
+    }
+
+    // trick with tangent space
+    vec3 T = mix(vec3(1,0,0),vec3(0,1,0),abs(N.y));
+    vec3 B = normalize(cross(T,N));
+    T      = cross(N,B);
+
+    float alpha     = roughness * roughness;
+    float size      = float(textureSize(texEnv,0).x);
+    float saTexel   = 4 * PI / (6 * size * size);
+
+    vec3  color  = vec3(0);
+    float weight = 0;
+    for(uint i = 0u ; i < NO_SAMPLES ; i++){
+        vec3 H      = importanceSampleGGX(hammersley(i), alpha, N, T, B);
+        vec3 L      = 2 * dot(N,H) * H - N;
+        float NdotL = dot(N,L);
+        if(NdotL > 0){
+            // for N = V the pdf of L is D/4
+            float NdotH    = max(dot(N,H),0.0);
+            float pdf      = GGX_Distribution(NdotH, alpha) / 4;
+            float saSample = 1.0 / (float(NO_SAMPLES) * pdf + 0.0001);
+            float lod      = max(0.5 * log2(saSample / saTexel) + 1.0, 0.0);
+
+            color  += textureLod(texEnv, L, lod).rgb * NdotL;
+            weight += NdotL;
+        }
+    }
+    FragColor = vec4(color / max(weight,0.001),1);
+}
@@ -8,7 +8,41 @@ uniform sampler2D layerA; // first layer
 uniform sampler2D layerB; // second layer
 uniform sampler2D layerC; // third layer
 uniform sampler2D layerD; // fourth layer
-uniform sampler2D materialTexture; // texture with material mask
+uniform usampler2D materialIdTexture; // material ID of each pixel
+
+// Batch mode: all materials are processed in one pass, each pixel takes
+// its settings from the row of materialParameters of its material.
+// Indices must match MaterialParameter enum in glimageeditor.h
+#define MATERIALS_BATCH               -20
+#define MATERIAL_PARAM_HUE             0
+#define MATERIAL_PARAM_SMALL_DETAILS   1
+#define MATERIAL_PARAM_MEDIUM_DETAILS  2
+#define MATERIAL_PARAM_CONTRAST        3
+#define MATERIAL_PARAM_INVERT_R        4
+#define MATERIAL_PARAM_NORMALS_STEP    7
+#define MATERIAL_PARAM_HEIGHT_MIN      8
+#define MATERIAL_PARAM_HEIGHT_MAX      9
+#define MATERIAL_PARAM_HEIGHT_OFFSET   10
+#define MATERIAL_PARAM_ROUGHNESS_TRESHOLD  11
+#define MATERIAL_PARAM_ROUGHNESS_AMPLIFIER 12
+#define MATERIAL_PARAM_NORMALIZE_MIN   13
+#define MATERIAL_PARAM_NORMALIZE_MAX   16
+#define MATERIAL_PARAMS_COUNT          19
+
+uniform samplerBuffer materialParameters;
+uniform int material_count; // number of rows in materialParameters
+int materialSlot = -1; // row of the current pixel material, -1 if batch is disabled
+
+float materialParameter(int param, float value){
+    if(materialSlot < 0) return value;
+    return texelFetch(materialParameters, materialSlot*MATERIAL_PARAMS_COUNT + param).r;
+}
+vec3 materialParameter3(int param, vec3 value){
+    if(materialSlot < 0) return value;
+    return vec3(materialParameter(param  ,value.r),
+                materialParameter(param+1,value.g),
+                materialParameter(param+2,value.b));
+}
 
 uniform int quad_draw_mode;
 
@@ -176,7 +210,7 @@ vec4 ffilter(){
 
    vec4 textureColor = texture( layerA, v2QuadCoords.xy);
    vec3 hsv = rgbToHsv(textureColor.r,textureColor.g,textureColor.b);
-   hsv.r +=  (gui_hue);
+   hsv.r +=  materialParameter(MATERIAL_PARAM_HUE,gui_hue);
    vec3 rgb = clamp(hsvToRgb(hsv.r,hsv.g,hsv.b),vec3(-1.0),vec3(1.0));
    return vec4(clamp(rgb,vec3(0),vec3(1)),1);
 
@@ -296,11 +330,12 @@ vec4 ffilter(){
 #endif
 
     vec4 color = texture( layerA, v2QuadCoords.xy);
+    vec3 inverted_components = materialParameter3(MATERIAL_PARAM_INVERT_R,gui_inverted_components);
     vec4 inversion;
     if(gui_image_type == 3){
-            inversion = vec4(gui_inverted_components.r,gui_inverted_components.r,gui_inverted_components.r,0);
+            inversion = vec4(inverted_components.r,inverted_components.r,inverted_components.r,0);
     }else{
-            inversion = vec4(gui_inverted_components,0);
+            inversion = vec4(inverted_components,0);
     }
     vec4 ocolor = inversion - color * inversion;
     ocolor += color*(1-inversion);
@@ -336,7 +371,7 @@ vec4 ffilter(){
 //
 // ----------------------------------------------------------------
 
-uniform vec3 average_color;
+// layerC: downscaled input with mipmaps, its last level is the average color
 uniform float gui_remove_shading_lf_blending;
 
 #ifndef mode_remove_low_freq_filter_330
@@ -350,6 +385,8 @@ vec4 ffilter(){
 
     vec4 colorA   = texture( layerA, v2QuadCoords.xy);
     vec4 blured   = texture( layerB, v2QuadCoords.xy);
+    int  lastLevel     = int(log2(float(max(textureSize(layerC,0).x,textureSize(layerC,0).y))) + 0.001);
+    vec3 average_color = texelFetch( layerC, ivec2(0,0), lastLevel).rgb;
     vec4 finalColor = colorA + (vec4(average_color,1) - blured);
 
     return mix(colorA,finalColor,gui_remove_shading_lf_blending);
@@ -743,7 +780,7 @@ vec4 ffilter(){
 #endif
 
     vec4 color = texture( layerA, v2QuadCoords.xy);
-    vec4 icolor = contrast_filter(color,gui_specular_contrast);
+    vec4 icolor = contrast_filter(color,materialParameter(MATERIAL_PARAM_CONTRAST,gui_specular_contrast));
     icolor = clamp(icolor,vec4(0),vec4(1));
     return clamp(icolor+gui_specular_brightness,vec4(0),vec4(1));
 }
@@ -824,7 +861,9 @@ vec4 mode_normalize_filter(){
 vec4 ffilter(){
 #endif
     vec4 color = texture( layerA, v2QuadCoords.xy);
-    color.rgb =  ( color.rgb - min_color )/(max_color-min_color) ;
+    vec3 cmin = materialParameter3(MATERIAL_PARAM_NORMALIZE_MIN,min_color);
+    vec3 cmax = materialParameter3(MATERIAL_PARAM_NORMALIZE_MAX,max_color);
+    color.rgb =  ( color.rgb - cmin )/(cmax-cmin) ;
     color.a = 1;
     return color;
 }
@@ -875,7 +914,7 @@ vec4 ffilter(){
 
     vec4 colorA   = texture( layerA, v2QuadCoords.xy);
     vec4 colorB   =-texture( layerB, v2QuadCoords.xy);
-    vec4 colorC   = 1-20*gui_small_details*colorB;
+    vec4 colorC   = 1-20*materialParameter(MATERIAL_PARAM_SMALL_DETAILS,gui_small_details)*colorB;
     return clamp(overlay_filter(colorA,colorC*0.5),vec4(0),vec4(1));
 
 }
@@ -900,7 +939,7 @@ vec4 ffilter(){
     vec4 dog = bluredSmall - bluredBig;
 
     //return dog;
-    vec4 colorC   = 1+20*gui_small_details*dog;
+    vec4 colorC   = 1+20*materialParameter(MATERIAL_PARAM_MEDIUM_DETAILS,gui_small_details)*dog;
     return clamp(overlay_filter(colorA,colorC*0.5),vec4(0),vec4(1));
 }
 
@@ -952,7 +991,7 @@ vec4 ffilter(){
 	
         vec4 color = 2*(texture( layerA, v2QuadCoords.xy) - 0.5);
 
-        color.xy *= gui_normals_step;//(1+2*gui_normals_step);
+        color.xy *= materialParameter(MATERIAL_PARAM_NORMALS_STEP,gui_normals_step);//(1+2*gui_normals_step);
 
         color.xyz = normalize(color.xyz);
 
@@ -1331,13 +1370,16 @@ vec4 ffilter(){
     }}
     ave_color /= no_samples;
 
-    height = height_clamp(height,ave_color,gui_height_proc_min_value,gui_height_proc_max_value);
-    vec4 hmin = height_clamp(vec4(0.0),vec4(0.0),gui_height_proc_min_value,gui_height_proc_max_value);
-    vec4 hmax = height_clamp(vec4(1.0),vec4(1.0),gui_height_proc_min_value,gui_height_proc_max_value);
+    float min_value    = materialParameter(MATERIAL_PARAM_HEIGHT_MIN   ,gui_height_proc_min_value);
+    float max_value    = materialParameter(MATERIAL_PARAM_HEIGHT_MAX   ,gui_height_proc_max_value);
+    float offset_value = materialParameter(MATERIAL_PARAM_HEIGHT_OFFSET,gui_height_proc_offset_value);
+    height = height_clamp(height,ave_color,min_value,max_value);
+    vec4 hmin = height_clamp(vec4(0.0),vec4(0.0),min_value,max_value);
+    vec4 hmax = height_clamp(vec4(1.0),vec4(1.0),min_value,max_value);
     if(gui_height_proc_normalization){
-        return clamp(vec4(height-hmin)/(hmax-hmin) + vec4(gui_height_proc_offset_value),vec4(0),vec4(1));
+        return clamp(vec4(height-hmin)/(hmax-hmin) + vec4(offset_value),vec4(0),vec4(1));
     }else{
-        return clamp(vec4(height-hmin) + vec4(gui_height_proc_offset_value),vec4(0),vec4(1));
+        return clamp(vec4(height-hmin) + vec4(offset_value),vec4(0),vec4(1));
     }
 
 }
@@ -1363,8 +1405,8 @@ vec4 ffilter(){
 
 
     float depth     = gui_roughness_depth ;
-    float treshold  = gui_roughness_treshold/20.0;
-    float amplifier = gui_roughness_amplifier*50;
+    float treshold  = materialParameter(MATERIAL_PARAM_ROUGHNESS_TRESHOLD ,gui_roughness_treshold)/20.0;
+    float amplifier = materialParameter(MATERIAL_PARAM_ROUGHNESS_AMPLIFIER,gui_roughness_amplifier)*50;
     float ave       = texture( layerB, v2QuadCoords.xy ).r;
 
 
@@ -1600,6 +1642,34 @@ vec4 ffilter(){
     return color;
 }
 
+// ----------------------------------------------------------------
+//  Channel packing: each output channel is taken from a channel
+//  of one of the layers (A-D) or set to a constant
+// ----------------------------------------------------------------
+uniform ivec4 pack_layers;    // layer index of each output channel, -1 for constant
+uniform ivec4 pack_channels;  // channel of the layer
+uniform vec4  pack_constants; // used when layer index is -1
+#ifndef mode_pack_channels_filter_330
+#ifndef USE_OPENGL_330
+subroutine(filterModeType)
+#endif
+vec4 mode_pack_channels_filter(){
+#else
+vec4 ffilter(){
+#endif
+    vec4 layers[4];
+    layers[0] = texture( layerA, v2QuadCoords.xy);
+    layers[1] = texture( layerB, v2QuadCoords.xy);
+    layers[2] = texture( layerC, v2QuadCoords.xy);
+    layers[3] = texture( layerD, v2QuadCoords.xy);
+
+    vec4 color = pack_constants;
+    for(int c = 0 ; c < 4 ; c++){
+        if(pack_layers[c] >= 0) color[c] = layers[pack_layers[c]][pack_channels[c]];
+    }
+    return color;
+}
+
 
 // ----------------------------------------------------------------
 //
@@ -1612,9 +1682,7 @@ uniform int material_id;
 void main() {   
 
 
-    vec3 materialColor = texture( materialTexture, v2QuadCoords.xy).rgb;
-
-    int materialIndex = int(255*255*255*materialColor.r)+int(255*255*materialColor.g)+int(255*materialColor.b);
+    int materialIndex = int(texture( materialIdTexture, v2QuadCoords.xy).r);
 
     if(material_id >= 0){// if current ID is different than -1
         if( materialIndex == material_id ){ // compare colors and process only the mask region
@@ -1626,6 +1694,13 @@ void main() {
         }else{
             discard;
         }
+    }else if(material_id == MATERIALS_BATCH){// all materials at once
+        if(materialIndex < material_count) materialSlot = materialIndex;
+            #ifndef USE_OPENGL_330
+            FragColor   = filterMode();
+            #else
+            FragColor   = ffilter();
+            #endif
     }else if(material_id == -1){//draw just last image
         FragColor = texture( layerA, v2QuadCoords.xy);
     }else{// normal processing (materials disabled)
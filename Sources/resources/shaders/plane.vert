@@ -3,8 +3,7 @@
 layout(location = 0) in vec3 positionIn;
 layout(location = 1) in vec3 texcoordIn;
 layout(location = 2) in vec3 normalIn;
-layout(location = 3) in vec3 tangentIn;
-layout(location = 4) in vec3 bitangentIn;
+layout(location = 3) in vec4 tangentIn; // w - handedness of the bitangent
 layout(location = 5) in vec3 smoothedNormalIn;
 
 
@@ -27,8 +26,8 @@ void main()
 {
     vPosition  = positionIn.xyz;
     vNormal    = normalIn;
-    vBitangent = bitangentIn;
-    vTangent   = tangentIn;
+    vBitangent = normalize(cross(normalIn, tangentIn.xyz)) * tangentIn.w;
+    vTangent   = tangentIn.xyz;
     vSmoothedNormal = smoothedNormalIn;
     vTexcoord  = vec3(texcoordIn.st,0)*gui_uvScale + vec3(gui_uvScaleOffset,0);
 }
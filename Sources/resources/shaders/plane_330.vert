@@ -3,8 +3,7 @@
 layout(location = 0) in vec3 positionIn;
 layout(location = 1) in vec3 texcoordIn;
 layout(location = 2) in vec3 normalIn;
-layout(location = 3) in vec3 tangentIn;
-layout(location = 4) in vec3 bitangentIn;
+layout(location = 3) in vec4 tangentIn; // w - handedness of the bitangent
 layout(location = 5) in vec3 smoothedNormalIn;
 
 
@@ -27,8 +26,8 @@ void main()
 {
     tePosition  = positionIn.xyz;
     teNormal    = normalIn;
-    teBitangent = bitangentIn;
-    teTangent   = tangentIn;
+    teBitangent = normalize(cross(normalIn, tangentIn.xyz)) * tangentIn.w;
+    teTangent   = tangentIn.xyz;
     teSmoothedNormal = smoothedNormalIn;
     teTexcoord  = vec3(texcoordIn.st,0)*gui_uvScale + vec3(gui_uvScaleOffset,0);
 }
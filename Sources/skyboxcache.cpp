@@ -0,0 +1,152 @@
+#include "skyboxcache.h"
+#include <QCryptographicHash>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDataStream>
+#include <QDebug>
+
+#define SKYBOX_CACHE_MAGIC   0x41424355 // "ABCU"
+#define SKYBOX_CACHE_VERSION 2
+#define SKYBOX_CACHE_FILE    "cubemap.cache"
+
+SkyBoxCache::SkyBoxCache(int capacity):
+    capacity(qMax(1,capacity)){
+}
+
+SkyBoxCache::~SkyBoxCache(){
+    for(int i = 0 ; i < entries.size() ; i++) release(entries[i]);
+}
+
+void SkyBoxCache::release(Entry& entry){
+    delete entry.envMap;
+    delete entry.prefilteredEnvMap;
+    delete entry.specularEnvMap;
+    entry.envMap            = NULL;
+    entry.prefilteredEnvMap = NULL;
+    entry.specularEnvMap    = NULL;
+}
+
+QByteArray SkyBoxCache::hashFiles(const QStringList& fileNames){
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    foreach(const QString& fileName, fileNames){
+        QFile file(fileName);
+        if(file.open(QIODevice::ReadOnly)) hash.addData(&file);
+    }
+    return hash.result();
+}
+
+QByteArray SkyBoxCache::stampFiles(const QStringList& fileNames){
+    QByteArray stamp;
+    QDataStream stream(&stamp,QIODevice::WriteOnly);
+    foreach(const QString& fileName, fileNames){
+        QFileInfo info(fileName);
+        stream << info.size() << info.lastModified().toMSecsSinceEpoch();
+    }
+    return stamp;
+}
+
+QString SkyBoxCache::cacheFileName(const QStringList& fileNames){
+    if(fileNames.isEmpty()) return QString();
+    return QFileInfo(fileNames.first()).absolutePath() + "/" + SKYBOX_CACHE_FILE;
+}
+
+SkyBoxCache::Entry SkyBoxCache::get(const QString& name, const QStringList& fileNames, int prefilteredSize,
+                                    int specularSize, int specularLevels){
+    // recently used, hashing the images is left for the disk cache
+    QByteArray stamp = stampFiles(fileNames);
+    for(int i = 0 ; i < entries.size() ; i++){
+        if(entries[i].name == name && entries[i].stamp == stamp){
+            entries.move(i,0);
+            qDebug() << "SkyBoxCache:: using" << name << "from memory";
+            return entries.first();
+        }
+    }
+
+    Entry entry;
+    entry.name              = name;
+    entry.stamp             = stamp;
+    entry.key               = hashFiles(fileNames);
+    entry.fileName          = cacheFileName(fileNames);
+    entry.envMap            = NULL;
+    entry.prefilteredEnvMap = NULL;
+    entry.specularEnvMap    = NULL;
+    entry.bBaked            = false;
+    entry.bStored           = false;
+
+    if(read(entry)){
+        qDebug() << "SkyBoxCache:: using" << name << "from" << entry.fileName;
+        entry.bBaked  = true;
+        entry.bStored = true;
+    }else{
+        entry.envMap            = new GLTextureCube(fileNames);
+        entry.prefilteredEnvMap = new GLTextureCube(prefilteredSize);
+        entry.specularEnvMap    = new GLTextureCube(specularSize,specularLevels);
+        entry.bStored           = entry.envMap->failed(); // do not cache missing images
+    }
+
+    entries.prepend(entry);
+    while(entries.size() > capacity){
+        release(entries.last());
+        entries.removeLast();
+    }
+    return entries.first();
+}
+
+void SkyBoxCache::store(const QString& name){
+    if(entries.isEmpty() || entries.first().name != name) return;
+    Entry& entry  = entries.first();
+    entry.bBaked  = true;
+    if(entry.bStored) return;
+    entry.bStored = true;
+    write(entry);
+}
+
+bool SkyBoxCache::read(Entry& entry){
+    const QString& fileName = entry.fileName;
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly)) return false;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    quint32 magic, version;
+    QByteArray key;
+    stream >> magic >> version >> key;
+    if(magic != SKYBOX_CACHE_MAGIC || version != SKYBOX_CACHE_VERSION || key != entry.key){
+        qDebug() << "SkyBoxCache::" << fileName << "is outdated";
+        return false;
+    }
+
+    GLTextureCube* envMap            = new GLTextureCube(stream);
+    GLTextureCube* prefilteredEnvMap = new GLTextureCube(stream);
+    GLTextureCube* specularEnvMap    = new GLTextureCube(stream);
+    if(envMap->failed() || prefilteredEnvMap->failed() || specularEnvMap->failed()){
+        qWarning() << "SkyBoxCache:: cannot read" << fileName;
+        delete envMap;
+        delete prefilteredEnvMap;
+        delete specularEnvMap;
+        return false;
+    }
+    entry.envMap            = envMap;
+    entry.prefilteredEnvMap = prefilteredEnvMap;
+    entry.specularEnvMap    = specularEnvMap;
+    return true;
+}
+
+void SkyBoxCache::write(Entry& entry){
+    const QString& fileName = entry.fileName;
+    QSaveFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly)){
+        qWarning() << "SkyBoxCache:: cannot write" << fileName;
+        return;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << quint32(SKYBOX_CACHE_MAGIC) << quint32(SKYBOX_CACHE_VERSION) << entry.key;
+    if(!entry.envMap->write(stream) || !entry.prefilteredEnvMap->write(stream) ||
+       !entry.specularEnvMap->write(stream) || !file.commit()){
+        qWarning() << "SkyBoxCache:: cannot write" << fileName;
+        return;
+    }
+    qDebug() << "SkyBoxCache::" << entry.name << "saved to" << fileName;
+}
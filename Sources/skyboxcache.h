@@ -0,0 +1,64 @@
+#ifndef SKYBOXCACHE_H
+#define SKYBOXCACHE_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+#include "utils/qglbuffers.h"
+
+/**
+ * @brief The SkyBoxCache class keeps processed environment maps. Recently used
+ * cube maps stay in GPU memory (LRU). The cube map with all its mipmaps and the
+ * baked prefiltered maps are also written to a binary file in the skybox folder,
+ * so the next time the skybox is chosen the images are not decoded again.
+ * Maps in memory are identified by the size and modification time of the
+ * source images, the disk cache by their hash.
+ * All methods require current GL context.
+ */
+class SkyBoxCache
+{
+public:
+    struct Entry{
+        QString        name;
+        QByteArray     stamp;             // sizes and modification times of the source images
+        QByteArray     key;               // hash of the source images
+        QString        fileName;          // disk cache file
+        GLTextureCube* envMap;
+        GLTextureCube* prefilteredEnvMap; // diffuse irradiance
+        GLTextureCube* specularEnvMap;    // GGX prefiltered radiance, roughness in mipmaps
+        bool           bBaked;            // prefiltered maps are ready
+        bool           bStored;           // written to the disk cache
+    };
+
+    explicit SkyBoxCache(int capacity = 3);
+    ~SkyBoxCache();
+
+    /**
+     * @brief get returns the maps of given skybox from memory, from the disk
+     * cache or decoded from the images (in this order). Maps are owned by the cache.
+     * @param prefilteredSize size of the new prefiltered diffuse map
+     * @param specularSize size and number of mipmap levels of the new specular map
+     */
+    Entry get(const QString& name, const QStringList& fileNames, int prefilteredSize,
+              int specularSize, int specularLevels);
+    /**
+     * @brief store marks prefiltered maps of given skybox as baked and writes
+     * the skybox to the disk cache if it was not stored yet.
+     */
+    void store(const QString& name);
+
+    static QByteArray hashFiles(const QStringList& fileNames);
+    static QByteArray stampFiles(const QStringList& fileNames);
+
+private:
+    static QString cacheFileName(const QStringList& fileNames);
+    bool read(Entry& entry);
+    void write(Entry& entry);
+    void release(Entry& entry);
+
+    QList<Entry> entries; // the most recently used first
+    int capacity;
+};
+
+#endif // SKYBOXCACHE_H
@@ -4,29 +4,72 @@
  */
 
 #include "Mesh.hpp"
-
-#define xyz(i,j,k)( i*100*100 + j*100 + k )
+#include "parallel.h"
+#include "objparser.h"
+#include "meshsimplifier.h"
+#include <cstddef>
+#include <cmath>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+
+#define MESH_CACHE_MAGIC   0x48534D41 // "AMSH"
+#define MESH_CACHE_VERSION 2
+#define MESH_CACHE_SUFFIX  ".abmesh"
+
+// Packs signed normalized xyzw to GL_INT_2_10_10_10_REV (w is -1, 0 or 1).
+static quint32 packNormal(const QVector4D& v){
+    qint32 x = qRound(qBound(-1.0f,v.x(),1.0f) * 511.0f);
+    qint32 y = qRound(qBound(-1.0f,v.y(),1.0f) * 511.0f);
+    qint32 z = qRound(qBound(-1.0f,v.z(),1.0f) * 511.0f);
+    qint32 w = qRound(qBound(-1.0f,v.w(),1.0f));
+    return (quint32(x) & 0x3FF) | ((quint32(y) & 0x3FF) << 10) |
+           ((quint32(z) & 0x3FF) << 20) | ((quint32(w) & 0x3) << 30);
+}
 
 
 
 Mesh::Mesh(QString dir, QString name):mesh_path(name){
+    load(dir,NULL);
+    upload();
+}
+
+Mesh::Mesh(QString dir, QString name, LoadStatus* status):mesh_path(name){
+    load(dir,status);
+}
+
+void Mesh::load(const QString& dir, LoadStatus* status){
 
     qDebug() << Q_FUNC_INFO << "Loading new mesh:" << dir + mesh_path ;
 
     mesh_log = QString("");
     bLoaded = false;
+    bProcessed = false;
+    mesh_uploaded = 0;
+    lod_indices.clear();
+    mesh_vao = 0;
+    mesh_file = dir + mesh_path;
+    LoadStatus localStatus;
+    if(status == NULL) status = &localStatus;
+
+    if(readCache()){
+        bProcessed = true;
+        status->setStep(1,1);
+        return;
+    }
+
     using namespace tinyobj;
-    std::string inputfile = (dir + mesh_path).toStdString();
     std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
+    QString err;
 
-    std::string err = tinyobj::LoadObj(shapes, materials, inputfile.c_str());
-
-    if (!err.empty()) {
-        qDebug() << Q_FUNC_INFO << "Loading mesh file failed:" << dir + mesh_path ;
-        mesh_log += "Loading mesh file failed:" + dir + mesh_path + "\n";
+    status->setStep(0.0f,0.5f);
+    if (!ObjParser::load(dir + mesh_path, shapes, err, status)) {
+        qDebug() << Q_FUNC_INFO << "Loading mesh file failed:" << dir + mesh_path << err;
+        mesh_log += "Loading mesh file failed:" + dir + mesh_path + "\n" + err + "\n";
         return;
     }
+    status->setStep(0.5f,0.55f);
     if(shapes.size() == 0){
         qDebug() << "Woops:: This model has no shapes, so it cannot be loaded." ;
         mesh_log += "Woops:: This model has no shapes, so it cannot be loaded.\n";
@@ -36,15 +79,28 @@ Mesh::Mesh(QString dir, QString name):mesh_path(name){
     int max_wrong_shapes = 10;
     int no_wrong_shapes  = 0;
 
+    // reserve the final sizes, arrays are not reallocated while shapes are copied
+    int totalVertices = 0, totalIndices = 0;
+    for (size_t i = 0; i < shapes.size(); i++) {
+        totalVertices += shapes[i].mesh.positions.size()/3;
+        totalIndices  += shapes[i].mesh.indices.size();
+    }
+    gl_vertices .reserve(totalVertices);
+    gl_texcoords.reserve(totalVertices);
+    gl_normals  .reserve(totalVertices);
+    gl_indices  .reserve(totalIndices);
+
     //qDebug() << "List of problematic shapes:";
     //mesh_log += "List of problematic shapes:\n";
 
     for (size_t i = 0; i < shapes.size(); i++) {
         bool problemWith[3] = {false,false,false};
-        if(shapes[i].mesh.texcoords.size() == 0){
+        // vertices are used as they are, so every vertex needs its UV and normal
+        size_t noShapeVertices = shapes[i].mesh.positions.size()/3;
+        if(shapes[i].mesh.texcoords.size() == 0 || shapes[i].mesh.texcoords.size()/2 != noShapeVertices){
             problemWith[0] = true;
         }
-        if(shapes[i].mesh.normals.size() == 0){
+        if(shapes[i].mesh.normals.size() == 0 || shapes[i].mesh.normals.size()/3 != noShapeVertices){
             problemWith[1] = true;
         }
         if(shapes[i].mesh.positions.size() == 0){
@@ -64,37 +120,36 @@ Mesh::Mesh(QString dir, QString name):mesh_path(name){
           continue;
         }
 
-      for (size_t f = 0; f < shapes[i].mesh.indices.size() / 3; f++) {
-
-        for(size_t d = 0 ; d < 3 ; d++){
-            unsigned int index = shapes[i].mesh.indices[3*f+d];
+      // tinyobj keeps one vertex per unique (position, uv, normal) index tuple,
+      // the shape vertices are appended and its indices are shifted accordingly
+      const tinyobj::mesh_t& shapeMesh = shapes[i].mesh;
+      unsigned int baseVertex = gl_vertices.size();
+      unsigned int noVertices = shapeMesh.positions.size()/3;
 
-            QVector3D pos = QVector3D(  shapes[i].mesh.positions[3*index+0],
-                                        shapes[i].mesh.positions[3*index+1],
-                                        shapes[i].mesh.positions[3*index+2]);
-            gl_vertices .push_back(pos);
-            centre_of_mass += pos;
-
-            QVector3D uv(shapes[i].mesh.texcoords[2*index+0],
-                         shapes[i].mesh.texcoords[2*index+1],0);
-
-            gl_texcoords.push_back(uv);
-
-            QVector3D normal = QVector3D(shapes[i].mesh.normals  [3*index+0],
-                                         shapes[i].mesh.normals  [3*index+1],
-                                         shapes[i].mesh.normals  [3*index+2]);
+      for (unsigned int v = 0; v < noVertices; v++) {
+            gl_vertices.push_back(QVector3D(shapeMesh.positions[3*v+0],
+                                            shapeMesh.positions[3*v+1],
+                                            shapeMesh.positions[3*v+2]));
 
+            gl_texcoords.push_back(QVector2D(shapeMesh.texcoords[2*v+0],
+                                             shapeMesh.texcoords[2*v+1]));
 
+            QVector3D normal = QVector3D(shapeMesh.normals[3*v+0],
+                                         shapeMesh.normals[3*v+1],
+                                         shapeMesh.normals[3*v+2]);
             normal.normalize();
-            gl_smoothed_normals.push_back(normal);
-            gl_normals  .push_back(normal);
-
-
-        } //end of for face loop
+            gl_normals.push_back(normal);
+      }
+
+      for (size_t f = 0; f < shapeMesh.indices.size(); f++) {
+            unsigned int index = baseVertex + shapeMesh.indices[f];
+            gl_indices.push_back(index);
+            // weighted by the number of triangle corners, as before indexing
+            centre_of_mass += gl_vertices[index];
       } // end of shape indices
     } // end of for shape
 
-    if(gl_vertices.size() == 0 || gl_normals.size() == 0 || gl_texcoords.size() == 0){
+    if(gl_indices.size() == 0 || gl_normals.size() == 0 || gl_texcoords.size() == 0){
         if(no_wrong_shapes >= max_wrong_shapes){
             mesh_log += "Total number of problematic shapes is:"+ QString::number(no_wrong_shapes) +". Listed only first ten of them.\n" ;
         }
@@ -104,236 +159,468 @@ Mesh::Mesh(QString dir, QString name):mesh_path(name){
     }
 
 
-    centre_of_mass /= gl_vertices.size();
+    centre_of_mass /= gl_indices.size();
     radius = 0;
     for(unsigned int i = 0 ; i < gl_vertices.size() ; i++ ){
         float dist = QVector3D(centre_of_mass - gl_vertices[i]).length();
         if(dist > radius) radius = dist;
     }
 
+    shapes.clear();
+    if(status->isCanceled()) return;
+    status->setStep(0.55f,0.65f);
     calculateTangents();
-
-
-    QVector3D minPos,maxPos;
-    minPos = QVector3D();
-    maxPos = QVector3D();
-    for(int i = 0; i < gl_vertices.size() ; i++){
-           if(minPos.x() > gl_vertices[i].x()) minPos.setX(gl_vertices[i].x());
-           if(minPos.y() > gl_vertices[i].y()) minPos.setY(gl_vertices[i].y());
-           if(minPos.z() > gl_vertices[i].z()) minPos.setZ(gl_vertices[i].z());
-
-           if(maxPos.x() < gl_vertices[i].x()) maxPos.setX(gl_vertices[i].x());
-           if(maxPos.y() < gl_vertices[i].y()) maxPos.setY(gl_vertices[i].y());
-           if(maxPos.z() < gl_vertices[i].z()) maxPos.setZ(gl_vertices[i].z());
-    }
-
-    int vsize = 100*100*100;
-    vector< int> *verlet = new vector< int>[vsize];
-
-    for(int i = 0; i < gl_vertices.size() ; i++){
-
-             QVector3D pos = (gl_vertices[i] - minPos)/(maxPos-minPos).length()*100;
-             int ii = pos.x();
-             int jj = pos.y();
-             int kk = pos.z();
-             verlet[xyz(ii,jj,kk)].push_back(i);
-    }
-
-    int sum = 0;
-
-    for(int i = 0; i < vsize ; i++){
-        sum += verlet[i].size();
-    }
-
-    for(int i = 0; i < vsize ; i++){
-
-        for( int k = 0 ; k < verlet[i].size() ; k++){
-            QVector3D smoothed;            
-            int ki = verlet[i][k];
-            for( int l = 0 ; l < verlet[i].size() ; l++){
-                int li = verlet[i][l];
-                if( (gl_vertices[ki] - gl_vertices[li]).length()/radius < 1.0E-5 ){
-                     smoothed += gl_normals[li];                   
-                }
-
-
-            }
-            smoothed.normalize();
-            gl_smoothed_normals[ki] = smoothed;
-
-        }
-    }
-    delete[] verlet;
-    bLoaded = true;
-    initializeMesh();
+    if(status->isCanceled()) return;
+    status->setStep(0.65f,0.7f);
+    calculateSmoothedNormals();
+    if(status->isCanceled()) return;
+    status->setStep(0.7f,0.95f);
+    buildLods(status);
+    if(status->isCanceled()) return;
+    status->setStep(0.95f,1.0f);
+    buildVertices();
+    writeCache();
+    bProcessed = true;
+    status->setProgress(1);
 }
 
 
-void Mesh::drawMesh(bool bUseArrays ){
+void Mesh::drawMesh(bool bUseArrays, int lod){
     if(bLoaded == false) return;
 
-    GLCHK(glBindVertexArray(mesh_vao));
-
-    GLCHK(glBindBuffer(GL_ARRAY_BUFFER, mesh_vbos[0]));
-    GLCHK(glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,sizeof(QVector3D),(void*)0));
+    // all levels of detail are stored one after another in the element buffer
+    lod = qBound(0,lod,lod_indices.size()-1);
+    int first = 0;
+    for(int l = 0; l < lod ; l++) first += lod_indices[l];
+    int   count  = lod_indices[lod];
+    void* offset = (void*)(qint64(first) * sizeof(unsigned int));
 
-    GLCHK(glBindBuffer(GL_ARRAY_BUFFER, mesh_vbos[1]));
-    GLCHK(glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,sizeof(QVector3D),(void*)0));
-
-    GLCHK(glBindBuffer(GL_ARRAY_BUFFER, mesh_vbos[2]));
-    GLCHK(glVertexAttribPointer(2,3,GL_FLOAT,GL_FALSE,sizeof(QVector3D),(void*)0));
-
-    GLCHK(glBindBuffer(GL_ARRAY_BUFFER, mesh_vbos[3]));
-    GLCHK(glVertexAttribPointer(3,3,GL_FLOAT,GL_FALSE,sizeof(QVector3D),(void*)0));
-
-    GLCHK(glBindBuffer(GL_ARRAY_BUFFER, mesh_vbos[4]));
-    GLCHK(glVertexAttribPointer(4,3,GL_FLOAT,GL_FALSE,sizeof(QVector3D),(void*)0));
-
-    GLCHK(glBindBuffer(GL_ARRAY_BUFFER, mesh_vbos[5]));
-    GLCHK(glVertexAttribPointer(5,3,GL_FLOAT,GL_FALSE,sizeof(QVector3D),(void*)0));
+    // all attributes and the element buffer are part of the VAO state
+    GLCHK(glBindVertexArray(mesh_vao));
 
     if(bUseArrays){
-        GLCHK(glDrawArrays(GL_TRIANGLES, 0,  gl_vertices.size()));
+        GLCHK(glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, offset));
 
     }else{
         #ifdef USE_OPENGL_330
-        GLCHK(glDrawArrays(GL_TRIANGLES, 0,  gl_vertices.size()));
+        GLCHK(glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, offset));
         #else
-        glPatchParameteri(GL_PATCH_VERTICES, 3);       // tell OpenGL that every patch has 16 verts
-        GLCHK(glDrawArrays(GL_PATCHES, 0, gl_vertices.size())); // draw a bunch of patches
+        glPatchParameteri(GL_PATCH_VERTICES, 3);       // tell OpenGL that every patch has 3 verts
+        GLCHK(glDrawElements(GL_PATCHES, count, GL_UNSIGNED_INT, offset)); // draw a bunch of patches
         #endif
     }    
     GLCHK(glBindVertexArray(0));
 }
 
-void Mesh::initializeMesh(){
+void Mesh::buildLods(LoadStatus* status){
+    lod_indices.clear();
+    lod_indices.push_back(gl_indices.size());
+    if(gl_indices.size()/3 <= MESH_LOD_MIN_TRIANGLES) return;
+
+    // simplified levels share the vertices, their indices are appended to gl_indices
+    QVector<QVector<unsigned int> > lods = MeshSimplifier::buildLods(gl_vertices,gl_indices,
+                                                                     MESH_MAX_LODS-1,MESH_LOD_RATIO,
+                                                                     MESH_LOD_MIN_TRIANGLES/MESH_LOD_RATIO,
+                                                                     MESH_LOD_MAX_ERROR,status);
+    for(int l = 0; l < lods.size() ; l++){
+        gl_indices  += lods[l];
+        lod_indices.push_back(lods[l].size());
+    }
+}
 
-    if(bLoaded == false){
-        cerr << Q_FUNC_INFO << " Cannot initialize mesh because is NULL.";
-        cerr.flush();
-        return;
+int Mesh::getNoTriangles(int lod) const{
+    if(lod_indices.isEmpty()) return 0;
+    return lod_indices[qBound(0,lod,lod_indices.size()-1)]/3;
+}
+
+int Mesh::selectLod(int maxTriangles) const{
+    for(int l = 0; l < lod_indices.size() ; l++){
+        if(lod_indices[l]/3 <= maxTriangles) return l;
     }
+    return qMax(0,lod_indices.size()-1);
+}
+
+void Mesh::buildVertices(){
+    // interleaved vertices, normal and tangents are packed to 10 bits per component
+    QVector<MeshVertex>& vertices = mesh_vertices;
+    vertices.resize(gl_vertices.size());
+    parallelFor(vertices.size(),[&](int begin, int end, int){
+        for(int i = begin; i < end ; i++){
+            MeshVertex& vertex = vertices[i];
+            vertex.position[0]     = gl_vertices[i].x();
+            vertex.position[1]     = gl_vertices[i].y();
+            vertex.position[2]     = gl_vertices[i].z();
+            vertex.texcoord[0]     = gl_texcoords[i].x();
+            vertex.texcoord[1]     = gl_texcoords[i].y();
+            vertex.normal          = packNormal(QVector4D(gl_normals[i],0));
+            vertex.tangent         = packNormal(gl_tangents[i]);
+            vertex.smoothedNormal  = packNormal(QVector4D(gl_smoothed_normals[i],0));
+        }
+    },4096);
+}
+
+bool Mesh::upload(qint64 maxBytes){
+    if(bLoaded) return true;
+    if(!bProcessed) return false;
+
+    qint64 vertexBytes = qint64(mesh_vertices.size()) * sizeof(MeshVertex);
+    qint64 indexBytes  = qint64(gl_indices.size()) * sizeof(unsigned int);
+    if(maxBytes <= 0) maxBytes = vertexBytes + indexBytes;
+    if(mesh_vao == 0) createBuffers();
+
+    // vertex buffer first, then the element buffer
+    if(mesh_uploaded < vertexBytes){
+        qint64 bytes = qMin(maxBytes, vertexBytes - mesh_uploaded);
+        GLCHK(glBindBuffer(GL_ARRAY_BUFFER, mesh_vbos[0]));
+        GLCHK(glBufferSubData(GL_ARRAY_BUFFER, mesh_uploaded, bytes,
+                              (const char*)mesh_vertices.constData() + mesh_uploaded));
+        GLCHK(glBindBuffer(GL_ARRAY_BUFFER, 0));
+        mesh_uploaded += bytes;
+        maxBytes      -= bytes;
+    }
+    if(mesh_uploaded >= vertexBytes && maxBytes > 0){
+        qint64 offset = mesh_uploaded - vertexBytes;
+        qint64 bytes  = qMin(maxBytes, indexBytes - offset);
+        GLCHK(glBindVertexArray(mesh_vao)); // element buffer binding is part of the VAO
+        GLCHK(glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset, bytes,
+                              (const char*)gl_indices.constData() + offset));
+        GLCHK(glBindVertexArray(0));
+        mesh_uploaded += bytes;
+    }
+    if(mesh_uploaded < vertexBytes + indexBytes) return false;
+
+    bLoaded      = true;
+    // CPU copies are not needed anymore
+    mesh_vertices       = QVector<MeshVertex>();
+    gl_vertices         = QVector<QVector3D>();
+    gl_normals          = QVector<QVector3D>();
+    gl_smoothed_normals = QVector<QVector3D>();
+    gl_texcoords        = QVector<QVector2D>();
+    gl_tangents         = QVector<QVector4D>();
+    gl_indices          = QVector<unsigned int>();
+    return true;
+}
+
+float Mesh::uploadProgress() const{
+    if(bLoaded) return 1.0f;
+    qint64 totalBytes = qint64(mesh_vertices.size()) * sizeof(MeshVertex) + qint64(gl_indices.size()) * sizeof(unsigned int);
+    return float(mesh_uploaded) / qMax(qint64(1),totalBytes);
+}
+
+void Mesh::createBuffers(){
 
     GLCHK(initializeOpenGLFunctions());
 
     GLCHK(glGenVertexArrays(1, &mesh_vao));
     GLCHK(glBindVertexArray(mesh_vao));
 
-    GLCHK(glGenBuffers(6, &mesh_vbos[0]));
+    GLCHK(glGenBuffers(2, &mesh_vbos[0]));
 
+    // storage only, data is sent in parts by upload()
     GLCHK(glBindBuffer(GL_ARRAY_BUFFER, mesh_vbos[0]));
-    GLCHK(glBufferData(GL_ARRAY_BUFFER, gl_vertices.size() * sizeof(QVector3D), gl_vertices.constData(), GL_STATIC_DRAW));
-    GLCHK(glEnableVertexAttribArray(0));
-    GLCHK(glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,sizeof(QVector3D),(void*)0));
+    GLCHK(glBufferData(GL_ARRAY_BUFFER, qint64(mesh_vertices.size()) * sizeof(MeshVertex), NULL, GL_STATIC_DRAW));
 
-    GLCHK(glBindBuffer(GL_ARRAY_BUFFER, mesh_vbos[1]));
-    GLCHK(glBufferData(GL_ARRAY_BUFFER, gl_texcoords.size() * sizeof(QVector3D), gl_texcoords.constData(), GL_STATIC_DRAW));
+    GLCHK(glEnableVertexAttribArray(0));
+    GLCHK(glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,sizeof(MeshVertex),(void*)offsetof(MeshVertex,position)));
     GLCHK(glEnableVertexAttribArray(1));
-    GLCHK(glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,sizeof(QVector3D),(void*)0));
-
-    GLCHK(glBindBuffer(GL_ARRAY_BUFFER, mesh_vbos[2]));
-    GLCHK(glBufferData(GL_ARRAY_BUFFER, gl_normals.size() * sizeof(QVector3D), gl_normals.constData(), GL_STATIC_DRAW));
+    GLCHK(glVertexAttribPointer(1,2,GL_FLOAT,GL_FALSE,sizeof(MeshVertex),(void*)offsetof(MeshVertex,texcoord)));
     GLCHK(glEnableVertexAttribArray(2));
-    GLCHK(glVertexAttribPointer(2,3,GL_FLOAT,GL_FALSE,sizeof(QVector3D),(void*)0));
-
-    GLCHK(glBindBuffer(GL_ARRAY_BUFFER, mesh_vbos[3]));
-    GLCHK(glBufferData(GL_ARRAY_BUFFER, gl_tangents.size() * sizeof(QVector3D), gl_tangents.constData(), GL_STATIC_DRAW));
+    GLCHK(glVertexAttribPointer(2,4,GL_INT_2_10_10_10_REV,GL_TRUE,sizeof(MeshVertex),(void*)offsetof(MeshVertex,normal)));
     GLCHK(glEnableVertexAttribArray(3));
-    GLCHK(glVertexAttribPointer(3,3,GL_FLOAT,GL_FALSE,sizeof(QVector3D),(void*)0));
-
-    GLCHK(glBindBuffer(GL_ARRAY_BUFFER, mesh_vbos[4]));
-    GLCHK(glBufferData(GL_ARRAY_BUFFER, gl_bitangents.size() * sizeof(QVector3D), gl_bitangents.constData(), GL_STATIC_DRAW));
-    GLCHK(glEnableVertexAttribArray(4));
-    GLCHK(glVertexAttribPointer(4,3,GL_FLOAT,GL_FALSE,sizeof(QVector3D),(void*)0));
-
-    GLCHK(glBindBuffer(GL_ARRAY_BUFFER, mesh_vbos[5]));
-    GLCHK(glBufferData(GL_ARRAY_BUFFER, gl_smoothed_normals.size() * sizeof(QVector3D), gl_smoothed_normals.constData(), GL_STATIC_DRAW));
+    GLCHK(glVertexAttribPointer(3,4,GL_INT_2_10_10_10_REV,GL_TRUE,sizeof(MeshVertex),(void*)offsetof(MeshVertex,tangent)));
     GLCHK(glEnableVertexAttribArray(5));
-    GLCHK(glVertexAttribPointer(5,3,GL_FLOAT,GL_FALSE,sizeof(QVector3D),(void*)0));
+    GLCHK(glVertexAttribPointer(5,4,GL_INT_2_10_10_10_REV,GL_TRUE,sizeof(MeshVertex),(void*)offsetof(MeshVertex,smoothedNormal)));
+
+    GLCHK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh_vbos[1]));
+    GLCHK(glBufferData(GL_ELEMENT_ARRAY_BUFFER, qint64(gl_indices.size()) * sizeof(unsigned int), NULL, GL_STATIC_DRAW));
 
     GLCHK(glBindVertexArray(0));
+    GLCHK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+    GLCHK(glBindBuffer(GL_ARRAY_BUFFER, 0));
 
 }
 
 
-// Calculation based on article:
-// Lengyel, Eric. “Computing Tangent Space Basis Vectors for an Arbitrary Mesh”.
-// Terathon Software 3D Graphics Library, 2001. http://www.terathon.com/code/tangent.html
-void Mesh::calculateTangents()
-{
-    int vertexCount = gl_vertices.size();
-
-    QVector3D *tan1 = new QVector3D[vertexCount * 2];
-    QVector3D *tan2 = tan1 + vertexCount;
+namespace{
+// Header of the binary mesh cache, followed by the vertex and index buffers.
+// The cache is written and read on the same machine, so native layout is used.
+struct MeshCacheHeader{
+    quint32 magic;
+    quint32 version;
+    quint32 vertexSize;       // sizeof(MeshVertex)
+    quint32 noVertices;
+    quint32 noIndices;        // all levels of detail
+    quint32 noLods;
+    quint32 lodIndices[MESH_MAX_LODS];
+    float   centre_of_mass[3];
+    float   radius;
+    qint64  sourceSize;
+    qint64  sourceTime;       // last modification in ms since epoch
+    char    sourceHash[20];   // SHA-1 of the first and the last MB of the source
+};
+}
 
-    for(int i = 0; i < 2*vertexCount ; i++){
-            tan1[i] = QVector3D(0.0f,0.0f,0.0f);
+QByteArray Mesh::sourceHash(const QString& fileName){
+    const qint64 blockSize = 1 << 20;
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly)) return QByteArray();
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(file.read(blockSize));
+    if(file.size() > blockSize){
+        file.seek(qMax(blockSize,file.size()-blockSize));
+        hash.addData(file.read(blockSize));
     }
-    //ZeroMemory(tan1, vertexCount * sizeof(Vector3D) * 2);
-
-    for (unsigned int a = 0; a < vertexCount/3; a++)
-    {
-        long i1 = 3*a+0;
-        long i2 = 3*a+1;
-        long i3 = 3*a+2;
-
-        const QVector3D& v1 = gl_vertices[i1];
-        const QVector3D& v2 = gl_vertices[i2];
-        const QVector3D& v3 = gl_vertices[i3];
-
-
-        const QVector3D& w1 = gl_texcoords[i1];
-        const QVector3D& w2 = gl_texcoords[i2];
-        const QVector3D& w3 = gl_texcoords[i3];
-
-
-        float x1 = v2.x() - v1.x();
-        float x2 = v3.x() - v1.x();
-        float y1 = v2.y() - v1.y();
-        float y2 = v3.y() - v1.y();
-        float z1 = v2.z() - v1.z();
-        float z2 = v3.z() - v1.z();
+    return hash.result();
+}
 
-        float s1 = w2.x() - w1.x();
-        float s2 = w3.x() - w1.x();
-        float t1 = w2.y() - w1.y();
-        float t2 = w3.y() - w1.y();
+QStringList Mesh::cacheFileNames(){
+    QFileInfo info(mesh_file);
+    QStringList names;
+    // next to the mesh, otherwise in the user cache folder
+    names << info.absolutePath() + "/" + info.completeBaseName() + MESH_CACHE_SUFFIX;
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if(!cacheDir.isEmpty()){
+        QByteArray pathHash = QCryptographicHash::hash(info.absoluteFilePath().toUtf8(),QCryptographicHash::Sha1);
+        names << cacheDir + "/meshes/" + pathHash.toHex() + MESH_CACHE_SUFFIX;
+    }
+    return names;
+}
 
-        float r = 1.0F / (s1 * t2 - s2 * t1);
-        QVector3D sdir((t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r,
-                (t2 * z1 - t1 * z2) * r);
-        QVector3D tdir((s1 * x2 - s2 * x1) * r, (s1 * y2 - s2 * y1) * r,
-                (s1 * z2 - s2 * z1) * r);
+bool Mesh::readCache(){
+    QFileInfo source(mesh_file);
+    if(!source.isFile()) return false;
+    QByteArray hash;
+
+    foreach(const QString& cacheName, cacheFileNames()){
+        QFile file(cacheName);
+        if(file.size() < qint64(sizeof(MeshCacheHeader)) || !file.open(QIODevice::ReadOnly)) continue;
+
+        const uchar* data = file.map(0,file.size());
+        if(data == NULL) continue;
+        MeshCacheHeader header;
+        memcpy(&header,data,sizeof(header));
+
+        qint64 expectedSize = qint64(sizeof(header)) + qint64(header.noVertices)*sizeof(MeshVertex)
+                            + qint64(header.noIndices)*sizeof(unsigned int);
+        bool bValid = header.magic      == MESH_CACHE_MAGIC   &&
+                      header.version    == MESH_CACHE_VERSION &&
+                      header.vertexSize == sizeof(MeshVertex) &&
+                      header.noIndices  >  0                  &&
+                      header.noLods     >  0                  &&
+                      header.noLods     <= MESH_MAX_LODS      &&
+                      header.sourceSize == source.size()      &&
+                      header.sourceTime == source.lastModified().toMSecsSinceEpoch() &&
+                      file.size()       == expectedSize;
+        quint64 lodSum = 0;
+        for(quint32 l = 0; bValid && l < header.noLods ; l++) lodSum += header.lodIndices[l];
+        bValid = bValid && lodSum == header.noIndices;
+        if(bValid){
+            if(hash.isEmpty()) hash = sourceHash(mesh_file);
+            bValid = hash == QByteArray(header.sourceHash,sizeof(header.sourceHash));
+        }
+        if(!bValid){
+            qDebug() << Q_FUNC_INFO << "Mesh cache" << cacheName << "is outdated";
+            continue;
+        }
 
-        tan1[i1] += sdir;
-        tan1[i2] += sdir;
-        tan1[i3] += sdir;
+        const MeshVertex*   vertices = (const MeshVertex*)(data + sizeof(header));
+        const unsigned int* indices  = (const unsigned int*)(vertices + header.noVertices);
+        centre_of_mass = QVector3D(header.centre_of_mass[0],header.centre_of_mass[1],header.centre_of_mass[2]);
+        radius         = header.radius;
+        // the copy is uploaded later in the GL thread
+        mesh_vertices.resize(header.noVertices);
+        gl_indices   .resize(header.noIndices);
+        memcpy(mesh_vertices.data(),vertices,qint64(header.noVertices)*sizeof(MeshVertex));
+        memcpy(gl_indices.data(),indices,qint64(header.noIndices)*sizeof(unsigned int));
+        lod_indices.clear();
+        for(quint32 l = 0; l < header.noLods ; l++) lod_indices.push_back(header.lodIndices[l]);
+        qDebug() << Q_FUNC_INFO << "Mesh loaded from cache:" << cacheName;
+        return true;
+    }
+    return false;
+}
 
-        tan2[i1] += tdir;
-        tan2[i2] += tdir;
-        tan2[i3] += tdir;
+void Mesh::writeCache(){
+    const QVector<MeshVertex>& vertices = mesh_vertices;
+    QFileInfo source(mesh_file);
+    if(!source.isFile()) return;
+
+    MeshCacheHeader header;
+    memset(&header,0,sizeof(header));
+    header.magic      = MESH_CACHE_MAGIC;
+    header.version    = MESH_CACHE_VERSION;
+    header.vertexSize = sizeof(MeshVertex);
+    header.noVertices = vertices.size();
+    header.noIndices  = gl_indices.size();
+    header.noLods     = lod_indices.size();
+    for(int l = 0; l < lod_indices.size() ; l++) header.lodIndices[l] = lod_indices[l];
+    header.centre_of_mass[0] = centre_of_mass.x();
+    header.centre_of_mass[1] = centre_of_mass.y();
+    header.centre_of_mass[2] = centre_of_mass.z();
+    header.radius     = radius;
+    header.sourceSize = source.size();
+    header.sourceTime = source.lastModified().toMSecsSinceEpoch();
+    QByteArray hash   = sourceHash(mesh_file);
+    memcpy(header.sourceHash,hash.constData(),qMin(hash.size(),int(sizeof(header.sourceHash))));
+
+    foreach(const QString& cacheName, cacheFileNames()){
+        QDir().mkpath(QFileInfo(cacheName).absolutePath());
+        QSaveFile file(cacheName);
+        if(!file.open(QIODevice::WriteOnly)) continue;
+        file.write((const char*)&header,sizeof(header));
+        file.write((const char*)vertices.constData(),qint64(vertices.size())*sizeof(MeshVertex));
+        file.write((const char*)gl_indices.constData(),qint64(gl_indices.size())*sizeof(unsigned int));
+        if(file.commit()){
+            qDebug() << Q_FUNC_INFO << "Mesh cache saved to:" << cacheName;
+            return;
+        }
+    }
+    qWarning() << Q_FUNC_INFO << "Cannot write mesh cache for:" << mesh_file;
+}
 
+// Vertices closer than radius*1E-5 share the smoothed normal. Positions are
+// quantized to cells of that size and packed into 64 bit keys (21 bits per axis),
+// the keys are radix sorted and normals are averaged over each run of equal keys.
+// Memory and time are linear in the number of vertices.
+void Mesh::calculateSmoothedNormals()
+{
+    int vertexCount = gl_vertices.size();
+    gl_smoothed_normals.resize(vertexCount);
+    if(vertexCount == 0) return;
 
+    QVector3D minPos = gl_vertices[0];
+    for(int i = 1; i < vertexCount ; i++){
+        const QVector3D& p = gl_vertices[i];
+        minPos = QVector3D(qMin(minPos.x(),p.x()),qMin(minPos.y(),p.y()),qMin(minPos.z(),p.z()));
+    }
+    float cellSize = qMax(radius*1.0E-5f,1.0E-20f);
+    const quint64 maxCell = (1 << 21) - 1;
+
+    QVector<quint64> keys(vertexCount);
+    QVector<int>     order(vertexCount);
+    parallelFor(vertexCount,[&](int begin, int end, int){
+        for(int i = begin; i < end ; i++){
+            QVector3D cell = (gl_vertices[i] - minPos) / cellSize;
+            quint64 x = qMin(maxCell,quint64(qMax(0.0f,cell.x() + 0.5f)));
+            quint64 y = qMin(maxCell,quint64(qMax(0.0f,cell.y() + 0.5f)));
+            quint64 z = qMin(maxCell,quint64(qMax(0.0f,cell.z() + 0.5f)));
+            keys[i]  = (x << 42) | (y << 21) | z;
+            order[i] = i;
+        }
+    },4096);
+
+    // LSD radix sort of the vertex order by key, 16 bits per pass. It is stable,
+    // so vertices with equal keys stay in the index order (deterministic sums).
+    QVector<quint64> sortedKeys(vertexCount);
+    QVector<int>     sortedOrder(vertexCount);
+    QVector<int>     offsets(1 << 16);
+    for(int shift = 0; shift < 64 ; shift += 16){
+        offsets.fill(0);
+        for(int i = 0; i < vertexCount ; i++) offsets[(keys[i] >> shift) & 0xFFFF]++;
+        if(offsets[(keys[0] >> shift) & 0xFFFF] == vertexCount) continue; // all digits equal
+        int sum = 0;
+        for(int d = 0; d < offsets.size() ; d++){
+            int count  = offsets[d];
+            offsets[d] = sum;
+            sum       += count;
+        }
+        for(int i = 0; i < vertexCount ; i++){
+            int dst = offsets[(keys[i] >> shift) & 0xFFFF]++;
+            sortedKeys [dst] = keys[i];
+            sortedOrder[dst] = order[i];
+        }
+        keys .swap(sortedKeys);
+        order.swap(sortedOrder);
     }
 
-    for (unsigned int a = 0; a < vertexCount; a++)
-    {
-        QVector3D& n = gl_normals[a];
-        QVector3D& t = tan1[a];
-        t.normalize();
-        // Gram-Schmidt orthogonalize
-        QVector3D tangent = t - n * QVector3D::dotProduct(n,t);
-        tangent.normalize();
-        // Calculate handedness
-        float handedness =(QVector3D::dotProduct(QVector3D::crossProduct(n, t), tan2[a]) < 0.0F) ? -1.0F : 1.0F;
-        gl_tangents.push_back(tangent);
-        QVector3D bitangent = QVector3D::crossProduct(n, t) * handedness;
-        bitangent.normalize();
-        gl_bitangents.push_back(bitangent);
-
+    // runs of equal keys are welded vertices
+    QVector<int> runStarts;
+    runStarts.reserve(vertexCount/2+1);
+    for(int i = 0; i < vertexCount ; i++){
+        if(i == 0 || keys[i] != keys[i-1]) runStarts.push_back(i);
     }
+    runStarts.push_back(vertexCount);
 
-    delete[] tan1;
+    parallelFor(runStarts.size()-1,[&](int begin, int end, int){
+        for(int r = begin; r < end ; r++){
+            QVector3D smoothed;
+            for(int k = runStarts[r]; k < runStarts[r+1] ; k++) smoothed += gl_normals[order[k]];
+            smoothed.normalize();
+            for(int k = runStarts[r]; k < runStarts[r+1] ; k++) gl_smoothed_normals[order[k]] = smoothed;
+        }
+    },1024);
+}
+
+// MikkTSpace compatible tangents (http://www.mikktspace.com): the tangent of each
+// triangle is projected to the tangent plane of the corner normal and averaged
+// with the corner angle as a weight, handedness follows the UV orientation.
+// Triangles are processed in parallel, then contributions of every vertex are
+// summed in the triangle order, so the result does not depend on the threads.
+void Mesh::calculateTangents()
+{
+    int vertexCount = gl_vertices.size();
+    int cornerCount = gl_indices.size();
+    gl_tangents.resize(vertexCount);
+    if(vertexCount == 0) return;
+
+    const unsigned int* indices   = gl_indices.constData();
+    const QVector3D*    positions = gl_vertices.constData();
+    const QVector3D*    normals   = gl_normals.constData();
+    const QVector2D*    texcoords = gl_texcoords.constData();
+
+    // per corner: angle weighted tangent (xyz) and signed angle (w)
+    QVector<QVector4D> corners(cornerCount);
+    parallelFor(cornerCount/3,[&](int begin, int end, int){
+        for(int a = begin; a < end ; a++){
+            const unsigned int* tri = indices + 3*a;
+            QVector3D d1  = positions[tri[1]] - positions[tri[0]];
+            QVector3D d2  = positions[tri[2]] - positions[tri[0]];
+            QVector2D t21 = texcoords[tri[1]] - texcoords[tri[0]];
+            QVector2D t31 = texcoords[tri[2]] - texcoords[tri[0]];
+
+            float signedArea = t21.x() * t31.y() - t21.y() * t31.x();
+            float sign       = (signedArea > 0.0f) ? 1.0f : -1.0f;
+            QVector3D sdir   = (t31.y() * d1 - t21.y() * d2) * sign;
+
+            for(int k = 0; k < 3 ; k++){
+                QVector4D& corner = corners[3*a+k];
+                corner = QVector4D(0,0,0,0);
+                if(signedArea == 0.0f) continue; // degenerated UVs do not contribute
+
+                QVector3D n = normals[tri[k]].normalized();
+                QVector3D t = (sdir - n * QVector3D::dotProduct(n,sdir)).normalized();
+                // corner angle measured in the tangent plane
+                QVector3D e1 = positions[tri[(k+1)%3]] - positions[tri[k]];
+                QVector3D e2 = positions[tri[(k+2)%3]] - positions[tri[k]];
+                e1 = (e1 - n * QVector3D::dotProduct(n,e1)).normalized();
+                e2 = (e2 - n * QVector3D::dotProduct(n,e2)).normalized();
+                float angle = acos(qBound(-1.0f,QVector3D::dotProduct(e1,e2),1.0f));
+                corner = QVector4D(t * angle, sign * angle);
+            }
+        }
+    },4096);
+
+    // corners of every vertex in the triangle order (counting sort)
+    QVector<int> offsets(vertexCount+1,0);
+    for(int c = 0; c < cornerCount ; c++) offsets[indices[c]+1]++;
+    for(int i = 0; i < vertexCount ; i++) offsets[i+1] += offsets[i];
+    QVector<int> vertexCorners(cornerCount);
+    QVector<int> next(offsets);
+    for(int c = 0; c < cornerCount ; c++) vertexCorners[next[indices[c]]++] = c;
+
+    parallelFor(vertexCount,[&](int begin, int end, int){
+        for(int i = begin; i < end ; i++){
+            QVector4D sum;
+            for(int k = offsets[i]; k < offsets[i+1] ; k++) sum += corners[vertexCorners[k]];
+
+            const QVector3D& n = normals[i];
+            QVector3D tangent  = sum.toVector3D();
+            if(tangent.lengthSquared() < 1.0E-20f){ // no valid UVs, any vector orthogonal to the normal
+                tangent = QVector3D::crossProduct(n,qAbs(n.x()) < 0.9f ? QVector3D(1,0,0) : QVector3D(0,1,0));
+            }
+            gl_tangents[i] = QVector4D(tangent.normalized(), sum.w() < 0.0f ? -1.0f : 1.0f);
+        }
+    },4096);
 }
 
 
@@ -343,11 +630,11 @@ Mesh::~Mesh() {
     gl_normals   .clear();
     gl_texcoords .clear();
     gl_tangents  .clear();
-    gl_bitangents.clear();
     gl_smoothed_normals.clear();
+    gl_indices   .clear();
 
-    if(bLoaded){
-        GLCHK(glDeleteBuffers(6 , mesh_vbos));
+    if(mesh_vao != 0){ // also partially uploaded meshes
+        GLCHK(glDeleteBuffers(2 , mesh_vbos));
         GLCHK(glDeleteVertexArrays(1, &mesh_vao));
     };
 }
@@ -16,9 +16,20 @@
 #include <QDebug>
 #include <QVector>
 #include <QVector3D>
+#include <QVector2D>
+#include <QVector4D>
 #include <iostream>
 #include "../qopenglerrorcheck.h"
 #include "tinyobj/tiny_obj_loader.h"
+#include "loadstatus.h"
+
+// Meshes with more triangles get simplified levels of detail, each MESH_LOD_RATIO
+// times smaller (MESH_MAX_LODS levels including the original one). The error
+// of the simplified surface is limited to MESH_LOD_MAX_ERROR of the mesh size.
+#define MESH_LOD_MIN_TRIANGLES 100000
+#define MESH_LOD_RATIO         4
+#define MESH_MAX_LODS          4
+#define MESH_LOD_MAX_ERROR     0.02f
 
 
 #ifdef USE_OPENGL_330
@@ -32,30 +43,68 @@
 
 using namespace std;
 
+/**
+ * @brief The MeshVertex struct is the interleaved vertex of the GPU buffer (32 bytes).
+ * Attribute locations: 0 - position, 1 - uv, 2 - normal, 3 - tangent (w is the
+ * bitangent handedness), 5 - smoothed normal. Directions are GL_INT_2_10_10_10_REV.
+ * UVs stay 32 bit floats: half floats step by 2 texels on 4k textures.
+ */
+struct MeshVertex{
+    float   position[3];
+    float   texcoord[2];
+    quint32 normal;
+    quint32 tangent;
+    quint32 smoothedNormal;
+};
+
 class Mesh : public OPENGL_FUNCTIONS {
 public:
 
 	/**
     * @brief Loads the OBJ mesh from folder "dir" and name "name": eq. Mesh("models/","cube.obj")
+    * and uploads it to the GPU (requires current GL context).
     * @param dir - mesh location
     * @param name - mesh name
 	*/
     Mesh(QString dir, QString name);
+    /**
+     * @brief Loads the mesh to memory only, so it can be created in a worker thread.
+     * The mesh is drawn after it is sent to the GPU with upload().
+     * @param status progress of the loading, the loading stops when it is cancelled
+     */
+    Mesh(QString dir, QString name, LoadStatus* status);
 
 	/**
     * @brief Draw the mesh if bLoaded is true otherwise does nothing
+    * @param lod level of detail, 0 - the original mesh
 	*/
-    void drawMesh(bool bUseArrays = false);
+    void drawMesh(bool bUseArrays = false, int lod = 0);
+    inline int getNoLods() const {return lod_indices.size();}
+    int getNoTriangles(int lod = 0) const;
+    /**
+     * @brief selectLod returns the most detailed level with at most maxTriangles
+     * triangles, or the coarsest level if all of them have more.
+     */
+    int selectLod(int maxTriangles) const;
     /**
      * @brief isLoaded returns true if mesh was succsesfully loaded from file,
      * otherwise returns false.
      */
     inline bool isLoaded(){return bLoaded;}
+    // true if the mesh was read and processed, so it can be uploaded
+    inline bool isProcessed(){return bProcessed;}
     inline QString& getMeshLog(){return mesh_log;}
     // Cleanings
     virtual ~Mesh();    
 
-    void initializeMesh();
+    /**
+     * @brief upload sends next part of the processed mesh to the GPU, so big
+     * meshes can be uploaded over several frames. Requires current GL context.
+     * @param maxBytes maximal number of bytes sent in this call, 0 - all
+     * @return true when the whole mesh is uploaded and can be drawn
+     */
+    bool upload(qint64 maxBytes = 0);
+    float uploadProgress() const; // 0 - 1
 
     // utils
     QVector3D centre_of_mass; // it helps to aling mesh to the center of the screen
@@ -63,22 +112,39 @@ public:
 private:       
     bool hasCommonEdge(int i, int j);
     void calculateTangents();
+    void calculateSmoothedNormals();
+    void load(const QString& dir, LoadStatus* status);
+    void buildLods(LoadStatus* status);
+    void buildVertices();
+    void createBuffers();
+
+    // Binary cache (.abmesh) of the GPU buffers, valid while the source file
+    // has the same size, modification time and hash.
+    bool readCache();
+    void writeCache();
+    QStringList cacheFileNames();
+    static QByteArray sourceHash(const QString& fileName);
 
 
     QString mesh_path;
+    QString mesh_file;  // full path of the source file
     GLuint mesh_vao;
+    QVector<int> lod_indices; // number of indices of each level of detail, all are in one element buffer
+    qint64 mesh_uploaded; // bytes of the vertex and the element buffer sent to the GPU
     bool bLoaded;
+    bool bProcessed;
 
 
-    // arrays
+    // arrays, one entry per unique (position, uv, normal) vertex
     QVector<QVector3D> gl_vertices;
     QVector<QVector3D> gl_normals;
     QVector<QVector3D> gl_smoothed_normals;
-    QVector<QVector3D> gl_texcoords;
-    QVector<QVector3D> gl_tangents;
-    QVector<QVector3D> gl_bitangents;
+    QVector<QVector2D> gl_texcoords;
+    QVector<QVector4D> gl_tangents;   // w - bitangent handedness
+    QVector<unsigned int> gl_indices; // three vertices per triangle
+    QVector<MeshVertex> mesh_vertices;  // packed vertices waiting for upload
 
-    unsigned int mesh_vbos[6]; // VBO indices
+    unsigned int mesh_vbos[2]; // interleaved vertex buffer and element buffer
     QString mesh_log;
 };
 
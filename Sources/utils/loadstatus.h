@@ -0,0 +1,47 @@
+#ifndef LOADSTATUS_H
+#define LOADSTATUS_H
+
+#include <QAtomicInt>
+#include <QtGlobal>
+
+/**
+ * @brief The LoadStatus class is shared between a loading thread and the GUI.
+ * The loader reports progress of its current step and checks if it was
+ * cancelled, the GUI polls the progress and can cancel the loading.
+ */
+class LoadStatus
+{
+public:
+    LoadStatus():canceled(0),permille(0),stepFrom(0),stepTo(1){}
+
+    void cancel(){ canceled.storeRelease(1); }
+    bool isCanceled() const { return canceled.loadAcquire() != 0; }
+
+    /**
+     * @brief setStep sets the part of the total progress which is used by next
+     * setProgress calls. Must be called before worker threads of the step start.
+     */
+    void setStep(float from, float to){
+        stepFrom = from;
+        stepTo   = to;
+        setProgress(0);
+    }
+    // fraction (0-1) of the current step done, can be called from any thread
+    void setProgress(float fraction){
+        permille.storeRelease(int(1000*(stepFrom + (stepTo - stepFrom)*qBound(0.0f,fraction,1.0f))));
+    }
+    // total progress 0-1000
+    int progress() const { return permille.loadAcquire(); }
+
+private:
+    QAtomicInt canceled;
+    QAtomicInt permille;
+    float stepFrom, stepTo;
+};
+
+// helper for optional status pointers
+inline bool isCanceled(const LoadStatus* status){
+    return status != NULL && status->isCanceled();
+}
+
+#endif // LOADSTATUS_H
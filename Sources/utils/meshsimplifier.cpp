@@ -0,0 +1,249 @@
+#include "meshsimplifier.h"
+#include "parallel.h"
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace{
+
+// Sum of squared distances to triangle planes: x^T A x + 2 b^T x + c,
+// weighted by the triangle areas (w is the total weight).
+struct Quadric{
+    float a00, a01, a02, a11, a12, a22;
+    float b0, b1, b2;
+    float c;
+    float w;
+};
+
+struct Collapse{
+    float error;
+    int   from, to;
+    bool operator<(const Collapse& other) const{
+        return error < other.error || (error == other.error && from < other.from);
+    }
+};
+
+void addPlane(Quadric& q, const QVector3D& n, float d, float w){
+    q.a00 += w*n.x()*n.x(); q.a01 += w*n.x()*n.y(); q.a02 += w*n.x()*n.z();
+    q.a11 += w*n.y()*n.y(); q.a12 += w*n.y()*n.z(); q.a22 += w*n.z()*n.z();
+    q.b0  += w*n.x()*d;     q.b1  += w*n.y()*d;     q.b2  += w*n.z()*d;
+    q.c   += w*d*d;
+    q.w   += w;
+}
+
+void addQuadric(Quadric& q, const Quadric& r){
+    q.a00 += r.a00; q.a01 += r.a01; q.a02 += r.a02;
+    q.a11 += r.a11; q.a12 += r.a12; q.a22 += r.a22;
+    q.b0  += r.b0;  q.b1  += r.b1;  q.b2  += r.b2;
+    q.c   += r.c;
+    q.w   += r.w;
+}
+
+float evaluate(const Quadric& q, const QVector3D& p){
+    float x = p.x(), y = p.y(), z = p.z();
+    float e = q.a00*x*x + q.a11*y*y + q.a22*z*z + 2*(q.a01*x*y + q.a02*x*z + q.a12*y*z)
+            + 2*(q.b0*x + q.b1*y + q.b2*z) + q.c;
+    return qAbs(e);
+}
+
+// Triangles around every vertex (counting sort, in the triangle order).
+void buildAdjacency(const QVector<unsigned int>& indices, int noVertices,
+                    QVector<int>& offsets, QVector<int>& fans){
+    offsets.fill(0,noVertices+1);
+    for(int c = 0; c < indices.size() ; c++) offsets[indices[c]+1]++;
+    for(int v = 0; v < noVertices ; v++) offsets[v+1] += offsets[v];
+    fans.resize(indices.size());
+    QVector<int> next(offsets);
+    for(int c = 0; c < indices.size() ; c++) fans[next[indices[c]]++] = c/3;
+}
+
+// Moving vertex "from" to "to" must not flip or collapse remaining triangles.
+bool isValidCollapse(const QVector<QVector3D>& positions, const unsigned int* indices,
+                     const int* fan, int fanSize, int from, int to){
+    for(int f = 0; f < fanSize ; f++){
+        const unsigned int* tri = indices + 3*fan[f];
+        if(int(tri[0]) == to || int(tri[1]) == to || int(tri[2]) == to) continue; // removed
+        QVector3D p[3], q[3];
+        for(int k = 0; k < 3 ; k++){
+            p[k] = positions[tri[k]];
+            q[k] = (int(tri[k]) == from) ? positions[to] : p[k];
+        }
+        QVector3D before = QVector3D::crossProduct(p[1]-p[0],p[2]-p[0]);
+        QVector3D after  = QVector3D::crossProduct(q[1]-q[0],q[2]-q[0]);
+        float lengths = before.length() * after.length();
+        if(before.lengthSquared() < 1.0E-24f) continue; // already degenerated
+        if(QVector3D::dotProduct(before,after) <= 0.5f * lengths) return false; // more than 60 degrees
+    }
+    return true;
+}
+
+// One pass of independent half edge collapses ordered by the error. Vertices
+// around a collapsed vertex are not changed again in the same pass, so the
+// precomputed errors and flip checks stay valid.
+// Returns false when nothing could be collapsed.
+bool collapsePass(const QVector<QVector3D>& positions, QVector<Quadric>& quadrics,
+                  const QVector<char>& locked, QVector<unsigned int>& indices,
+                  int targetTriangles, float maxError){
+    int noVertices  = positions.size();
+    int noTriangles = indices.size()/3;
+    QVector<int> offsets, fans;
+    buildAdjacency(indices,noVertices,offsets,fans);
+    const unsigned int* tris = indices.constData();
+
+    QVector<Collapse> candidates(noVertices);
+    parallelFor(noVertices,[&](int begin, int end, int){
+        for(int v = begin; v < end ; v++){
+            Collapse& best = candidates[v];
+            best.from  = v;
+            best.to    = -1;
+            best.error = maxError;
+            if(locked[v]) continue;
+            for(int f = offsets[v]; f < offsets[v+1] ; f++){
+                const unsigned int* tri = tris + 3*fans[f];
+                for(int k = 0; k < 3 ; k++){
+                    int to = tri[k];
+                    if(to == v) continue;
+                    const Quadric& qv = quadrics[v];
+                    const Quadric& qt = quadrics[to];
+                    float error = (evaluate(qv,positions[to]) + evaluate(qt,positions[to])) / qMax(qv.w + qt.w,1.0E-20f);
+                    if(error >= best.error && best.to >= 0) continue;
+                    if(error > maxError) continue;
+                    if(!isValidCollapse(positions,tris,fans.constData()+offsets[v],offsets[v+1]-offsets[v],v,to)) continue;
+                    best.error = error;
+                    best.to    = to;
+                }
+            }
+        }
+    },4096);
+
+    int noCandidates = 0;
+    for(int v = 0; v < noVertices ; v++){
+        if(candidates[v].to >= 0) candidates[noCandidates++] = candidates[v];
+    }
+    if(noCandidates == 0) return false;
+    std::sort(candidates.begin(),candidates.begin()+noCandidates);
+
+    QVector<int>  remap(noVertices);
+    QVector<char> blocked(noVertices,0);
+    for(int v = 0; v < noVertices ; v++) remap[v] = v;
+    int removed = 0;
+    for(int c = 0; c < noCandidates && noTriangles - removed > targetTriangles ; c++){
+        const Collapse& collapse = candidates[c];
+        if(blocked[collapse.from] || blocked[collapse.to]) continue;
+        remap[collapse.from] = collapse.to;
+        addQuadric(quadrics[collapse.to],quadrics[collapse.from]);
+        for(int f = offsets[collapse.from]; f < offsets[collapse.from+1] ; f++){
+            const unsigned int* tri = tris + 3*fans[f];
+            blocked[tri[0]] = blocked[tri[1]] = blocked[tri[2]] = 1;
+            if(int(tri[0]) == collapse.to || int(tri[1]) == collapse.to || int(tri[2]) == collapse.to) removed++;
+        }
+    }
+    if(removed == 0) return false;
+
+    // remap indices and drop degenerated triangles
+    int noOutput = 0;
+    for(int t = 0; t < noTriangles ; t++){
+        unsigned int a = remap[indices[3*t+0]];
+        unsigned int b = remap[indices[3*t+1]];
+        unsigned int c = remap[indices[3*t+2]];
+        if(a == b || b == c || a == c) continue;
+        indices[3*noOutput+0] = a;
+        indices[3*noOutput+1] = b;
+        indices[3*noOutput+2] = c;
+        noOutput++;
+    }
+    indices.resize(3*noOutput);
+    return true;
+}
+
+} // namespace
+
+QVector<QVector<unsigned int> > MeshSimplifier::buildLods(const QVector<QVector3D>& sourcePositions,
+                                                         const QVector<unsigned int>& sourceIndices,
+                                                         int maxLods, float ratio, int minTriangles,
+                                                         float maxError, LoadStatus* status){
+    QVector<QVector<unsigned int> > lods;
+    int noVertices  = sourcePositions.size();
+    int noTriangles = sourceIndices.size()/3;
+    if(noVertices == 0 || noTriangles == 0 || maxLods <= 0 || ratio <= 1) return lods;
+    LoadStatus localStatus;
+    if(status == NULL) status = &localStatus;
+
+    // positions are scaled to the unit box, so the error is relative to the mesh size
+    QVector3D minPos = sourcePositions[0], maxPos = sourcePositions[0];
+    for(int v = 1; v < noVertices ; v++){
+        const QVector3D& p = sourcePositions[v];
+        minPos = QVector3D(qMin(minPos.x(),p.x()),qMin(minPos.y(),p.y()),qMin(minPos.z(),p.z()));
+        maxPos = QVector3D(qMax(maxPos.x(),p.x()),qMax(maxPos.y(),p.y()),qMax(maxPos.z(),p.z()));
+    }
+    QVector3D size  = maxPos - minPos;
+    float scale     = 1.0f / qMax(qMax(size.x(),size.y()),qMax(size.z(),1.0E-20f));
+    QVector<QVector3D> positions(noVertices);
+    parallelFor(noVertices,[&](int begin, int end, int){
+        for(int v = begin; v < end ; v++) positions[v] = (sourcePositions[v] - minPos) * scale;
+    },4096);
+
+    QVector<unsigned int> indices = sourceIndices;
+    QVector<int> offsets, fans;
+    buildAdjacency(indices,noVertices,offsets,fans);
+
+    // Vertices on open edges (borders, UV and normal seams) are locked: in a
+    // closed fan every edge leaving the vertex also comes back to it.
+    QVector<char> locked(noVertices);
+    parallelFor(noVertices,[&](int begin, int end, int){
+        std::vector<unsigned int> outgoing, incoming;
+        for(int v = begin; v < end ; v++){
+            outgoing.clear();
+            incoming.clear();
+            for(int f = offsets[v]; f < offsets[v+1] ; f++){
+                const unsigned int* tri = indices.constData() + 3*fans[f];
+                int k = (int(tri[0]) == v) ? 0 : (int(tri[1]) == v ? 1 : 2);
+                outgoing.push_back(tri[(k+1)%3]);
+                incoming.push_back(tri[(k+2)%3]);
+            }
+            std::sort(outgoing.begin(),outgoing.end());
+            std::sort(incoming.begin(),incoming.end());
+            locked[v] = outgoing.empty() || outgoing != incoming;
+        }
+    },4096);
+
+    QVector<Quadric> quadrics(noVertices);
+    parallelFor(noVertices,[&](int begin, int end, int){
+        for(int v = begin; v < end ; v++){
+            Quadric& q = quadrics[v];
+            memset(&q,0,sizeof(q));
+            for(int f = offsets[v]; f < offsets[v+1] ; f++){
+                const unsigned int* tri = indices.constData() + 3*fans[f];
+                QVector3D normal = QVector3D::crossProduct(positions[tri[1]] - positions[tri[0]],
+                                                           positions[tri[2]] - positions[tri[0]]);
+                float length = normal.length();
+                if(length <= 0) continue;
+                normal /= length;
+                addPlane(q,normal,-QVector3D::dotProduct(normal,positions[tri[0]]),0.5f*length);
+            }
+        }
+    },4096);
+
+    float maxError2   = maxError * maxError;
+    float totalSteps  = maxLods * std::log(ratio);
+    int   target      = noTriangles;
+    for(int lod = 0; lod < maxLods ; lod++){
+        int before = indices.size()/3;
+        target     = int(before / ratio);
+        if(target < minTriangles) break;
+
+        while(int(indices.size()/3) > target){
+            if(!collapsePass(positions,quadrics,locked,indices,target,maxError2)) break;
+            if(status->isCanceled()) return QVector<QVector<unsigned int> >();
+            status->setProgress(std::log(float(noTriangles) / (indices.size()/3)) / totalSteps);
+        }
+
+        int after = indices.size()/3;
+        if(after > 0.75f * before) break; // error limit or locked vertices
+        lods.push_back(indices);
+        qDebug() << "MeshSimplifier:: LOD" << lod+1 << "has" << after << "triangles";
+    }
+    status->setProgress(1);
+    return lods;
+}
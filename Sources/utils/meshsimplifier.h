@@ -0,0 +1,34 @@
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include <QVector>
+#include <QVector3D>
+#include "loadstatus.h"
+
+/**
+ * @brief The MeshSimplifier class builds levels of detail of indexed triangle
+ * meshes with quadric error metric edge collapses (Garland, Heckbert 1997).
+ * Half edge collapses are used (a vertex is moved to one of its neighbours),
+ * so all levels share the vertex buffer of the original mesh and differ only
+ * by indices. Vertices on open edges are never moved: UV and normal seams are
+ * split vertices in the indexed mesh, so seams and borders stay intact.
+ */
+class MeshSimplifier
+{
+public:
+    /**
+     * @brief buildLods simplifies the mesh in steps, each level has about
+     * "ratio" times fewer triangles than the previous one. Stops when a level
+     * would have less than minTriangles or could not be reduced enough within
+     * the error limit.
+     * @param maxError maximal distance of the simplified surface relative to the mesh size
+     * @param status optional progress, returns no levels when cancelled
+     * @return index buffers of the simplified levels, the original is not included
+     */
+    static QVector<QVector<unsigned int> > buildLods(const QVector<QVector3D>& positions,
+                                                    const QVector<unsigned int>& indices,
+                                                    int maxLods, float ratio, int minTriangles,
+                                                    float maxError, LoadStatus* status = NULL);
+};
+
+#endif // MESHSIMPLIFIER_H
@@ -0,0 +1,400 @@
+#include "objparser.h"
+#include "parallel.h"
+#include <QFile>
+#include <QDebug>
+#include <cstring>
+#include <cmath>
+
+struct ObjParser::Chunk{
+    // group (g/o line) starting inside the chunk, corners before firstCorner
+    // belong to the previous group
+    struct Group{
+        std::string name;
+        size_t      firstCorner;
+    };
+
+    const char* begin;
+    const char* end;
+    int noPositions, noTexcoords, noNormals;       // lines in this chunk
+    int basePositions, baseTexcoords, baseNormals; // lines in previous chunks
+    int totalPositions, totalTexcoords, totalNormals;
+    std::vector<Corner> corners;                   // triangulated faces
+    std::vector<Group>  groups;
+    LoadStatus* status;                            // optional, shared by all chunks
+    QAtomicInt* parsedMB;
+    int         totalMB;
+};
+
+enum LineType{
+    LINE_OTHER = 0,
+    LINE_POSITION,
+    LINE_TEXCOORD,
+    LINE_NORMAL,
+    LINE_FACE,
+    LINE_GROUP
+};
+
+static inline bool isBlank(char c){
+    return c == ' ' || c == '\t';
+}
+
+static inline bool isSeparator(const char* p, const char* end){
+    return p >= end || *p == ' ' || *p == '\t' || *p == '\r';
+}
+
+static inline const char* skipBlanks(const char* p, const char* end){
+    while(p < end && isBlank(*p)) p++;
+    return p;
+}
+
+// Classifies the line starting at p (leading blanks already skipped).
+static inline LineType lineType(const char* p, const char* end){
+    if(p >= end) return LINE_OTHER;
+    switch(p[0]){
+        case('v'):
+            if(isSeparator(p+1,end) && p+1 < end) return LINE_POSITION;
+            if(p+1 < end && p[1] == 't' && p+2 < end && isBlank(p[2])) return LINE_TEXCOORD;
+            if(p+1 < end && p[1] == 'n' && p+2 < end && isBlank(p[2])) return LINE_NORMAL;
+            return LINE_OTHER;
+        case('f'):
+            return (p+1 < end && isBlank(p[1])) ? LINE_FACE : LINE_OTHER;
+        case('g'):
+        case('o'):
+            return isSeparator(p+1,end) ? LINE_GROUP : LINE_OTHER;
+        default:
+            return LINE_OTHER;
+    }
+}
+
+// Fast float parser: [+-]digits[.digits][(e|E)[+-]digits], stops at the token end.
+static const char* parseFloat(const char* p, const char* end, float& value){
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                                    1e11,1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22};
+    p = skipBlanks(p,end);
+    bool bNegative = false;
+    if(p < end && (*p == '-' || *p == '+')){
+        bNegative = (*p == '-');
+        p++;
+    }
+    double mantissa = 0;
+    int exponent    = 0;
+    bool bDigits    = false;
+    while(p < end && *p >= '0' && *p <= '9'){
+        mantissa = mantissa*10 + (*p - '0');
+        bDigits  = true;
+        p++;
+    }
+    if(p < end && *p == '.'){
+        p++;
+        while(p < end && *p >= '0' && *p <= '9'){
+            mantissa = mantissa*10 + (*p - '0');
+            exponent--;
+            bDigits  = true;
+            p++;
+        }
+    }
+    if(bDigits && p < end && (*p == 'e' || *p == 'E')){
+        p++;
+        bool bNegativeExp = false;
+        if(p < end && (*p == '-' || *p == '+')){
+            bNegativeExp = (*p == '-');
+            p++;
+        }
+        int e = 0;
+        while(p < end && *p >= '0' && *p <= '9'){
+            e = qMin(e*10 + (*p - '0'),1000);
+            p++;
+        }
+        exponent += bNegativeExp ? -e : e;
+    }
+    if(exponent != 0){
+        int absExponent = qAbs(exponent);
+        double scale = (absExponent <= 22) ? powers[absExponent] : pow(10.0,absExponent);
+        mantissa = (exponent < 0) ? mantissa / scale : mantissa * scale;
+    }
+    value = float(bNegative ? -mantissa : mantissa);
+    while(!isSeparator(p,end)) p++; // skip unsupported characters (e.g. "nan")
+    return p;
+}
+
+static inline const char* parseInt(const char* p, const char* end, int& value){
+    bool bNegative = false;
+    if(p < end && (*p == '-' || *p == '+')){
+        bNegative = (*p == '-');
+        p++;
+    }
+    int result = 0;
+    while(p < end && *p >= '0' && *p <= '9'){
+        result = result*10 + (*p - '0');
+        p++;
+    }
+    value = bNegative ? -result : result;
+    return p;
+}
+
+// OBJ indices are one based, negative values are relative to the current count.
+static inline int resolveIndex(int index, int count, int total){
+    int resolved = (index > 0) ? index - 1 : (index < 0 ? count + index : -1);
+    return (resolved >= 0 && resolved < total) ? resolved : -1;
+}
+
+void ObjParser::countChunk(Chunk& chunk){
+    chunk.noPositions = chunk.noTexcoords = chunk.noNormals = 0;
+    const char* p = chunk.begin;
+    while(p < chunk.end){
+        const char* lineEnd = (const char*)memchr(p,'\n',chunk.end - p);
+        if(lineEnd == NULL) lineEnd = chunk.end;
+        switch(lineType(skipBlanks(p,lineEnd),lineEnd)){
+            case(LINE_POSITION): chunk.noPositions++; break;
+            case(LINE_TEXCOORD): chunk.noTexcoords++; break;
+            case(LINE_NORMAL):   chunk.noNormals++;   break;
+            default: break;
+        }
+        p = lineEnd + 1;
+    }
+}
+
+void ObjParser::parseChunk(Chunk& chunk, float* positions, float* texcoords, float* normals){
+    int noPositions = chunk.basePositions;
+    int noTexcoords = chunk.baseTexcoords;
+    int noNormals   = chunk.baseNormals;
+    std::vector<Corner> face;
+
+    const char* p = chunk.begin;
+    const char* reported = chunk.begin;
+    while(p < chunk.end){
+        if(p - reported > (1 << 20)){ // every MB
+            if(isCanceled(chunk.status)) return;
+            if(chunk.status != NULL){
+                int parsedMB = chunk.parsedMB->fetchAndAddRelaxed(1) + 1;
+                chunk.status->setProgress(float(parsedMB) / chunk.totalMB);
+            }
+            reported += 1 << 20;
+        }
+        const char* lineEnd = (const char*)memchr(p,'\n',chunk.end - p);
+        if(lineEnd == NULL) lineEnd = chunk.end;
+        p = skipBlanks(p,lineEnd);
+
+        switch(lineType(p,lineEnd)){
+            case(LINE_POSITION):{
+                float* dst = positions + 3*qint64(noPositions++);
+                p = parseFloat(p+1,lineEnd,dst[0]);
+                p = parseFloat(p,lineEnd,dst[1]);
+                p = parseFloat(p,lineEnd,dst[2]);
+                break;
+            }
+            case(LINE_TEXCOORD):{
+                float* dst = texcoords + 2*qint64(noTexcoords++);
+                p = parseFloat(p+2,lineEnd,dst[0]);
+                p = parseFloat(p,lineEnd,dst[1]);
+                break;
+            }
+            case(LINE_NORMAL):{
+                float* dst = normals + 3*qint64(noNormals++);
+                p = parseFloat(p+2,lineEnd,dst[0]);
+                p = parseFloat(p,lineEnd,dst[1]);
+                p = parseFloat(p,lineEnd,dst[2]);
+                break;
+            }
+            case(LINE_FACE):{
+                face.clear();
+                p = skipBlanks(p+1,lineEnd);
+                bool bValid = true;
+                while(p < lineEnd && *p != '\r'){
+                    int v = 0, vt = 0, vn = 0;
+                    p = parseInt(p,lineEnd,v);
+                    if(p < lineEnd && *p == '/'){
+                        p++;
+                        if(p < lineEnd && *p != '/') p = parseInt(p,lineEnd,vt);
+                        if(p < lineEnd && *p == '/'){
+                            p++;
+                            p = parseInt(p,lineEnd,vn);
+                        }
+                    }
+                    while(!isSeparator(p,lineEnd)) p++; // malformed token
+                    p = skipBlanks(p,lineEnd);
+
+                    Corner corner;
+                    corner.v  = resolveIndex(v ,noPositions,chunk.totalPositions);
+                    corner.vt = resolveIndex(vt,noTexcoords,chunk.totalTexcoords);
+                    corner.vn = resolveIndex(vn,noNormals  ,chunk.totalNormals);
+                    if(corner.v < 0) bValid = false;
+                    face.push_back(corner);
+                }
+                if(!bValid) break; // faces referencing missing positions are skipped
+                // polygon -> triangle fan
+                for(size_t k = 2; k < face.size(); k++){
+                    chunk.corners.push_back(face[0]);
+                    chunk.corners.push_back(face[k-1]);
+                    chunk.corners.push_back(face[k]);
+                }
+                break;
+            }
+            case(LINE_GROUP):{
+                const char* name = skipBlanks(p+1,lineEnd);
+                const char* nameEnd = name;
+                while(!isSeparator(nameEnd,lineEnd)) nameEnd++;
+                Chunk::Group group;
+                group.name        = std::string(name,nameEnd - name);
+                group.firstCorner = chunk.corners.size();
+                chunk.groups.push_back(group);
+                break;
+            }
+            default: break;
+        }
+        p = lineEnd + 1;
+    }
+}
+
+void ObjParser::exportShape(const std::vector<Corner>& corners,
+                            const std::vector<float>& positions,
+                            const std::vector<float>& texcoords,
+                            const std::vector<float>& normals,
+                            tinyobj::shape_t& shape){
+    int minV = corners[0].v, maxV = corners[0].v;
+    for(size_t c = 1; c < corners.size(); c++){
+        minV = qMin(minV,corners[c].v);
+        maxV = qMax(maxV,corners[c].v);
+    }
+
+    // one vertex per unique (v,vt,vn), tuples sharing a position are chained
+    std::vector<int> head(maxV - minV + 1,-1);
+    std::vector<int> next;
+    std::vector<Corner> unique;
+    shape.mesh.indices.resize(corners.size());
+    for(size_t c = 0; c < corners.size(); c++){
+        const Corner& corner = corners[c];
+        int& first = head[corner.v - minV];
+        int index  = first;
+        while(index >= 0 && (unique[index].vt != corner.vt || unique[index].vn != corner.vn)){
+            index = next[index];
+        }
+        if(index < 0){
+            index = unique.size();
+            unique.push_back(corner);
+            next.push_back(first);
+            first = index;
+        }
+        shape.mesh.indices[c] = index;
+    }
+
+    // like tinyobj: UVs and normals are added only for vertices which have them
+    tinyobj::mesh_t& mesh = shape.mesh;
+    mesh.positions.reserve(3*unique.size());
+    for(size_t u = 0; u < unique.size(); u++){
+        const Corner& corner = unique[u];
+        mesh.positions.insert(mesh.positions.end(),&positions[3*size_t(corner.v)],&positions[3*size_t(corner.v)]+3);
+        if(corner.vt >= 0) mesh.texcoords.insert(mesh.texcoords.end(),&texcoords[2*size_t(corner.vt)],&texcoords[2*size_t(corner.vt)]+2);
+        if(corner.vn >= 0) mesh.normals  .insert(mesh.normals  .end(),&normals  [3*size_t(corner.vn)],&normals  [3*size_t(corner.vn)]+3);
+    }
+    mesh.material_ids.assign(corners.size()/3,-1);
+}
+
+bool ObjParser::load(const QString& fileName, std::vector<tinyobj::shape_t>& shapes, QString& error,
+                     LoadStatus* status){
+    shapes.clear();
+    error.clear();
+
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly)){
+        error = "Cannot open file: " + fileName;
+        return false;
+    }
+    qint64 size = file.size();
+    QByteArray content;
+    const char* data = (size > 0) ? (const char*)file.map(0,size) : NULL;
+    if(data == NULL){ // mapping is not supported, read the file to memory
+        content = file.readAll();
+        data    = content.constData();
+        size    = content.size();
+    }
+
+    // newline aligned chunks, at least 4MB each
+    int noChunks = parallelRanges(int(size >> 22));
+    std::vector<Chunk> chunks(noChunks);
+    const char* end = data + size;
+    const char* chunkBegin = data;
+    for(int c = 0; c < noChunks; c++){
+        const char* chunkEnd = (c == noChunks-1) ? end : data + size*(c+1)/noChunks;
+        if(chunkEnd < chunkBegin) chunkEnd = chunkBegin;
+        const char* newLine = (const char*)memchr(chunkEnd,'\n',end - chunkEnd);
+        chunkEnd = (newLine != NULL) ? newLine + 1 : end;
+        chunks[c].begin = chunkBegin;
+        chunks[c].end   = chunkEnd;
+        chunkBegin      = chunkEnd;
+    }
+
+    parallelFor(noChunks,[&](int begin, int end, int){
+        for(int c = begin; c < end; c++) countChunk(chunks[c]);
+    });
+
+    int noPositions = 0, noTexcoords = 0, noNormals = 0;
+    for(int c = 0; c < noChunks; c++){
+        chunks[c].basePositions = noPositions;
+        chunks[c].baseTexcoords = noTexcoords;
+        chunks[c].baseNormals   = noNormals;
+        noPositions += chunks[c].noPositions;
+        noTexcoords += chunks[c].noTexcoords;
+        noNormals   += chunks[c].noNormals;
+    }
+    std::vector<float> positions(3*size_t(noPositions));
+    std::vector<float> texcoords(2*size_t(noTexcoords));
+    std::vector<float> normals  (3*size_t(noNormals));
+    for(int c = 0; c < noChunks; c++){
+        chunks[c].totalPositions = noPositions;
+        chunks[c].totalTexcoords = noTexcoords;
+        chunks[c].totalNormals   = noNormals;
+    }
+
+    QAtomicInt parsedMB(0);
+    for(int c = 0; c < noChunks; c++){
+        chunks[c].status   = status;
+        chunks[c].parsedMB = &parsedMB;
+        chunks[c].totalMB  = qMax(qint64(1),size >> 20);
+    }
+    parallelFor(noChunks,[&](int begin, int end, int){
+        for(int c = begin; c < end; c++) parseChunk(chunks[c],positions.data(),texcoords.data(),normals.data());
+    });
+    if(isCanceled(status)){
+        error = "Loading canceled";
+        return false;
+    }
+
+    // merge face streams into shapes, groups may continue in the next chunk
+    std::vector<std::string>         names;
+    std::vector<std::vector<Corner> > shapeCorners(1);
+    names.push_back(std::string());
+    for(int c = 0; c < noChunks; c++){
+        Chunk& chunk = chunks[c];
+        size_t from  = 0;
+        for(size_t g = 0; g < chunk.groups.size(); g++){
+            size_t to = chunk.groups[g].firstCorner;
+            shapeCorners.back().insert(shapeCorners.back().end(),chunk.corners.begin()+from,chunk.corners.begin()+to);
+            if(shapeCorners.back().empty()){
+                names.back() = chunk.groups[g].name; // group without faces, only renamed
+            }else{
+                names.push_back(chunk.groups[g].name);
+                shapeCorners.push_back(std::vector<Corner>());
+            }
+            from = to;
+        }
+        shapeCorners.back().insert(shapeCorners.back().end(),chunk.corners.begin()+from,chunk.corners.end());
+        std::vector<Corner>().swap(chunk.corners);
+    }
+    if(shapeCorners.back().empty()){
+        shapeCorners.pop_back();
+        names.pop_back();
+    }
+
+    shapes.resize(shapeCorners.size());
+    parallelFor(int(shapes.size()),[&](int begin, int end, int){
+        for(int s = begin; s < end; s++){
+            shapes[s].name = names[s];
+            exportShape(shapeCorners[s],positions,texcoords,normals,shapes[s]);
+        }
+    });
+
+    qDebug() << "ObjParser:: loaded" << fileName << "in" << noChunks << "chunks:"
+             << noPositions << "positions," << shapes.size() << "shapes";
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef OBJPARSER_H
+#define OBJPARSER_H
+
+#include <QString>
+#include <vector>
+#include "tinyobj/tiny_obj_loader.h"
+#include "loadstatus.h"
+
+/**
+ * @brief The ObjParser class reads Wavefront OBJ files in parallel. The file
+ * is memory mapped and split into newline aligned chunks. The first pass
+ * counts v/vt/vn lines of every chunk, so in the second pass each chunk
+ * writes its values directly to the final arrays and can resolve relative
+ * (negative) face indices. Shapes are created at g/o lines like in tinyobj and
+ * contain one vertex per unique (position, uv, normal) index tuple.
+ * Materials (mtllib/usemtl) and smoothing groups are ignored.
+ */
+class ObjParser
+{
+public:
+    /**
+     * @brief load parses the file into shapes in the tinyobj format.
+     * @param error reason of the failure, empty on success
+     * @param status optional progress of parsing, the parsing stops when it is cancelled
+     */
+    static bool load(const QString& fileName, std::vector<tinyobj::shape_t>& shapes, QString& error,
+                     LoadStatus* status = NULL);
+
+private:
+    struct Chunk;
+    struct Corner{
+        int v, vt, vn; // global zero based indices, -1 if missing
+    };
+    static void countChunk(Chunk& chunk);
+    static void parseChunk(Chunk& chunk, float* positions, float* texcoords, float* normals);
+    static void exportShape(const std::vector<Corner>& corners,
+                            const std::vector<float>& positions,
+                            const std::vector<float>& texcoords,
+                            const std::vector<float>& normals,
+                            tinyobj::shape_t& shape);
+};
+
+#endif // OBJPARSER_H
@@ -0,0 +1,45 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <QThread>
+#include <vector>
+#include <thread>
+
+/**
+ * @brief parallelRanges returns the number of ranges used by parallelFor
+ * for given number of items. Use it to allocate per thread accumulators.
+ * @param count number of items
+ * @param minRangeSize the smallest number of items processed by one thread
+ */
+inline int parallelRanges(int count, int minRangeSize = 1){
+    int noRanges = count / qMax(1,minRangeSize);
+    return qMax(1,qMin(QThread::idealThreadCount(),noRanges));
+}
+
+/**
+ * @brief parallelFor splits [0,count) into continuous ranges and calls
+ * func(begin,end,range) for each of them in a separate thread. Returns
+ * when all ranges are done. The range index is smaller than
+ * parallelRanges(count,minRangeSize).
+ */
+template<class Func>
+void parallelFor(int count, Func func, int minRangeSize = 1){
+    if(count <= 0) return;
+    int noRanges  = parallelRanges(count,minRangeSize);
+    int rangeSize = (count + noRanges - 1) / noRanges;
+    if(noRanges == 1){
+        func(0,count,0);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    for(int r = 1 ; r < noRanges ; r++){
+        int begin = qMin(count,r*rangeSize);
+        int end   = qMin(count,begin+rangeSize);
+        threads.push_back(std::thread(func,begin,end,r));
+    }
+    func(0,qMin(count,rangeSize),0);
+    for(size_t t = 0 ; t < threads.size() ; t++) threads[t].join();
+}
+
+#endif // PARALLEL_H
@@ -32,6 +32,8 @@
 ****************************************************************************/
 
 #include "qglbuffers.h"
+#include "textureupload.h"
+#include "parallel.h"
 #include <QtGui/qmatrix4x4.h>
 
 
@@ -91,8 +93,6 @@ GLTexture2D::GLTexture2D(const QString& fileName, int width, int height)
         return;
     }
 
-    image = image.convertToFormat(QImage::Format_ARGB32);
-
     //qDebug() << "Image size:" << image.width() << "x" << image.height();
     if (width <= 0)
         width = image.width();
@@ -103,10 +103,8 @@ GLTexture2D::GLTexture2D(const QString& fileName, int width, int height)
 
     glBindTexture(GL_TEXTURE_2D, m_texture);
 
-    // Works on x86, so probably works on all little-endian systems.
-    // Does it work on big-endian systems?
-    glTexImage2D(GL_TEXTURE_2D, 0, 4, image.width(), image.height(), 0,
-        GL_BGRA, GL_UNSIGNED_BYTE, image.bits());
+    // decoded pixels are uploaded without conversion when possible
+    TextureUpload::upload(GL_TEXTURE_2D, image, false);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -184,24 +182,33 @@ void GLTexture3D::unbind()
 //                                GLTextureCube                               //
 //============================================================================//
 
-GLTextureCube::GLTextureCube(int size)
+GLTextureCube::GLTextureCube(int size, int levels)
 {
     GLCHK(glBindTexture(GL_TEXTURE_2D, 0));
     GLCHK(glBindTexture(GL_TEXTURE_CUBE_MAP, m_texture));
     qDebug() << "m_texture:" << m_texture;
-    for (int i = 0; i < 6; ++i)
-        GLCHK(glTexImage2D(
-                  GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, size, size, 0,
-                  GL_BGRA, GL_UNSIGNED_BYTE, 0)
-              );
+    levels = qMax(1,levels);
+    for (int level = 0; level < levels; ++level)
+        for (int i = 0; i < 6; ++i)
+            GLCHK(glTexImage2D(
+                      GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level, GL_RGBA,
+                      qMax(1,size >> level), qMax(1,size >> level), 0,
+                      GL_BGRA, GL_UNSIGNED_BYTE, 0)
+                  );
 
     GLCHK(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
     GLCHK(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
     GLCHK(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE));
     GLCHK(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
-    GLCHK(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+    GLCHK(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR));
+    GLCHK(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levels-1));
     GLCHK(glBindTexture(GL_TEXTURE_CUBE_MAP, 0));
+    numMipmaps = levels-1;
+    createFBO();
+}
 
+void GLTextureCube::createFBO()
+{
     // from http://stackoverflow.com/questions/462721/rendering-to-cube-map
     // framebuffer object
     GLCHK(glGenFramebuffers   (1, &fbo));
@@ -221,34 +228,34 @@ GLTextureCube::GLTextureCube(const QStringList& fileNames, int size)
 {
     // TODO: Add error handling.
 
+    // faces are decoded and scaled in parallel, GL calls stay in this thread
+    QVector<QImage> images(qMin(fileNames.size(),6));
+    parallelFor(images.size(),[&](int begin, int end, int){
+        for(int i = begin ; i < end ; i++) images[i] = QImage(fileNames[i]);
+    });
+    if (size <= 0 && !images.isEmpty())
+        size = images[0].width();
+    parallelFor(images.size(),[&](int begin, int end, int){
+        for(int i = begin ; i < end ; i++){
+            QImage& image = images[i];
+            if (!image.isNull() && (size != image.width() || size != image.height()))
+                image = image.scaled(size, size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        }
+    });
+
     GLCHK(glBindTexture(GL_TEXTURE_CUBE_MAP, m_texture));
 
     int index = 0;
-    foreach (QString file, fileNames) {
-        QImage image(file);
+    foreach (const QImage& image, images) {
         if (image.isNull()) {
             m_failed = true;
             break;
         }
-
-        image = image.convertToFormat(QImage::Format_ARGB32);
-
         //qDebug() << "Image size:" << image.width() << "x" << image.height();
-        if (size <= 0)
-            size = image.width();
-        if (size != image.width() || size != image.height())
-            image = image.scaled(size, size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
-
-        // Works on x86, so probably works on all little-endian systems.
-        // Does it work on big-endian systems?
-        GLCHK(glTexImage2D(
-                  GL_TEXTURE_CUBE_MAP_POSITIVE_X + index, 0,
-                  GL_RGBA, image.width(), image.height(), 0,
-                  GL_BGRA, GL_UNSIGNED_BYTE, image.bits()
-                  ));
 
-        if (++index == 6)
-            break;
+        // decoded pixels are uploaded without conversion when possible
+        TextureUpload::upload(GL_TEXTURE_CUBE_MAP_POSITIVE_X + index, image, false);
+        ++index;
     }
 
     // Clear remaining faces.
@@ -279,6 +286,69 @@ GLTextureCube::GLTextureCube(const QStringList& fileNames, int size)
 
 }
 
+GLTextureCube::GLTextureCube(QDataStream& stream)
+{
+    qint32 mipmaps = 0, levels = 0;
+    stream >> mipmaps >> levels;
+    numMipmaps = mipmaps;
+
+    GLCHK(glBindTexture(GL_TEXTURE_CUBE_MAP, m_texture));
+    QByteArray pixels;
+    for (int level = 0 ; level < levels && !m_failed ; level++) {
+        qint32 size = 0;
+        stream >> size;
+        pixels.resize(size*size*4);
+        for (int face = 0 ; face < 6 ; face++) {
+            if (stream.readRawData(pixels.data(), pixels.size()) != pixels.size()) {
+                m_failed = true;
+                break;
+            }
+            GLCHK(glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGBA, size, size, 0,
+                               GL_BGRA, GL_UNSIGNED_BYTE, pixels.constData()));
+        }
+    }
+    if (levels <= 0 || stream.status() != QDataStream::Ok) m_failed = true;
+
+    GLCHK(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+    GLCHK(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+    GLCHK(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE));
+    GLCHK(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+    GLCHK(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR));
+    GLCHK(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, qMax(0,levels-1)));
+    GLCHK(glBindTexture(GL_TEXTURE_CUBE_MAP, 0));
+    // cached prefiltered maps can be baked again e.g. after resize
+    createFBO();
+}
+
+bool GLTextureCube::write(QDataStream& stream)
+{
+    GLCHK(glBindTexture(GL_TEXTURE_CUBE_MAP, m_texture));
+    // only levels which were created are saved
+    QVector<int> sizes;
+    for (int level = 0 ; ; level++) {
+        int size = 0;
+        GLCHK(glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, level, GL_TEXTURE_WIDTH, &size));
+        if (size <= 0) break;
+        sizes.push_back(size);
+        if (size == 1) break;
+    }
+    stream << qint32(numMipmaps) << qint32(sizes.size());
+
+    QByteArray pixels;
+    GLCHK(glPixelStorei(GL_PACK_ALIGNMENT, 4));
+    for (int level = 0 ; level < sizes.size() ; level++) {
+        int size = sizes[level];
+        stream << qint32(size);
+        pixels.resize(size*size*4);
+        for (int face = 0 ; face < 6 ; face++) {
+            GLCHK(glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_BGRA, GL_UNSIGNED_BYTE, pixels.data()));
+            stream.writeRawData(pixels.constData(), pixels.size());
+        }
+    }
+    GLCHK(glBindTexture(GL_TEXTURE_CUBE_MAP, 0));
+    return !sizes.isEmpty() && stream.status() == QDataStream::Ok;
+}
+
 void GLTextureCube::load(int size, int face, QRgb *data)
 {
     GLCHK(glBindTexture(GL_TEXTURE_CUBE_MAP, m_texture));
@@ -293,8 +363,9 @@ void GLTextureCube::bind()
 //    GLCHK(glEnable(GL_TEXTURE_CUBE_MAP));
 }
 
-void GLTextureCube::bindFBO(){
+void GLTextureCube::bindFBO(int level){
     GLCHK(glBindFramebuffer   (GL_FRAMEBUFFER, fbo));
+    GLCHK(glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_texture, level));
     GLCHK(glDrawBuffer        (GL_COLOR_ATTACHMENT0)); // important!
 }
 
@@ -323,6 +394,79 @@ int GLTextureCube::textureCalcLevels(GLenum target)
 
 
 
+//============================================================================//
+//                                GLTextureBRDF                               //
+//============================================================================//
+
+GLTextureBRDF::GLTextureBRDF(int size, int samples)
+{
+    // GGX importance sampling in tangent space (N = +Z), Smith geometry term
+    // with k = alpha/2 and Schlick fresnel split into F0 scale and bias.
+    QVector<float> table(size*size*2);
+    parallelFor(size,[&](int begin, int end, int){
+        for (int y = begin ; y < end ; y++) {
+            float roughness = (y + 0.5f) / size;
+            float alpha     = roughness * roughness;
+            float k         = alpha / 2;
+            for (int x = 0 ; x < size ; x++) {
+                float NdotV = (x + 0.5f) / size;
+                QVector3D V(sqrt(1 - NdotV*NdotV), 0, NdotV);
+                float scale = 0, bias = 0;
+                for (int i = 0 ; i < samples ; i++) {
+                    // Hammersley point set
+                    quint32 bits = i;
+                    bits = (bits << 16u) | (bits >> 16u);
+                    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+                    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+                    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+                    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+                    float u = float(i) / samples;
+                    float v = bits * 2.3283064365386963e-10f;
+
+                    float phi      = 2 * M_PI * u;
+                    float cosTheta = sqrt((1 - v) / (1 + (alpha*alpha - 1) * v));
+                    float sinTheta = sqrt(1 - cosTheta*cosTheta);
+                    QVector3D H(sinTheta*cos(phi), sinTheta*sin(phi), cosTheta);
+                    float VdotH = QVector3D::dotProduct(V,H);
+                    QVector3D L = 2 * VdotH * H - V;
+
+                    float NdotL = L.z();
+                    float NdotH = H.z();
+                    if (NdotL <= 0) continue;
+                    VdotH = qMax(VdotH, 0.0f);
+                    float G    = (NdotV / (NdotV*(1 - k) + k)) * (NdotL / (NdotL*(1 - k) + k));
+                    float GVis = G * VdotH / (NdotH * NdotV);
+                    float Fc   = pow(1 - VdotH, 5);
+                    scale += (1 - Fc) * GVis;
+                    bias  += Fc * GVis;
+                }
+                table[2*(y*size + x)    ] = scale / samples;
+                table[2*(y*size + x) + 1] = bias  / samples;
+            }
+        }
+    });
+
+    GLCHK(glBindTexture(GL_TEXTURE_2D, m_texture));
+    GLCHK(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+    GLCHK(glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, size, size, 0,
+                       GL_RG, GL_FLOAT, table.constData()));
+    GLCHK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+    GLCHK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+    GLCHK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+    GLCHK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+    GLCHK(glBindTexture(GL_TEXTURE_2D, 0));
+}
+
+void GLTextureBRDF::bind()
+{
+    GLCHK(glBindTexture(GL_TEXTURE_2D, m_texture));
+}
+
+void GLTextureBRDF::unbind()
+{
+    GLCHK(glBindTexture(GL_TEXTURE_2D, 0));
+}
+
 //============================================================================//
 //                            GLFrameBufferObject                             //
 //============================================================================//
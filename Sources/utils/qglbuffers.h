@@ -112,15 +112,36 @@ public:
 class GLTextureCube : public GLTexture
 {
 public:
-    GLTextureCube(int size);
+    // Empty cube map with given number of mipmap levels (e.g. a render target).
+    GLTextureCube(int size, int levels = 1);
     explicit GLTextureCube(const QStringList& fileNames, int size = 0);
+    // Creates cube map from data saved by write (all mipmap levels).
+    explicit GLTextureCube(QDataStream& stream);
     void load(int size, int face, QRgb *data);
+    bool write(QDataStream& stream);
     virtual void bind() Q_DECL_OVERRIDE;
-    virtual void bindFBO();
+    // Binds framebuffer with given mipmap level attached (all faces are layers).
+    virtual void bindFBO(int level = 0);
     virtual void unbind() Q_DECL_OVERRIDE;
     int textureCalcLevels(GLenum target);
 public:
     int numMipmaps;
+private:
+    void createFBO();
+};
+
+/**
+ * @brief The GLTextureBRDF class is a 2D lookup table of the GGX specular BRDF
+ * integrated over the hemisphere (split-sum approximation). For given N.V (s)
+ * and roughness (t) it stores scale (R) and bias (G) applied to F0.
+ * The table does not depend on the environment, it is computed once on the CPU.
+ */
+class GLTextureBRDF : public GLTexture
+{
+public:
+    explicit GLTextureBRDF(int size = 128, int samples = 512);
+    virtual void bind() Q_DECL_OVERRIDE;
+    virtual void unbind() Q_DECL_OVERRIDE;
 };
 
 
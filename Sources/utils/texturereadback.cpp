@@ -0,0 +1,143 @@
+#include "texturereadback.h"
+#include "../qopenglerrorcheck.h"
+#include <QOpenGLFunctions_3_3_Core>
+
+static QOpenGLFunctions_3_3_Core* currentFunctions(){
+    QOpenGLContext* context = QOpenGLContext::currentContext();
+    return (context != NULL) ? context->versionFunctions<QOpenGLFunctions_3_3_Core>() : NULL;
+}
+
+TextureReadback::TextureReadback():
+    buffer(0),
+    fence(0),
+    bufferSize(0),
+    width(0),
+    height(0),
+    bPending(false)
+{
+}
+
+void TextureReadback::start(QGLFramebufferObject* fbo){
+    QOpenGLFunctions_3_3_Core* gl = currentFunctions();
+    if(gl == NULL) return;
+
+    if(fence != 0) GLCHK(gl->glDeleteSync(fence));
+    fence  = 0;
+    width  = fbo->width();
+    height = fbo->height();
+
+    allocate(qint64(width)*height*3*sizeof(float));
+
+    GLCHK(fbo->bind());
+    // the copy goes to the buffer, glReadPixels does not wait for it
+    GLCHK(gl->glReadPixels(0, 0, width, height, GL_RGB, GL_FLOAT, 0));
+    GLCHK(fbo->bindDefault());
+    GLCHK(gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+
+    fence    = gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    bPending = true;
+}
+
+void TextureReadback::start(GLuint texture, GLenum format, GLenum type, int bytesPerPixel){
+    QOpenGLFunctions_3_3_Core* gl = currentFunctions();
+    if(gl == NULL) return;
+
+    if(fence != 0) GLCHK(gl->glDeleteSync(fence));
+    fence = 0;
+
+    GLint boundTexture;
+    GLCHK(gl->glGetIntegerv(GL_TEXTURE_BINDING_2D, &boundTexture));
+    GLCHK(gl->glBindTexture(GL_TEXTURE_2D, texture));
+    GLCHK(gl->glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH , &width ));
+    GLCHK(gl->glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height));
+
+    allocate(qint64(width)*height*bytesPerPixel);
+
+    GLCHK(gl->glPixelStorei(GL_PACK_ALIGNMENT, 1));
+    GLCHK(gl->glGetTexImage(GL_TEXTURE_2D, 0, format, type, 0));
+    GLCHK(gl->glPixelStorei(GL_PACK_ALIGNMENT, 4));
+    GLCHK(gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+    GLCHK(gl->glBindTexture(GL_TEXTURE_2D, boundTexture));
+
+    fence    = gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    bPending = true;
+}
+
+// Creates the buffer of given size and leaves it bound to GL_PIXEL_PACK_BUFFER.
+void TextureReadback::allocate(qint64 size){
+    QOpenGLFunctions_3_3_Core* gl = currentFunctions();
+    if(buffer == 0) GLCHK(gl->glGenBuffers(1, &buffer));
+    GLCHK(gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer));
+    if(size != bufferSize){
+        GLCHK(gl->glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ));
+        bufferSize = size;
+    }
+}
+
+bool TextureReadback::isPending() const{
+    return bPending;
+}
+
+bool TextureReadback::isReady(bool bWait){
+    if(!bPending) return false;
+    if(fence == 0) return true; // finished, not mapped yet
+
+    QOpenGLFunctions_3_3_Core* gl = currentFunctions();
+    if(gl == NULL) return false;
+    GLenum status = gl->glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                         bWait ? GL_TIMEOUT_IGNORED : 0);
+    if(status == GL_TIMEOUT_EXPIRED) return false;
+    GLCHK(gl->glDeleteSync(fence));
+    fence = 0;
+    return true;
+}
+
+const float* TextureReadback::map(){
+    return (const float*)mapData();
+}
+
+const void* TextureReadback::mapData(){
+    if(!isReady(false)) return NULL;
+    QOpenGLFunctions_3_3_Core* gl = currentFunctions();
+    if(gl == NULL) return NULL;
+
+    GLCHK(gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer));
+    const void* data = gl->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bufferSize, GL_MAP_READ_BIT);
+    GLCHK(gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+    if(data == NULL) bPending = false; // nothing to unmap, the copy is lost
+    return data;
+}
+
+void TextureReadback::unmap(){
+    QOpenGLFunctions_3_3_Core* gl = currentFunctions();
+    if(gl == NULL) return;
+
+    GLCHK(gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer));
+    GLCHK(gl->glUnmapBuffer(GL_PIXEL_PACK_BUFFER));
+    GLCHK(gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+    bPending = false;
+}
+
+int TextureReadback::getWidth() const{
+    return width;
+}
+
+int TextureReadback::getHeight() const{
+    return height;
+}
+
+qint64 TextureReadback::getSize() const{
+    return bufferSize;
+}
+
+void TextureReadback::release(){
+    QOpenGLFunctions_3_3_Core* gl = currentFunctions();
+    if(gl == NULL) return;
+
+    if(fence  != 0) GLCHK(gl->glDeleteSync(fence));
+    if(buffer != 0) GLCHK(gl->glDeleteBuffers(1, &buffer));
+    fence      = 0;
+    buffer     = 0;
+    bufferSize = 0;
+    bPending   = false;
+}
@@ -0,0 +1,53 @@
+#ifndef TEXTUREREADBACK_H
+#define TEXTUREREADBACK_H
+
+#include <QtOpenGL>
+#include <QGLFramebufferObject>
+
+/**
+ * @brief The TextureReadback class copies RGB pixels of an FBO (or the base
+ * level of a texture in any pixel transfer format) to a pixel buffer object. The copy is queued on the GPU and start() returns
+ * immediately. The data can be mapped when the fence placed after the copy
+ * is signaled, so the caller decides if it waits for the result or picks it
+ * up later. All functions need the GL context of the FBO to be current.
+ */
+class TextureReadback
+{
+public:
+    TextureReadback();
+
+    // Queues the copy of the FBO. Result of the previous copy is discarded.
+    void start(QGLFramebufferObject* fbo);
+    // Queues the copy of the base level of the texture, see glGetTexImage.
+    void start(GLuint texture, GLenum format, GLenum type, int bytesPerPixel);
+    // True if a copy was started and its data was not mapped yet.
+    bool isPending() const;
+    /**
+     * @brief isReady checks if the started copy is finished.
+     * @param bWait if true blocks until the GPU finished the copy
+     */
+    bool isReady(bool bWait);
+    // RGB float pixels (rows from the bottom) of the finished copy, unmap() must follow.
+    const float* map();
+    // Pixels of the finished copy in the format given to start(), unmap() must follow.
+    const void* mapData();
+    void unmap();
+
+    int getWidth() const;
+    int getHeight() const;
+    qint64 getSize() const;
+    // Deletes the buffer and the fence.
+    void release();
+
+private:
+    void allocate(qint64 size);
+
+    GLuint buffer;
+    GLsync fence;
+    qint64 bufferSize;
+    int    width;
+    int    height;
+    bool   bPending;
+};
+
+#endif // TEXTUREREADBACK_H
@@ -0,0 +1,120 @@
+#include "textureupload.h"
+#include "../qopenglerrorcheck.h"
+#include <QOpenGLFunctions_3_3_Core>
+
+bool TextureUpload::uploadFormat(QImage::Format format, Format& glFormat){
+    glFormat.bGray = false;
+    switch(format){
+        case(QImage::Format_RGB32):
+        case(QImage::Format_ARGB32):
+            // pixels are 0xAARRGGBB words, this works for any byte order
+            glFormat.internalFormat = GL_RGBA8;
+            glFormat.pixelFormat    = GL_BGRA;
+            glFormat.pixelType      = GL_UNSIGNED_INT_8_8_8_8_REV;
+            return true;
+        case(QImage::Format_RGBX8888):
+        case(QImage::Format_RGBA8888):
+            glFormat.internalFormat = GL_RGBA8;
+            glFormat.pixelFormat    = GL_RGBA;
+            glFormat.pixelType      = GL_UNSIGNED_BYTE;
+            return true;
+        case(QImage::Format_RGB888):
+            glFormat.internalFormat = GL_RGB8;
+            glFormat.pixelFormat    = GL_RGB;
+            glFormat.pixelType      = GL_UNSIGNED_BYTE;
+            return true;
+#if QT_VERSION >= QT_VERSION_CHECK(5,5,0)
+        case(QImage::Format_Grayscale8):
+            glFormat.internalFormat = GL_R8;
+            glFormat.pixelFormat    = GL_RED;
+            glFormat.pixelType      = GL_UNSIGNED_BYTE;
+            glFormat.bGray          = true;
+            return true;
+#endif
+        default: return false;
+    }
+}
+
+qint64 TextureUpload::upload(GLenum target, const QImage& _image, bool bFlip){
+
+    QImage image = _image; // shallow copy, data is shared with the source image
+    Format glFormat;
+    bool bNative = uploadFormat(image.format(),glFormat);
+    // all faces of a cube map must have the same internal format (and swizzle)
+    if(!bNative || (target != GL_TEXTURE_2D && glFormat.internalFormat != GL_RGBA8)){
+        image = image.convertToFormat(QImage::Format_ARGB32);
+        uploadFormat(image.format(),glFormat);
+    }
+
+    int width  = image.width();
+    int height = image.height();
+    // QImage lines are aligned to 4 bytes
+    GLCHK(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+
+    bool bUploaded = false;
+    if(!bFlip){
+        GLCHK(glTexImage2D(target, 0, glFormat.internalFormat, width, height, 0,
+                           glFormat.pixelFormat, glFormat.pixelType, image.constBits()));
+        bUploaded = true;
+    }else if(target == GL_TEXTURE_2D){
+        bUploaded = uploadFlipped(image,glFormat);
+    }
+    if(!bUploaded){
+        // cube map face or no framebuffer blit: upload the rows one by one in reversed order
+        GLCHK(glTexImage2D(target, 0, glFormat.internalFormat, width, height, 0,
+                           glFormat.pixelFormat, glFormat.pixelType, 0));
+        for(int y = 0 ; y < height ; y++){
+            glTexSubImage2D(target, 0, 0, height-1-y, width, 1,
+                            glFormat.pixelFormat, glFormat.pixelType, image.constScanLine(y));
+        }
+    }
+
+    if(glFormat.bGray){
+        GLint swizzle[4] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+        GLCHK(glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle));
+    }
+    return qint64(width)*height*(glFormat.bGray ? 1 : 4);
+}
+
+bool TextureUpload::uploadFlipped(const QImage& image, const Format& glFormat){
+    QOpenGLContext* context = QOpenGLContext::currentContext();
+    QOpenGLFunctions_3_3_Core* gl = (context != NULL) ?
+                context->versionFunctions<QOpenGLFunctions_3_3_Core>() : NULL;
+    if(gl == NULL) return false;
+
+    int width  = image.width();
+    int height = image.height();
+    GLint texture, readFramebuffer, drawFramebuffer;
+    GLCHK(gl->glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture));
+    GLCHK(gl->glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer));
+    GLCHK(gl->glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer));
+
+    // image rows as they are in a temporary texture
+    GLuint source;
+    GLCHK(gl->glGenTextures(1, &source));
+    GLCHK(gl->glBindTexture(GL_TEXTURE_2D, source));
+    GLCHK(gl->glTexImage2D(GL_TEXTURE_2D, 0, glFormat.internalFormat, width, height, 0,
+                           glFormat.pixelFormat, glFormat.pixelType, image.constBits()));
+    GLCHK(gl->glBindTexture(GL_TEXTURE_2D, texture));
+    GLCHK(gl->glTexImage2D(GL_TEXTURE_2D, 0, glFormat.internalFormat, width, height, 0,
+                           glFormat.pixelFormat, glFormat.pixelType, 0));
+
+    // flipped copy on the GPU
+    GLuint framebuffers[2];
+    GLCHK(gl->glGenFramebuffers(2, framebuffers));
+    GLCHK(gl->glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]));
+    GLCHK(gl->glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, source, 0));
+    GLCHK(gl->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]));
+    GLCHK(gl->glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0));
+    bool bComplete = gl->glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE &&
+                     gl->glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if(bComplete){
+        GLCHK(gl->glBlitFramebuffer(0, 0, width, height, 0, height, width, 0,
+                                    GL_COLOR_BUFFER_BIT, GL_NEAREST));
+    }
+    GLCHK(gl->glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer));
+    GLCHK(gl->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFramebuffer));
+    GLCHK(gl->glDeleteFramebuffers(2, framebuffers));
+    GLCHK(gl->glDeleteTextures(1, &source));
+    return bComplete;
+}
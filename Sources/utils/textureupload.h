@@ -0,0 +1,47 @@
+#ifndef TEXTUREUPLOAD_H
+#define TEXTUREUPLOAD_H
+
+#include <QtOpenGL>
+#include <QImage>
+
+/**
+ * @brief The TextureUpload class sends QImage pixels to a texture without
+ * intermediate copies. Formats which GL can read directly (32 bit RGB/ARGB,
+ * RGBA8888, RGB888, grayscale) are uploaded from the image memory as they are,
+ * other formats are converted to ARGB32 first. Images which have to be flipped
+ * to the GL bottom-up row order are uploaded as they are and flipped on the
+ * GPU with a framebuffer blit, so the CPU never copies the pixels.
+ */
+class TextureUpload
+{
+public:
+    // How the QImage memory is passed to glTexImage2D.
+    struct Format{
+        GLenum internalFormat;
+        GLenum pixelFormat;
+        GLenum pixelType;
+        bool   bGray; // single channel, sampled as (r,r,r,1)
+    };
+
+    /**
+     * @brief uploadFormat returns false if the image has to be converted before upload.
+     */
+    static bool uploadFormat(QImage::Format format, Format& glFormat);
+
+    /**
+     * @brief upload creates level 0 of the texture bound to target.
+     * @param target GL_TEXTURE_2D or one of the cube map faces (always uploaded
+     * as RGBA8, so all faces have the same format)
+     * @param bFlip if true the first row of the image is placed at the bottom
+     * of the texture (convention used by the FBOs and the filters)
+     * @return number of bytes used by the texture
+     */
+    static qint64 upload(GLenum target, const QImage& image, bool bFlip);
+
+private:
+    // Uploads image to the bound GL_TEXTURE_2D through a temporary texture
+    // and a flipped blit. Returns false if the blit is not possible.
+    static bool uploadFlipped(const QImage& image, const Format& glFormat);
+};
+
+#endif // TEXTUREUPLOAD_H
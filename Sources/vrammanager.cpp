@@ -0,0 +1,399 @@
+#include "vrammanager.h"
+#include "qopenglerrorcheck.h"
+#include "utils/texturereadback.h"
+#include <QOpenGLFunctions_3_3_Core>
+#include <QDebug>
+
+QMap<QGLFramebufferObject**,VRAMManager::Handle>        VRAMManager::handles;
+QMap<QString,QList<QGLFramebufferObject**> >            VRAMManager::visible;
+QMap<GLuint,VRAMManager::Allocation>                    VRAMManager::allocations;
+qint64  VRAMManager::budget        = 0; // 0 - no limit
+qint64  VRAMManager::usedMemory    = 0;
+qint64  VRAMManager::spilledMemory = 0;
+qint64  VRAMManager::savedMemory   = 0;
+qint64  VRAMManager::pendingSpillMemory = 0;
+quint64 VRAMManager::currentFrame  = 0;
+int     VRAMManager::noEvictions   = 0;
+QMutex  VRAMManager::mutex(QMutex::Recursive);
+
+// Pixel transfer format which keeps the data of given internal format unchanged.
+static bool transferFormat(GLint internalFormat, GLenum& format, GLenum& type, int& bytesPerPixel){
+    switch(internalFormat){
+        case(GL_R8):      format = GL_RED;  type = GL_UNSIGNED_BYTE; bytesPerPixel = 1;  break;
+        case(GL_R16F):    format = GL_RED;  type = GL_HALF_FLOAT;    bytesPerPixel = 2;  break;
+        case(GL_R32F):    format = GL_RED;  type = GL_FLOAT;         bytesPerPixel = 4;  break;
+        case(GL_RGB8):    format = GL_RGB;  type = GL_UNSIGNED_BYTE; bytesPerPixel = 3;  break;
+        case(GL_RGBA8):   format = GL_RGBA; type = GL_UNSIGNED_BYTE; bytesPerPixel = 4;  break;
+        case(GL_RGB16F):  format = GL_RGB;  type = GL_HALF_FLOAT;    bytesPerPixel = 6;  break;
+        case(GL_RGBA16F): format = GL_RGBA; type = GL_HALF_FLOAT;    bytesPerPixel = 8;  break;
+        case(GL_RGB32F):  format = GL_RGB;  type = GL_FLOAT;         bytesPerPixel = 12; break;
+        case(GL_RGBA32F): format = GL_RGBA; type = GL_FLOAT;         bytesPerPixel = 16; break;
+        default: return false;
+    }
+    return true;
+}
+
+void VRAMManager::registerHandle(QGLFramebufferObject** handle, const QString& owner, Policy policy){
+    QMutexLocker locker(&mutex);
+    Handle h;
+    h.owner  = owner;
+    h.policy = policy;
+    handles[handle] = h;
+}
+
+void VRAMManager::unregisterHandle(QGLFramebufferObject** handle){
+    QMutexLocker locker(&mutex);
+    handles.remove(handle);
+}
+
+void VRAMManager::swapHandles(QGLFramebufferObject** a, QGLFramebufferObject** b){
+    QMutexLocker locker(&mutex);
+    QGLFramebufferObject* tmp = *a;
+    *a = *b;
+    *b = tmp;
+    assignHandle(a);
+    assignHandle(b);
+}
+
+// Allocation of the FBO held by the pointer takes the owner and policy of the pointer.
+void VRAMManager::assignHandle(QGLFramebufferObject** handle){
+    if(*handle == NULL) return;
+    QMap<GLuint,Allocation>::iterator it = allocations.find((*handle)->texture());
+    if(it == allocations.end()) return;
+    it->handle = handle;
+    if(handles.contains(handle)){
+        it->owner  = handles[handle].owner;
+        it->policy = handles[handle].policy;
+    }
+}
+
+void VRAMManager::addAllocation(GLuint id, const Allocation& a){
+    removeAllocation(id); // in case the same object was reported twice
+    allocations[id] = a;
+    usedMemory  += a.bytes;
+    savedMemory += a.savedBytes;
+}
+
+void VRAMManager::removeAllocation(GLuint id){
+    QMap<GLuint,Allocation>::iterator it = allocations.find(id);
+    if(it == allocations.end()) return;
+    if(it->readback != NULL) cancelSpill(*it);
+    if(it->bSpilled){
+        spilledMemory -= it->bytes;
+    }else{
+        usedMemory    -= it->bytes;
+    }
+    savedMemory -= it->savedBytes;
+    allocations.erase(it);
+}
+
+void VRAMManager::allocated(QGLFramebufferObject** handle, qint64 bytes, qint64 savedBytes){
+    QMutexLocker locker(&mutex);
+    if(handle == NULL || *handle == NULL) return;
+
+    Allocation a;
+    a.owner         = "unregistered";
+    a.policy        = KEEP;
+    a.bytes         = bytes;
+    a.savedBytes    = savedBytes;
+    a.fbo           = *handle;
+    a.handle        = handle;
+    a.lastUsedFrame = currentFrame;
+    a.bSpilled      = false;
+    a.readback      = NULL;
+    if(handles.contains(handle)){
+        a.owner  = handles[handle].owner;
+        a.policy = handles[handle].policy;
+    }
+    addAllocation((*handle)->texture(),a);
+}
+
+void VRAMManager::touch(QGLFramebufferObject* fbo){
+    if(fbo != NULL) use(fbo->texture());
+}
+
+void VRAMManager::released(QGLFramebufferObject* fbo){
+    QMutexLocker locker(&mutex);
+    if(fbo != NULL) removeAllocation(fbo->texture());
+}
+
+void VRAMManager::allocatedTexture(GLuint id, qint64 bytes, const QString& owner, Policy policy, qint64 savedBytes){
+    QMutexLocker locker(&mutex);
+    Allocation a;
+    a.owner         = owner;
+    a.policy        = (policy == EVICT) ? KEEP : policy; // only FBOs can be recreated
+    a.bytes         = bytes;
+    a.savedBytes    = savedBytes;
+    a.fbo           = NULL;
+    a.handle        = NULL;
+    a.lastUsedFrame = currentFrame;
+    a.bSpilled      = false;
+    a.readback      = NULL;
+    addAllocation(id,a);
+}
+
+void VRAMManager::releasedTexture(GLuint id){
+    QMutexLocker locker(&mutex);
+    removeAllocation(id);
+}
+
+GLuint VRAMManager::use(GLuint id){
+    QMutexLocker locker(&mutex);
+    QMap<GLuint,Allocation>::iterator it = allocations.find(id);
+    if(it == allocations.end()) return id;
+    it->lastUsedFrame = currentFrame;
+    // the texture may be changed after this call so the copy is not valid anymore
+    if(it->readback != NULL) cancelSpill(*it);
+    if(it->bSpilled) restore(id,*it);
+    return id;
+}
+
+void VRAMManager::setVisible(const QString& view, const QList<QGLFramebufferObject**>& visibleHandles){
+    QMutexLocker locker(&mutex);
+    visible[view] = visibleHandles;
+}
+
+bool VRAMManager::isVisible(const Allocation& a){
+    if(a.handle == NULL) return false;
+    foreach(const QList<QGLFramebufferObject**>& viewHandles, visible){
+        if(viewHandles.contains(a.handle)) return true;
+    }
+    return false;
+}
+
+bool VRAMManager::spill(GLuint id, Allocation& a){
+    QOpenGLContext* context = QOpenGLContext::currentContext();
+    QOpenGLFunctions_3_3_Core* gl = (context != NULL) ?
+                context->versionFunctions<QOpenGLFunctions_3_3_Core>() : NULL;
+    if(gl == NULL) return false;
+
+    GLint texture;
+    GLCHK(gl->glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture));
+    GLCHK(gl->glBindTexture(GL_TEXTURE_2D, id));
+
+    GLint width, height, internalFormat, mipmapWidth;
+    GLCHK(gl->glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH , &width ));
+    GLCHK(gl->glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height));
+    GLCHK(gl->glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat));
+    GLCHK(gl->glGetTexLevelParameteriv(GL_TEXTURE_2D, 1, GL_TEXTURE_WIDTH , &mipmapWidth));
+    GLCHK(gl->glBindTexture(GL_TEXTURE_2D, texture));
+
+    GLenum format, type;
+    int bytesPerPixel;
+    if(width == 0 || height == 0 || !transferFormat(internalFormat,format,type,bytesPerPixel)){
+        return false;
+    }
+    a.width          = width;
+    a.height         = height;
+    a.internalFormat = internalFormat;
+    a.noLevels       = 1;
+    if(mipmapWidth > 0){
+        for(int size = qMax(width,height) ; size > 1 ; size /= 2) a.noLevels++;
+    }
+
+    // source textures do not change, the copy from the previous spill is still valid
+    if(!a.hostData.isEmpty()){
+        releaseStorage(id,a);
+        return true;
+    }
+    // the copy is queued, the storage is released when it is finished (see finishSpills)
+    a.readback = new TextureReadback();
+    a.readback->start(id,format,type,bytesPerPixel);
+    pendingSpillMemory += a.bytes;
+    return true;
+}
+
+/**
+ * @brief finishSpills moves the data of finished copies to host memory and
+ * releases their VRAM storage. Does not wait for the copies in progress.
+ */
+void VRAMManager::finishSpills(){
+    QMap<GLuint,Allocation>::iterator it = allocations.begin();
+    for(; it != allocations.end(); ++it){
+        if(it->readback == NULL || !it->readback->isReady(false)) continue;
+        const char* data = (const char*)it->readback->mapData();
+        if(data == NULL){
+            qWarning() << "VRAMManager:: cannot map the copy of" << it->owner;
+            cancelSpill(*it);
+            continue;
+        }
+        it->hostData = QByteArray(data,int(it->readback->getSize()));
+        it->readback->unmap();
+        cancelSpill(*it); // the copy is not needed anymore
+        releaseStorage(it.key(),*it);
+    }
+}
+
+void VRAMManager::cancelSpill(Allocation& a){
+    a.readback->release();
+    delete a.readback;
+    a.readback = NULL;
+    pendingSpillMemory -= a.bytes;
+}
+
+// Empty levels release the storage, the texture name and its parameters stay valid.
+void VRAMManager::releaseStorage(GLuint id, Allocation& a){
+    QOpenGLFunctions_3_3_Core* gl = QOpenGLContext::currentContext()->versionFunctions<QOpenGLFunctions_3_3_Core>();
+
+    GLenum format, type;
+    int bytesPerPixel;
+    transferFormat(a.internalFormat,format,type,bytesPerPixel);
+
+    GLint texture;
+    GLCHK(gl->glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture));
+    GLCHK(gl->glBindTexture(GL_TEXTURE_2D, id));
+    for(int level = 0 ; level < a.noLevels ; level++){
+        GLCHK(gl->glTexImage2D(GL_TEXTURE_2D, level, a.internalFormat, 0, 0, 0, format, type, NULL));
+    }
+    GLCHK(gl->glBindTexture(GL_TEXTURE_2D, texture));
+
+    a.bSpilled     = true;
+    usedMemory    -= a.bytes;
+    spilledMemory += a.bytes;
+    qDebug() << "VRAMManager::" << a.owner << "moved to host memory (" << a.bytes/(1024*1024) << "MB)";
+}
+
+void VRAMManager::restore(GLuint id, Allocation& a){
+    QOpenGLContext* context = QOpenGLContext::currentContext();
+    QOpenGLFunctions_3_3_Core* gl = (context != NULL) ?
+                context->versionFunctions<QOpenGLFunctions_3_3_Core>() : NULL;
+    if(gl == NULL){
+        qWarning() << "VRAMManager:: cannot restore" << a.owner << "without GL context.";
+        return;
+    }
+
+    GLenum format, type;
+    int bytesPerPixel;
+    transferFormat(a.internalFormat,format,type,bytesPerPixel);
+
+    GLint texture;
+    GLCHK(gl->glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture));
+    GLCHK(gl->glBindTexture(GL_TEXTURE_2D, id));
+    GLCHK(gl->glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+    GLCHK(gl->glTexImage2D(GL_TEXTURE_2D, 0, a.internalFormat, a.width, a.height, 0,
+                           format, type, a.hostData.constData()));
+    GLCHK(gl->glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+    if(a.noLevels > 1) GLCHK(gl->glGenerateMipmap(GL_TEXTURE_2D));
+    GLCHK(gl->glBindTexture(GL_TEXTURE_2D, texture));
+
+    // FBO content may be changed after this call
+    if(a.fbo != NULL) a.hostData.clear();
+    a.bSpilled     = false;
+    usedMemory    += a.bytes;
+    spilledMemory -= a.bytes;
+}
+
+void VRAMManager::nextFrame(){
+    QMutexLocker locker(&mutex);
+    currentFrame++;
+}
+
+qint64 VRAMManager::enforceBudget(){
+    QMutexLocker locker(&mutex);
+    finishSpills();
+    if(budget <= 0) return 0;
+
+    qint64 releasedBytes = 0;
+    while(usedMemory - pendingSpillMemory > budget){
+        // intermediate FBOs first, then the least recently used spillable
+        // texture which was not used in current frame
+        GLuint lruId      = 0;
+        bool   bFound     = false;
+        bool   bEvict     = false;
+        quint64 lruFrame  = currentFrame;
+        QMap<GLuint,Allocation>::iterator it = allocations.begin();
+        for(; it != allocations.end(); ++it){
+            if(it->policy == EVICT){
+                if(*(it->handle) != it->fbo) continue; // pointer was changed by owner
+                if(bEvict && it->lastUsedFrame >= lruFrame) continue;
+                bEvict = true;
+            }else if(it->policy == SPILL){
+                if(bEvict || it->bSpilled || it->readback != NULL ||
+                   it->lastUsedFrame >= lruFrame || isVisible(*it)) continue;
+            }else{
+                continue;
+            }
+            lruFrame = it->lastUsedFrame;
+            lruId    = it.key();
+            bFound   = true;
+        }
+        if(!bFound){
+            qWarning() << "VRAMManager:: memory budget exceeded (" << usedMemory/(1024*1024)
+                       << "MB of" << budget/(1024*1024) << "MB) but nothing can be released.";
+            break;
+        }
+
+        Allocation& a = allocations[lruId];
+        qint64 bytes  = a.bytes;
+        if(bEvict){
+            qDebug() << "VRAMManager:: evicting" << a.owner << "(" << bytes/(1024*1024) << "MB)";
+            QGLFramebufferObject*  fbo    = a.fbo;
+            QGLFramebufferObject** handle = a.handle;
+            removeAllocation(lruId);
+            delete fbo;
+            *handle = NULL;
+        }else{
+            qDebug() << "VRAMManager:: copying" << a.owner << "to host memory (" << bytes/(1024*1024) << "MB)";
+            if(!spill(lruId,a)){
+                a.policy = KEEP; // format without exact host representation
+                continue;
+            }
+        }
+        releasedBytes += bytes;
+        noEvictions++;
+    }
+    return releasedBytes;
+}
+
+void VRAMManager::setBudget(qint64 bytes){
+    QMutexLocker locker(&mutex);
+    budget = bytes;
+    qDebug() << "VRAMManager:: budget set to" << budget/(1024*1024) << "MB";
+}
+
+qint64 VRAMManager::getBudget(){
+    QMutexLocker locker(&mutex);
+    return budget;
+}
+
+qint64 VRAMManager::getUsedMemory(){
+    QMutexLocker locker(&mutex);
+    return usedMemory;
+}
+
+qint64 VRAMManager::getSpilledMemory(){
+    QMutexLocker locker(&mutex);
+    return spilledMemory;
+}
+
+qint64 VRAMManager::getSavedMemory(){
+    QMutexLocker locker(&mutex);
+    return savedMemory;
+}
+
+int VRAMManager::getNoEvictions(){
+    QMutexLocker locker(&mutex);
+    return noEvictions;
+}
+
+QMap<QString,qint64> VRAMManager::getUsageByOwner(){
+    QMutexLocker locker(&mutex);
+    QMap<QString,qint64> usage;
+    foreach(const Allocation& a, allocations){
+        if(!a.bSpilled) usage[a.owner] += a.bytes;
+    }
+    return usage;
+}
+
+void VRAMManager::report(){
+    QMutexLocker locker(&mutex);
+    qDebug() << "VRAMManager:: used memory" << usedMemory/(1024*1024) << "MB, budget"
+             << budget/(1024*1024) << "MB, in host memory" << spilledMemory/(1024*1024)
+             << "MB, saved by single channel formats" << savedMemory/(1024*1024)
+             << "MB, evictions" << noEvictions;
+    QMap<QString,qint64> usage = getUsageByOwner();
+    QMap<QString,qint64>::const_iterator it = usage.constBegin();
+    for(; it != usage.constEnd(); ++it){
+        qDebug() << "  " << it.key() << ":" << it.value()/(1024*1024) << "MB";
+    }
+}
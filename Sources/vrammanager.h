@@ -0,0 +1,153 @@
+#ifndef VRAMMANAGER_H
+#define VRAMMANAGER_H
+
+#include <QGLFramebufferObject>
+#include <QByteArray>
+#include <QString>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+
+class TextureReadback;
+
+/**
+ * @brief The VRAMManager class keeps track of all textures and FBOs allocated
+ * by the application. Each allocation is assigned to an owner and a policy
+ * which tells what can be done with it when the tracked memory exceeds the
+ * budget:
+ *  - intermediate buffers of the image processing pipeline are deleted, they
+ *    are created again by FBOImages::resize when they are needed,
+ *  - output images and source textures which are not shown by any view are
+ *    copied to host memory and their VRAM storage is released. The texture
+ *    name stays valid and the data is uploaded again by use() before the
+ *    texture is bound.
+ * All functions are thread safe, the images are processed by the render
+ * thread while the views use their results.
+ */
+class VRAMManager
+{
+public:
+    enum Policy{
+        KEEP = 0, // always resident
+        EVICT,    // recomputable intermediate, deleted when out of budget
+        SPILL     // moved to host memory when out of budget and not visible
+    };
+
+    /**
+     * @brief registerHandle assigns owner name to the FBO pointer. All FBOs
+     * created with FBOImages::create under this pointer will be accounted to owner.
+     * @param handle address of the FBO pointer
+     * @param owner name used in the report
+     * @param policy what can be done with the FBO when the budget is exceeded
+     */
+    static void registerHandle(QGLFramebufferObject** handle, const QString& owner, Policy policy = KEEP);
+    static void unregisterHandle(QGLFramebufferObject** handle);
+    /**
+     * @brief swapHandles swaps the FBOs of two registered pointers (e.g. front
+     * and back buffer of an image). Each FBO is accounted to the owner and
+     * the policy of the pointer which holds it after the swap.
+     */
+    static void swapHandles(QGLFramebufferObject** a, QGLFramebufferObject** b);
+
+    // Called by FBOImages when FBO is created, used or deleted.
+    // savedBytes is the memory saved by using a smaller format than the default one.
+    static void allocated(QGLFramebufferObject** handle, qint64 bytes, qint64 savedBytes = 0);
+    static void touch(QGLFramebufferObject* fbo);
+    static void released(QGLFramebufferObject* fbo);
+
+    // Textures which are not attached to any FBO (e.g. source images).
+    static void allocatedTexture(GLuint id, qint64 bytes, const QString& owner, Policy policy = KEEP, qint64 savedBytes = 0);
+    static void releasedTexture(GLuint id);
+
+    /**
+     * @brief use has to be called before a tracked texture is bound. Spilled
+     * texture is uploaded again from host memory. The texture is marked as
+     * used in the current frame. The GL context has to be current.
+     * @return the same texture id
+     */
+    static GLuint use(GLuint id);
+
+    /**
+     * @brief setVisible sets the FBOs shown by the given view. They are never
+     * spilled. Each view keeps its own list.
+     */
+    static void setVisible(const QString& view, const QList<QGLFramebufferObject**>& visibleHandles);
+
+    /**
+     * @brief nextFrame marks the beginning of new frame. Everything used
+     * after this call is considered as visible.
+     */
+    static void nextFrame();
+    /**
+     * @brief enforceBudget releases memory until the used memory fits the
+     * budget. Intermediate FBOs go first, they are expected to keep no data
+     * at the time of the call (end of the processing). Then the least recently
+     * used spillable textures which were not used in the current frame are
+     * moved to host memory. The copy to host memory does not block: it is
+     * queued to a pixel buffer and the VRAM storage is released by one of
+     * the next calls, when the GPU has finished the copy. Using the texture
+     * in the meantime cancels the spill. The GL context has to be current.
+     * @return number of released (or being released) bytes
+     */
+    static qint64 enforceBudget();
+
+    static void   setBudget(qint64 bytes);
+    static qint64 getBudget();
+    static qint64 getUsedMemory();
+    static qint64 getSpilledMemory();
+    // Memory saved by single channel formats of the allocated textures.
+    static qint64 getSavedMemory();
+    static int    getNoEvictions();
+    // Used memory per owner, sorted by owner name.
+    static QMap<QString,qint64> getUsageByOwner();
+    // Prints the used memory per owner, call it on demand only.
+    static void report();
+
+private:
+    struct Handle{
+        QString owner;
+        Policy  policy;
+    };
+    struct Allocation{
+        QString owner;
+        qint64  bytes;
+        qint64  savedBytes;
+        QGLFramebufferObject*  fbo;    // NULL for textures
+        QGLFramebufferObject** handle; // NULL for textures
+        Policy  policy;
+        quint64 lastUsedFrame;
+        // spilled texture
+        bool       bSpilled;
+        QByteArray hostData;
+        GLint      width;
+        GLint      height;
+        GLint      internalFormat;
+        int        noLevels;
+        TextureReadback* readback; // pending copy to host memory
+    };
+
+    static void   addAllocation(GLuint id, const Allocation& a);
+    static void   removeAllocation(GLuint id);
+    static bool   isVisible(const Allocation& a);
+    static bool   spill(GLuint id, Allocation& a);
+    static void   finishSpills();
+    static void   releaseStorage(GLuint id, Allocation& a);
+    static void   cancelSpill(Allocation& a);
+    static void   restore(GLuint id, Allocation& a);
+    static void   assignHandle(QGLFramebufferObject** handle);
+
+    static QMutex  mutex; // recursive, public functions call each other
+
+    static QMap<QGLFramebufferObject**,Handle> handles;
+    static QMap<QString,QList<QGLFramebufferObject**> > visible;
+    static QMap<GLuint,Allocation> allocations; // key is the texture id
+    static qint64  budget;
+    static qint64  usedMemory;
+    static qint64  spilledMemory;
+    static qint64  savedMemory;
+    static qint64  pendingSpillMemory; // spills waiting for the copy
+    static quint64 currentFrame;
+    static int     noEvictions;
+};
+
+#endif // VRAMMANAGER_H